@@ -73,4 +73,21 @@
 
 #define SET_DDRAM_ADDRESS			0x80
 
+/** Framebuffer driver (HD44780_Print())
+ * The display is written in the background by the microsecond timer (us_timer.c), one bus phase per callback, and only
+ * the cells that differ from what the display shows. Times in uS: the enable edges are far apart for the
+ * NHD-0216 (450 nS minimum), a byte takes 37 uS to execute, and with nothing to write the framebuffer is checked
+ * again every HD44780_POLL_US.
+ */
+#define HD44780_ROWS				2
+#define HD44780_COLS				16
+
+#define HD44780_EDGE_US				10
+#define HD44780_EXEC_US				50
+#define HD44780_POLL_US				20000
+
+void HD44780_Start(void);
+void HD44780_Print(uint8_t, const char *);
+void HD44780_Service(void);
+
 #endif /* HD44780_H_ */
@@ -0,0 +1,62 @@
+/** adc_acq.h
+ * Header file for the continuous, circular-mode DMA acquisition of the ADC1 regular sequence
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef ADC_ACQ_H_
+#define ADC_ACQ_H_
+
+#include "stm32f4xx_hal.h"
+#include "adc_filter.h"
+
+#include <stdbool.h>
+
+/** ADC Frame Description
+ * Indexes 0 - 3 are the regular sequence configured in MX_ADC1_Init(), 4 - 7 come from the injected group (see adc_sched.c)
+ * 0: Battery Bank Voltage
+ * 1: Solar Array Voltage
+ * 2: Battery Bank Current
+ * 3: Solar Array Current
+ * 4: Battery Load Voltage
+ * 5: Ambient Temperature
+ * 6: MOSFET Temperature
+ * 7: Battery Load Current
+ */
+#define ADC_ACQ_CHANNELS			8
+#define ADC_ACQ_REGULAR_CHANNELS	4
+
+// Number of raw passes through the regular sequence in each half of the DMA buffer. Every half is filtered down to one published frame.
+#define ADC_ACQ_FRAMES_PER_HALF		32
+
+// Decimation filter applied to each half buffer (see adc_filter.h)
+#define ADC_ACQ_FILTER				ADC_FILTER_MEDIAN3
+
+#define ADC_ACQ_BUFFER_SIZE			(2 * ADC_ACQ_FRAMES_PER_HALF * ADC_ACQ_REGULAR_CHANNELS)
+
+typedef struct
+{
+	uint16_t channel[ADC_ACQ_CHANNELS];		// Decimated ADC counts, indexed as described above
+	uint32_t sequence;						// Publish count of this frame, starting at 1
+	uint32_t timestamp;						// prof_Now() when the DMA finished the half buffer behind this frame
+} ADC_Frame;
+
+void adcAcq_Start(ADC_HandleTypeDef *);
+uint32_t adcAcq_GetFrame(ADC_Frame *);
+uint32_t adcAcq_GetSequence(void);
+uint32_t adcAcq_GetLostHalves(void);
+bool adcAcq_WaitFrames(uint8_t, uint32_t);
+void adcAcq_FrameCallback(const ADC_Frame *);
+
+#endif /* ADC_ACQ_H_ */
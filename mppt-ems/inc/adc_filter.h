@@ -0,0 +1,34 @@
+/** adc_filter.h
+ * Header file for the outlier rejecting decimation filter applied to each burst of ADC samples
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef ADC_FILTER_H_
+#define ADC_FILTER_H_
+
+#include <stdint.h>
+
+// Filter modes
+#define ADC_FILTER_MEAN			0	// Plain mean of every pass
+#define ADC_FILTER_TRIMMED		1	// Mean with the lowest and highest sample of each channel left out
+#define ADC_FILTER_MEDIAN3		2	// Mean of the sliding median of 3 passes
+#define ADC_FILTER_MEDIAN5		3	// Mean of the sliding median of 5 passes
+
+// Largest channel count (number of interleaved channels in a pass) the filter handles. Must be even.
+#define ADC_FILTER_MAX_CHANNELS	8
+
+void adcFilter_Run(const uint16_t *, uint8_t, uint8_t, uint8_t, uint16_t *);
+
+#endif /* ADC_FILTER_H_ */
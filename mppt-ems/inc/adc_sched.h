@@ -0,0 +1,50 @@
+/** adc_sched.h
+ * Header file for the ADC1 injected group scheduler that samples the slow channels at their own rates
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef ADC_SCHED_H_
+#define ADC_SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32f4xx_hal.h"
+
+// Slow channels, converted one at a time by the injected group. They fill ADC frame indexes 4 - 7 (see adc_acq.h).
+#define ADC_SCHED_SLOW_CHANNELS		4
+
+// Sample period of each slow channel, in mS
+#define ADC_SCHED_LOAD_PERIOD_MS	10		// Load voltage and current, 100 Hz
+#define ADC_SCHED_TEMP_PERIOD_MS	100		// LM335 temperatures, 10 Hz
+
+/** Sample time of each slow channel
+ * CC4 is placed for the longest of them (adcSched_SampleCycles()), and every one has to keep a whole injected
+ * conversion between the gate edges and clear of the regular one (adcSched_Verify()). The load dividers and the LM335
+ * outputs (under 1 Ohm dynamic impedance, buffered by their filter capacitors) settle well within 28 cycles.
+ */
+#define ADC_SCHED_LOAD_SAMPLETIME	ADC_SAMPLETIME_28CYCLES
+#define ADC_SCHED_TEMP_SAMPLETIME	ADC_SAMPLETIME_28CYCLES
+
+void adcSched_Init(ADC_HandleTypeDef *);
+uint16_t adcSched_SampleCycles(void);
+bool adcSched_Verify(uint16_t, uint16_t);
+void adcSched_Start(void);
+void adcSched_Poll(void);
+void adcSched_Collect(uint16_t *);
+uint32_t adcSched_GetRate(uint8_t);
+uint32_t adcSched_GetConversions(uint8_t);
+
+#endif /* ADC_SCHED_H_ */
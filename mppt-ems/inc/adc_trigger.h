@@ -0,0 +1,39 @@
+/** adc_trigger.h
+ * Header file for placing the PWM synchronized ADC trigger (TIM1 channel 3) between switching edges
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef ADC_TRIGGER_H_
+#define ADC_TRIGGER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// All times below are in TIM1 clock ticks (100 MHz, 10 nS). One center aligned PWM period is 2 * TIM1_PERIOD ticks.
+#define ADC_TRIG_TICKS_PER_ADC_CYCLE	2		// ADC clock is PCLK2 / 2 = 50 MHz
+#define ADC_TRIG_LATENCY_CYCLES			3		// ADC clock cycles from the trigger edge to the start of sampling
+#define ADC_TRIG_SAMPLE_CYCLES			15		// Must match ADC_SYNC_SAMPLETIME in MX_ADC1_Init()
+#define ADC_TRIG_CONVERSION_CYCLES		12		// 12 bit successive approximation, after the sample time
+
+// No part of the sampling window may come closer than this to any MOSFET gate edge
+#define ADC_TRIG_KEEPOUT_TICKS			10		// 100 nS
+
+uint16_t adcTrig_Clearance(uint16_t, uint16_t);
+uint16_t adcTrig_Select(void);
+bool adcTrig_Verify(uint16_t);
+uint16_t adcTrig_SelectInjected(uint16_t, uint16_t);
+bool adcTrig_VerifyInjected(uint16_t, uint16_t, uint16_t);
+
+#endif /* ADC_TRIGGER_H_ */
@@ -0,0 +1,59 @@
+/** calibration.h
+ * Header file for the per channel ADC calibration (offset and gain) stored in flash
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef CALIBRATION_H_
+#define CALIBRATION_H_
+
+#include <stdint.h>
+
+#include "adc_acq.h"
+
+// Start of flash sector 4, written by the mppt-test calibration program. The host build puts its flash elsewhere.
+#ifndef CAL_RECORD_ADDRESS
+#define CAL_RECORD_ADDRESS	0x08010000
+#endif
+
+#define CAL_MAGIC			0xCA1B
+#define CAL_VERSION			1
+
+#define CAL_GAIN_ONE		16384		// Gains are Q14
+#define CAL_MAX_COUNTS		4095		// Corrected readings are clamped to the 12 bit ADC range
+
+/** Calibration record, version 1
+ * Channels are indexed as in the ADC frame (see adc_acq.h). A corrected reading is
+ * (raw - offset) * gain / CAL_GAIN_ONE, so the gain trims the divider, INA213 and sense resistor tolerances
+ * that the nominal scale factors in measure.h don't know about.
+ */
+typedef struct
+{
+	uint16_t magic;								// CAL_MAGIC
+	uint16_t version;							// CAL_VERSION
+	int16_t offset[ADC_ACQ_CHANNELS];			// ADC counts read with zero input
+	uint16_t gain[ADC_ACQ_CHANNELS];			// Q14 gain correction
+	uint16_t crc;								// crc16() of everything above, seeded with 0xffff
+} CAL_Record;
+
+// Where the coefficients in use came from
+#define CAL_SOURCE_DEFAULT	0	// Nothing usable in flash: zero offsets, unity gains
+#define CAL_SOURCE_LEGACY	1	// The five uint16 offsets of the original layout, unity gains
+#define CAL_SOURCE_RECORD	2	// A valid CAL_Record
+
+uint8_t calib_Load(const void *);
+uint16_t calib_Apply(uint8_t, uint16_t);
+uint8_t calib_GetSource(void);
+
+#endif /* CALIBRATION_H_ */
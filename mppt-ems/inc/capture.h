@@ -0,0 +1,52 @@
+/** capture.h
+ * Header file for the ADC frame capture (frames, duty cycle and control state, streamed over the UART)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "adc_acq.h"
+
+// Records held until the main context sends them. A record is 21 bytes on the UART.
+#define CAPTURE_RECORDS			64
+
+// Control state bits in CAPTURE_Record.flags. Bits 5 - 7 hold the active strategy (MPPT_STRATEGY_x).
+#define CAPTURE_MPPT_RUNNING	0x01
+#define CAPTURE_REGULATING		0x02
+#define CAPTURE_SCANNING		0x04
+#define CAPTURE_BYPASS			0x08
+#define CAPTURE_CHARGING		0x10
+#define CAPTURE_STRATEGY_SHIFT	5
+
+typedef struct
+{
+	uint16_t frame;							// Low 16 bits of the frame sequence number
+	uint32_t tick;							// HAL_GetTick() in mS
+	uint16_t channel[ADC_ACQ_CHANNELS];		// The published frame, as getADCreadings() reads it
+	uint16_t duty;							// Duty cycle TIM1 was given after this frame, 1/16 counts (0: converter off)
+	uint8_t flags;
+} CAPTURE_Record;
+
+void capture_Start(uint16_t, bool);
+void capture_Stop(void);
+void capture_Frame(const ADC_Frame *, uint32_t, uint16_t, uint8_t);
+uint8_t capture_Read(CAPTURE_Record *, uint8_t);
+uint16_t capture_GetDropped(void);
+
+#endif /* CAPTURE_H_ */
@@ -0,0 +1,35 @@
+/** charge_reg.h
+ * Header file for the constant voltage (absorption / float) battery voltage regulator
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef CHARGE_REG_H_
+#define CHARGE_REG_H_
+
+#include <stdint.h>
+
+/** PI gains in Q16, duty cycle in 1/16 counts per mV of battery voltage error
+ * Kp: 100 mV of error backs the duty off by one count.
+ * Ki: per control step. 100 mV of error held for 150 steps (about 0.1 S) moves the duty by one more count.
+ */
+#define CHARGE_REG_KP_Q16		10486
+#define CHARGE_REG_KI_Q16		70
+
+void chargeReg_SetTarget(int32_t);
+int32_t chargeReg_GetTarget(void);
+void chargeReg_Reset(uint16_t);
+uint16_t chargeReg_Step(int32_t, uint16_t);
+
+#endif /* CHARGE_REG_H_ */
@@ -0,0 +1,36 @@
+/** converter.h
+ * Header file for the switching converter (TIM1) settings and duty cycle limits
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Nothing here depends on the HAL, so the control code (the MPPT strategies, the scan and the battery voltage
+ * regulator) only needs this header and builds on its own, e.g. against a model of the converter.
+ */
+
+// Prevent recursive inclusion
+#ifndef CONVERTER_H_
+#define CONVERTER_H_
+
+// TIM1 (switching converter) settings, see MX_TIM1_Init() in mppt.c
+#define TIM1_PERIOD			256		// Center aligned, 2 * 256 ticks of 10 nS per PWM period
+#define TIM1_DEADTIME		22		// Dead time in TIM1 ticks, about 220 nS
+
+#define MIN_DUTY_CYCLE		192		//75% of the TIM1 period
+#define MAX_DUTY_CYCLE  	235 	//92% of the TIM1 period
+#define PCT80_DUTY_CYCLE 	205
+
+// The MPPT works with duty cycles in 1/16 TIM1 counts (see pwm_dither.c)
+#define DUTY_FRACTION_BITS	4
+#define DUTY_FINE(counts)	((counts) << DUTY_FRACTION_BITS)
+
+#endif /* CONVERTER_H_ */
@@ -0,0 +1,36 @@
+/** event.h
+ * Header file for the deferred event queue
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Events an interrupt leaves for the main context (see TASK_EVENTS in mppt.c)
+#define EVENT_NONE			0
+#define EVENT_SECOND		1		// TIM9 counted off another second
+
+// Events the queue holds. One slot always stays empty, so this many - 1 can be pending.
+#define EVENT_QUEUE_SIZE	16
+
+bool event_Post(uint8_t);
+uint8_t event_Get(void);
+uint16_t event_GetDropped(void);
+uint8_t event_GetHighWater(void);
+
+#endif /* EVENT_H_ */
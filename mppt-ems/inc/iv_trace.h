@@ -0,0 +1,44 @@
+/** iv_trace.h
+ * Header file for the solar array I-V curve tracer
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef IV_TRACE_H_
+#define IV_TRACE_H_
+
+#include <stdint.h>
+
+// Room for one point per duty count from MIN_DUTY_CYCLE to MAX_DUTY_CYCLE
+#define IV_TRACE_MAX_POINTS		64
+
+// Published ADC frames to let go by after every duty change before the point is taken (about 0.65 mS each)
+#define IV_TRACE_SETTLE_FRAMES	2
+
+// A sweep is abandoned if the ADC stops publishing frames for this long (mS)
+#define IV_TRACE_TIMEOUT_MS		10
+
+typedef struct
+{
+	uint16_t duty;
+	uint16_t vSolar;		// mV
+	uint16_t iSolar;		// mA
+} IV_Point;
+
+uint8_t ivTrace_Sweep(uint16_t, uint16_t, void (*)(uint16_t));
+void ivTrace_Clear(void);
+uint8_t ivTrace_GetCount(void);
+const IV_Point *ivTrace_GetPoint(uint8_t);
+
+#endif /* IV_TRACE_H_ */
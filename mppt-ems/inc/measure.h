@@ -0,0 +1,41 @@
+/** measure.h
+ * Header file for the fixed-point conversion of ADC counts to engineering units
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef MEASURE_H_
+#define MEASURE_H_
+
+#include <stdint.h>
+
+/** Scale factors in Q16 (units per ADC count * 65536)
+ * adcUnit = Vref / 2^12 = 0.000806 V, the voltage divider gives 0.0623 V out / V in,
+ * the INA213AIDCK has a gain of 50 into 0.002 Ohm sense resistors and the LM335 scaling gives 10 mV / degC.
+ */
+#define MEAS_MV_PER_COUNT_Q16	847865UL	// 0.000806 / 0.0623 * 1000 = 12.9374 mV
+#define MEAS_MA_PER_COUNT_Q16	528220UL	// 0.000806 / 50 / 0.002 * 1000 = 8.06 mA
+#define MEAS_CC_PER_COUNT_Q16	528220UL	// 0.000806 / 0.010 * 100 = 8.06 centi-degC
+#define MEAS_CC_OFFSET			5000		// 50 degC
+
+// Splits a positive mV or mA value into whole units and hundredths for "%d.%02d" formatting
+#define MEAS_WHOLE(x)			((int)((x) / 1000))
+#define MEAS_HUNDREDTHS(x)		((int)(((x) % 1000) / 10))
+
+int32_t calcVoltage(uint16_t, uint8_t);
+int32_t calcCurrent(uint16_t);
+int32_t calcTemperature(uint16_t);
+int32_t calcPower(int32_t, int32_t);
+
+#endif /* MEASURE_H_ */
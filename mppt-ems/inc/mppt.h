@@ -42,21 +42,21 @@
 #define MAX_CHARGE_CURRENT	0xEBA	// 3722 counts = 30 amps
 
 
-// Adsorption Threshold voltage values at specified _temperature (flooded)
-#define ATV_25        		14.4
-#define ATV_40      		13.97
-#define ATV_NEG30			16.05
-#define ATV_80				12.75
-
-// Float Threshold voltage values at specified _temperature (flooded)
-#define FTV_25        		13.5
-#define FTV_40      		13.06
-#define FTV_NEG30			14.87
-#define FTV_80				12.13
-
-// Rate, in volts/degC,  at which battery voltage declines with increasing temperature.
+// Adsorption Threshold voltage values in mV at specified _temperature (flooded)
+#define ATV_25        		14400
+#define ATV_40      		13970
+#define ATV_NEG30			16050
+#define ATV_80				12750
+
+// Float Threshold voltage values in mV at specified _temperature (flooded)
+#define FTV_25        		13500
+#define FTV_40      		13060
+#define FTV_NEG30			14870
+#define FTV_80				12130
+
+// Rate, in mV/degC,  at which battery voltage declines with increasing temperature.
 // Used in floatVoltage() and adsorptionVoltage() calculations
-#define RATE1				.029
+#define RATE1				29
 
 // Ambient temperature values in deg Celsius
 #define TEMP_0      		0
@@ -71,9 +71,86 @@
 /* This is the maximum temperature degC beyond which is considered as overheated */
 #define MAXTEMP				100
 
+// TIM1 (switching converter) settings and duty cycle limits
+#include "converter.h"
+
+// Running statistics (see updateStats()), one set of windows per measured value
+#define STAT_VBAT			0
+#define STAT_IBAT			1
+#define STAT_VSOLAR			2
+#define STAT_ISOLAR			3
+#define STAT_VLOAD			4
+#define STAT_ILOAD			5
+#define STAT_QUANTITIES		6
+
+#define STAT_DISPLAY_SLOTS	5		// 5 x 1 second
+#define STAT_MINUTE_SLOTS	60		// 60 x 1 second
+#define STAT_QUARTER_SLOTS	60		// 60 x 15 seconds = 15 minutes
+#define STAT_QUARTER_DECIMATION	15
+
+// Main loop tasks (see tasks[] in mppt.c), in priority order. Periods in mS.
+#define TASK_EVENTS			0		// eventTask(): the work interrupts posted to the event queue
+#define TASK_MEASURE		1		// getADCreadings()
+#define TASK_CHARGE			2		// chargeTask(), right after the readings it works from
+#define TASK_REQUESTS		3		// Replies to the UART commands
+#define TASK_MESSAGE		4		// The periodic data packet (the console line with DEBUG2)
+#define TASK_STATS			5		// updateStats()
+#define TASK_LCD			6		// updateLCD()
+#define TASKS				7
+
+#define EVENTS_PERIOD		10
+#define MEASURE_PERIOD		100
+#define REQUESTS_PERIOD		10
+#define STATS_PERIOD		1000
+#define LCD_PERIOD			1000
+
+/** Charge stages (chargeTask())
+ * CHARGE_OFF, DARK, DESULFATE and IDLE are re-selected on every run from the array and battery voltages.
+ * From IDLE the battery can need charging (WAIT), which starts the converter (START) and tracks the MPP (MPPT),
+ * or, after too long at MAX_DUTY_CYCLE, connects the array straight to the battery for a while (BYPASS).
+ */
+#define CHARGE_OFF			0		// Battery below BAT_DROP_DEAD_VOLT or the MOSFETs overheated: everything off
+#define CHARGE_DARK			1		// Array below the battery
+#define CHARGE_DESULFATE	2		// Array above the battery, but not by TWO_VOLT: desulfation pulses only
+#define CHARGE_IDLE			3		// Array can charge, but the battery doesn't need it
+#define CHARGE_WAIT			4		// Converter off: array at its open circuit voltage, or waiting out LOW_CHARGE_CURRENT_TIMEOUT
+#define CHARGE_START		5		// Converter started at the seed duty cycle, checking for THRESHOLD_CURRENT
+#define CHARGE_MPPT			6		// MPPT control loop (and charge regulator) running
+#define CHARGE_BYPASS		7		// Array switched straight to the battery
+
+// UART commands (inBuff[1]), see handleData()
+#define CMD_POWER_CYCLE		0x00
+#define CMD_STATISTICS		0x01
+#define CMD_STRATEGY		0x02		// inBuff[2]: MPPT_STRATEGY_x
+#define CMD_IV_TRACE		0x03
+#define CMD_BENCHMARK		0x04		// inBuff[2]: 1 clears the counters after sending them
+#define CMD_PROFILE			0x05		// inBuff[2]: 1 clears the profiler records after sending them
+#define CMD_CAPTURE			0x06		// inBuff[2], inBuff[3]: frames per record (MSB first, 0 stops), inBuff[4]: 1 for a burst
+#define CMD_SCHEDULE		0x07		// inBuff[2]: 1 clears the task counters after sending them
+
+// Message types that follow the version string in frames sent to the controller
+#define MSG_DATA			0x9e
+#define MSG_STATISTICS		0x9d
+#define MSG_IV_TRACE		0x9c
+#define MSG_BENCHMARK		0x99
+#define MSG_PROFILE			0x98
+#define MSG_CAPTURE			0x97
+#define MSG_SCHEDULE		0x96
+
+// I-V points sent per MSG_IV_TRACE frame (5 bytes each)
+#define IV_POINTS_PER_FRAME	20
+
+// Capture records sent per MSG_CAPTURE frame (21 bytes each)
+#define CAPTURE_PER_FRAME	4
+
+// Frames of a full I-V trace
+#define IV_TRACE_FRAMES		((IV_TRACE_MAX_POINTS + IV_POINTS_PER_FRAME - 1) / IV_POINTS_PER_FRAME)
+
+// UART frames that can be on their way out at once (see txBuffer in mppt.c), at least IV_TRACE_FRAMES
+#define TX_BUFFERS			4
+
 void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
 void HD44780_Init(void);
-void HD44780_WriteData(uint8_t, uint8_t, char *, uint8_t);
 void HD44780_WriteCommand(uint8_t);
 void HD44780_GotoXY(uint8_t, uint8_t);
 void delay_us(uint32_t);
@@ -0,0 +1,45 @@
+/** mppt_bench.h
+ * Header file for the per strategy MPPT tracking performance counters
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef MPPT_BENCH_H_
+#define MPPT_BENCH_H_
+
+#include <stdint.h>
+
+#include "mppt_strategy.h"
+
+// A strategy has converged once the array power reaches this share of the available power (percent)
+#define MPPT_BENCH_CONVERGED_PCT	98
+
+// Totals for one strategy, in control steps. All sums only cover steps with a known available power.
+typedef struct
+{
+	uint32_t steps;				// Tracking steps
+	uint64_t energy;			// Sum of the array power, mW * steps
+	uint64_t available;			// Sum of the available power, mW * steps
+	uint64_t ripple;			// Sum of the power change from one step to the next, mW
+	uint32_t convergeSteps;		// Sum of the steps it took to converge
+	uint16_t converged;			// Number of times it converged
+} MPPT_BenchRecord;
+
+void mpptBench_Reset(void);
+void mpptBench_SetPeak(int32_t);
+void mpptBench_Start(void);
+void mpptBench_Step(uint8_t, int32_t);
+void mpptBench_Get(uint8_t, MPPT_BenchRecord *);
+
+#endif /* MPPT_BENCH_H_ */
@@ -0,0 +1,43 @@
+/** mppt_scan.h
+ * Header file for the periodic global peak scan that keeps the MPPT off local maxima
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef MPPT_SCAN_H_
+#define MPPT_SCAN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mppt_strategy.h"
+
+// Time between scans in mS, 0 turns scanning off
+#define MPPT_SCAN_INTERVAL_MS	600000UL		// 10 minutes
+
+// Scan budget: at most this many duty cycles are visited per scan, spread evenly over MIN_DUTY_CYCLE..MAX_DUTY_CYCLE
+#define MPPT_SCAN_POINTS		22
+
+// Control steps to wait at each point before its power is measured (about 10 mS at the default control rate)
+#define MPPT_SCAN_SETTLE_STEPS	15
+
+void mpptScan_Schedule(uint32_t);
+bool mpptScan_Due(uint32_t);
+void mpptScan_Start(uint32_t);
+void mpptScan_Cancel(void);
+bool mpptScan_Active(void);
+bool mpptScan_Step(const MPPT_Measurement *, uint16_t *);
+int32_t mpptScan_GetPeakPower(void);
+
+#endif /* MPPT_SCAN_H_ */
@@ -0,0 +1,103 @@
+/** mppt_strategy.h
+ * Header file for the runtime selectable MPPT strategies
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef MPPT_STRATEGY_H_
+#define MPPT_STRATEGY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Strategy indexes, as sent with the UART strategy command
+#define MPPT_STRATEGY_PO		0	// Perturb and observe (the original calcMPPT())
+#define MPPT_STRATEGY_TI		1	// Perturb and observe on power only (calcMPPT_TI())
+#define MPPT_STRATEGY_IC		2	// Incremental conductance
+#define MPPT_STRATEGY_CV		3	// Constant voltage ratio (from mppt-test)
+#define MPPT_STRATEGY_VPO		4	// Variable step perturb and observe
+#define MPPT_STRATEGY_COUNT		5
+
+// Solar array voltage the constant voltage strategy holds the converter input at
+#define MPPT_CV_TARGET_MV		16000
+
+/** Cold start
+ * Before the converter starts, the array sits at its open circuit voltage. The MPP of crystalline panels is close to
+ * 0.76 Voc, and the buck converter runs at duty = Vbattery / Varray, so that is where the duty cycle starts.
+ */
+#define MPPT_SEED_VOC_FRACTION_Q8	195		// 0.76 * 256
+
+// Incremental conductance step, in 1/16 duty counts
+#define MPPT_IC_STEP			8
+
+/** Incremental conductance deadbands
+ * A step changing the array voltage by no more than MPPT_IC_DV_DEADBAND_MV counts as no voltage change, then a current
+ * change of no more than MPPT_IC_DI_DEADBAND_MA counts as no change at all. A power change of no more than
+ * MPPT_IC_DP_DEADBAND_MW counts as being at the MPP. The duty cycle holds in all three cases.
+ */
+#define MPPT_IC_DV_DEADBAND_MV	25
+#define MPPT_IC_DI_DEADBAND_MA	25
+#define MPPT_IC_DP_DEADBAND_MW	100
+
+/** Variable step P&O settings
+ * The step is |dP/dV| (mW / mV) * MPPT_VPO_GAIN_Q8 / 256 duty counts, limited to MPPT_VPO_MIN_STEP..MPPT_VPO_MAX_STEP
+ * (1/16 counts). dP/dV is about the array current far from the MPP and falls to 0 at it, so 0.8 gives about 8 counts at 10 A.
+ * A step changing the array voltage by no more than MPPT_VPO_DV_DEADBAND_MV (two ADC counts) says nothing about dP/dV
+ * and gets the smallest step.
+ * Perturbation stops after MPPT_VPO_FLAT_STEPS steps in a row that change the power by no more than MPPT_VPO_FLAT_MW,
+ * and starts again once the power drifts further than that from where it stopped.
+ */
+#define MPPT_VPO_GAIN_Q8		205
+#define MPPT_VPO_MIN_STEP		8
+#define MPPT_VPO_MAX_STEP		128
+#define MPPT_VPO_DV_DEADBAND_MV	25
+#define MPPT_VPO_FLAT_MW		150
+#define MPPT_VPO_FLAT_STEPS		5
+
+// Measurements a strategy works from: voltages in mV, currents in mA (see measure.h)
+typedef struct
+{
+	int32_t vSolar;
+	int32_t iSolar;
+	int32_t vBat;
+	int32_t iBat;
+} MPPT_Measurement;
+
+/** A strategy
+ * Duty cycles are in 1/16 TIM1 counts (DUTY_FRACTION_BITS in mppt.h).
+ * init:  charging starts at duty with the converter input at m
+ * step:  called every control period, returns the next duty command. The caller limits it to MIN_DUTY_CYCLE..MAX_DUTY_CYCLE
+ *        and passes the limited value back as duty on the next step.
+ * reset: forget everything learned, e.g. when the strategy is switched
+ */
+typedef struct
+{
+	void (*init)(const MPPT_Measurement *m, uint16_t duty);
+	int32_t (*step)(const MPPT_Measurement *m, uint16_t duty);
+	void (*reset)(void);
+} MPPT_Strategy;
+
+extern const MPPT_Strategy mpptPO;
+extern const MPPT_Strategy mpptTI;
+extern const MPPT_Strategy mpptIC;
+extern const MPPT_Strategy mpptCV;
+extern const MPPT_Strategy mpptVPO;
+
+bool mpptStrategy_Select(uint8_t);
+uint8_t mpptStrategy_GetActive(void);
+void mpptStrategy_Init(const MPPT_Measurement *, uint16_t);
+int32_t mpptStrategy_Step(const MPPT_Measurement *, uint16_t);
+uint16_t mpptStrategy_SeedDuty(int32_t, int32_t);
+
+#endif /* MPPT_STRATEGY_H_ */
@@ -0,0 +1,47 @@
+/** profile.h
+ * Header file for the cycle count profiler
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+// Probe points, in the order they are sent with CMD_PROFILE
+#define PROF_GET_ADC_READINGS	0		// getADCreadings(), including everything it calls
+#define PROF_MPPT_STEP			1		// One control loop step, in the ADC interrupt
+#define PROF_UPDATE_LCD			2		// updateLCD()
+#define PROF_SEND_MESSAGE		3		// sendMessage()
+#define PROF_DEBUG_PRINT		4		// The DEBUG2 console output
+#define PROF_UPDATE_STATS		5		// updateStats()
+#define PROF_TICK_ISR			6		// The TIM9 1 mS interrupt, HAL handler included
+#define PROF_PROBES				7
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;				// Cycles (ns on a host build)
+	uint32_t max;
+	uint64_t total;
+} PROF_Record;
+
+void prof_Init(void);
+uint32_t prof_Now(void);
+void prof_Stop(uint8_t, uint32_t);
+void prof_Get(uint8_t, PROF_Record *);
+void prof_Reset(void);
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,27 @@
+/** pwm_dither.h
+ * Header file for the high resolution TIM1 duty cycle (dithering between adjacent counts)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef PWM_DITHER_H_
+#define PWM_DITHER_H_
+
+#include <stdint.h>
+
+void pwmDither_Set(uint16_t);
+void pwmDither_Start(void);
+void pwmDither_Stop(void);
+
+#endif /* PWM_DITHER_H_ */
@@ -0,0 +1,54 @@
+/** sched.h
+ * Header file for the cooperative task scheduler
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+
+/** A task
+ * Released every period ticks, the first time offset ticks after sched_Init(), and expected to have finished
+ * deadline ticks after its release. Tasks run to completion; when several are due, the first one in the table runs first.
+ */
+typedef struct
+{
+	void (*run)(void);
+	uint16_t period;
+	uint16_t offset;
+	uint16_t deadline;
+} SCHED_Task;
+
+// What the scheduler keeps per task. Times are in ticks.
+typedef struct
+{
+	uint32_t release;			// Next release
+	uint32_t runs;
+	uint16_t misses;			// Runs that finished after their deadline
+	uint16_t skipped;			// Releases that passed while the task was still waiting to run
+	uint16_t lateness;			// Start of the last run after its release
+	uint16_t maxLateness;
+	uint32_t totalLateness;
+	uint16_t maxRun;			// Longest run
+} SCHED_State;
+
+void sched_Init(const SCHED_Task *, SCHED_State *, uint8_t, uint32_t (*)(void));
+void sched_Run(void);
+uint8_t sched_Count(void);
+const SCHED_State *sched_GetState(uint8_t);
+void sched_ResetStats(void);
+
+#endif /* SCHED_H_ */
@@ -0,0 +1,57 @@
+/** stats.h
+ * Header file for the fixed-size running window statistics (mean, min, max, variance)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+
+/** A window over the last size slots. Every slot holds the mean of decimation consecutive samples,
+ * so a window of 60 slots with a decimation of 15 covers 15 minutes of 1 second samples.
+ * The caller owns the storage: sample, minQ and maxQ must each have room for size entries (size <= 255).
+ */
+typedef struct
+{
+	int32_t *sample;			// Ring of slot values
+	uint8_t *minQ;				// Slot indexes with increasing values, oldest first (front is the minimum)
+	uint8_t *maxQ;				// Slot indexes with decreasing values, oldest first (front is the maximum)
+	uint8_t size;
+	uint8_t decimation;
+
+	uint8_t head;				// Next slot to write
+	uint8_t count;				// Slots in use
+	uint8_t minFront, minCount;
+	uint8_t maxFront, maxCount;
+
+	uint8_t pending;			// Samples accumulated towards the next slot
+	int32_t pendingSum;
+
+	int32_t sum;
+	int64_t sumSquares;
+} STATS_Window;
+
+void stats_Init(STATS_Window *, int32_t *, uint8_t *, uint8_t *, uint8_t, uint8_t);
+void stats_Reset(STATS_Window *);
+void stats_Add(STATS_Window *, int32_t);
+uint8_t stats_Count(const STATS_Window *);
+int32_t stats_Mean(const STATS_Window *);
+int32_t stats_Min(const STATS_Window *);
+int32_t stats_Max(const STATS_Window *);
+uint32_t stats_Variance(const STATS_Window *);
+uint32_t stats_StdDev(const STATS_Window *);
+
+#endif /* STATS_H_ */
@@ -58,6 +58,12 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void TIM1_BRK_TIM9_IRQHandler(void);
+void TIM1_TRG_COM_TIM11_IRQHandler(void);
+void USART1_IRQHandler(void);
+void ADC_IRQHandler(void);
+void DMA2_Stream0_IRQHandler(void);
+void DMA2_Stream7_IRQHandler(void);
 
 #ifdef __cplusplus
 }
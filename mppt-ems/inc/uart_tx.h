@@ -0,0 +1,44 @@
+/** uart_tx.h
+ * Header file for the DMA driven UART transmit queue
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef UART_TX_H_
+#define UART_TX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32f4xx_hal.h"
+
+// Frames that can wait for the UART, the one going out included. One slot always stays empty.
+#define UART_TX_QUEUE		9
+
+// Called from the USART1 interrupt once the last byte of data has gone out; data can be reused from then on
+typedef void (*UART_TxDone)(const uint8_t *data);
+
+// A frame waiting for, or going out on, the UART. The data is the caller's and is not copied.
+typedef struct
+{
+	const uint8_t *data;
+	uint16_t length;
+	UART_TxDone done;
+} UART_TxFrame;
+
+void uartTx_Init(UART_HandleTypeDef *);
+bool uartTx_Send(const uint8_t *, uint16_t, UART_TxDone);
+void uartTx_Complete(void);
+
+#endif /* UART_TX_H_ */
@@ -0,0 +1,44 @@
+/** us_timer.h
+ * Header file for the one-shot microsecond timers
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef US_TIMER_H_
+#define US_TIMER_H_
+
+#include <stdint.h>
+
+// Timer slots, one per user. Each slot holds at most one pending callback.
+#define US_TIMER_LCD		0		// HD44780 bus phases (HD44780.c)
+#define US_TIMER_PULSE		1		// Desulfation pulse edges (pulse() in mppt.c)
+#define US_TIMER_SLOTS		2
+
+// TIM11 prescaler for a 1 uS count: the 100 MHz APB2 timer clock / 100 (MX_TIM11_Init() in mppt.c)
+#define US_TIMER_PRESCALER	99
+
+// Longest delay that can be scheduled. The deadlines are compared as signed 16 bit differences of the TIM11 count.
+#define US_TIMER_MAX_DELAY	32767
+
+typedef void (*US_TimerCallback)(void);
+
+void usTimer_Init(void);
+uint16_t usTimer_Now(void);
+void usTimer_Schedule(uint8_t, uint16_t, US_TimerCallback);
+void usTimer_Cancel(uint8_t);
+void usTimer_Service(void);
+uint16_t usTimer_GetMaxLatency(void);
+void usTimer_ResetLatency(void);
+
+#endif /* US_TIMER_H_ */
@@ -25,9 +25,27 @@
 #include "HD44780.h"
 #include "stm32f4xx_hal.h"
 #include "mppt.h"
+#include "us_timer.h"
 
+#include <stdbool.h>
 #include <string.h>
 
+// Bus phases of the byte being written in the background. Every phase ends with a US_TIMER_LCD callback.
+#define BUS_IDLE		0		// Nothing on the bus, next byte (if any) when the interrupt comes
+#define BUS_HIGH		1		// High nibble on the pins, enable high
+#define BUS_LOW_SETUP	2		// Enable low, low nibble on the pins
+#define BUS_LOW			3		// Enable high again
+
+static char frame[HD44780_ROWS][HD44780_COLS];		// What the display should show, written by HD44780_Print()
+static char shown[HD44780_ROWS][HD44780_COLS];		// What it does show, interrupt only
+static uint8_t cursor;								// DDRAM address the next data byte goes to
+
+static uint8_t bus;
+static uint8_t busByte;
+static uint8_t busData;								// Data (RS high) or command byte
+
+static const uint8_t rowAddress[HD44780_ROWS] = {0x00, 0x40};
+
 void HD44780_WriteCommand(uint8_t data) {
 
 	HD44780_CommandMode;
@@ -117,83 +135,6 @@ void HD44780_WriteCommand(uint8_t data) {
 	}
 }
 
-void HD44780_WriteData(uint8_t row, uint8_t col, char *data, uint8_t clearDisplay) {
-
-	uint8_t length;
-	uint8_t i;
-
-	HD44780_ClearRW;
-
-	if (clearDisplay)
-	{
-		HD44780_WriteCommand(CLEAR_DISPLAY);
-		delay_us(2000);
-	}
-
-	HD44780_GotoXY(row, col);
-	delay_us(15000);
-
-	HD44780_DataMode;
-	delay_us(150);
-
-	length = strlen(data);
-
-	for(i=0; i<length; i++) {
-
-		if ( (*data & 0x80) == 0x80 )
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_6, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_6, GPIO_PIN_RESET);
-
-		if ( (*data & 0x40) == 0x40)
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_5, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_5, GPIO_PIN_RESET);
-
-		if ( (*data & 0x20) == 0x20)
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_4, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_4, GPIO_PIN_RESET);
-
-		if ( (*data & 0x10) == 0x10)
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_3, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_3, GPIO_PIN_RESET);
-
-		delay_us(150);
-		HD44780_SetEnable;
-		delay_us(150);
-		HD44780_ClearEnable;
-
-		if ( (*data & 0x08) == 0x08 )
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_6, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_6, GPIO_PIN_RESET);
-
-		if ( (*data & 0x04) == 0x04)
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_5, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_5, GPIO_PIN_RESET);
-
-		if ( (*data & 0x02) == 0x02)
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_4, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_4, GPIO_PIN_RESET);
-
-		if ( (*data & 0x01) == 0x01)
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_3, GPIO_PIN_SET);
-		else
-			HAL_GPIO_WritePin(GPIOC, GPIO_PIN_3, GPIO_PIN_RESET);
-
-		delay_us(150);
-		HD44780_SetEnable;
-		delay_us(150);
-		HD44780_ClearEnable;
-
-		data++;
-	}
-}
-
 void HD44780_GotoXY(uint8_t row, uint8_t col) {
 
 	uint8_t row_offsets[] = {0x00, 0x40};
@@ -230,12 +171,144 @@ void HD44780_Init() {
 
 void HD44780_ReadBusy()
 {
-	uint8_t data;
-
 	HD44780_CommandMode;
 	HD44780_SetRW;
+}
+
+// Puts the low 4 bits of nibble on D7 - D4
+static void HD44780_Nibble(uint8_t nibble)
+{
+	HAL_GPIO_WritePin(GPIOC, GPIO_PIN_6, (nibble & 0x08) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(GPIOC, GPIO_PIN_5, (nibble & 0x04) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(GPIOC, GPIO_PIN_4, (nibble & 0x02) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(GPIOC, GPIO_PIN_3, (nibble & 0x01) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+/** Picks the next byte for the bus: the first cell, from the cursor on, that differs from what the display shows.
+ * A cell the cursor isn't at needs a DDRAM address command first; the cursor then moves along with the data writes,
+ * so a run of changed cells in a row costs one command. Returns false if the display is up to date.
+ */
+static bool HD44780_NextByte(void)
+{
+	uint8_t i, row, col, start;
+
+	// Past the end of a row the scan goes on with the next one
+	start = ((cursor & 0x40) ? HD44780_COLS : 0) + (cursor & 0x3f);
+
+	for (i = 0; i < HD44780_ROWS * HD44780_COLS; i++)
+	{
+		row = ((start + i) / HD44780_COLS) % HD44780_ROWS;
+		col = (start + i) % HD44780_COLS;
+
+		if (frame[row][col] == shown[row][col])
+			continue;
+
+		if (cursor != (rowAddress[row] + col))
+		{
+			cursor = rowAddress[row] + col;
+			busByte = SET_DDRAM_ADDRESS | cursor;
+			busData = 0;
+		}
+		else
+		{
+			shown[row][col] = frame[row][col];
+			busByte = (uint8_t)shown[row][col];
+			busData = 1;
+			cursor++;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+// One bus phase, run by the microsecond timer (see us_timer.c)
+void HD44780_Service(void)
+{
+	switch (bus)
+	{
+		case BUS_IDLE:
 
+			if (!HD44780_NextByte())
+			{
+				usTimer_Schedule(US_TIMER_LCD, HD44780_POLL_US, HD44780_Service);
+				break;
+			}
 
+			if (busData)
+			{
+				HD44780_DataMode;
+			}
+			else
+			{
+				HD44780_CommandMode;
+			}
+
+			HD44780_Nibble(busByte >> 4);
+			HD44780_SetEnable;
+
+			bus = BUS_HIGH;
+			usTimer_Schedule(US_TIMER_LCD, HD44780_EDGE_US, HD44780_Service);
+			break;
+
+		case BUS_HIGH:
+
+			HD44780_ClearEnable;
+			HD44780_Nibble(busByte);
+
+			bus = BUS_LOW_SETUP;
+			usTimer_Schedule(US_TIMER_LCD, HD44780_EDGE_US, HD44780_Service);
+			break;
+
+		case BUS_LOW_SETUP:
+
+			HD44780_SetEnable;
+
+			bus = BUS_LOW;
+			usTimer_Schedule(US_TIMER_LCD, HD44780_EDGE_US, HD44780_Service);
+			break;
+
+		default:
+
+			HD44780_ClearEnable;
+
+			bus = BUS_IDLE;
+			usTimer_Schedule(US_TIMER_LCD, HD44780_EXEC_US, HD44780_Service);
+			break;
+	}
+}
+
+/** Starts the background updates. HD44780_Init() must have run: it leaves the display cleared with the cursor at 0,
+ * which is where the framebuffer starts too.
+ */
+void HD44780_Start(void)
+{
+	memset((void *)frame, ' ', sizeof(frame));
+	memset((void *)shown, ' ', sizeof(shown));
+	cursor = 0;
+	bus = BUS_IDLE;
+
+	HD44780_ClearRW;
+
+	usTimer_Schedule(US_TIMER_LCD, HD44780_EDGE_US, HD44780_Service);
 }
 
+/** Writes text to row of the framebuffer from the first column, and blanks the rest of the row.
+ * Never waits for the display: the changed cells go out in the background.
+ */
+void HD44780_Print(uint8_t row, const char *text)
+{
+	uint8_t col;
+
+	if (row >= HD44780_ROWS)
+		return;
 
+	for (col = 0; col < HD44780_COLS; col++)
+	{
+		if (*text != '\0')
+			frame[row][col] = *text++;
+		else
+			frame[row][col] = ' ';
+	}
+}
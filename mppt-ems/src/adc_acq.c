@@ -0,0 +1,197 @@
+/** adc_acq.c
+ * Source file for the continuous, circular-mode DMA acquisition of the ADC1 regular sequence
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * TIM1 channel 3 triggers the conversion of one channel of the regular sequence per PWM period (see adc_trigger.c)
+ * and DMA2 Stream 0 writes the results into a circular buffer
+ * that holds two halves of ADC_ACQ_FRAMES_PER_HALF frames each. The DMA half transfer and transfer complete callbacks
+ * filter the half that was just filled (while the DMA fills the other half) and publish the result into one of two
+ * frame slots. The main loop picks up the most recently published frame with adcAcq_GetFrame() and never waits on the ADC.
+ * Code that has to see every frame, as soon as it exists, overrides adcAcq_FrameCallback() instead.
+ *
+ * Two things can lose a half. The DMA can come back round into a half before its callback has finished filtering it,
+ * which the DMA position after the filter shows. And the main loop holds a slot while it copies it out, so the
+ * callbacks never write a slot that is still held; if the main loop is preempted for two publishes in a row, the
+ * second finds its slot held and only reaches adcAcq_FrameCallback(). Both are counted in adcAcq_GetLostHalves().
+ * The slow channels converted by the injected group are merged in when a frame is published (see adc_sched.c),
+ * and published frames are already offset and gain corrected (see calibration.c).
+ */
+
+#include "adc_acq.h"
+#include "adc_sched.h"
+#include "calibration.h"
+#include "profile.h"
+#include "stm32f4xx_hal.h"
+
+#include <string.h>
+
+static ADC_HandleTypeDef *acqHandle;
+
+// Word aligned so the filter can read two channels at a time
+static uint16_t dmaBuffer[ADC_ACQ_BUFFER_SIZE] __attribute__((aligned(4)));
+
+// Published frames. The callbacks write the slot the main loop isn't holding and then flip publishIndex.
+static ADC_Frame frames[2];
+static volatile uint8_t publishIndex;
+static volatile uint32_t publishSequence;
+
+// Slot adcAcq_GetFrame() is copying out, NO_SLOT when it isn't. Only the main context writes it.
+#define NO_SLOT		0xff
+static volatile uint8_t heldSlot = NO_SLOT;
+
+static volatile uint32_t lostHalves;
+
+static void adcAcq_Publish(uint16_t, uint32_t);
+
+
+// Starts the circular DMA acquisition. The ADC must already be configured by MX_ADC1_Init().
+void adcAcq_Start(ADC_HandleTypeDef *hadc)
+{
+	acqHandle = hadc;
+
+	adcSched_Start();
+
+	HAL_ADC_Start_DMA(hadc, (uint32_t *)dmaBuffer, ADC_ACQ_BUFFER_SIZE);
+}
+
+// Copies the most recently published frame into frame and returns its sequence number (0 if nothing was published yet).
+uint32_t adcAcq_GetFrame(ADC_Frame *frame)
+{
+	uint8_t slot;
+
+	// Hold the newest slot. A publish between reading publishIndex and holding the slot makes it the older one,
+	// which the next publish would need, so take the newest again. Once held, the slot is left alone until released.
+	do
+	{
+		slot = publishIndex;
+		heldSlot = slot;
+		__DMB();
+	} while (slot != publishIndex);
+
+	memcpy((void *)frame, (void *)&frames[slot], sizeof(ADC_Frame));
+
+	__DMB();
+	heldSlot = NO_SLOT;
+
+	return frame->sequence;
+}
+
+uint32_t adcAcq_GetSequence(void)
+{
+	return publishSequence;
+}
+
+// Waits until count new frames have been published. Returns false if they don't come within timeoutMs.
+bool adcAcq_WaitFrames(uint8_t count, uint32_t timeoutMs)
+{
+	uint32_t start = HAL_GetTick();
+	uint32_t sequence = publishSequence;
+
+	while ((publishSequence - sequence) < count)
+	{
+		if ((HAL_GetTick() - start) > timeoutMs)
+			return false;
+	}
+
+	return true;
+}
+
+/** Number of half buffers that never made it into a frame slot (should always be 0): overwritten by the DMA before
+ * they were filtered, published while the main loop still held the slot they needed, or lost to an ADC overrun.
+ */
+uint32_t adcAcq_GetLostHalves(void)
+{
+	return lostHalves;
+}
+
+/** Called from the DMA interrupt with every frame, right after it is published.
+ * This default does nothing. Override it to process frames at the full frame rate; it must be quick.
+ */
+__weak void adcAcq_FrameCallback(const ADC_Frame *frame)
+{
+	UNUSED(frame);
+}
+
+// True if the DMA is writing into the half that starts at index first of dmaBuffer, i.e. it has lapped the callback
+static bool adcAcq_DmaInside(uint16_t first)
+{
+	uint16_t position = ADC_ACQ_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(acqHandle->DMA_Handle);
+
+	return (position >= first) && (position < first + ADC_ACQ_BUFFER_SIZE / 2);
+}
+
+// Filters and calibrates the half of the DMA buffer that starts at index first and publishes it into the free slot.
+static void adcAcq_Publish(uint16_t first, uint32_t timestamp)
+{
+	uint16_t raw[ADC_ACQ_CHANNELS];
+	ADC_Frame frame;
+	uint8_t slot;
+	uint8_t ch;
+
+	adcFilter_Run(&dmaBuffer[first], ADC_ACQ_FRAMES_PER_HALF, ADC_ACQ_REGULAR_CHANNELS, ADC_ACQ_FILTER, raw);
+
+	// The half has to be untouched until the filter is done with it. Otherwise the average mixes two sample times.
+	if (adcAcq_DmaInside(first))
+	{
+		lostHalves++;
+		return;
+	}
+
+	adcSched_Collect(raw);
+
+	for (ch = 0; ch < ADC_ACQ_CHANNELS; ch++)
+		frame.channel[ch] = calib_Apply(ch, raw[ch]);
+
+	frame.sequence = publishSequence + 1;
+	frame.timestamp = timestamp;
+
+	slot = publishIndex ^ 1;
+
+	if (slot == heldSlot)
+	{
+		lostHalves++;
+	}
+	else
+	{
+		frames[slot] = frame;
+		publishIndex = slot;
+	}
+
+	publishSequence++;
+
+	adcSched_Poll();
+
+	adcAcq_FrameCallback(&frame);
+}
+
+// First half of dmaBuffer is full, DMA is now filling the second half
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc)
+{
+	adcAcq_Publish(0, prof_Now());
+}
+
+// Second half of dmaBuffer is full, DMA has wrapped around to the first half
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc)
+{
+	adcAcq_Publish(ADC_ACQ_BUFFER_SIZE / 2, prof_Now());
+}
+
+// An overrun stops the DMA requests, so restart the acquisition from the top of the buffer
+void HAL_ADC_ErrorCallback(ADC_HandleTypeDef *hadc)
+{
+	lostHalves++;
+
+	HAL_ADC_Stop_DMA(acqHandle);
+	adcAcq_Start(acqHandle);
+}
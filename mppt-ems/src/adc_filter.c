@@ -0,0 +1,184 @@
+/** adc_filter.c
+ * Source file for the outlier rejecting decimation filter applied to each burst of ADC samples
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A burst is passes * channels interleaved 12 bit samples, as the DMA writes them. Two neighbouring channels are
+ * handled together as one 32 bit word, so the Cortex-M4 SIMD instructions (UADD16, USUB16 / SEL) add, compare
+ * and select both at once. Builds without the DSP extension use plain C versions of the same lane operations,
+ * so both paths give identical results.
+ *
+ * A single switching spike drags a plain mean along with it. The median modes take the median of every
+ * 3 or 5 consecutive passes first, so an isolated spike never reaches the mean.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "adc_filter.h"
+
+#include <string.h>
+
+#define MAX_PAIRS		(ADC_FILTER_MAX_CHANNELS / 2)
+
+// 16 * 4095 still fits in a 16 bit lane, so the packed sums are moved into 32 bit sums every 16 passes
+#define SPILL_PASSES	16
+
+
+#if defined(__ARM_FEATURE_SIMD32)
+
+static inline uint32_t pairAdd(uint32_t a, uint32_t b)
+{
+	return __UADD16(a, b);
+}
+
+// USUB16 sets the GE flags of each lane where a >= b, SEL then picks that lane from its first operand
+static inline uint32_t pairMax(uint32_t a, uint32_t b)
+{
+	__USUB16(a, b);
+	return __SEL(a, b);
+}
+
+static inline uint32_t pairMin(uint32_t a, uint32_t b)
+{
+	__USUB16(a, b);
+	return __SEL(b, a);
+}
+
+#else
+
+static inline uint32_t pairAdd(uint32_t a, uint32_t b)
+{
+	return ((a + b) & 0x0000ffff) | (((a >> 16) + (b >> 16)) << 16);
+}
+
+static inline uint32_t pairMax(uint32_t a, uint32_t b)
+{
+	uint32_t lo = ((a & 0xffff) >= (b & 0xffff)) ? (a & 0xffff) : (b & 0xffff);
+	uint32_t hi = ((a >> 16) >= (b >> 16)) ? (a >> 16) : (b >> 16);
+
+	return lo | (hi << 16);
+}
+
+static inline uint32_t pairMin(uint32_t a, uint32_t b)
+{
+	uint32_t lo = ((a & 0xffff) >= (b & 0xffff)) ? (b & 0xffff) : (a & 0xffff);
+	uint32_t hi = ((a >> 16) >= (b >> 16)) ? (b >> 16) : (a >> 16);
+
+	return lo | (hi << 16);
+}
+
+#endif
+
+static inline uint32_t pairMedian3(uint32_t a, uint32_t b, uint32_t c)
+{
+	return pairMax(pairMin(a, b), pairMin(pairMax(a, b), c));
+}
+
+static inline uint32_t pairMedian5(uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e)
+{
+	return pairMedian3(e, pairMax(pairMin(a, b), pairMin(c, d)), pairMin(pairMax(a, b), pairMax(c, d)));
+}
+
+static void spill(uint32_t *packedSum, uint32_t *sum, uint8_t pairs)
+{
+	uint8_t p;
+
+	for (p = 0; p < pairs; p++)
+	{
+		sum[2 * p] += packedSum[p] & 0xffff;
+		sum[2 * p + 1] += packedSum[p] >> 16;
+		packedSum[p] = 0;
+	}
+}
+
+/** Filters a burst down to one value per channel
+ * samples: passes * channels samples, 32 bit aligned, channel 0 of every pass first
+ * channels: even, at most ADC_FILTER_MAX_CHANNELS
+ * mode: ADC_FILTER_x
+ * out: channels results, truncated like the integer mean they replace
+ */
+void adcFilter_Run(const uint16_t *samples, uint8_t passes, uint8_t channels, uint8_t mode, uint16_t *out)
+{
+	const uint32_t *pass = (const uint32_t *)samples;
+	const uint32_t *w;
+	uint32_t packedSum[MAX_PAIRS], low[MAX_PAIRS], high[MAX_PAIRS];
+	uint32_t sum[ADC_FILTER_MAX_CHANNELS];
+	uint32_t value;
+	uint8_t pairs = channels / 2;
+	uint8_t window, used, pending, i, p;
+
+	if (mode == ADC_FILTER_MEDIAN5)
+		window = 5;
+	else if (mode == ADC_FILTER_MEDIAN3)
+		window = 3;
+	else
+		window = 1;
+
+	if (passes < window)
+		window = 1;
+
+	memset((void *)packedSum, 0, sizeof(packedSum));
+	memset((void *)sum, 0, sizeof(sum));
+	memset((void *)low, 0xff, sizeof(low));
+	memset((void *)high, 0, sizeof(high));
+
+	used = 0;
+	pending = 0;
+
+	for (i = 0; i + window <= passes; i++)
+	{
+		for (p = 0; p < pairs; p++)
+		{
+			w = pass + p;
+
+			if (window == 5)
+				value = pairMedian5(w[0], w[pairs], w[2 * pairs], w[3 * pairs], w[4 * pairs]);
+			else if (window == 3)
+				value = pairMedian3(w[0], w[pairs], w[2 * pairs]);
+			else
+				value = w[0];
+
+			packedSum[p] = pairAdd(packedSum[p], value);
+
+			if (mode == ADC_FILTER_TRIMMED)
+			{
+				low[p] = pairMin(low[p], value);
+				high[p] = pairMax(high[p], value);
+			}
+		}
+
+		pass += pairs;
+		used++;
+
+		if (++pending == SPILL_PASSES)
+		{
+			spill(packedSum, sum, pairs);
+			pending = 0;
+		}
+	}
+
+	spill(packedSum, sum, pairs);
+
+	if ( (mode == ADC_FILTER_TRIMMED) && (used > 2) )
+	{
+		for (p = 0; p < pairs; p++)
+		{
+			sum[2 * p] -= (low[p] & 0xffff) + (high[p] & 0xffff);
+			sum[2 * p + 1] -= (low[p] >> 16) + (high[p] >> 16);
+		}
+
+		used -= 2;
+	}
+
+	for (i = 0; i < channels; i++)
+		out[i] = sum[i] / used;
+}
@@ -0,0 +1,251 @@
+/** adc_sched.c
+ * Source file for the ADC1 injected group scheduler that samples the slow channels at their own rates
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The regular sequence only carries the four channels the MPPT loop needs (solar and battery V and I),
+ * so each of them is converted every 4th PWM period instead of every 8th. The load and temperature channels are
+ * converted one at a time by the injected group, triggered by TIM1 channel 4 half a PWM period away from the regular
+ * trigger. adcSched_Poll() runs after every published frame, picks the most overdue slow channel and arms
+ * the injected trigger for exactly one conversion. The result is accumulated until adcSched_Collect() averages it
+ * into the next published frame.
+ *
+ * Every slow channel has its own sample time, short enough that an injected conversion samples in the quiet spot
+ * between the gate edges and is finished long before the next regular trigger; the regular samples keep their timing.
+ * adcSched_Verify() checks each one against the trigger positions once TIM1 is set up, and leaves a channel whose
+ * conversion wouldn't fit out of the schedule rather than let it run into the regular samples.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "adc_sched.h"
+#include "adc_acq.h"
+#include "adc_trigger.h"
+#include "converter.h"
+
+typedef struct
+{
+	uint8_t frameIndex;			// Index in ADC_Frame.channel
+	uint32_t channel;			// ADC_CHANNEL_x
+	uint16_t periodMs;			// Time between conversions
+	uint32_t sampleTime;		// ADC_SAMPLETIME_x
+} ADC_SchedEntry;
+
+static const ADC_SchedEntry schedTable[ADC_SCHED_SLOW_CHANNELS] =
+{
+	{ 4, ADC_CHANNEL_4, ADC_SCHED_LOAD_PERIOD_MS, ADC_SCHED_LOAD_SAMPLETIME },		// Load Voltage
+	{ 5, ADC_CHANNEL_6, ADC_SCHED_TEMP_PERIOD_MS, ADC_SCHED_TEMP_SAMPLETIME },		// Ambient Temperature
+	{ 6, ADC_CHANNEL_7, ADC_SCHED_TEMP_PERIOD_MS, ADC_SCHED_TEMP_SAMPLETIME },		// MOSFET Temperature
+	{ 7, ADC_CHANNEL_8, ADC_SCHED_LOAD_PERIOD_MS, ADC_SCHED_LOAD_SAMPLETIME }		// Load Current
+};
+
+// ADC clock cycles of each ADC_SAMPLETIME_x, which is the SMPx field value
+static const uint16_t sampleCycles[8] = { 3, 15, 28, 56, 84, 112, 144, 480 };
+
+static ADC_HandleTypeDef *schedHandle;
+
+static bool enabled[ADC_SCHED_SLOW_CHANNELS];
+
+static uint32_t dueTick[ADC_SCHED_SLOW_CHANNELS];
+static uint32_t sum[ADC_SCHED_SLOW_CHANNELS];
+static uint16_t count[ADC_SCHED_SLOW_CHANNELS];
+static uint16_t last[ADC_SCHED_SLOW_CHANNELS];
+static uint32_t conversions[ADC_SCHED_SLOW_CHANNELS];
+
+static volatile uint8_t armed;
+static uint8_t current;
+
+
+// Sets the injected group up for single conversions triggered by TIM1 CC4 and programs every slow channel's sample time.
+// The trigger edge is left disabled until adcSched_Poll() arms it. Called from MX_ADC1_Init().
+void adcSched_Init(ADC_HandleTypeDef *hadc)
+{
+	ADC_InjectionConfTypeDef sConfigInjected;
+	uint8_t i;
+
+	schedHandle = hadc;
+
+	sConfigInjected.InjectedRank = 1;
+	sConfigInjected.InjectedNbrOfConversion = 1;
+	sConfigInjected.InjectedOffset = 0;
+	sConfigInjected.InjectedDiscontinuousConvMode = DISABLE;
+	sConfigInjected.AutoInjectedConv = DISABLE;
+	sConfigInjected.ExternalTrigInjecConv = ADC_EXTERNALTRIGINJECCONV_T1_CC4;
+	sConfigInjected.ExternalTrigInjecConvEdge = ADC_EXTERNALTRIGINJECCONVEDGE_NONE;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+	{
+		sConfigInjected.InjectedChannel = schedTable[i].channel;
+		sConfigInjected.InjectedSamplingTime = schedTable[i].sampleTime;
+
+		HAL_ADCEx_InjectedConfigChannel(hadc, &sConfigInjected);
+
+		enabled[i] = true;
+	}
+}
+
+// Longest sample time of the slow channels in ADC clock cycles, the one the injected trigger is placed for
+uint16_t adcSched_SampleCycles(void)
+{
+	uint16_t longest = 0;
+	uint8_t i;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+	{
+		if (sampleCycles[schedTable[i].sampleTime] > longest)
+			longest = sampleCycles[schedTable[i].sampleTime];
+	}
+
+	return longest;
+}
+
+/** Checks every slow channel's sample time with the injected trigger at CCR4 = injected and the regular one at
+ * CCR3 = regular (see adcTrig_VerifyInjected()). A channel that fails is never converted, and its rate reads 0.
+ * Returns false if any failed. Called from MX_TIM1_Init() once both triggers are placed.
+ */
+bool adcSched_Verify(uint16_t injected, uint16_t regular)
+{
+	bool pass = true;
+	uint8_t i;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+	{
+		enabled[i] = adcTrig_VerifyInjected(injected, regular, sampleCycles[schedTable[i].sampleTime]);
+
+		if (!enabled[i])
+			pass = false;
+	}
+
+	return pass;
+}
+
+// Forgets any armed conversion and schedules every slow channel right away. Called whenever the acquisition (re)starts.
+void adcSched_Start(void)
+{
+	uint32_t now = HAL_GetTick();
+	uint8_t i;
+
+	schedHandle->Instance->CR2 &= ~ADC_CR2_JEXTEN;
+	__HAL_ADC_DISABLE_IT(schedHandle, ADC_IT_JEOC);
+	armed = 0;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+		dueTick[i] = now;
+}
+
+// Arms the injected group for the most overdue slow channel, if one is due and no conversion is pending
+void adcSched_Poll(void)
+{
+	uint32_t now, late, latest;
+	uint8_t i, next;
+
+	if (armed)
+		return;
+
+	now = HAL_GetTick();
+	latest = 0;
+	next = ADC_SCHED_SLOW_CHANNELS;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+	{
+		if ( !enabled[i] || ((int32_t)(now - dueTick[i]) < 0) )
+			continue;
+
+		late = now - dueTick[i];
+
+		if ( (next == ADC_SCHED_SLOW_CHANNELS) || (late > latest) )
+		{
+			latest = late;
+			next = i;
+		}
+	}
+
+	if (next == ADC_SCHED_SLOW_CHANNELS)
+		return;
+
+	// A channel that fell more than a period behind restarts its schedule instead of converting back to back
+	if (latest >= schedTable[next].periodMs)
+		dueTick[next] = now + schedTable[next].periodMs;
+	else
+		dueTick[next] += schedTable[next].periodMs;
+
+	current = next;
+	armed = 1;
+
+	schedHandle->Instance->JSQR = ADC_JSQR(schedTable[next].channel, 1, 1);
+	__HAL_ADC_CLEAR_FLAG(schedHandle, ADC_FLAG_JEOC | ADC_FLAG_JSTRT);
+	__HAL_ADC_ENABLE_IT(schedHandle, ADC_IT_JEOC);
+	schedHandle->Instance->CR2 |= ADC_EXTERNALTRIGINJECCONVEDGE_RISING;
+}
+
+// Writes the average of the slow channel conversions since the last call into channel (indexed as an ADC frame).
+// A channel with no new conversion keeps its previous value.
+void adcSched_Collect(uint16_t *channel)
+{
+	uint8_t i;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+	{
+		if (count[i] != 0)
+		{
+			last[i] = sum[i] / count[i];
+			sum[i] = 0;
+			count[i] = 0;
+		}
+
+		channel[schedTable[i].frameIndex] = last[i];
+	}
+}
+
+// Configured conversions per second of ADC frame index (the regular channels share the TIM1 CC3 trigger)
+uint32_t adcSched_GetRate(uint8_t index)
+{
+	uint8_t i;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+	{
+		if (schedTable[i].frameIndex == index)
+			return enabled[i] ? 1000 / schedTable[i].periodMs : 0;
+	}
+
+	return SystemCoreClock / (2 * TIM1_PERIOD) / ADC_ACQ_REGULAR_CHANNELS;
+}
+
+// Number of injected conversions completed for ADC frame index, for checking the achieved rates
+uint32_t adcSched_GetConversions(uint8_t index)
+{
+	uint8_t i;
+
+	for (i = 0; i < ADC_SCHED_SLOW_CHANNELS; i++)
+	{
+		if (schedTable[i].frameIndex == index)
+			return conversions[i];
+	}
+
+	return 0;
+}
+
+// One injected conversion finished. Disarm the trigger so the next CC4 event doesn't convert the same channel again.
+void HAL_ADCEx_InjectedConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	hadc->Instance->CR2 &= ~ADC_CR2_JEXTEN;
+	__HAL_ADC_DISABLE_IT(hadc, ADC_IT_JEOC);
+
+	if (!armed)
+		return;
+
+	sum[current] += hadc->Instance->JDR1;
+	count[current]++;
+	conversions[current]++;
+
+	armed = 0;
+}
@@ -0,0 +1,208 @@
+/** adc_trigger.c
+ * Source file for placing the PWM synchronized ADC trigger (TIM1 channel 3) between switching edges
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * TIM1 counts up from 0 to TIM1_PERIOD and back down (center aligned). With t measured in ticks from the valley
+ * (t = CNT while counting up, t = 2 * TIM1_PERIOD - CNT while counting down) and d = CCR1, the gate edges are:
+ *
+ *   Phase 2 (CH2 / CH2N, PWM2, CCR2 = TIM1_PERIOD - d):  t = P - d,  P - d + DT,  P + d,  P + d + DT
+ *   Phase 1 (CH1 / CH1N, PWM1, CCR1 = d):                t = d,  d + DT,  2P - d,  2P - d + DT
+ *
+ * where P = TIM1_PERIOD and DT = TIM1_DEADTIME (the dead time delays every rising gate edge).
+ * The interleaved phases mean phase 2 switches right around the valley and phase 1 around the peak,
+ * so the quiet spots are in between. Channel 3 (PWM2, ADC trigger on its rising edge) fires once per period
+ * at t = CCR3 while counting up, and the ADC samples from t = CCR3 + latency for the sample time.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "adc_trigger.h"
+#include "converter.h"
+
+#define PWM_TICKS		(2 * TIM1_PERIOD)
+
+#define SAMPLE_START	(ADC_TRIG_LATENCY_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE)
+#define SAMPLE_END		((ADC_TRIG_LATENCY_CYCLES + ADC_TRIG_SAMPLE_CYCLES) * ADC_TRIG_TICKS_PER_ADC_CYCLE)
+
+
+// Distance, in ticks, from edge to the sampling window that opens at start and lasts length ticks,
+// measured around the circular PWM period. 0 if the edge falls inside the window.
+static uint16_t edgeDistance(int16_t edge, int16_t start, int16_t length)
+{
+	int16_t offset;
+
+	if (length >= PWM_TICKS)
+		return 0;
+
+	// Ticks from the start of the window forward to the edge
+	offset = ((edge - start) % PWM_TICKS + PWM_TICKS) % PWM_TICKS;
+
+	if (offset <= length)
+		return 0;
+
+	// The edge is either offset - length ticks after the window closes or PWM_TICKS - offset ticks before it opens
+	return ((offset - length) < (PWM_TICKS - offset)) ? (offset - length) : (PWM_TICKS - offset);
+}
+
+// Smallest distance, in ticks, between a sampling window and any of the 8 gate edges at CCR1 = duty
+static uint16_t windowClearance(uint16_t duty, int16_t start, int16_t length)
+{
+	int16_t edges[8];
+	uint16_t clearance, distance;
+	uint8_t i;
+
+	edges[0] = TIM1_PERIOD - duty;
+	edges[1] = TIM1_PERIOD - duty + TIM1_DEADTIME;
+	edges[2] = TIM1_PERIOD + duty;
+	edges[3] = TIM1_PERIOD + duty + TIM1_DEADTIME;
+	edges[4] = duty;
+	edges[5] = duty + TIM1_DEADTIME;
+	edges[6] = PWM_TICKS - duty;
+	edges[7] = PWM_TICKS - duty + TIM1_DEADTIME;
+
+	clearance = PWM_TICKS;
+
+	for (i = 0; i < 8; i++)
+	{
+		distance = edgeDistance(edges[i], start, length);
+
+		if (distance < clearance)
+			clearance = distance;
+	}
+
+	return clearance;
+}
+
+// Returns the smallest distance, in TIM1 ticks, between the ADC sampling window started by a trigger at
+// CCR3 = trigger and any of the 8 gate edges at CCR1 = duty.
+uint16_t adcTrig_Clearance(uint16_t duty, uint16_t trigger)
+{
+	return windowClearance(duty, trigger + SAMPLE_START, SAMPLE_END - SAMPLE_START);
+}
+
+// Picks the CCR3 value with the largest worst case clearance over every duty cycle from MIN_DUTY_CYCLE to MAX_DUTY_CYCLE.
+uint16_t adcTrig_Select(void)
+{
+	uint16_t trigger, duty;
+	uint16_t best = TIM1_PERIOD / 2;
+	uint16_t bestClearance = 0;
+	uint16_t worst, clearance;
+
+	// Channel 3 only has a rising edge while counting up, anywhere from 1 to TIM1_PERIOD - 1
+	for (trigger = 1; trigger < TIM1_PERIOD; trigger++)
+	{
+		worst = PWM_TICKS;
+
+		for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+		{
+			clearance = adcTrig_Clearance(duty, trigger);
+
+			if (clearance < worst)
+				worst = clearance;
+		}
+
+		if (worst > bestClearance)
+		{
+			bestClearance = worst;
+			best = trigger;
+		}
+	}
+
+	return best;
+}
+
+// True if the sampling window stays ADC_TRIG_KEEPOUT_TICKS away from every gate edge for every duty cycle
+bool adcTrig_Verify(uint16_t trigger)
+{
+	uint16_t duty;
+
+	for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+	{
+		if (adcTrig_Clearance(duty, trigger) < ADC_TRIG_KEEPOUT_TICKS)
+			return false;
+	}
+
+	return true;
+}
+
+// Ticks from a trigger to the end of its conversion, for a sample time of sampleCycles
+static int16_t conversionTicks(uint16_t sampleCycles)
+{
+	return (ADC_TRIG_LATENCY_CYCLES + sampleCycles + ADC_TRIG_CONVERSION_CYCLES) * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+}
+
+// True if the conversion started by the regular trigger at CCR3 = regular and the injected one at CCR4 = injected
+// overlap anywhere around the circular PWM period. The ADC would then hold one of them off, and sample it late.
+static bool conversionsOverlap(uint16_t injected, uint16_t regular, uint16_t sampleCycles)
+{
+	int16_t start = PWM_TICKS - injected;
+	int16_t offset = ((regular - start) % PWM_TICKS + PWM_TICKS) % PWM_TICKS;
+
+	// The regular conversion has to start after the injected one ends and end before it starts again
+	return (offset < conversionTicks(sampleCycles)) || (offset + conversionTicks(ADC_TRIG_SAMPLE_CYCLES) > PWM_TICKS);
+}
+
+/** Picks the CCR4 value for the injected group trigger, with the regular trigger at CCR3 = regular.
+ * Channel 4 runs in PWM1 mode, so its rising edge comes while counting down, at t = 2 * TIM1_PERIOD - CCR4.
+ * Of the triggers whose conversion doesn't overlap the regular one, this is the one whose sampleCycles long sample
+ * stays furthest from the gate edges.
+ */
+uint16_t adcTrig_SelectInjected(uint16_t regular, uint16_t sampleCycles)
+{
+	uint16_t trigger, duty;
+	uint16_t best = TIM1_PERIOD / 2;
+	uint16_t bestClearance = 0;
+	uint16_t worst, clearance;
+
+	for (trigger = 1; trigger < TIM1_PERIOD; trigger++)
+	{
+		if (conversionsOverlap(trigger, regular, sampleCycles))
+			continue;
+
+		worst = PWM_TICKS;
+
+		for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+		{
+			clearance = windowClearance(duty, PWM_TICKS - trigger + SAMPLE_START, sampleCycles * ADC_TRIG_TICKS_PER_ADC_CYCLE);
+
+			if (clearance < worst)
+				worst = clearance;
+		}
+
+		if (worst > bestClearance)
+		{
+			bestClearance = worst;
+			best = trigger;
+		}
+	}
+
+	return best;
+}
+
+// True if an injected conversion of sampleCycles triggered at CCR4 = injected samples ADC_TRIG_KEEPOUT_TICKS away
+// from every gate edge for every duty cycle, and leaves the regular conversion triggered at CCR3 = regular alone
+bool adcTrig_VerifyInjected(uint16_t injected, uint16_t regular, uint16_t sampleCycles)
+{
+	uint16_t duty;
+
+	if (conversionsOverlap(injected, regular, sampleCycles))
+		return false;
+
+	for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+	{
+		if (windowClearance(duty, PWM_TICKS - injected + SAMPLE_START, sampleCycles * ADC_TRIG_TICKS_PER_ADC_CYCLE) < ADC_TRIG_KEEPOUT_TICKS)
+			return false;
+	}
+
+	return true;
+}
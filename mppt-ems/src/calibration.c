@@ -0,0 +1,118 @@
+/** calibration.c
+ * Source file for the per channel ADC calibration (offset and gain) stored in flash
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The coefficients are loaded once at startup and applied to every published ADC frame by adc_acq.c,
+ * so everything downstream of the acquisition sees corrected counts.
+ */
+
+#include "calibration.h"
+
+#include <string.h>
+
+static int16_t calOffset[ADC_ACQ_CHANNELS];
+static uint16_t calGain[ADC_ACQ_CHANNELS];
+static uint8_t calSource;
+
+extern uint16_t crc16(uint8_t[], uint8_t, uint16_t);
+
+
+static void calib_SetDefaults(void)
+{
+	uint8_t ch;
+
+	for (ch = 0; ch < ADC_ACQ_CHANNELS; ch++)
+	{
+		calOffset[ch] = 0;
+		calGain[ch] = CAL_GAIN_ONE;
+	}
+}
+
+// Erased flash reads back 0xffff, which means the offset was never measured
+static int16_t legacyOffset(const uint16_t *image, uint8_t index)
+{
+	if (image[index] == 0xffff)
+		return 0;
+
+	return (int16_t)image[index];
+}
+
+/** Loads the calibration coefficients from image (normally CAL_RECORD_ADDRESS) and returns the CAL_SOURCE_ used.
+ * Boards calibrated before the versioned record existed only have the five offsets at
+ * 0x08010000 (battery V), 0x08010002 (solar V), 0x08010004 (solar I), 0x08010006 (battery I) and 0x08010008 (load I).
+ * crc16_init() must have been called first.
+ */
+uint8_t calib_Load(const void *image)
+{
+	CAL_Record record;
+	const uint16_t *legacy = (const uint16_t *)image;
+
+	calib_SetDefaults();
+
+	memcpy((void *)&record, image, sizeof(record));
+
+	if (record.magic == CAL_MAGIC)
+	{
+		if ( (record.version == CAL_VERSION) && (record.crc == crc16((uint8_t *)&record, sizeof(record) - sizeof(record.crc), 0xffff)) )
+		{
+			memcpy((void *)calOffset, (void *)record.offset, sizeof(calOffset));
+			memcpy((void *)calGain, (void *)record.gain, sizeof(calGain));
+			calSource = CAL_SOURCE_RECORD;
+		}
+		else
+		{
+			// A record that fails its CRC, or of a version this firmware doesn't know, is not trusted at all
+			calSource = CAL_SOURCE_DEFAULT;
+		}
+	}
+
+	else if ( (legacy[0] == 0xffff) && (legacy[1] == 0xffff) && (legacy[2] == 0xffff) && (legacy[3] == 0xffff) && (legacy[4] == 0xffff) )
+	{
+		calSource = CAL_SOURCE_DEFAULT;
+	}
+
+	else
+	{
+		calOffset[0] = legacyOffset(legacy, 0);
+		calOffset[1] = legacyOffset(legacy, 1);
+		calOffset[3] = legacyOffset(legacy, 2);
+		calOffset[2] = legacyOffset(legacy, 3);
+		calOffset[7] = legacyOffset(legacy, 4);
+		calSource = CAL_SOURCE_LEGACY;
+	}
+
+	return calSource;
+}
+
+// Returns the corrected reading for counts on ADC frame channel ch
+uint16_t calib_Apply(uint8_t ch, uint16_t counts)
+{
+	int32_t value;
+
+	value = ((int32_t)counts - calOffset[ch]) * calGain[ch];
+	value = (value + CAL_GAIN_ONE / 2) / CAL_GAIN_ONE;
+
+	if (value < 0)
+		return 0;
+
+	if (value > CAL_MAX_COUNTS)
+		return CAL_MAX_COUNTS;
+
+	return (uint16_t)value;
+}
+
+uint8_t calib_GetSource(void)
+{
+	return calSource;
+}
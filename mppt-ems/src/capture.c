@@ -0,0 +1,113 @@
+/** capture.c
+ * Source file for the ADC frame capture (frames, duty cycle and control state, streamed over the UART)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every decimation published frames, the ADC interrupt stores the frame together with the duty cycle and the control
+ * state that resulted from it. The main context takes the records out and sends them (see sendCapture() in mppt.c),
+ * so a field problem can be reproduced by feeding the same frames through the control code.
+ *
+ * The records go through a ring with one writer (the interrupt) and one reader (the main context), so neither side
+ * has to mask interrupts. The UART is much slower than the frame rate:
+ * - streaming: records that find the ring full are dropped and counted, pick a decimation the UART keeps up with
+ * - burst: capturing stops once the ring is full, so CAPTURE_RECORDS consecutive frames arrive intact
+ */
+
+#include "capture.h"
+
+#include <string.h>
+
+static CAPTURE_Record ring[CAPTURE_RECORDS];
+static volatile uint8_t head;			// Next record to write, interrupt only
+static volatile uint8_t tail;			// Next record to read, main context only
+
+static volatile uint16_t decimation;	// 0: not capturing
+static volatile bool burst;
+static uint16_t frames;
+static volatile uint16_t dropped;
+
+
+// Captures every decimation-th frame from now on, in burst mode until the ring is full
+void capture_Start(uint16_t every, bool burstMode)
+{
+	decimation = 0;
+
+	tail = head;
+	frames = 0;
+	dropped = 0;
+	burst = burstMode;
+
+	decimation = every;
+}
+
+void capture_Stop(void)
+{
+	decimation = 0;
+}
+
+// Called from the ADC interrupt with every frame, after the control step
+void capture_Frame(const ADC_Frame *frame, uint32_t tick, uint16_t duty, uint8_t flags)
+{
+	CAPTURE_Record *record;
+	uint8_t next;
+
+	if (decimation == 0)
+		return;
+
+	if (++frames < decimation)
+		return;
+
+	frames = 0;
+	next = (head + 1) % CAPTURE_RECORDS;
+
+	if (next == tail)
+	{
+		if (burst)
+			decimation = 0;
+		else
+			dropped++;
+
+		return;
+	}
+
+	record = &ring[head];
+
+	record->frame = (uint16_t)frame->sequence;
+	record->tick = tick;
+	memcpy((void *)record->channel, (void *)frame->channel, sizeof(record->channel));
+	record->duty = duty;
+	record->flags = flags;
+
+	head = next;
+}
+
+// Takes up to max records out of the ring into records. Returns how many there were.
+uint8_t capture_Read(CAPTURE_Record *records, uint8_t max)
+{
+	uint8_t count = 0;
+
+	while ( (count < max) && (tail != head) )
+	{
+		memcpy((void *)&records[count], (void *)&ring[tail], sizeof(CAPTURE_Record));
+		tail = (tail + 1) % CAPTURE_RECORDS;
+		count++;
+	}
+
+	return count;
+}
+
+// Records dropped since the capture started because the ring was full
+uint16_t capture_GetDropped(void)
+{
+	return dropped;
+}
@@ -0,0 +1,97 @@
+/** charge_reg.c
+ * Source file for the constant voltage (absorption / float) battery voltage regulator
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A PI controller on the battery voltage. Its output is a duty cycle no higher than the ceiling it is given, which is
+ * the MPPT duty: lowering the duty from there moves the array towards its open circuit voltage and gives the battery
+ * less power, so the MPPT is the upper bound on what the regulator can deliver. Below the target the output simply sits
+ * at the ceiling, and follows it when the MPPT raises it. The integrator is held so the output stays within
+ * MIN_DUTY_CYCLE..ceiling (anti-windup), which also makes the hand over from the MPPT bumpless.
+ */
+
+#include "charge_reg.h"
+#include "converter.h"
+
+#include <stdbool.h>
+
+static volatile int32_t target;		// mV, 0: not regulating
+static int32_t integral;			// 1/16 duty counts in Q16
+static bool atCeiling;				// The last output was the ceiling
+
+
+// Sets the battery voltage to hold, in mV. 0 turns the regulator off.
+void chargeReg_SetTarget(int32_t milliVolts)
+{
+	target = milliVolts;
+}
+
+int32_t chargeReg_GetTarget(void)
+{
+	return target;
+}
+
+// Starts the regulator from duty (1/16 counts), e.g. when the converter starts
+void chargeReg_Reset(uint16_t duty)
+{
+	integral = (int32_t)duty << 16;
+	atCeiling = true;
+}
+
+/** One control step with the battery at vBat mV.
+ * Returns the duty cycle to apply in 1/16 counts, at most ceiling.
+ */
+uint16_t chargeReg_Step(int32_t vBat, uint16_t ceiling)
+{
+	int32_t error, proportional, output;
+	int32_t low = DUTY_FINE(MIN_DUTY_CYCLE);
+	int32_t high = ceiling;
+
+	if (target == 0)
+	{
+		integral = (int32_t)ceiling << 16;
+		atCeiling = true;
+		return ceiling;
+	}
+
+	if (high < low)
+		high = low;
+
+	error = target - vBat;
+	proportional = error * CHARGE_REG_KP_Q16;
+
+	integral += error * CHARGE_REG_KI_Q16;
+
+	// Below the target with the output on the ceiling, the MPPT is what limits: the output follows the ceiling up too
+	if ( atCeiling && (error > 0) )
+		integral = (high << 16) - proportional;
+
+	// Hold the integrator where the output stays in range, instead of letting it wind up beyond
+	if (integral > (high << 16) - proportional)
+		integral = (high << 16) - proportional;
+
+	if (integral < (low << 16) - proportional)
+		integral = (low << 16) - proportional;
+
+	output = (proportional + integral) >> 16;
+
+	if (output > high)
+		output = high;
+
+	if (output < low)
+		output = low;
+
+	atCeiling = (output == high);
+
+	return (uint16_t)output;
+}
@@ -0,0 +1,79 @@
+/** event.c
+ * Source file for the deferred event queue
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Interrupts do the least they can and post an event for the rest; the main context takes the events out in order and
+ * does the work. There is one writer (the interrupt posting) and one reader (the main context), so neither side has to
+ * mask interrupts: only event_Post() moves head and only event_Get() moves tail. Events that find the queue full are
+ * dropped and counted, and the deepest the queue has been is kept, so the queue size can be checked on the target.
+ */
+
+#include "event.h"
+
+static uint8_t queue[EVENT_QUEUE_SIZE];
+static volatile uint8_t head;			// Next slot to write, interrupt only
+static volatile uint8_t tail;			// Next slot to read, main context only
+
+static volatile uint16_t dropped;
+static volatile uint8_t highWater;
+
+
+// Called from the interrupt. Returns false, and counts the event as dropped, if the queue is full.
+bool event_Post(uint8_t event)
+{
+	uint8_t next = (head + 1) % EVENT_QUEUE_SIZE;
+	uint8_t depth;
+
+	if (next == tail)
+	{
+		dropped++;
+		return false;
+	}
+
+	queue[head] = event;
+	head = next;
+
+	depth = (head + EVENT_QUEUE_SIZE - tail) % EVENT_QUEUE_SIZE;
+
+	if (depth > highWater)
+		highWater = depth;
+
+	return true;
+}
+
+// Takes the oldest event out of the queue, EVENT_NONE if there is none
+uint8_t event_Get(void)
+{
+	uint8_t event;
+
+	if (tail == head)
+		return EVENT_NONE;
+
+	event = queue[tail];
+	tail = (tail + 1) % EVENT_QUEUE_SIZE;
+
+	return event;
+}
+
+// Events dropped since reset because the queue was full (should always be 0)
+uint16_t event_GetDropped(void)
+{
+	return dropped;
+}
+
+// Most events that were ever pending at once
+uint8_t event_GetHighWater(void)
+{
+	return highWater;
+}
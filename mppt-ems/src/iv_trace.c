@@ -0,0 +1,72 @@
+/** iv_trace.c
+ * Source file for the solar array I-V curve tracer
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Steps the converter duty cycle one count at a time and records the array voltage and current of the
+ * first ADC frame published after it has settled. Both values come from the same frame, so every point
+ * is one operating point. A full sweep of the safe duty range takes well under 100 mS, short enough
+ * not to upset charging. The points stay in RAM until the next sweep.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "iv_trace.h"
+#include "adc_acq.h"
+#include "measure.h"
+
+static IV_Point points[IV_TRACE_MAX_POINTS];
+static uint8_t pointCount;
+
+
+/** Sweeps the duty cycle from first to last, setting it through setDuty(), and returns the number of points taken.
+ * The caller must have the converter running and puts its own duty cycle back afterwards.
+ */
+uint8_t ivTrace_Sweep(uint16_t first, uint16_t last, void (*setDuty)(uint16_t))
+{
+	ADC_Frame frame;
+	uint16_t duty;
+
+	pointCount = 0;
+
+	for (duty = first; (duty <= last) && (pointCount < IV_TRACE_MAX_POINTS); duty++)
+	{
+		setDuty(duty);
+
+		if (!adcAcq_WaitFrames(IV_TRACE_SETTLE_FRAMES, IV_TRACE_TIMEOUT_MS))
+			break;
+
+		adcAcq_GetFrame(&frame);
+
+		points[pointCount].duty = duty;
+		points[pointCount].vSolar = calcVoltage(frame.channel[1], 2);
+		points[pointCount].iSolar = calcCurrent(frame.channel[3]);
+		pointCount++;
+	}
+
+	return pointCount;
+}
+
+void ivTrace_Clear(void)
+{
+	pointCount = 0;
+}
+
+uint8_t ivTrace_GetCount(void)
+{
+	return pointCount;
+}
+
+const IV_Point *ivTrace_GetPoint(uint8_t index)
+{
+	return &points[index];
+}
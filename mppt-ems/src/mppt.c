@@ -21,29 +21,37 @@
  */
 
 /** Console Output for Debugging
- * Used in getADCReadings()
- * Uncomment #define DEBUG2 to get a string of formatted, human readable ADC data to a terminal program.
- * DEFAULT: Leave commented to send the real data packet to the controller.
+ * Used in messageTask()
+ * Uncomment #define DEBUG2 to get a string of formatted, human readable ADC data to a terminal program every second.
+ * DEFAULT: Leave commented to send the real data packet to the controller every 15 seconds.
  */
 #define DEBUG2
 
+#ifdef DEBUG2
+#define MESSAGE_PERIOD		1000
+#else
+#define MESSAGE_PERIOD		15000
+#endif
+
 /** MPPT Algorithm Selection
-*Uncomment #define INC_COND to utilize the MPPT Incremental Conductance (IC) algorithm.
-*DEFAULT: Leave commented to implement the Perturb and Observe (P&O) method.
-*
-*NOTE: THE INCREMENTAL CONDUCTNACE ALGORITHM IS UNVERIFIED FOR PRODUCTION USE IN VERSION 1.0!
+*The strategy used after reset (MPPT_STRATEGY_x, see mppt_strategy.h). The controller can switch strategies at runtime with CMD_STRATEGY.
+*DEFAULT: the Perturb and Observe (P&O) method.
 */
-//#define INC_COND
+#define DEFAULT_MPPT_STRATEGY	MPPT_STRATEGY_PO
+
+/** High Resolution Duty Cycle
+ * Uncomment #define PWM_HIGH_RESOLUTION to dither the TIM1 duty cycle between adjacent counts (see pwm_dither.c),
+ * so the MPPT duty cycle steps of 1/16 count really reach the converter.
+ * Commented, the duty cycle is rounded to whole TIM1 counts.
+ * DEFAULT: Leave uncommented.
+ */
+#define PWM_HIGH_RESOLUTION
 
 // Used to control timer and fan functionality
 #define ON		1	// Start the timer / fan
 #define OFF		0	// Stop the timer / fan
 #define UPDATE	2	// Update the timer duty cycle
 
-// Used to clear, or not clear, the LCD
-#define YES		1	// Clear
-#define NO		0	// Don't clear
-
 // Battery Voltage Warning Indicators
 #define NORMALBATTV	0
 #define HIBATTV 	1
@@ -57,9 +65,15 @@
 #define ADSORPTION_TIME_FLOODED	3600 		// 3600 seconds = 60 minutes
 #define ADSORPTION_LOCKOUT_TIME 28800		// 28800 seconds = 8 hours
 
-#define MIN_DUTY_CYCLE		192		//75% of the TIM1 period
-#define MAX_DUTY_CYCLE  	235 	//92% of the TIM1 period
-#define PCT80_DUTY_CYCLE 	205
+/** MPPT Control Rate
+ * The MPPT steps in the ADC DMA interrupt on every MPPT_CONTROL_FRAMES published ADC frames (see adcAcq_FrameCallback()).
+ * A frame is 32 passes of the 4 channel regular sequence at one conversion per 5.12 uS PWM period, 655 uS, so 1 gives 1526 steps / second.
+ */
+#define MPPT_CONTROL_FRAMES	1
+#define MPPT_CONTROL_STEP_US	(MPPT_CONTROL_FRAMES * 655)
+
+// Sample time of every ADC channel. Conversions are triggered by TIM1 and the sampling has to fit between switching edges (see adc_trigger.c)
+#define ADC_SYNC_SAMPLETIME	ADC_SAMPLETIME_15CYCLES
 
 // Time, in seconds, to wait between reading solar array charge current when it's below THRESHOLD_CURRENT
 // The switching converter is turned off while in timeout, conserving power.
@@ -71,6 +85,24 @@
 #include "stm32f4xx_hal.h"
 #include "HD44780.h"
 #include "mppt.h"
+#include "adc_acq.h"
+#include "adc_sched.h"
+#include "adc_trigger.h"
+#include "calibration.h"
+#include "capture.h"
+#include "charge_reg.h"
+#include "event.h"
+#include "measure.h"
+#include "iv_trace.h"
+#include "mppt_bench.h"
+#include "mppt_scan.h"
+#include "mppt_strategy.h"
+#include "profile.h"
+#include "pwm_dither.h"
+#include "sched.h"
+#include "stats.h"
+#include "uart_tx.h"
+#include "us_timer.h"
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
@@ -78,6 +110,8 @@
 
 ADC_HandleTypeDef hadc1;
 DMA_HandleTypeDef hdma_adc1;
+DMA_HandleTypeDef hdma_tim1_up;
+DMA_HandleTypeDef hdma_usart1_tx;
 
 TIM_HandleTypeDef htim1;
 TIM_HandleTypeDef htim5;
@@ -86,18 +120,16 @@ TIM_HandleTypeDef htim11;
 UART_HandleTypeDef huart1;
 
 
-uint8_t strBuffer[256];
-uint8_t sendBuffer[128], escBuffer[128];
+uint8_t sendBuffer[128];
+
+/** Frames on their way out of the UART (see uart_tx.c). A buffer belongs to the TX queue from sendFrame() (or the DEBUG2
+ * console output) until the queue hands it back through txRelease(), from the USART1 interrupt.
+ * Escaping can double the length of a frame.
+ */
+uint8_t txBuffer[TX_BUFFERS][256];
+volatile bool txBusy[TX_BUFFERS];
 
-/** adcBuffer Description
- * 0: Battery Bank Voltage
- * 1: Solar Array Voltage
- * 2: Battery Bank Current
- * 3: Solar Array Current
- * 4: Battery Load Voltage
- * 5: Ambient Temperature
- * 6: MOSFET Temperature
- * 7: Battery Load Current
+/** ADC readings in counts, averaged over one published ADC frame (see ADC_Frame in adc_acq.h)
  */
 
 uint32_t vBattery;
@@ -109,35 +141,46 @@ uint32_t tempAmbient;
 uint32_t tempMOSFETS;
 uint32_t iLoad;
 
-uint16_t adcBuffer[9];
 uint16_t flashData;
 uint16_t adsorptionTime, adsorptionCompleteTime;
-uint16_t tim9Count, adcCount;
+uint16_t tim9Count;
 uint16_t canPulse;
+uint8_t pulseEdges;		// Edges of the desulfation pulse train so far (see pulse())
 uint16_t powerCycleTimeout, timerCount;
-uint16_t battOffsetV, solarOffsetV, battOffsetI, solarOffsetI, loadOffsetI;
 uint16_t mpptBypassCount = 0;
-uint16_t duty;
+uint16_t duty;		// MPPT duty cycle in 1/16 TIM1 counts (DUTY_FRACTION_BITS)
+uint16_t dutyApplied;	// Duty cycle TIM1 was last given, 1/16 counts, 0 while the converter is off
 uint16_t tim1_ccer;
 
 uint8_t powerCycleOffTime, offTimeCount;
 uint8_t cycleLoadTime = 0;
 uint8_t maxDutyCycleCount = 0;
+uint8_t strategyRequest = DEFAULT_MPPT_STRATEGY;		// Set by CMD_STRATEGY, applied by calcMPPT()
+uint8_t controlFrames;
+
+/** MPPT control loop (see adcAcq_FrameCallback())
+ * Set by the main loop while the MPPT should run, cleared before anything else touches the duty cycle.
+ * The loop sets atMaxDuty when it had to limit the duty at MAX_DUTY_CYCLE, the main loop counts it in maxDutyCycleCount.
+ */
+volatile bool mpptRunning;
+volatile bool atMaxDuty;
+volatile bool regulating;		// The battery voltage regulator is holding the duty cycle below the MPPT duty
+volatile bool dutyResetRequest;	// Set by chargeTrack(), applied by calcMPPT(): the duty cycle back to PCT80_DUTY_CYCLE
+
+// Control loop latency in DWT cycles, from the frame being published to the duty cycle being written.
+// The step itself is the PROF_MPPT_STEP probe.
+volatile uint32_t controlSteps;
+volatile uint32_t controlLatency, controlLatencyMax;
 
 uint8_t lowChargeCurrentTimeout;
-uint8_t sendMessageCount = 0;
-uint8_t getADC = 0;
-uint8_t adcConvComplete = 0;
+uint8_t chargeState = CHARGE_OFF;		// CHARGE_x (see chargeTask())
 uint8_t lcdUpdate = 0;
 uint8_t warning = 0;
 uint8_t pulseInterval = 120;		// 120 second (2 minute) intervals between pulsing the battery bank
-uint8_t aveCount;
-uint8_t readTempCount;
 
 bool adsorptionFlag;
 bool adsorptionComplete;
 bool floatFlag;
-bool canCharge;
 bool isCharging;
 bool lowChargeCurrentFlag;
 bool overTempFlag;
@@ -147,23 +190,35 @@ bool cycleLoadPower;
 bool enablePowerCycle;
 bool isBypass;
 bool overheatFlag;
-bool updateLCDflag;
+bool sendStatsFlag;
+bool ivTraceRequest;
+bool sendBenchFlag, resetBenchFlag;
+bool sendProfileFlag, resetProfileFlag;
+bool sendSchedFlag, resetSchedFlag;
+bool captureRequest;
+uint16_t captureDecimation;
+bool captureBurst;
 
-int POB_Direction = 1;
+// Measured values in fixed point: voltages in mV, currents in mA, power in mW and temperatures in hundredths of a degC (see measure.c)
+int32_t lastIbattery;
+int32_t vBat, iBat, vSolar, iSolar, loadVoltage, ambientTemp, mosfetTemp, loadCurrent;
 
-double dV, dI;
-double currentPower, lastPower, lastVsolar, lastIsolar, lastIbattery;
-double vBat, iBat, vSolar, iSolar, loadVoltage, ambientTemp, mosfetTemp, loadCurrent;
+int32_t quietAmbientTemp, quietMosfetTemp;
 
-double quietAmbientTemp, quietMosfetTemp;
+int32_t vBatOut, iBatOut, vSolarOut, iSolarOut, loadVoltageOut, loadCurrentOut;
+
+/** Running statistics of the measured values, updated once a second from updateStats() and indexed by STAT_x (see mppt.h).
+ * The 5 second window gives the display (and the periodic data packet) values, the 1 and 15 minute windows are sent on request.
+ */
+STATS_Window displayStats[STAT_QUANTITIES], minuteStats[STAT_QUANTITIES], quarterStats[STAT_QUANTITIES];
 
-double vBatAve, iBatAve, vSolarAve, iSolarAve, loadVoltageAve, loadCurrentAve;
-double vBatOut, iBatOut, vSolarOut, iSolarOut, loadVoltageOut, loadCurrentOut;
+int32_t displaySamples[STAT_QUANTITIES][STAT_DISPLAY_SLOTS];
+int32_t minuteSamples[STAT_QUANTITIES][STAT_MINUTE_SLOTS];
+int32_t quarterSamples[STAT_QUANTITIES][STAT_QUARTER_SLOTS];
 
-// adcUnit = Vref / 2^12
-//Vref = 3.3v and 2^12 = 4096 for 12 bits of resolution
-const double adcUnit = 0.000806;
-const double voltageDividerOutput = 0.0623;		// Voltage Divider ratio gives 0.0623 volts out / volt in
+uint8_t displayMinQ[STAT_QUANTITIES][STAT_DISPLAY_SLOTS], displayMaxQ[STAT_QUANTITIES][STAT_DISPLAY_SLOTS];
+uint8_t minuteMinQ[STAT_QUANTITIES][STAT_MINUTE_SLOTS], minuteMaxQ[STAT_QUANTITIES][STAT_MINUTE_SLOTS];
+uint8_t quarterMinQ[STAT_QUANTITIES][STAT_QUARTER_SLOTS], quarterMaxQ[STAT_QUANTITIES][STAT_QUARTER_SLOTS];
 
 // LCD Strings
 char logo[] = "SOLAR TECH";
@@ -199,10 +254,7 @@ static void MX_DMA_Init(void);
 
 void changePWM_TIM5(uint16_t, uint8_t);
 void changePWM_TIM1(uint16_t, uint8_t);
-
-double calcVoltage(uint16_t, uint8_t);
-double calcCurrent(uint16_t );
-double calcTemperature(uint16_t);
+void changePWM_TIM1_Fine(uint16_t);
 
 void switchFan(uint8_t);
 
@@ -218,24 +270,62 @@ void switchCapacitors(uint8_t);
 void lcdBatteryInfo(void);
 void lcdSolarInfo(void);
 void lcdLoadInfo();
-void getADCreadings(uint8_t);
+void getADCreadings(void);
 
-double AdsorptionVoltage(double);
-double FloatVoltage(double);
+int32_t AdsorptionVoltage(int32_t);
+int32_t FloatVoltage(int32_t);
 
 void updateLCD(uint8_t);
+void initStats(void);
+void updateStats(void);
+uint8_t *txAcquire(void);
+void txRelease(const uint8_t *);
+uint8_t txFree(void);
+bool sendFrame(uint8_t);
 void sendMessage(void);
+void sendStatistics(void);
+void sendBenchmark(void);
+void sendProfile(void);
+void sendCapture(void);
+void sendSchedule(void);
+void setTraceDuty(uint16_t);
+void traceIV(void);
+void sendIVTrace(void);
 void pulse(void);
 //void delay_us(uint32_t);
 
-void calcMPPT(void);
-void calcMPPT_TI(void);
-
-void calcMPPT_IC(void);
+void getMeasurement(MPPT_Measurement *);
+void startMPPT(void);
+void calcMPPT(const MPPT_Measurement *);
 
 void mpptBypass(uint8_t);
 void handleData(void);
 
+void secondTick(void);
+void eventTask(void);
+void serviceRequests(void);
+void messageTask(void);
+void statsTask(void);
+void lcdTask(void);
+void chargeTask(void);
+
+/** Main loop tasks, indexed by TASK_x and run by sched_Run() on the HAL_GetTick() clock: function, period, offset, deadline (mS).
+ * Nothing in them waits for the display or the UART any more, so a miss in the MSG_SCHEDULE counters points at
+ * a task that took too long itself. The offsets keep the slow tasks off the measurement ticks.
+ */
+static const SCHED_Task tasks[TASKS] =
+{
+	{ eventTask,		EVENTS_PERIOD,		0,		100 },
+	{ getADCreadings,	MEASURE_PERIOD,		0,		20 },
+	{ chargeTask,		MEASURE_PERIOD,		0,		20 },
+	{ serviceRequests,	REQUESTS_PERIOD,	5,		100 },
+	{ messageTask,		MESSAGE_PERIOD,		50,		1000 },
+	{ statsTask,		STATS_PERIOD,		20,		100 },
+	{ lcdTask,			LCD_PERIOD,			70,		100 }
+};
+
+static SCHED_State taskState[TASKS];
+
 extern void crc16_init(void);
 extern uint16_t crc16(uint8_t[], uint8_t, uint16_t);
 
@@ -295,12 +385,13 @@ static void MX_ADC1_Init(void)
 	hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV2; // was _DIV4
 	hadc1.Init.Resolution = ADC_RESOLUTION_12B;
 	hadc1.Init.ScanConvMode = ENABLE;
-	hadc1.Init.ContinuousConvMode = DISABLE; //DISABLE;
-	hadc1.Init.DiscontinuousConvMode = DISABLE;
-	hadc1.Init.ExternalTrigConv = ADC_SOFTWARE_START;
-	hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
+	hadc1.Init.ContinuousConvMode = DISABLE;
+	hadc1.Init.DiscontinuousConvMode = ENABLE;		// One channel of the sequence per TIM1 trigger, i.e. per PWM period
+	hadc1.Init.NbrOfDiscConversion = 1;
+	hadc1.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T1_CC3;
+	hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
 	hadc1.Init.DataAlign = ADC_DATAALIGN_RIGHT;
-	hadc1.Init.NbrOfConversion = 8;
+	hadc1.Init.NbrOfConversion = ADC_ACQ_REGULAR_CHANNELS;
 	hadc1.Init.DMAContinuousRequests = ENABLE;
 	hadc1.Init.EOCSelection = ADC_EOC_SEQ_CONV;
 
@@ -311,58 +402,33 @@ static void MX_ADC1_Init(void)
 	// Battery Bank Voltage
 	sConfig.Channel = ADC_CHANNEL_0;
 	sConfig.Rank = 1;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+	sConfig.SamplingTime = ADC_SYNC_SAMPLETIME;
 
 	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
 
 	//Solar Array Voltage
 	sConfig.Channel = ADC_CHANNEL_1;
 	sConfig.Rank = 2;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+	sConfig.SamplingTime = ADC_SYNC_SAMPLETIME;
 
 	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
 
 //	Battery Bank Current
 	sConfig.Channel = ADC_CHANNEL_2;
 	sConfig.Rank = 3;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+	sConfig.SamplingTime = ADC_SYNC_SAMPLETIME;
 
 	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
 
 //	Solar Array Current
 	sConfig.Channel = ADC_CHANNEL_3;
 	sConfig.Rank = 4;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
-	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
-
-// 	Load Voltage
-	sConfig.Channel = ADC_CHANNEL_4;
-	sConfig.Rank = 5;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
-
-	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
-
-//	Ambient Temperature
-	sConfig.Channel = ADC_CHANNEL_6;
-	sConfig.Rank = 6;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
-
-	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
-
-//	MOSFET Temperature
-	sConfig.Channel = ADC_CHANNEL_7;
-	sConfig.Rank = 7;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
-
-	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
-
-//	Load Current
-	sConfig.Channel = ADC_CHANNEL_8;
-	sConfig.Rank = 8;
-	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+	sConfig.SamplingTime = ADC_SYNC_SAMPLETIME;
 
 	HAL_ADC_ConfigChannel(&hadc1, &sConfig);
 
+	// Load voltage, temperatures and load current are converted by the injected group at their own rates
+	adcSched_Init(&hadc1);
 }
 
 /**
@@ -391,13 +457,15 @@ static void MX_TIM1_Init(void)
 
 	  TIM_OC_InitTypeDef sConfigOC;
 	  TIM_OC_InitTypeDef sConfigOC2;
+	  TIM_OC_InitTypeDef sConfigOC3;
+	  TIM_OC_InitTypeDef sConfigOC4;
 
 	  htim1.Instance = TIM1;
 	  htim1.Init.Prescaler = 0;
 	  htim1.Init.CounterMode = TIM_COUNTERMODE_CENTERALIGNED2;
-	  htim1.Init.Period = 256;
+	  htim1.Init.Period = TIM1_PERIOD;
 	  htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
-	  htim1.Init.RepetitionCounter = 0;
+	  htim1.Init.RepetitionCounter = 1;	// One update event per PWM period instead of two (the high resolution duty cycle DMA runs on it)
 
 	  HAL_TIM_Base_Init(&htim1);
 
@@ -420,7 +488,7 @@ static void MX_TIM1_Init(void)
 	  sBreakDeadTimeConfig.OffStateRunMode = TIM_OSSR_ENABLE;
 	  sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_DISABLE;
 	  sBreakDeadTimeConfig.LockLevel = TIM_LOCKLEVEL_OFF;
-	  sBreakDeadTimeConfig.DeadTime =  22; //8;
+	  sBreakDeadTimeConfig.DeadTime =  TIM1_DEADTIME; //8;
 	  sBreakDeadTimeConfig.BreakState = TIM_BREAK_DISABLE;
 	  sBreakDeadTimeConfig.BreakPolarity = TIM_BREAKPOLARITY_HIGH;
 	  sBreakDeadTimeConfig.AutomaticOutput = TIM_AUTOMATICOUTPUT_DISABLE;
@@ -447,6 +515,36 @@ static void MX_TIM1_Init(void)
 
 	  HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC2, TIM_CHANNEL_2);
 
+	  // Channel 3 triggers the ADC on its rising edge, once per period while counting up, between switching edges.
+	  // It has no output pin and stays enabled when the converter is off, so the ADC keeps running.
+	  sConfigOC3.OCMode = TIM_OCMODE_PWM2;
+	  sConfigOC3.Pulse = adcTrig_Select();
+	  sConfigOC3.OCPolarity = TIM_OCPOLARITY_HIGH;
+	  sConfigOC3.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+	  sConfigOC3.OCFastMode = TIM_OCFAST_DISABLE;
+	  sConfigOC3.OCIdleState = TIM_OCIDLESTATE_RESET;
+	  sConfigOC3.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+
+	  HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC3, TIM_CHANNEL_3);
+
+	  // Channel 4 triggers the injected group on its rising edge, once per period while counting down.
+	  // Its pin (PA11) is not mapped to TIM1, and the trigger is only armed when a slow channel is due.
+	  sConfigOC4.OCMode = TIM_OCMODE_PWM1;
+	  sConfigOC4.Pulse = adcTrig_SelectInjected(sConfigOC3.Pulse, adcSched_SampleCycles());
+	  sConfigOC4.OCPolarity = TIM_OCPOLARITY_HIGH;
+	  sConfigOC4.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+	  sConfigOC4.OCFastMode = TIM_OCFAST_DISABLE;
+	  sConfigOC4.OCIdleState = TIM_OCIDLESTATE_RESET;
+	  sConfigOC4.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+
+	  HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC4, TIM_CHANNEL_4);
+
+	  // A slow channel whose sample time doesn't fit there is left out of the schedule
+	  adcSched_Verify(sConfigOC4.Pulse, sConfigOC3.Pulse);
+
+	  TIM1->CCER |= TIM_CCER_CC3E | TIM_CCER_CC4E;
+	  __HAL_TIM_ENABLE(&htim1);
+
 	 HAL_TIM_MspPostInit(&htim1);
 }
 
@@ -525,13 +623,14 @@ static void MX_TIM11_Init(void) {
 	  TIM_MasterConfigTypeDef sMasterConfig;
 
 	  htim11.Instance = TIM11;
-	  htim11.Init.Prescaler = 50; // 50 MHz / 50 = 1 MHz clock... 1 uS count interval
+	  htim11.Init.Prescaler = US_TIMER_PRESCALER; // 100 MHz (APB2 timer clock) / 100 = 1 MHz clock... 1 uS count interval
 	  htim11.Init.CounterMode = TIM_COUNTERMODE_UP;
 	  htim11.Init.Period = 0xffff; // Full 16 bit counter
 	  htim11.Init.ClockDivision = TIM_CLOCKDIVISION_DIV2;
 
 	  HAL_TIM_Base_Init(&htim11);
 
+	  // TIM11 has no slave mode controller: whatever the source says, it counts the internal clock
 	  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_ITR0; //TIM_CLOCKSOURCE_INTERNAL;
 
 	  HAL_TIM_ConfigClockSource(&htim11, &sClockSourceConfig);
@@ -557,6 +656,7 @@ static void MX_USART1_UART_Init(void)
 	huart1.Init.OverSampling = UART_OVERSAMPLING_16;
 
 	HAL_UART_Init(&huart1);
+	uartTx_Init(&huart1);
 
 	__HAL_UART_ENABLE_IT(&huart1, UART_IT_RXNE);
 	HAL_NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_0);
@@ -578,6 +678,9 @@ static void MX_DMA_Init(void)
   /* DMA2_Stream0_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+  /* DMA2_Stream7_IRQn interrupt configuration (USART1 TX) */
+  HAL_NVIC_SetPriority(DMA2_Stream7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
 
 }
 
@@ -623,190 +726,160 @@ static void MX_GPIO_Init(void)
 
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
 
-	//TIM9 is the 1 mS timer
+	//TIM9 is the 1 mS timer. It only counts; the once a second housekeeping runs in the main context (secondTick()).
 	if (htim->Instance==TIM9)
 	{
-		// Read the ADC and execute the MPPT algorithm in the isCharging loop every 250 mS
-//		if (adcCount == 1000)
-		if (adcCount == 100)
+		if (++tim9Count >= 1000) // 1 second interval
 		{
-			adcCount = 0;
-			getADC = 1;
+			tim9Count = 0;
+			event_Post(EVENT_SECOND);
 		}
 
-		if (tim9Count == 1000) // 1 second interval
-		{
-			tim9Count = 0;
-//			lcdUpdate++;
-			canPulse++;
+		HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_11); // Ping the WDT
+//		HAL_GPIO_WritePin(GPIOC, GPIO_PIN_11, GPIO_PIN_SET);
+//		HAL_GPIO_WritePin(GPIOC, GPIO_PIN_11, GPIO_PIN_RESET);
 
-//			updateLCD(warning);
-			updateLCDflag = true;
+	}
+}
 
-			if (readTempCount == 0)
-			{
-				//check MOSFET temperature and switch fan on or off as needed
-				if (quietMosfetTemp >= FAN_ON_TEMP)
-					switchFan(ON);
-				if (quietMosfetTemp <= FAN_OFF_TEMP)
-					switchFan(OFF);
-			}
+// The last byte of a DMA transmit has gone out (see USART1_IRQHandler())
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
 
-			readTempCount++;
+	if (huart->Instance==USART1)
+		uartTx_Complete();
+}
 
-			if (canPulse > pulseInterval)
-				canPulse = 0;
+// TIM11 CC1 runs the one-shot microsecond timers
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim) {
 
-/** Average the voltage and current readings over a 5 second interval/
- * This smoothes out some of the variation and makes these vaues easier to understand
- */
-			if (aveCount <= 5)
-			{
-				if (aveCount == 0)
-				{
-					vBatAve = 0;
-					iBatAve = 0;
-					vSolarAve = 0;
-					iSolarAve = 0;
-					loadVoltageAve = 0;
-					loadCurrentAve = 0;
-				}
+	if (htim->Instance==TIM11)
+		usTimer_Service();
+}
+
+// The once a second timers and housekeeping, for every EVENT_SECOND posted by the TIM9 interrupt
+void secondTick(void)
+{
 
-				vBatAve += vBat;
-				iBatAve += iBat;
-				vSolarAve += vSolar;
-				iSolarAve  += iSolar;
-				loadVoltageAve += loadVoltage;
-				loadCurrentAve += loadCurrent;
+	canPulse++;
 
-				aveCount++;
+	//check MOSFET temperature and switch fan on or off as needed
+	if (quietMosfetTemp >= FAN_ON_TEMP * 100)
+		switchFan(ON);
+	if (quietMosfetTemp <= FAN_OFF_TEMP * 100)
+		switchFan(OFF);
 
-				if (aveCount == 5)
-				{
-					vBatOut = vBatAve / aveCount;
-					iBatOut = iBatAve / aveCount;
-					vSolarOut = vSolarAve / aveCount;
-					iSolarOut = iSolarAve / aveCount;
-					loadVoltageOut = loadVoltageAve / aveCount;
-					loadCurrentOut = loadCurrentAve / aveCount;
-					aveCount = 0;
-				}
-			}
+	if (canPulse > pulseInterval)
+		canPulse = 0;
 
-/**Time interval to wait between checking for minimum charge current. This flag get set in the canCharge loop
+/**Time interval to wait between checking for minimum charge current. This flag get set in CHARGE_START (see chargeTask())
  *
  */
-			if (lowChargeCurrentFlag)
-			{
-				lowChargeCurrentTimeout++;
-
-				if (lowChargeCurrentTimeout == LOW_CHARGE_CURRENT_TIMEOUT)
-				{
-					lowChargeCurrentTimeout = 0;
-					lowChargeCurrentFlag = false;
-				}
-			}
-			else
-			{
-				lowChargeCurrentTimeout = 0;
-			}
-
-			// Flash the charge LED when charging is active
-			if (isCharging == 0)
-				toggleChargeLED();
-			else
-				switchChargeLED(ON);
-
+	if (lowChargeCurrentFlag)
+	{
+		lowChargeCurrentTimeout++;
 
-			// Adsorption voltage (Va) timer.
-			if (adsorptionFlag)
-			{
-				adsorptionTime++;
+		if (lowChargeCurrentTimeout == LOW_CHARGE_CURRENT_TIMEOUT)
+		{
+			lowChargeCurrentTimeout = 0;
+			lowChargeCurrentFlag = false;
+		}
+	}
+	else
+	{
+		lowChargeCurrentTimeout = 0;
+	}
 
-				if (adsorptionTime >= ADSORPTION_TIME_FLOODED)
-				{
-					adsorptionFlag = false;
-					adsorptionComplete = true;
-					adsorptionTime = 0;
-				}
-			}
+	// Flash the charge LED when charging is active
+	if (isCharging == 0)
+		toggleChargeLED();
+	else
+		switchChargeLED(ON);
 
-			// Va lockout timer. After charging to Va and holding for ADSORPTION_TIME_FLOODED, wait for ADSORPTION_LOCKOUT_TIME
-			// before allowing to charge up to Va again
-			if (adsorptionComplete)
-			{
-				adsorptionCompleteTime++;
 
-				if (adsorptionCompleteTime >= ADSORPTION_LOCKOUT_TIME)
-				{
-					adsorptionCompleteTime = 0;
-					adsorptionComplete = false;
-				}
-			}
+	// Adsorption voltage (Va) timer.
+	if (adsorptionFlag)
+	{
+		adsorptionTime++;
 
+		if (adsorptionTime >= ADSORPTION_TIME_FLOODED)
+		{
+			adsorptionFlag = false;
+			adsorptionComplete = true;
+			adsorptionTime = 0;
+		}
+	}
 
-			// Power cycle watchdog timer: set by the host controller over the UART to power cycle the load after a programmed time
-			// (powerCycleTimeout) and holds the load off for powercycleOffTime before restoring power to the load.
-			if (enablePowerCycle)
-			{
-				timerCount++;
+	// Va lockout timer. After charging to Va and holding for ADSORPTION_TIME_FLOODED, wait for ADSORPTION_LOCKOUT_TIME
+	// before allowing to charge up to Va again
+	if (adsorptionComplete)
+	{
+		adsorptionCompleteTime++;
 
-				if (timerCount >= powerCycleTimeout)
-				{
-					enablePowerCycle = false;
-					offTimeCount++;
-					switchLoad(OFF);
-				}
-			}
+		if (adsorptionCompleteTime >= ADSORPTION_LOCKOUT_TIME)
+		{
+			adsorptionCompleteTime = 0;
+			adsorptionComplete = false;
+		}
+	}
 
-			if (offTimeCount > 0)
-			{
-				offTimeCount++;
 
-				if (offTimeCount >= powerCycleOffTime)
-				{
-					offTimeCount = 0;
-					switchLoad(ON);
-				}
-			}
+	// Power cycle watchdog timer: set by the host controller over the UART to power cycle the load after a programmed time
+	// (powerCycleTimeout) and holds the load off for powercycleOffTime before restoring power to the load.
+	if (enablePowerCycle)
+	{
+		timerCount++;
 
-			if (cycleLoadPower)
-			{
-				cycleLoadTime++;
+		if (timerCount >= powerCycleTimeout)
+		{
+			enablePowerCycle = false;
+			offTimeCount++;
+			switchLoad(OFF);
+		}
+	}
 
-				if (cycleLoadTime >= CYCLE_LOAD_TIMEOUT)
-				{
-					cycleLoadTime = 0;
-					cycleLoadPower = false;
-					switchLoad(ON);
-				}
+	if (offTimeCount > 0)
+	{
+		offTimeCount++;
 
-			}
+		if (offTimeCount >= powerCycleOffTime)
+		{
+			offTimeCount = 0;
+			switchLoad(ON);
 		}
+	}
 
-		tim9Count++;
-		adcCount++;
+	if (cycleLoadPower)
+	{
+		cycleLoadTime++;
 
-		HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_11); // Ping the WDT
-//		HAL_GPIO_WritePin(GPIOC, GPIO_PIN_11, GPIO_PIN_SET);
-//		HAL_GPIO_WritePin(GPIOC, GPIO_PIN_11, GPIO_PIN_RESET);
+		if (cycleLoadTime >= CYCLE_LOAD_TIMEOUT)
+		{
+			cycleLoadTime = 0;
+			cycleLoadPower = false;
+			switchLoad(ON);
+		}
 
 	}
 }
 
-void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc1) {
+// Does the work the interrupts left in the event queue (see event.c), oldest first
+void eventTask(void)
+{
 
-	vBattery += adcBuffer[0];
-	vSolarArray += adcBuffer[1];
-	iBattery += adcBuffer[2];
-	iSolarArray += adcBuffer[3];
-	vLoad += adcBuffer[4];
-	tempAmbient += adcBuffer[5];
-	tempMOSFETS += adcBuffer[6];
-	iLoad += adcBuffer[7];
+	uint8_t event;
 
-	adcConvComplete = 1;
+	while ((event = event_Get()) != EVENT_NONE)
+	{
+		switch (event)
+		{
+			case EVENT_SECOND:
+				secondTick();
+				break;
 
+			default:
+				break;
+		}
+	}
 }
 
 // Controls the Duty cycle of the switching MOSFETs
@@ -815,18 +888,33 @@ void changePWM_TIM1(uint16_t pulse, uint8_t onOffUpdate)
 
 	  if (onOffUpdate == ON)
 	  {
-		  __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_1, PCT80_DUTY_CYCLE);
-		  __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_2, 256 - PCT80_DUTY_CYCLE);
+		  __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_1, pulse);
+		  __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_2, 256 - pulse);
 
 		  HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_1);
 		  HAL_TIMEx_PWMN_Start(&htim1, TIM_CHANNEL_1);
 
 		  HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_2);
 		  HAL_TIMEx_PWMN_Start(&htim1, TIM_CHANNEL_2);
+
+#ifdef PWM_HIGH_RESOLUTION
+		  pwmDither_Set(DUTY_FINE(pulse));
+		  pwmDither_Start();
+#endif
+
+		  dutyApplied = DUTY_FINE(pulse);
 	  }
 
 	  else if (onOffUpdate == OFF)
 	  {
+#ifdef PWM_HIGH_RESOLUTION
+		  pwmDither_Stop();
+#endif
+
+		  // Nothing may step the duty cycle of a converter that is off
+		  mpptRunning = false;
+		  dutyApplied = 0;
+
 		  HAL_TIM_PWM_Stop(&htim1, TIM_CHANNEL_1);
 		  HAL_TIMEx_PWMN_Stop(&htim1, TIM_CHANNEL_1);
 
@@ -837,15 +925,22 @@ void changePWM_TIM1(uint16_t pulse, uint8_t onOffUpdate)
 		  // Even though this step appears to be handled properly by the HAL Stop functions...
 		  // ...this provides added insurance that these timer output channels (that drive the switching MOSFET gates) are disabled and in a LOW state
 		  // so we may avoid leaving one or more MOSFETS turned on
-		  tim1_ccer = *(__IO uint16_t *)0x40010020;
+		  tim1_ccer = TIM1->CCER;
 		  TIM1->CCER = tim1_ccer & 0x3faa;
 
 	  }
 
 	  else if (onOffUpdate == UPDATE)
 	  {
+#ifdef PWM_HIGH_RESOLUTION
+		  // The update DMA would overwrite the compare registers
+		  pwmDither_Set(DUTY_FINE(pulse));
+#else
 		  __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_1, pulse);
 		  __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_2, 256 - pulse);
+#endif
+
+		  dutyApplied = DUTY_FINE(pulse);
 	  }
 	  else
 	  {
@@ -853,6 +948,17 @@ void changePWM_TIM1(uint16_t pulse, uint8_t onOffUpdate)
 	  }
 }
 
+// Updates the duty cycle of the running converter, in 1/16 counts (DUTY_FRACTION_BITS)
+void changePWM_TIM1_Fine(uint16_t pulseFine)
+{
+#ifdef PWM_HIGH_RESOLUTION
+	pwmDither_Set(pulseFine);
+	dutyApplied = pulseFine;
+#else
+	changePWM_TIM1((pulseFine + DUTY_FINE(1) / 2) >> DUTY_FRACTION_BITS, UPDATE);
+#endif
+}
+
 // Controls the brightness of the LCD backlight
 void changePWM_TIM5(uint16_t pulse, uint8_t onOffUpdate)
 {
@@ -878,39 +984,24 @@ void changePWM_TIM5(uint16_t pulse, uint8_t onOffUpdate)
 	 }
 }
 
-void getADCreadings (uint8_t howMany)
+void getADCreadings(void)
 {
 
-	uint8_t i;
-
-	vBattery = 0;
-	vSolarArray = 0;
-	iBattery = 0;
-	iSolarArray = 0;
-	vLoad = 0;
-	tempAmbient = 0;
-	tempMOSFETS = 0;
-	iLoad = 0;
-
-	//	ADC channel values are initialized above and new values are accumulated in HAL_ADC_ConvCpltCallback() after each loop
-	//	(i.e.each completed conversion)
-	for (i=howMany; i>0; i--)
-	{
-		adcConvComplete = 0;
+	ADC_Frame frame;
+	uint32_t profStart = prof_Now();
 
-		HAL_ADC_Start_DMA(&hadc1, (uint32_t *)adcBuffer, 8);
-		while(!adcConvComplete);
-	}
+	//	The ADC runs continuously and the DMA callbacks in adc_acq.c publish averaged frames.
+	//	Just pick up the latest one, there is nothing to wait for here.
+	adcAcq_GetFrame(&frame);
 
-// Averaging the readings
-	vBattery /= howMany;
-	vSolarArray /= howMany;
-	iBattery /= howMany;
-	iSolarArray /= howMany;
-	vLoad /= howMany;
-	tempAmbient /= howMany;
-	tempMOSFETS /= howMany;
-	iLoad /= howMany;
+	vBattery = frame.channel[0];
+	vSolarArray = frame.channel[1];
+	iBattery = frame.channel[2];
+	iSolarArray = frame.channel[3];
+	vLoad = frame.channel[4];
+	tempAmbient = frame.channel[5];
+	tempMOSFETS = frame.channel[6];
+	iLoad = frame.channel[7];
 
 // Check for any problems with battery voltage
 	if (vBattery >= V_MAX_LOAD_OFF )
@@ -950,12 +1041,12 @@ void getADCreadings (uint8_t howMany)
 	}
 
 // Check for overheating
-	if (quietMosfetTemp >= MAXTEMP)
+	if (quietMosfetTemp >= MAXTEMP * 100)
 	{
 		overheatFlag = true;
 	}
 
-	if ( overheatFlag && (quietMosfetTemp <= FAN_ON_TEMP) )
+	if ( overheatFlag && (quietMosfetTemp <= FAN_ON_TEMP * 100) )
 	{
 		overheatFlag = false;
 	}
@@ -970,83 +1061,184 @@ void getADCreadings (uint8_t howMany)
 	mosfetTemp = calcTemperature(tempMOSFETS);
 	loadCurrent = calcCurrent(iLoad);
 
-	sendMessageCount++;
+	// Conversions are synchronized to the PWM, so the temperatures are clean even while charging
+	quietAmbientTemp = ambientTemp;
+	quietMosfetTemp = mosfetTemp;
 
-#ifdef DEBUG2
+	// The load MOSFET driver can latch off with RF interference: with the battery fine and the load output reading neither
+	// off nor full, cycle the load (see CYCLE_LOAD_TIMEOUT). Not while the power cycle watchdog is running.
+	if ((!enablePowerCycle) && (warning == NORMALBATTV) && (loadVoltage > 100) && (loadVoltage < 8000))
+	{
+		cycleLoadPower = true;
+		switchLoad(OFF);
+	}
+
+	prof_Stop(PROF_GET_ADC_READINGS, profStart);
+}
+
+/** Sends the replies to the UART commands that handleData() left for the main context.
+ * A reply waits, with its flag still set, until there are TX buffers for all its frames.
+ */
+void serviceRequests(void)
+{
 
-	if (sendMessageCount >= 15)		// Output a line every second (debugging)
+	if ( sendStatsFlag && (txFree() != 0) )
 	{
-		sendMessageCount = 0;
-		// This data is sent to a terminal like puTTY
-		 sprintf(strBuffer, "MPPT ADC Values: %2.2f, %2.2f, %2.2f, %2.2f, %2.2f, %2.2f, %2.2f, %2.2f, %2.2f, %2.2f, %d\r\n", vBat, iBat, vSolar, iSolar, loadVoltage, loadCurrent, quietAmbientTemp, quietMosfetTemp, FloatVoltage(quietAmbientTemp), AdsorptionVoltage(quietAmbientTemp), lcdUpdate);
-		 HAL_UART_Transmit(&huart1, strBuffer, sizeof(strBuffer), 0xffff);
+		sendStatsFlag = false;
+		sendStatistics();
 	}
 
-#else
-		if (sendMessageCount >= 150)	// Output a data packet every 15 seconds
+	if ( sendBenchFlag && (txFree() != 0) )
+	{
+		sendBenchFlag = false;
+		sendBenchmark();
+
+		if (resetBenchFlag)
 		{
-			sendMessageCount = 0;
-			sendMessage();
+			resetBenchFlag = false;
+			mpptBench_Reset();
 		}
+	}
 
-#endif
+	if (captureRequest)
+	{
+		captureRequest = false;
+
+		if (captureDecimation == 0)
+			capture_Stop();
+		else
+			capture_Start(captureDecimation, captureBurst);
+	}
+
+	sendCapture();
+
+	if ( sendProfileFlag && (txFree() != 0) )
+	{
+		sendProfileFlag = false;
+		sendProfile();
+
+		if (resetProfileFlag)
+		{
+			resetProfileFlag = false;
+			prof_Reset();
+		}
+	}
 
-	if (updateLCDflag)
+	if ( sendSchedFlag && (txFree() != 0) )
 	{
-		updateLCDflag = false;
-		updateLCD(warning);
+		sendSchedFlag = false;
+		sendSchedule();
+
+		if (resetSchedFlag)
+		{
+			resetSchedFlag = false;
+			sched_ResetStats();
+			usTimer_ResetLatency();
+		}
 	}
 
+	if ( ivTraceRequest && (txFree() >= IV_TRACE_FRAMES) )
+	{
+		ivTraceRequest = false;
+		traceIV();
+	}
 }
 
-double AdsorptionVoltage(double ambTemp)
+// The data packet to the controller every MESSAGE_PERIOD, or with DEBUG2 a line to a terminal like puTTY
+void messageTask(void)
 {
-	if (ambTemp < TEMP_NEG30)
-		return (ATV_NEG30);
 
-//	else if ( (ambTemp > TEMP_NEG30) && (ambTemp < TEMP_40) )
-	else if ( (ambTemp > TEMP_NEG30) && (ambTemp < TEMP_80) )
-		return (ATV_NEG30 - ( (ambTemp - TEMP_NEG30) * (double)RATE1) );
+	uint32_t probe = prof_Now();
 
-	else
-//		return (ATV_40);
-		return (ATV_80);
+#ifdef DEBUG2
+
+	uint8_t *strBuffer;
+
+	// The console lines wait for nothing: while the UART is still busy with earlier frames, a line is skipped
+	if ((strBuffer = txAcquire()) == NULL)
+		return;
+
+	sprintf(strBuffer, "MPPT ADC Values: %d.%02d, %d.%02d, %d.%02d, %d.%02d, %d.%02d, %d.%02d, %d, %d, %d.%02d, %d.%02d, %d\r\n",
+			MEAS_WHOLE(vBat), MEAS_HUNDREDTHS(vBat), MEAS_WHOLE(iBat), MEAS_HUNDREDTHS(iBat),
+			MEAS_WHOLE(vSolar), MEAS_HUNDREDTHS(vSolar), MEAS_WHOLE(iSolar), MEAS_HUNDREDTHS(iSolar),
+			MEAS_WHOLE(loadVoltage), MEAS_HUNDREDTHS(loadVoltage), MEAS_WHOLE(loadCurrent), MEAS_HUNDREDTHS(loadCurrent),
+			(int)(quietAmbientTemp / 100), (int)(quietMosfetTemp / 100),
+			MEAS_WHOLE(FloatVoltage(quietAmbientTemp)), MEAS_HUNDREDTHS(FloatVoltage(quietAmbientTemp)),
+			MEAS_WHOLE(AdsorptionVoltage(quietAmbientTemp)), MEAS_HUNDREDTHS(AdsorptionVoltage(quietAmbientTemp)), lcdUpdate);
+
+	if (!uartTx_Send(strBuffer, strlen((char *)strBuffer), txRelease))
+		txRelease(strBuffer);
+
+	if ( isCharging && ((strBuffer = txAcquire()) != NULL) )
+	{
+		sprintf(strBuffer, "MPPT control: %lu steps, latency %lu uS (max %lu)\r\n",
+				controlSteps, controlLatency / (SystemCoreClock / 1000000), controlLatencyMax / (SystemCoreClock / 1000000));
+
+		if (!uartTx_Send(strBuffer, strlen((char *)strBuffer), txRelease))
+			txRelease(strBuffer);
+	}
+
+	prof_Stop(PROF_DEBUG_PRINT, probe);
+
+#else
+
+	// A data packet that finds the UART still busy is skipped, the next one follows MESSAGE_PERIOD later
+	if (txFree() == 0)
+		return;
+
+	sendMessage();
+	prof_Stop(PROF_SEND_MESSAGE, probe);
+
+#endif
 }
 
-double FloatVoltage(double ambTemp)
+// The 5 second display averages and the telemetry statistics
+void statsTask(void)
 {
-	if (ambTemp <= TEMP_NEG30)
-		return (FTV_NEG30);
 
-//	else if ( (ambTemp > TEMP_NEG30) && (ambTemp < TEMP_40) )
-	else if ( (ambTemp > TEMP_NEG30) && (ambTemp < TEMP_80) )
-		return (FTV_NEG30 - ( (ambTemp - TEMP_NEG30) * (double)RATE1) );
+	uint32_t probe = prof_Now();
 
-	else
-//		return (FTV_40);
-		return (FTV_80);
+	updateStats();
+	prof_Stop(PROF_UPDATE_STATS, probe);
 }
 
-double calcVoltage(uint16_t ADvalue, uint8_t gain)
+void lcdTask(void)
 {
-	return (ADvalue * adcUnit) / gain / voltageDividerOutput;
+
+	uint32_t probe = prof_Now();
+
+	updateLCD(warning);
+	prof_Stop(PROF_UPDATE_LCD, probe);
 }
 
-double calcCurrent(uint16_t ADvalue)
+// Returns the adsorption voltage in mV for an ambient temperature in hundredths of a degC
+int32_t AdsorptionVoltage(int32_t ambTemp)
 {
-	const uint8_t gain = 50;						// Gain of the INA213AIDCK current sense amplifier
-	const double Rsense	=	0.002;					// Value of current sense resistors used in design.
+	if (ambTemp <= TEMP_NEG30 * 100)
+		return (ATV_NEG30);
 
-	return (ADvalue * adcUnit) / gain / Rsense;
+//	else if ( (ambTemp > TEMP_NEG30) && (ambTemp < TEMP_40) )
+	else if ( (ambTemp > TEMP_NEG30 * 100) && (ambTemp < TEMP_80 * 100) )
+		return (ATV_NEG30 - ( (ambTemp - TEMP_NEG30 * 100) * RATE1 / 100) );
+
+	else
+//		return (ATV_40);
+		return (ATV_80);
 }
 
-double calcTemperature(uint16_t ADvalue)
+// Returns the float voltage in mV for an ambient temperature in hundredths of a degC
+int32_t FloatVoltage(int32_t ambTemp)
 {
-//	const double LM335voltage = 0.010;				// The LM335 outputs 10 mV / degree Kelvin
-//	const double kelvin = 273.15;					// 0 C = 273.15 K
+	if (ambTemp <= TEMP_NEG30 * 100)
+		return (FTV_NEG30);
+
+//	else if ( (ambTemp > TEMP_NEG30) && (ambTemp < TEMP_40) )
+	else if ( (ambTemp > TEMP_NEG30 * 100) && (ambTemp < TEMP_80 * 100) )
+		return (FTV_NEG30 - ( (ambTemp - TEMP_NEG30 * 100) * RATE1 / 100) );
 
-//	return ((ADvalue * adcUnit) / LM335voltage) - kelvin;
-	return ( (ADvalue * adcUnit) / 0.010)  - 50;
+	else
+//		return (FTV_40);
+		return (FTV_80);
 }
 
 void mpptBypass(uint8_t onOff)
@@ -1076,173 +1268,457 @@ void mpptBypass(uint8_t onOff)
 	}
 }
 
-void calcMPPT_IC(void)
+// Fills m with the latest solar and battery readings
+void getMeasurement(MPPT_Measurement *m)
+{
+	m->vSolar = vSolar;
+	m->iSolar = iSolar;
+	m->vBat = vBat;
+	m->iBat = iBat;
+}
+
+// Starts the active MPPT strategy from the present duty cycle and readings
+void startMPPT(void)
 {
-	double conductance;
+	MPPT_Measurement m;
+
+	getMeasurement(&m);
+	mpptStrategy_Init(&m, duty);
+
+	regulating = false;
+	dutyResetRequest = false;		// A reset left over from before the stop: startMPPT() has the duty cycle already
+	chargeReg_Reset(duty);
+	mpptBench_Start();
+}
 
-	dV = vSolar - lastVsolar;
-	dI = iSolar - lastIsolar;
+/** One MPPT step with m measured at the present duty cycle: the active strategy picks the next duty cycle (1/16 counts),
+ * limited here to MIN_DUTY_CYCLE..MAX_DUTY_CYCLE. Runs in the ADC DMA interrupt, see adcAcq_FrameCallback().
+ *
+ * In the absorption and float stages the battery voltage regulator (charge_reg.c) backs the duty cycle off below
+ * the MPPT duty, which stays its ceiling. While it does, the array isn't at the MPPT duty, so the strategy and the
+ * scan wait; the strategy carries on from there once the battery takes everything the array delivers again.
+ * A scan that brings the battery up to the stage voltage is dropped where it is, and the regulator takes over.
+ * An over-voltage reset from chargeTrack() drops the scan too, and restarts the strategy at PCT80_DUTY_CYCLE.
+ */
+void calcMPPT(const MPPT_Measurement *m)
+{
+	int32_t command;
+	uint16_t scanDuty, output;
 
-	if (dV != 0)
+	// A strategy change requested over the UART takes effect between two steps
+	if (strategyRequest != mpptStrategy_GetActive())
 	{
-		conductance  = (double)dI / (double)dV;
+		mpptStrategy_Select(strategyRequest);
+		mpptStrategy_Init(m, duty);
+		mpptBench_Start();
 	}
 
-	if (dV != 0)
+	// duty belongs to this interrupt, so the main loop asks for a reset instead of writing it. The strategy (and a
+	// running scan) would carry on from the old operating point, so it starts again from the new one.
+	if (dutyResetRequest)
 	{
+		dutyResetRequest = false;
 
-//		if ((iSolar + (conductance * vSolar)) == 0)
-		if (conductance == -((double)iSolar/(double)vSolar))
-		{
+		mpptScan_Cancel();
+		duty = DUTY_FINE(PCT80_DUTY_CYCLE);
+		mpptStrategy_Init(m, duty);
+		mpptBench_Start();
 
-		}
+		output = chargeReg_Step(m->vBat, duty);
+		regulating = (output < duty);
+		changePWM_TIM1_Fine(output);
+
+		return;
+	}
+
+	if (!regulating)
+	{
+		// Periodic global peak scan (not needed for the constant voltage strategy). It sweeps the whole duty range,
+		// so it bypasses the MAX_DUTY_CYCLE count, and hands over to the strategy at the peak it found.
+		if ( (mpptStrategy_GetActive() != MPPT_STRATEGY_CV) && mpptScan_Due(HAL_GetTick()) )
+			mpptScan_Start(HAL_GetTick());
 
-//		else if ((iSolar + (conductance * vSolar)) > 0)
-		else if (conductance > -((double)iSolar/(double)vSolar))
+		if (mpptScan_Active())
 		{
-			duty++;
+			// The scan works in whole counts
+			scanDuty = duty >> DUTY_FRACTION_BITS;
 
-			if (duty >= MAX_DUTY_CYCLE)
+			if (mpptScan_Step(m, &scanDuty))
 			{
-				duty = MAX_DUTY_CYCLE;
-				maxDutyCycleCount++;
-			}
-		}
+				duty = DUTY_FINE(scanDuty);
+				output = chargeReg_Step(m->vBat, duty);
 
-		else
-		{
-			duty--;
+				// The battery reached the stage voltage: a sweep can't hold it there, so the regulator takes over
+				if (output < duty)
+				{
+					mpptScan_Cancel();
+					regulating = true;
+				}
+
+				changePWM_TIM1_Fine(output);
+			}
+			else
+			{
+				mpptStrategy_Init(m, duty);
+				mpptBench_SetPeak(mpptScan_GetPeakPower());
+				mpptBench_Start();
+			}
 
-			if (duty <= MIN_DUTY_CYCLE)
-				duty = MIN_DUTY_CYCLE;
+			return;
 		}
 
-	}
+		command = mpptStrategy_Step(m, duty);
+		mpptBench_Step(mpptStrategy_GetActive(), calcPower(m->vSolar, m->iSolar));
 
-	else if (dI != 0)
-	{
-		if (dI > 0)
+		if (command >= DUTY_FINE(MAX_DUTY_CYCLE))
 		{
-			duty--;
-
-			if (duty <= MIN_DUTY_CYCLE)
-				duty = MIN_DUTY_CYCLE;
+			command = DUTY_FINE(MAX_DUTY_CYCLE);
+			atMaxDuty = true;
 		}
 
-		else
-		{
-			duty++;
+		if (command <= DUTY_FINE(MIN_DUTY_CYCLE))
+			command = DUTY_FINE(MIN_DUTY_CYCLE);
 
-			if (duty >= MAX_DUTY_CYCLE)
-			{
-				duty = MAX_DUTY_CYCLE;
-				maxDutyCycleCount++;
-			}
+		duty = command;
+	}
+
+	output = chargeReg_Step(m->vBat, duty);
+
+	if (output < duty)
+	{
+		regulating = true;
+	}
+	else if (regulating)
+	{
+		regulating = false;
+		mpptStrategy_Init(m, duty);
+		mpptBench_Start();
+	}
+
+	changePWM_TIM1_Fine(output);
+}
+
+/** MPPT control loop
+ * Runs in the ADC DMA interrupt for every published frame, and steps the MPPT on every MPPT_CONTROL_FRAMES of them
+ * while mpptRunning is set. The step rate is fixed by TIM1 and the measurement is never older than one frame, whatever
+ * the main loop is doing. The latency is measured from the end of the DMA half buffer to the new duty cycle being written;
+ * TIM1 picks it up at its next update event, at most one PWM period later.
+ */
+static void controlStep(const ADC_Frame *frame)
+{
+	MPPT_Measurement m;
+	uint32_t start = prof_Now();
+
+	m.vBat = calcVoltage(frame->channel[0], 2);
+	m.vSolar = calcVoltage(frame->channel[1], 2);
+	m.iBat = calcCurrent(frame->channel[2]);
+	m.iSolar = calcCurrent(frame->channel[3]);
+
+	calcMPPT(&m);
+
+	prof_Stop(PROF_MPPT_STEP, start);
+
+	controlLatency = prof_Now() - frame->timestamp;
+	if (controlLatency > controlLatencyMax)
+		controlLatencyMax = controlLatency;
+
+	controlSteps++;
+}
+
+void adcAcq_FrameCallback(const ADC_Frame *frame)
+{
+	uint8_t flags;
+
+	if (!mpptRunning)
+	{
+		controlFrames = 0;
+	}
+	else if (++controlFrames >= MPPT_CONTROL_FRAMES)
+	{
+		controlFrames = 0;
+		controlStep(frame);
+	}
+
+	// The capture sees the frame with the duty cycle and state that resulted from it
+	flags = mpptStrategy_GetActive() << CAPTURE_STRATEGY_SHIFT;
+
+	if (mpptRunning)
+		flags |= CAPTURE_MPPT_RUNNING;
+	if (regulating)
+		flags |= CAPTURE_REGULATING;
+	if (mpptScan_Active())
+		flags |= CAPTURE_SCANNING;
+	if (isBypass)
+		flags |= CAPTURE_BYPASS;
+	if (isCharging)
+		flags |= CAPTURE_CHARGING;
+
+	capture_Frame(frame, HAL_GetTick(), dutyApplied, flags);
+}
+
+// Converter off and the array disconnected from the battery, back to where a charge starts from
+static void chargeStop(void)
+{
+	mpptRunning = false;
+	changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
+	mpptBypass(OFF);
+	isBypass = false;
+	isCharging = false;
+}
+
+// The stage to be in with the converter off, from the array and battery voltages
+static uint8_t chargeSelect(void)
+{
+
+	// We have enough solar energy to charge the batteries
+	if (vSolarArray >= (vBattery + TWO_VOLT))
+	{
+		switchSolarArray(ON);
+		switchCharger(ON);
+
+		// Batteries need bulk charging?
+		if (vBat < FloatVoltage(quietAmbientTemp) - 250)
+		{
+			adsorptionFlag = false;
+			adsorptionTime = 0;
+			floatFlag = false;
+
+			return CHARGE_WAIT;
 		}
 
+		// Did we charge to the adsorption voltage (Va) but didn't hold it for ADSORPTION_TIME_FLOODED?
+		if (adsorptionFlag && floatFlag && !adsorptionComplete)
+		{
+			if (vBat <= AdsorptionVoltage(quietAmbientTemp) - 500)
+				return CHARGE_WAIT;
+		}
+
+		// Did we charge to Va and hold it for ADSORPTION_TIME_FLOODED?
+		else if (!adsorptionFlag && adsorptionComplete)
+		{
+			if (vBat <= FloatVoltage(quietAmbientTemp) - 250)
+				return CHARGE_WAIT;
+		}
+
+		chargeStop();
+		return CHARGE_IDLE;
 	}
 
-	lastVsolar = vSolar;
-	lastIsolar = iSolar;
-	changePWM_TIM1(duty, UPDATE);
+	// Solar array voltage is high enough to de-sulfate the batteries but not high enough to charge them
+	if (vSolarArray > vBattery)
+	{
+		switchCharger(OFF);
+		switchSolarArray(ON);
+		chargeStop();
+
+		return CHARGE_DESULFATE;
+	}
+
+	// Don't do anything if the solar array voltage is below battery voltage.
+	switchCharger(OFF);
+	switchSolarArray(OFF);
+	chargeStop();
+	canPulse = 0;
+
+	return CHARGE_DARK;
+}
+
+// Battery voltage the charge stage holds, in mV: absorption until the adsorption timer completes, float after that
+static int32_t chargeStageVoltage(void)
+{
+	if (adsorptionComplete)
+		return FloatVoltage(quietAmbientTemp);
+
+	return AdsorptionVoltage(quietAmbientTemp);
 }
 
-void calcMPPT_TI(void)
+// Absorption and float tracking while the array charges the battery, through the converter or bypassing it
+static void chargeTrack(void)
 {
-	currentPower = vSolar * iSolar;
 
-	if (currentPower < lastPower)
+	// We no longer have enough current to charge. A low current is expected while the regulator holds the battery voltage.
+	if ( (iSolarArray < THRESHOLD_CURRENT) && !regulating )
 	{
-		POB_Direction *= -1;
+		chargeStop();
+		chargeState = CHARGE_WAIT;
+		return;
 	}
 
-	if (POB_Direction == 1)
+	if ( (warning == HIBATTV) || (warning == DEADBATT) )
 	{
-		duty--;
+		chargeStop();
+		chargeState = CHARGE_IDLE;
+		return;
+	}
 
-		if (duty <= MIN_DUTY_CYCLE)
-			duty = MIN_DUTY_CYCLE;
+	// calcMPPT() owns the duty cycle while the MPPT runs, and applies the reset on its next step
+	if (vSolarArray >= MAX_PV_VOLT)
+	{
+		dutyResetRequest = true;
 	}
-	else
+
+	if (vBat < FloatVoltage(quietAmbientTemp))
 	{
-		duty++;
+		adsorptionFlag = false;
+		floatFlag = false;
+		adsorptionTime = 0;
+	}
 
-		if (duty >= MAX_DUTY_CYCLE)
-		{
-			duty = MAX_DUTY_CYCLE;
-			maxDutyCycleCount++;
-		}
-//		else
-//		{
-//			maxDutyCycleCount = 0;
-//		}
+	if (vBat >= FloatVoltage(quietAmbientTemp) )
+		floatFlag = true;
+
+	if ( !adsorptionFlag && !adsorptionComplete && floatFlag && (vBat >= AdsorptionVoltage(quietAmbientTemp) ) )
+	{
+		adsorptionFlag = true;
+		floatFlag = true;
+		adsorptionTime = 0;
 	}
 
-	lastPower = currentPower;
-	changePWM_TIM1(duty, UPDATE);
+	// The regulator in calcMPPT() holds the battery at the stage voltage instead of switching the converter off
+	// and on around it.
+	chargeReg_SetTarget(chargeStageVoltage());
 }
 
-void calcMPPT(void)
+/** Charge stage state machine (CHARGE_x in mppt.h), run by TASK_CHARGE right after TASK_MEASURE has read the ADC.
+ * Every stage change happens here, and the converter is only ever started from CHARGE_WAIT, where it has been off for
+ * at least one task period, so the array has settled at its open circuit voltage for the seed duty cycle.
+ */
+void chargeTask(void)
 {
 
-	currentPower = vSolar * iSolar;
+	// We charge only if the battery isn't too dead and the MOSFETs aren't overheated, whatever the stage.
+	// Everything stays off while we warn the user through the LCD.
+	if ( (vBattery < BAT_DROP_DEAD_VOLT) || overheatFlag )
+	{
+		switchCharger(OFF);
+		switchSolarArray(OFF);
+		chargeStop();
+		canPulse = 0;
+		adsorptionComplete = false;
+		adsorptionFlag = false;
+		floatFlag = false;
+
+		chargeState = CHARGE_OFF;
+		return;
+	}
 
-//	if (currentPower == lastPower) {
-		//do nothing
-//	}
+	switch (chargeState)
+	{
+		case CHARGE_WAIT:
 
-//	else
-//	{
-		if (currentPower > lastPower)
-		{
-//			if (vSolarArray > last_vSolarArray)
-			if (vSolar > lastVsolar)
+			if (vBat < (FloatVoltage(quietAmbientTemp) - 250) )
 			{
-				duty--;
+				adsorptionFlag = false;
+				floatFlag = false;
+				adsorptionTime = 0;
+			}
 
-				if (duty <= MIN_DUTY_CYCLE)
-					duty = MIN_DUTY_CYCLE;
+			// We can't charge, or no longer need to
+			if ( (vSolarArray <= (vBattery + TWO_VOLT) ) || (vBat >= AdsorptionVoltage(quietAmbientTemp) ) )
+			{
+				chargeStop();
+				chargeState = CHARGE_IDLE;
 			}
-			else
+
+			// Start the converter near the MPP instead of at a fixed duty cycle, unless we're waiting out
+			// LOW_CHARGE_CURRENT_TIMEOUT
+			else if (!lowChargeCurrentFlag)
 			{
-				duty++;
+				duty = DUTY_FINE(mpptStrategy_SeedDuty(vSolar, vBat));
+				changePWM_TIM1(duty >> DUTY_FRACTION_BITS, ON);
 
-				if (duty >= MAX_DUTY_CYCLE)
-				{
-					duty = MAX_DUTY_CYCLE;
-					maxDutyCycleCount++;
-				}
+				chargeState = CHARGE_START;
 			}
-		}
 
-		else
-		{
+			break;
 
-//			if (vSolarArray > last_vSolarArray)
-			if (vSolar > lastVsolar)
+		case CHARGE_START:
+
+			// Start charging if we have enough current
+			if (iSolarArray >= THRESHOLD_CURRENT)
 			{
-				duty++;
+				isCharging = true;
+				startMPPT();
+				mpptScan_Schedule(HAL_GetTick());
+				mpptRunning = true;
 
-				if (duty >= MAX_DUTY_CYCLE)
-				{
-					duty = MAX_DUTY_CYCLE;
-					maxDutyCycleCount++;
-				}
+				chargeState = CHARGE_MPPT;
 			}
+			// If we don't have minimum charge current, set a flag and wait for LOW_CHARGE_CURRENT_TIMEOUT before trying again
 			else
 			{
-				duty--;
+				changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
+				lowChargeCurrentFlag = true;
 
-				if (duty <= MIN_DUTY_CYCLE)
-					duty = MIN_DUTY_CYCLE;
+				chargeState = CHARGE_WAIT;
 			}
-		}
-//	}
 
-	lastPower = currentPower;
-//	last_vSolarArray = vSolarArray;
-	lastVsolar = vSolar;
-	changePWM_TIM1(duty, UPDATE);
+			break;
+
+		case CHARGE_MPPT:
+
+			if (atMaxDuty)
+			{
+				atMaxDuty = false;
+				maxDutyCycleCount++;
+			}
+
+			// Too long at MAX_DUTY_CYCLE: the array is too close to the battery for the converter, connect it straight across
+			if (maxDutyCycleCount >= 100)
+			{
+				mpptRunning = false;
+				lastIbattery = iBat;
+
+				changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
+				mpptBypass(ON);
+				isBypass = true;
+
+				chargeState = CHARGE_BYPASS;
+			}
+
+			chargeTrack();
+			break;
+
+		case CHARGE_BYPASS:
+
+			/* mpptBypass() sets mpptBypassFlag once the bypass has run its time, or the current dropped. Straight
+			 * across the battery the array can't be throttled, so the bypass also ends once the battery reaches the
+			 * stage voltage, and the converter restarts with the regulator in calcMPPT() holding it there.
+			 */
+			if ( mpptBypassFlag || (vBat >= chargeStageVoltage()) )
+			{
+				mpptBypass(OFF);
+				isBypass = false;
+
+				duty = DUTY_FINE(PCT80_DUTY_CYCLE);
+				changePWM_TIM1(PCT80_DUTY_CYCLE, ON);
+				startMPPT();
+				mpptRunning = true;
+
+				chargeState = CHARGE_MPPT;
+			}
+			else
+			{
+				mpptBypass(ON);
+			}
+
+			chargeTrack();
+			break;
+
+		default:
+			chargeState = chargeSelect();
+			break;
+	}
+
+	// Desulfation pulses, whenever the array is connected and the converter is off
+	if ( (chargeState == CHARGE_DESULFATE) || (chargeState == CHARGE_IDLE) || (chargeState == CHARGE_WAIT) )
+	{
+		if (canPulse == pulseInterval)
+		{
+			pulse();
+			canPulse = 0;
+		}
+	}
 }
 
 void switchFan(uint8_t onOff)
@@ -1311,33 +1787,33 @@ void lcdBatteryInfo(void)
 {
 	char tmp_buffer[16];
 
-	HD44780_WriteData(0, 0, battery, YES);
+	HD44780_Print(0, battery);
 //	sprintf(tmp_buffer, "%2.2f V %2.2f A", vBat, iBat);
-	sprintf(tmp_buffer, "%2.2f V %2.2f A", vBatOut, iBatOut);
-	HD44780_WriteData(1, 0, tmp_buffer, NO);
+	sprintf(tmp_buffer, "%d.%02d V %d.%02d A", MEAS_WHOLE(vBatOut), MEAS_HUNDREDTHS(vBatOut), MEAS_WHOLE(iBatOut), MEAS_HUNDREDTHS(iBatOut));
+	HD44780_Print(1, tmp_buffer);
 }
 
 void lcdSolarInfo(void)
 {
 	char tmp_buffer[16];
 
-	HD44780_WriteData(0, 0, solarArray, YES);
+	HD44780_Print(0, solarArray);
 //	sprintf(tmp_buffer, "%2.2f V %2.2f A", vSolar, iSolar);
-	sprintf(tmp_buffer, "%2.2f V %2.2f A", vSolarOut, iSolarOut);
-	HD44780_WriteData(1, 0, tmp_buffer, NO);
+	sprintf(tmp_buffer, "%d.%02d V %d.%02d A", MEAS_WHOLE(vSolarOut), MEAS_HUNDREDTHS(vSolarOut), MEAS_WHOLE(iSolarOut), MEAS_HUNDREDTHS(iSolarOut));
+	HD44780_Print(1, tmp_buffer);
 }
 
 void lcdLoadInfo(void)
 {
 	char tmp_buffer[16];
 
-	HD44780_WriteData(0, 0, load, YES);
+	HD44780_Print(0, load);
 //	sprintf(tmp_buffer, "%2.2f V %2.2f A", loadVoltage, loadCurrent);
-	sprintf(tmp_buffer, "%2.2f V %2.2f A", loadVoltageOut, loadCurrentOut);
-	HD44780_WriteData(1, 0, tmp_buffer, NO);
+	sprintf(tmp_buffer, "%d.%02d V %d.%02d A", MEAS_WHOLE(loadVoltageOut), MEAS_HUNDREDTHS(loadVoltageOut), MEAS_WHOLE(loadCurrentOut), MEAS_HUNDREDTHS(loadCurrentOut));
+	HD44780_Print(1, tmp_buffer);
 }
 
-// Called every second from the timer callback
+// Called every second by TASK_LCD. Only fills the LCD framebuffer, the display catches up in the background.
 void updateLCD(uint8_t warning)
 {
 
@@ -1358,18 +1834,18 @@ void updateLCD(uint8_t warning)
 
 				if (warning == HIBATTV)
 				{
-					HD44780_WriteData(0, 0, battery, YES);
-					HD44780_WriteData(1, 0, battHi, NO);
+					HD44780_Print(0, battery);
+					HD44780_Print(1, battHi);
 				}
 				else if (warning == LOBATTV)
 				{
-					HD44780_WriteData(0, 0, battery, YES);
-					HD44780_WriteData(1, 0, battLo, NO);
+					HD44780_Print(0, battery);
+					HD44780_Print(1, battLo);
 				}
 				else if (warning == DEADBATT)
 				{
-					HD44780_WriteData(0, 0, battery, YES);
-					HD44780_WriteData(1, 0, battDead, NO);
+					HD44780_Print(0, battery);
+					HD44780_Print(1, battDead);
 				}
 
 				else
@@ -1380,8 +1856,8 @@ void updateLCD(uint8_t warning)
 					}
 					else
 					{
-						HD44780_WriteData(0, 0, logo, YES);
-						HD44780_WriteData(1, 0, version, NO);
+						HD44780_Print(0, logo);
+						HD44780_Print(1, version);
 					}
 
 				break;
@@ -1390,8 +1866,8 @@ void updateLCD(uint8_t warning)
 
 				if (warning == DEADBATT)
 				{
-					HD44780_WriteData(0, 0, charger1, YES);
-					HD44780_WriteData(1, 0, charger2, NO);
+					HD44780_Print(0, charger1);
+					HD44780_Print(1, charger2);
 				}
 				else
 				{
@@ -1418,8 +1894,8 @@ void updateLCD(uint8_t warning)
 			case 6:
 				if (overheatFlag)
 				{
-					HD44780_WriteData(0, 0, overheat1, YES);
-					HD44780_WriteData(1, 0, overheat2, NO);
+					HD44780_Print(0, overheat1);
+					HD44780_Print(1, overheat2);
 				}
 				else
 				{
@@ -1437,46 +1913,100 @@ void updateLCD(uint8_t warning)
 	}
 }
 
-void pulse(void)
+// One edge of the desulfation pulse train every 100 uS, on the microsecond timer
+static void pulseEdge(void)
 {
 
-	uint8_t i;
-
-	switchCapacitors(OFF);
-
-	for (i=0; i<=9; i++)
+	if (pulseEdges < 10)
 	{
 		HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_11);
-		delay_us(100);
+		pulseEdges++;
+
+		usTimer_Schedule(US_TIMER_PULSE, 100, pulseEdge);
 	}
+	else
+	{
+		HAL_GPIO_WritePin(GPIOB, GPIO_PIN_11, GPIO_PIN_RESET);
+		switchCapacitors(ON);
+	}
+}
 
-	HAL_GPIO_WritePin(GPIOB, GPIO_PIN_11, GPIO_PIN_RESET);
-	switchCapacitors(ON);
+// Starts a desulfation pulse train. Returns right away, the edges come from the microsecond timer.
+void pulse(void)
+{
+
+	switchCapacitors(OFF);
+
+	pulseEdges = 0;
+	pulseEdge();
 }
 
+/** Spins for usDelay uS on TIM11, with interrupts running, so it can only take longer.
+ * Only for startup (HD44780_Init()); anything that runs once the scheduler does schedules a usTimer_ callback instead.
+ */
 void delay_us(uint32_t usDelay)
 {
 	uint32_t initTime;
 
 	initTime = __HAL_TIM_GET_COUNTER(&htim11);
 
-	__disable_irq();
-	while ( (__HAL_TIM_GET_COUNTER(&htim11) - initTime < usDelay));
-	__enable_irq();
+	while ( (uint16_t)(__HAL_TIM_GET_COUNTER(&htim11) - initTime) < usDelay);
+}
+
+
+// A free TX buffer, now owned by the caller until it goes to uartTx_Send() with txRelease(). NULL if all are in use.
+uint8_t *txAcquire(void)
+{
+
+	uint8_t i;
+
+	for (i = 0; i < TX_BUFFERS; i++)
+	{
+		if (!txBusy[i])
+		{
+			txBusy[i] = true;
+			return txBuffer[i];
+		}
+	}
+
+	return NULL;
+}
+
+// The UART is done with buffer (UART_TxDone, from the USART1 interrupt)
+void txRelease(const uint8_t *buffer)
+{
+
+	uint8_t i;
+
+	for (i = 0; i < TX_BUFFERS; i++)
+	{
+		if (buffer == txBuffer[i])
+			txBusy[i] = false;
+	}
 }
 
+uint8_t txFree(void)
+{
+
+	uint8_t i, count = 0;
+
+	for (i = 0; i < TX_BUFFERS; i++)
+	{
+		if (!txBusy[i])
+			count++;
+	}
+
+	return count;
+}
 
 // this function sends data to the controller
 void sendMessage(void)
 {
 
-	uint16_t crc = 0xffff;
 	uint8_t msgLength = 0;
-	uint8_t i, j;
 	uint16_t data;
 
 	memset((void *)sendBuffer, 0, sizeof(sendBuffer));
-	memset((void *)escBuffer, 0, sizeof(escBuffer));
 
 	sendBuffer[0] = 0x9a;
 	msgLength++;
@@ -1484,12 +2014,12 @@ void sendMessage(void)
 	strncpy((char *)&sendBuffer[1], ver, 4);
 	msgLength += 4;
 
-	sendBuffer[msgLength] = 0x9e;
+	sendBuffer[msgLength] = MSG_DATA;
 	msgLength++;
 
 	// Battery Voltage
 //	data = vBat * 1000;	// Convert to mV
-	data = vBatOut * 1000;	// Convert to mV
+	data = vBatOut;	// Already in mV
 	sendBuffer[msgLength] = (uint8_t)data & 0x00ff;
 	msgLength++;
 	sendBuffer[msgLength] = (uint8_t) (data>>8);
@@ -1497,7 +2027,7 @@ void sendMessage(void)
 
 	// Battery current
 //	data = iBat * 1000;
-	data = iBatOut * 1000;
+	data = iBatOut;
 	sendBuffer[msgLength] = (uint8_t)data & 0x00ff;
 	msgLength++;
 	sendBuffer[msgLength] = (uint8_t) (data>>8);
@@ -1505,7 +2035,7 @@ void sendMessage(void)
 
 	// Solar Array Voltage
 //	data = vSolar * 1000;
-	data = vSolarOut * 1000;
+	data = vSolarOut;
 	sendBuffer[msgLength] = (uint8_t)data & 0x00ff;
 	msgLength++;
 	sendBuffer[msgLength] = (uint8_t) (data>>8);
@@ -1513,7 +2043,7 @@ void sendMessage(void)
 
 	// Solar Array Current
 //	data = iSolar * 1000;
-	data = iSolarOut * 1000;
+	data = iSolarOut;
 	sendBuffer[msgLength] = (uint8_t)data & 0x00ff;
 	msgLength++;
 	sendBuffer[msgLength] = (uint8_t) (data>>8);
@@ -1521,7 +2051,7 @@ void sendMessage(void)
 
 	// Load Voltage
 //	data = loadVoltage * 1000;
-	data = loadVoltageOut * 1000;
+	data = loadVoltageOut;
 	sendBuffer[msgLength] = (uint8_t)data & 0x00ff;
 	msgLength++;
 	sendBuffer[msgLength] = (uint8_t) (data>>8);
@@ -1529,7 +2059,7 @@ void sendMessage(void)
 
 	// Load Current
 //	data = loadCurrent * 1000;
-	data = loadCurrentOut * 1000;
+	data = loadCurrentOut;
 	sendBuffer[msgLength] = (uint8_t)data & 0x00ff;
 	msgLength++;
 	sendBuffer[msgLength] = (uint8_t) (data>>8);
@@ -1545,6 +2075,22 @@ void sendMessage(void)
 	sendBuffer[msgLength] = (uint8_t)data & 0x00ff;
 	msgLength++;
 
+	sendFrame(msgLength);
+}
+
+/** Appends the CRC to the msgLength bytes in sendBuffer, escapes the frame into a TX buffer and queues it for the controller.
+ * Returns false, and sends nothing, without a free TX buffer; callers check txFree() first.
+ */
+bool sendFrame(uint8_t msgLength)
+{
+
+	uint16_t crc;
+	uint8_t i, j;
+	uint8_t *escBuffer = txAcquire();
+
+	if (escBuffer == NULL)
+		return false;
+
 	crc = crc16(sendBuffer, msgLength, 0xffff);
 	sendBuffer[msgLength] = (uint8_t)crc & 0x00ff;
 	msgLength++;
@@ -1583,7 +2129,438 @@ void sendMessage(void)
 		}
 	}
 
-	HAL_UART_Transmit(&huart1, escBuffer, j, 0xffff);
+	if (!uartTx_Send(escBuffer, j, txRelease))
+	{
+		txRelease(escBuffer);
+		return false;
+	}
+
+	return true;
+}
+
+// Sends the 1 and 15 minute mean, minimum, maximum and standard deviation of every STAT_x value
+void sendStatistics(void)
+{
+
+	uint8_t msgLength = 0;
+	uint8_t i, k;
+	uint16_t data[4];
+	STATS_Window *window;
+
+	memset((void *)sendBuffer, 0, sizeof(sendBuffer));
+
+	sendBuffer[0] = 0x9a;
+	msgLength++;
+
+	strncpy((char *)&sendBuffer[1], ver, 4);
+	msgLength += 4;
+
+	sendBuffer[msgLength] = MSG_STATISTICS;
+	msgLength++;
+
+	for (i = 0; i < 2 * STAT_QUANTITIES; i++)
+	{
+		window = (i < STAT_QUANTITIES) ? &minuteStats[i] : &quarterStats[i - STAT_QUANTITIES];
+
+		data[0] = stats_Mean(window);
+		data[1] = stats_Min(window);
+		data[2] = stats_Max(window);
+		data[3] = stats_StdDev(window);
+
+		for (k = 0; k < 4; k++)
+		{
+			sendBuffer[msgLength] = (uint8_t)data[k] & 0x00ff;
+			msgLength++;
+			sendBuffer[msgLength] = (uint8_t) (data[k]>>8);
+			msgLength++;
+		}
+	}
+
+	sendFrame(msgLength);
+}
+
+/** Sends the tracking performance of every strategy (see mppt_bench.c) as one MSG_BENCHMARK frame:
+ * strategy count, active strategy, then per strategy the tracking steps (4 bytes), harvested energy in mWh (4 bytes),
+ * tracking efficiency in 0.01 % (2 bytes), mean convergence time in mS (2 bytes) and mean ripple in mW (2 bytes), LSB first.
+ */
+void sendBenchmark(void)
+{
+
+	uint8_t msgLength = 0;
+	uint8_t i, k;
+	uint32_t data[5];
+	MPPT_BenchRecord record;
+
+	memset((void *)sendBuffer, 0, sizeof(sendBuffer));
+
+	sendBuffer[0] = 0x9a;
+	msgLength++;
+
+	strncpy((char *)&sendBuffer[1], ver, 4);
+	msgLength += 4;
+
+	sendBuffer[msgLength] = MSG_BENCHMARK;
+	msgLength++;
+
+	sendBuffer[msgLength] = MPPT_STRATEGY_COUNT;
+	msgLength++;
+
+	sendBuffer[msgLength] = mpptStrategy_GetActive();
+	msgLength++;
+
+	for (i = 0; i < MPPT_STRATEGY_COUNT; i++)
+	{
+		mpptBench_Get(i, &record);
+
+		data[0] = record.steps;
+		data[1] = (uint32_t)(record.energy * MPPT_CONTROL_STEP_US / 3600000000ULL);
+		data[2] = (record.available != 0) ? (uint32_t)(record.energy * 10000 / record.available) : 0;
+		data[3] = (record.converged != 0) ? (uint32_t)((uint64_t)record.convergeSteps * MPPT_CONTROL_STEP_US / 1000 / record.converged) : 0;
+		data[4] = (record.steps > 1) ? (uint32_t)(record.ripple / (record.steps - 1)) : 0;
+
+		// Steps and energy in 4 bytes, the rest in 2
+		for (k = 0; k < 5; k++)
+		{
+			if ( (k >= 2) && (data[k] > 0xffff) )
+				data[k] = 0xffff;
+
+			sendBuffer[msgLength] = (uint8_t)data[k];
+			msgLength++;
+			sendBuffer[msgLength] = (uint8_t)(data[k] >> 8);
+			msgLength++;
+
+			if (k < 2)
+			{
+				sendBuffer[msgLength] = (uint8_t)(data[k] >> 16);
+				msgLength++;
+				sendBuffer[msgLength] = (uint8_t)(data[k] >> 24);
+				msgLength++;
+			}
+		}
+	}
+
+	sendFrame(msgLength);
+}
+
+/** Sends the capture records waiting in the ring (see capture.c), CAPTURE_PER_FRAME to a MSG_CAPTURE frame:
+ * records dropped so far (2 bytes), record count, then per record the frame number (2 bytes), the tick in mS (4 bytes),
+ * the 8 channels packed two to 3 bytes (12 bytes, channel 0 in the low 12 bits of the first pair), the duty cycle
+ * in 1/16 counts (2 bytes) and the CAPTURE_x flags, LSB first.
+ */
+void sendCapture(void)
+{
+
+	uint8_t msgLength;
+	uint8_t count, i, ch;
+	CAPTURE_Record records[CAPTURE_PER_FRAME];
+	CAPTURE_Record *record;
+	uint32_t pair;
+
+	while ( (txFree() != 0) && ((count = capture_Read(records, CAPTURE_PER_FRAME)) != 0) )
+	{
+		memset((void *)sendBuffer, 0, sizeof(sendBuffer));
+		msgLength = 0;
+
+		sendBuffer[0] = 0x9a;
+		msgLength++;
+
+		strncpy((char *)&sendBuffer[1], ver, 4);
+		msgLength += 4;
+
+		sendBuffer[msgLength] = MSG_CAPTURE;
+		msgLength++;
+
+		sendBuffer[msgLength] = (uint8_t)capture_GetDropped();
+		msgLength++;
+		sendBuffer[msgLength] = (uint8_t)(capture_GetDropped() >> 8);
+		msgLength++;
+
+		sendBuffer[msgLength] = count;
+		msgLength++;
+
+		for (i = 0; i < count; i++)
+		{
+			record = &records[i];
+
+			sendBuffer[msgLength++] = (uint8_t)record->frame;
+			sendBuffer[msgLength++] = (uint8_t)(record->frame >> 8);
+
+			sendBuffer[msgLength++] = (uint8_t)record->tick;
+			sendBuffer[msgLength++] = (uint8_t)(record->tick >> 8);
+			sendBuffer[msgLength++] = (uint8_t)(record->tick >> 16);
+			sendBuffer[msgLength++] = (uint8_t)(record->tick >> 24);
+
+			for (ch = 0; ch < ADC_ACQ_CHANNELS; ch += 2)
+			{
+				pair = (record->channel[ch] & 0x0fff) | ((uint32_t)(record->channel[ch + 1] & 0x0fff) << 12);
+
+				sendBuffer[msgLength++] = (uint8_t)pair;
+				sendBuffer[msgLength++] = (uint8_t)(pair >> 8);
+				sendBuffer[msgLength++] = (uint8_t)(pair >> 16);
+			}
+
+			sendBuffer[msgLength++] = (uint8_t)record->duty;
+			sendBuffer[msgLength++] = (uint8_t)(record->duty >> 8);
+
+			sendBuffer[msgLength++] = record->flags;
+		}
+
+		sendFrame(msgLength);
+	}
+}
+
+/** Sends the profiler records (see profile.c) as one MSG_PROFILE frame: core clock in MHz, probe count, then per probe
+ * the count, minimum, maximum and mean time in core clock cycles (4 bytes each), LSB first.
+ */
+void sendProfile(void)
+{
+
+	uint8_t msgLength = 0;
+	uint8_t i, k;
+	uint32_t data[4];
+	PROF_Record record;
+
+	memset((void *)sendBuffer, 0, sizeof(sendBuffer));
+
+	sendBuffer[0] = 0x9a;
+	msgLength++;
+
+	strncpy((char *)&sendBuffer[1], ver, 4);
+	msgLength += 4;
+
+	sendBuffer[msgLength] = MSG_PROFILE;
+	msgLength++;
+
+	sendBuffer[msgLength] = (uint8_t)(SystemCoreClock / 1000000);
+	msgLength++;
+
+	sendBuffer[msgLength] = PROF_PROBES;
+	msgLength++;
+
+	for (i = 0; i < PROF_PROBES; i++)
+	{
+		prof_Get(i, &record);
+
+		data[0] = record.count;
+		data[1] = record.min;
+		data[2] = record.max;
+		data[3] = (record.count != 0) ? (uint32_t)(record.total / record.count) : 0;
+
+		for (k = 0; k < 4; k++)
+		{
+			sendBuffer[msgLength] = (uint8_t)data[k];
+			msgLength++;
+			sendBuffer[msgLength] = (uint8_t)(data[k] >> 8);
+			msgLength++;
+			sendBuffer[msgLength] = (uint8_t)(data[k] >> 16);
+			msgLength++;
+			sendBuffer[msgLength] = (uint8_t)(data[k] >> 24);
+			msgLength++;
+		}
+	}
+
+	sendFrame(msgLength);
+}
+
+/** Sends the scheduler counters in a MSG_SCHEDULE frame: the charge stage (CHARGE_x), the events dropped (2 bytes),
+ * the deepest the event queue has been, the worst microsecond timer latency (2 bytes, uS), the task count, then per task
+ * (TASK_x order) the runs (4 bytes), deadline misses, skipped releases, last, maximum and mean start lateness and the
+ * longest run (2 bytes each, mS), LSB first.
+ */
+void sendSchedule(void)
+{
+
+	uint8_t msgLength = 0;
+	uint8_t i, k;
+	uint16_t data[6];
+	const SCHED_State *task;
+
+	memset((void *)sendBuffer, 0, sizeof(sendBuffer));
+
+	sendBuffer[0] = 0x9a;
+	msgLength++;
+
+	strncpy((char *)&sendBuffer[1], ver, 4);
+	msgLength += 4;
+
+	sendBuffer[msgLength] = MSG_SCHEDULE;
+	msgLength++;
+
+	sendBuffer[msgLength] = chargeState;
+	msgLength++;
+
+	sendBuffer[msgLength] = (uint8_t)event_GetDropped();
+	msgLength++;
+	sendBuffer[msgLength] = (uint8_t)(event_GetDropped() >> 8);
+	msgLength++;
+
+	sendBuffer[msgLength] = event_GetHighWater();
+	msgLength++;
+
+	sendBuffer[msgLength] = (uint8_t)usTimer_GetMaxLatency();
+	msgLength++;
+	sendBuffer[msgLength] = (uint8_t)(usTimer_GetMaxLatency() >> 8);
+	msgLength++;
+
+	sendBuffer[msgLength] = sched_Count();
+	msgLength++;
+
+	for (i = 0; i < sched_Count(); i++)
+	{
+		task = sched_GetState(i);
+
+		sendBuffer[msgLength] = (uint8_t)task->runs;
+		msgLength++;
+		sendBuffer[msgLength] = (uint8_t)(task->runs >> 8);
+		msgLength++;
+		sendBuffer[msgLength] = (uint8_t)(task->runs >> 16);
+		msgLength++;
+		sendBuffer[msgLength] = (uint8_t)(task->runs >> 24);
+		msgLength++;
+
+		data[0] = task->misses;
+		data[1] = task->skipped;
+		data[2] = task->lateness;
+		data[3] = task->maxLateness;
+		data[4] = (task->runs != 0) ? (uint16_t)(task->totalLateness / task->runs) : 0;
+		data[5] = task->maxRun;
+
+		for (k = 0; k < 6; k++)
+		{
+			sendBuffer[msgLength] = (uint8_t)data[k];
+			msgLength++;
+			sendBuffer[msgLength] = (uint8_t)(data[k] >> 8);
+			msgLength++;
+		}
+	}
+
+	sendFrame(msgLength);
+}
+
+void setTraceDuty(uint16_t pulse)
+{
+	changePWM_TIM1(pulse, UPDATE);
+}
+
+// Traces the array I-V curve and sends it. Needs the converter running, so nothing is traced unless we're charging.
+void traceIV(void)
+{
+
+	bool running = mpptRunning;
+
+	if (isCharging && !isBypass)
+	{
+		// The control loop would fight the sweep
+		mpptRunning = false;
+
+		ivTrace_Sweep(MIN_DUTY_CYCLE, MAX_DUTY_CYCLE, setTraceDuty);
+
+		// Back to where the MPPT left off. The strategy's last readings are from a different operating point, so restart it.
+		changePWM_TIM1_Fine(duty);
+		startMPPT();
+		mpptRunning = running;
+	}
+	else
+	{
+		ivTrace_Clear();
+	}
+
+	sendIVTrace();
+}
+
+/** Sends the last I-V trace in MSG_IV_TRACE frames of up to IV_POINTS_PER_FRAME points:
+ * frame index, frame count, point count, then per point the duty (1 byte), the array voltage in mV and current in mA (2 bytes each, LSB first).
+ * An empty trace (not charging) is one frame with no points.
+ */
+void sendIVTrace(void)
+{
+
+	uint8_t msgLength;
+	uint8_t frameIndex, frameCount, first, count, i;
+	const IV_Point *point;
+
+	frameCount = (ivTrace_GetCount() + IV_POINTS_PER_FRAME - 1) / IV_POINTS_PER_FRAME;
+
+	if (frameCount == 0)
+		frameCount = 1;
+
+	for (frameIndex = 0; frameIndex < frameCount; frameIndex++)
+	{
+		first = frameIndex * IV_POINTS_PER_FRAME;
+		count = ivTrace_GetCount() - first;
+
+		if (count > IV_POINTS_PER_FRAME)
+			count = IV_POINTS_PER_FRAME;
+
+		memset((void *)sendBuffer, 0, sizeof(sendBuffer));
+		msgLength = 0;
+
+		sendBuffer[0] = 0x9a;
+		msgLength++;
+
+		strncpy((char *)&sendBuffer[1], ver, 4);
+		msgLength += 4;
+
+		sendBuffer[msgLength++] = MSG_IV_TRACE;
+		sendBuffer[msgLength++] = frameIndex;
+		sendBuffer[msgLength++] = frameCount;
+		sendBuffer[msgLength++] = count;
+
+		for (i = 0; i < count; i++)
+		{
+			point = ivTrace_GetPoint(first + i);
+
+			sendBuffer[msgLength++] = (uint8_t)point->duty;
+			sendBuffer[msgLength++] = (uint8_t)point->vSolar & 0x00ff;
+			sendBuffer[msgLength++] = (uint8_t) (point->vSolar>>8);
+			sendBuffer[msgLength++] = (uint8_t)point->iSolar & 0x00ff;
+			sendBuffer[msgLength++] = (uint8_t) (point->iSolar>>8);
+		}
+
+		sendFrame(msgLength);
+	}
+}
+
+void initStats(void)
+{
+
+	uint8_t i;
+
+	for (i = 0; i < STAT_QUANTITIES; i++)
+	{
+		stats_Init(&displayStats[i], displaySamples[i], displayMinQ[i], displayMaxQ[i], STAT_DISPLAY_SLOTS, 1);
+		stats_Init(&minuteStats[i], minuteSamples[i], minuteMinQ[i], minuteMaxQ[i], STAT_MINUTE_SLOTS, 1);
+		stats_Init(&quarterStats[i], quarterSamples[i], quarterMinQ[i], quarterMaxQ[i], STAT_QUARTER_SLOTS, STAT_QUARTER_DECIMATION);
+	}
+}
+
+// Adds the latest values to the running statistics (once a second) and updates the display values
+void updateStats(void)
+{
+
+	int32_t value[STAT_QUANTITIES];
+	uint8_t i;
+
+	value[STAT_VBAT] = vBat;
+	value[STAT_IBAT] = iBat;
+	value[STAT_VSOLAR] = vSolar;
+	value[STAT_ISOLAR] = iSolar;
+	value[STAT_VLOAD] = loadVoltage;
+	value[STAT_ILOAD] = loadCurrent;
+
+	for (i = 0; i < STAT_QUANTITIES; i++)
+	{
+		stats_Add(&displayStats[i], value[i]);
+		stats_Add(&minuteStats[i], value[i]);
+		stats_Add(&quarterStats[i], value[i]);
+	}
+
+	vBatOut = stats_Mean(&displayStats[STAT_VBAT]);
+	iBatOut = stats_Mean(&displayStats[STAT_IBAT]);
+	vSolarOut = stats_Mean(&displayStats[STAT_VSOLAR]);
+	iSolarOut = stats_Mean(&displayStats[STAT_ISOLAR]);
+	loadVoltageOut = stats_Mean(&displayStats[STAT_VLOAD]);
+	loadCurrentOut = stats_Mean(&displayStats[STAT_ILOAD]);
 }
 
 void handleData()
@@ -1593,8 +2570,54 @@ void handleData()
 
 	commandByte = inBuff[1];
 
+	// Statistics are sent from the main context, not from this interrupt
+	if (commandByte == CMD_STATISTICS) {
+		sendStatsFlag = true;
+		return;
+	}
+
+	// Started, and streamed, from the main context
+	if (commandByte == CMD_CAPTURE) {
+		captureDecimation = (inBuff[2] << 8) | inBuff[3];
+		captureBurst = (inBuff[4] == 1);
+		captureRequest = true;
+		return;
+	}
+
+	// Sent from the main context as well
+	if (commandByte == CMD_SCHEDULE) {
+		resetSchedFlag = (inBuff[2] == 1);
+		sendSchedFlag = true;
+		return;
+	}
+
+	if (commandByte == CMD_PROFILE) {
+		resetProfileFlag = (inBuff[2] == 1);
+		sendProfileFlag = true;
+		return;
+	}
+
+	if (commandByte == CMD_BENCHMARK) {
+		resetBenchFlag = (inBuff[2] == 1);
+		sendBenchFlag = true;
+		return;
+	}
+
+	// The sweep runs from the main context, the next time TASK_REQUESTS runs
+	if (commandByte == CMD_IV_TRACE) {
+		ivTraceRequest = true;
+		return;
+	}
+
+	// Unknown strategies are ignored, calcMPPT() switches over on its next step
+	if (commandByte == CMD_STRATEGY) {
+		if (inBuff[2] < MPPT_STRATEGY_COUNT)
+			strategyRequest = inBuff[2];
+		return;
+	}
+
 	//to be altered as we add more commands
-	if (commandByte != 0x00) {
+	if (commandByte != CMD_POWER_CYCLE) {
 		return;
 	}
 
@@ -1633,17 +2656,24 @@ int main(void)
 	MX_TIM9_Init();
 	MX_TIM11_Init();
 	MX_USART1_UART_Init();
+	usTimer_Init();
+	prof_Init();
 
+	// The calibration record is CRC checked, and the coefficients must be in place before the first frame is published
 	crc16_init();
+	calib_Load((const void *)CAL_RECORD_ADDRESS);
+	adcAcq_Start(&hadc1);
+
 	HD44780_Init();
-	HD44780_WriteData(0, 0, "INITIALIZING!", YES);
+	HD44780_Start();
+	HD44780_Print(0, "INITIALIZING!");
 
 	lcdUpdate = 0;
-	updateLCDflag = false;
-	canCharge = false;
+	chargeState = CHARGE_OFF;
 	isCharging = false;
 	isBypass = false;
 	mpptBypass(OFF);
+	mpptStrategy_Select(DEFAULT_MPPT_STRATEGY);
 
 	switchFan(OFF);
 	switchCharger(OFF);
@@ -1659,13 +2689,7 @@ int main(void)
 	changePWM_TIM5(15000, ON);
 	changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
 
-	battOffsetV =  *(__IO uint16_t *)0x08010000;
-	solarOffsetV = *(__IO uint16_t *)0x08010002;
-	battOffsetI = *(__IO uint16_t *)0x08010006;
-	solarOffsetI = *(__IO uint16_t *)0x08010004;
-	loadOffsetI = *(__IO uint16_t *)0x08010008;
-
-	tim1_ccer = *(__IO uint16_t *)0x40010020; //TIM1_CCER
+	tim1_ccer = TIM1->CCER;
 
 	lowChargeCurrentFlag = false;
 	lowChargeCurrentTimeout = 0;
@@ -1678,346 +2702,13 @@ int main(void)
 
 	adsorptionTime = 0;
 	adsorptionCompleteTime = 0;
-	aveCount = 0;
+	initStats();
+
+	// Everything from here on runs as a task (see tasks[]); the MPPT itself steps in the ADC interrupt
+	sched_Init(tasks, taskState, TASKS, HAL_GetTick);
 
 	while (1)
 	{
-
-		// Get ADC readings
-		if (getADC == 1)
-		{
-			getADC = 0;
-			getADCreadings(32);
-
-			tim1_ccer = *(__IO uint16_t *)0x40010020;
-
-			quietMosfetTemp = mosfetTemp;
-			quietAmbientTemp = ambientTemp;
-		}
-
-		if ((!enablePowerCycle) && (warning == NORMALBATTV) && (loadVoltage > 0.1) && (loadVoltage < 8.0))
-		{
-			cycleLoadPower = true;
-			switchLoad(OFF);
-		}
-
-		if ( (vBattery >= BAT_DROP_DEAD_VOLT) && !overheatFlag ) // We charge only if the battery isn't too dead
-		{
-
-			// We have enough solar energy to charge the batteries
-			if (vSolarArray >= (vBattery + TWO_VOLT))
-			{
-				switchSolarArray(ON);
-				switchCharger(ON);
-
-				if (canPulse == pulseInterval)
-				{
-					pulse();
-					canPulse = 0;
-				}
-
-				// Batteries need bulk charging?
-				if ( (vBat < FloatVoltage(quietAmbientTemp) - (double)0.25) )
-				{
-					canCharge = true;
-					adsorptionFlag = false;
-					adsorptionTime = 0;
-					floatFlag = false;
-				}
-
-				// did we charge to the adsorption voltage (Va) but didn't hold it for ADSORPTION_TIME_FLOODED?
-				else if (adsorptionFlag && floatFlag && !adsorptionComplete)
-				{
-					if (vBat <= AdsorptionVoltage(quietAmbientTemp) - (double)0.5)
-					{
-						canCharge = true;
-					}
-					else
-					{
-						canCharge = false;
-						changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-					}
-				}
-
-				// Did we charge to Va and hold it for ADSORPTION_TIME_FLOODED?
-				else if ( (!adsorptionFlag && floatFlag && adsorptionComplete) || (!adsorptionFlag && !floatFlag && adsorptionComplete) )
-				{
-					if (vBat <= FloatVoltage(quietAmbientTemp) - (double)(0.25))
-					{
-						canCharge = true;
-					}
-					else
-					{
-						canCharge = false;
-						changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-					}
-				}
-
-				else
-				{
-					canCharge = false;
-					changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-				}
-
-				while(canCharge)
-				{
-
-					if (canPulse == pulseInterval)
-					{
-						pulse();
-						canPulse = 0;
-					}
-
-					if (getADC == 1)
-					{
-						getADC = 0;
-						getADCreadings(32);
-					}
-
-					if ((!enablePowerCycle) && (warning == NORMALBATTV) && (loadVoltage > 0.1) && (loadVoltage < 8.0))
-					{
-						cycleLoadPower = true;
-						switchLoad(OFF);
-					}
-
-					// May not need this here...
-					if (vBat < (FloatVoltage(quietAmbientTemp) - (double)0.25) )
-					{
-						adsorptionFlag = false;
-						floatFlag = false;
-						adsorptionTime = 0;
-					}
-
-					// Get out of this loop if we can't charge, no longer need to charge
-					// or, for whatever reason, we drop below our "drop dead" threshold voltage
-					if ( (vSolarArray <= (vBattery + TWO_VOLT) ) || (vBat >= AdsorptionVoltage(quietAmbientTemp) ) || (vBattery < BAT_DROP_DEAD_VOLT) )
-					{
-						canCharge = false;
-						isCharging = false;
-						changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-					}
-
-					else
-					{
-
-						// Check if we have minimum charge current from the PV panels
-						if (!lowChargeCurrentFlag)
-						{
-
-							changePWM_TIM1(PCT80_DUTY_CYCLE, ON);
-							HAL_Delay(1000);
-							getADCreadings(32);
-
-							// Start charging if we have enough current
-							if (iSolarArray >= THRESHOLD_CURRENT)
-							{
-								HAL_Delay(10);
-								isCharging = true;
-//								currentPower = vSolar * iSolar;
-//								last_vSolarArray = vSolarArray;
-								lastVsolar = vSolar;
-								duty = PCT80_DUTY_CYCLE;
-								lastPower = currentPower;
-								lastVsolar = vSolar;
-								lastIsolar = iSolar;
-								readTempCount = 0;
-							}
-							// If we don't have minimum charge current, set a flag and wait for LOW_CHARGE_CURRENT_TIMEOUT before trying again
-							else
-							{
-								isCharging = false;
-								changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-								lowChargeCurrentFlag = true;
-							}
-						}
-
-						while (isCharging)
-						{
-
-							if (getADC == 1)
-							{
-								getADC = 0;
-
-								//Our temperature sensors are affected by switching noise so we interrupt charging to read temperatures
-								// There is no sense in running the MPPT algorithm here if we're shut down...
-								if (readTempCount >= 30)
-								{
-									readTempCount = 0;
-									changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-									//HAL_Delay(5); //50
-									getADCreadings(32);
-									quietAmbientTemp = ambientTemp;
-									quietMosfetTemp = mosfetTemp;
-
-									if (!isBypass)
-										changePWM_TIM1(PCT80_DUTY_CYCLE, ON);
-								}
-
-
-								else
-								{
-									isBypass = false;
-									getADCreadings(32);
-
-									tim1_ccer = *(__IO uint16_t *)0x40010020;
-
-									if (maxDutyCycleCount < 100)
-									{
-										if (mpptBypassFlag == true)
-										{
-											changePWM_TIM1(PCT80_DUTY_CYCLE, ON);
-											mpptBypassFlag = false;
-											mpptBypass(OFF);
-											isBypass = false;
-										}
-
-#ifdef INC_COND
-//										calcMPPT_IC();
-#else
-										calcMPPT();
-//										calcMPPT_TI();
-#endif
-
-									}
-									else if ( (maxDutyCycleCount >= 100) && (mpptBypassCount < 600) )
-									{
-
-										if (mpptBypassCount == 0)
-											lastIbattery = iBat;
-
-										changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-										mpptBypass(ON);
-										isBypass = true;
-									}
-								}
-
-							} //end if (getADC == 1)
-
-							if ((!enablePowerCycle) && (warning == NORMALBATTV) && (loadVoltage > 0.1) && (loadVoltage < 8.0))
-							{
-								cycleLoadPower = true;
-								switchLoad(OFF);
-							}
-
-							// We no longer have enough current to charge.
-							if (iSolarArray < THRESHOLD_CURRENT)
-							{
-								isCharging = false;
-								mpptBypass(OFF);
-								isBypass = false;
-							}
-
-							if (vSolarArray >= MAX_PV_VOLT)
-							{
-								duty = PCT80_DUTY_CYCLE;
-							}
-
-							if (vBat < FloatVoltage(quietAmbientTemp))
-							{
-								adsorptionFlag = false;
-								floatFlag = false;
-								adsorptionTime = 0;
-							}
-
-							if ( (warning == HIBATTV) || (warning == DEADBATT) )
-							{
-								isCharging = false;
-								canCharge = false;
-								changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-								mpptBypass(OFF);
-								isBypass = false;
-							}
-
-							if (vBat >= FloatVoltage(quietAmbientTemp) )
-								floatFlag = true;
-
-							if ( !adsorptionFlag && !adsorptionComplete && floatFlag && (vBat >= AdsorptionVoltage(quietAmbientTemp) ) )
-							{
-								adsorptionFlag = true;
-								floatFlag = true;
-								adsorptionTime = 0;
-							}
-
-							if (adsorptionFlag && floatFlag && !adsorptionComplete)
-							{
-								if (vBat >= AdsorptionVoltage(quietAmbientTemp) )
-								{
-									isCharging = false;
-									canCharge = false;
-									changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-									mpptBypass(OFF);
-									isBypass = false;
-								}
-							}
-							else if (!adsorptionFlag && floatFlag && adsorptionComplete)
-							{
-
-								if (vBat >= FloatVoltage(quietAmbientTemp) + (double)0.25 )
-								{
-									isCharging = false;
-									canCharge = false;
-									changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-									mpptBypass(OFF);
-									isBypass = false;
-								}
-							}
-							else
-							{
-								// Do Nothing
-							}
-						} // end while (isCharging)
-					} //end else
-				} //end while (canCharge)
-			} // end if (vSolarArray > (vBattery + TWO_VOLT))
-
-			// Solar array voltage is high enough to de-sulfate the batteries but not high enough to charge them
-			else if ( (vSolarArray > vBattery) && (vSolarArray < (vBattery + TWO_VOLT)))
-			{
-				switchCharger(OFF);
-				switchSolarArray(ON);
-				changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-				canCharge = false;
-				isCharging = false;
-				isBypass = false;
-				mpptBypass(OFF);
-
-				if (canPulse == pulseInterval)
-				{
-					pulse();
-					canPulse = 0;
-				}
-			}
-
-			// Don't do anything if the solar array voltage is below battery voltage.
-			else
-			{
-				switchCharger(OFF);
-				switchSolarArray(OFF);
-				changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-				mpptBypass(OFF);
-				canCharge = false;
-				isCharging = false;
-				isBypass = false;
-				canPulse = 0;
-			}
-		} // end if (vBattery > BAT_DROP_DEAD_VOLT)
-
-		// If batteries are below BAT_DROP_DEAD_VOLT or if we are overheated, just keep these all off while
-		// we warn the user through the LCD
-		else
-		{
-			switchCharger(OFF);
-			switchSolarArray(OFF);
-			changePWM_TIM1(PCT80_DUTY_CYCLE, OFF);
-			mpptBypass(OFF);
-			canCharge = false;
-			isCharging = false;
-			isBypass = false;
-			canPulse = 0;
-			adsorptionComplete = false;
-			adsorptionFlag = false;
-			floatFlag = false;
-		}
-	} //end while
+		sched_Run();
+	}
 }
-
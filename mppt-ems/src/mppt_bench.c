@@ -0,0 +1,118 @@
+/** mppt_bench.c
+ * Source file for the per strategy MPPT tracking performance counters
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Compares the strategies on the real array: switch strategies with CMD_STRATEGY and read the table with CMD_BENCHMARK.
+ * The available power is the peak the last global scan found (see mppt_scan.c), or the array power itself when that
+ * is higher, so the tracking efficiency (energy / available) is never over 100 %. Until the first scan nothing is counted.
+ * The ripple is the mean power change from one step to the next, which slow irradiance changes hardly add to.
+ *
+ * mpptBench_Step() runs in the control loop interrupt, everything else from the main context.
+ */
+
+#include "mppt_bench.h"
+
+#include <string.h>
+
+static MPPT_BenchRecord records[MPPT_STRATEGY_COUNT];
+
+static volatile uint32_t sequence;		// Bumped by every step, so a copy can tell it was interrupted
+static volatile uint8_t resetRequest;
+
+static int32_t peakPower;				// mW, 0: unknown
+static int32_t lastPower;
+static uint32_t convergeSteps;
+static uint8_t converging;
+
+
+// Clears all records, from the next step on
+void mpptBench_Reset(void)
+{
+	resetRequest = 1;
+}
+
+// Available power found by a global scan, in mW
+void mpptBench_SetPeak(int32_t power)
+{
+	peakPower = power;
+}
+
+// The active strategy (re)starts tracking: its convergence is timed from here
+void mpptBench_Start(void)
+{
+	converging = 1;
+	convergeSteps = 0;
+	lastPower = -1;
+}
+
+// One tracking step of strategy with the array at power mW
+void mpptBench_Step(uint8_t strategy, int32_t power)
+{
+	MPPT_BenchRecord *record;
+	int32_t available;
+
+	if (resetRequest)
+	{
+		memset((void *)records, 0, sizeof(records));
+		resetRequest = 0;
+	}
+
+	if ( (strategy >= MPPT_STRATEGY_COUNT) || (peakPower <= 0) )
+		return;
+
+	record = &records[strategy];
+	available = (power > peakPower) ? power : peakPower;
+
+	record->steps++;
+	record->energy += (power > 0) ? power : 0;
+	record->available += available;
+
+	if (lastPower >= 0)
+		record->ripple += (power > lastPower) ? (power - lastPower) : (lastPower - power);
+
+	lastPower = power;
+
+	if (converging)
+	{
+		convergeSteps++;
+
+		if ((int64_t)power * 100 >= (int64_t)available * MPPT_BENCH_CONVERGED_PCT)
+		{
+			record->convergeSteps += convergeSteps;
+			record->converged++;
+			converging = 0;
+		}
+	}
+
+	sequence++;
+}
+
+// Copies the record of strategy into record
+void mpptBench_Get(uint8_t strategy, MPPT_BenchRecord *record)
+{
+	uint32_t start;
+
+	if (strategy >= MPPT_STRATEGY_COUNT)
+	{
+		memset((void *)record, 0, sizeof(MPPT_BenchRecord));
+		return;
+	}
+
+	// A step between reading the sequence and finishing the copy may have torn it, so take it again
+	do
+	{
+		start = sequence;
+		memcpy((void *)record, (void *)&records[strategy], sizeof(MPPT_BenchRecord));
+	} while (start != sequence);
+}
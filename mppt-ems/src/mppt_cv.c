@@ -0,0 +1,42 @@
+/** mppt_cv.c
+ * Constant voltage MPPT strategy
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Holds the array at MPPT_CV_TARGET_MV by setting the duty to the battery / array voltage ratio,
+ * as calcMPPT_CV() in mppt-test does. It needs no history, so init and reset have nothing to do.
+ */
+
+#include "mppt_strategy.h"
+#include "converter.h"
+
+
+static void cv_Init(const MPPT_Measurement *m, uint16_t duty)
+{
+}
+
+static int32_t cv_Step(const MPPT_Measurement *m, uint16_t duty)
+{
+	return (int32_t)DUTY_FINE(TIM1_PERIOD) * m->vBat / MPPT_CV_TARGET_MV;
+}
+
+static void cv_Reset(void)
+{
+}
+
+const MPPT_Strategy mpptCV =
+{
+	cv_Init,
+	cv_Step,
+	cv_Reset
+};
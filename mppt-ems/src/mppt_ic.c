@@ -0,0 +1,134 @@
+/** mppt_ic.c
+ * Incremental conductance MPPT strategy
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * At the maximum power point dP/dV = 0, i.e. dI/dV = -I/V. Left of the MPP dI/dV > -I/V and the array voltage
+ * has to go up (duty down), right of it the voltage has to come down (duty up).
+ *
+ * Everything is integer. Multiplying dI/dV + I/V by V * dV gives dI * V + I * dV, which is the power change dP
+ * (uW) of the step, so the test needs no division: the sign of dP/dV is the sign of dP times the sign of dV.
+ * Changes inside the deadbands (see mppt_strategy.h) are treated as noise, so the duty holds at the MPP
+ * instead of following ADC noise. The duty commands never leave MIN_DUTY_CYCLE..MAX_DUTY_CYCLE.
+ *
+ * On a steady curve nothing changes unless the duty does, so until a step has found the MPP the tracker keeps
+ * perturbing in the direction it last moved. The first perturbation after ic_Init() raises the array voltage.
+ */
+
+#include "mppt_strategy.h"
+#include "converter.h"
+
+#include <stdlib.h>
+
+static int32_t lastVsolar;
+static int32_t lastIsolar;
+static int32_t direction;				// MPPT_IC_STEP or -MPPT_IC_STEP
+static bool atMpp;
+
+
+static void ic_Init(const MPPT_Measurement *m, uint16_t duty)
+{
+	lastVsolar = m->vSolar;
+	lastIsolar = m->iSolar;
+	direction = -MPPT_IC_STEP;
+	atMpp = false;
+}
+
+// duty + delta (1/16 counts), limited to MIN_DUTY_CYCLE..MAX_DUTY_CYCLE
+static int32_t ic_Move(uint16_t duty, int32_t delta)
+{
+	int32_t command = (int32_t)duty + delta;
+
+	if (command > DUTY_FINE(MAX_DUTY_CYCLE))
+		return DUTY_FINE(MAX_DUTY_CYCLE);
+
+	if (command < DUTY_FINE(MIN_DUTY_CYCLE))
+		return DUTY_FINE(MIN_DUTY_CYCLE);
+
+	return command;
+}
+
+static int32_t ic_Step(const MPPT_Measurement *m, uint16_t duty)
+{
+	int32_t dV, dI;
+	int64_t dP;
+	int32_t command;
+
+	dV = m->vSolar - lastVsolar;
+	dI = m->iSolar - lastIsolar;
+
+	if (abs(dV) > MPPT_IC_DV_DEADBAND_MV)
+	{
+		// dI * V + I * dV, in uW. 64 bits, since each product can come close to 2^31.
+		dP = (int64_t)dI * m->vSolar + (int64_t)m->iSolar * dV;
+
+		// At the MPP
+		if ( (dP <= (int64_t)MPPT_IC_DP_DEADBAND_MW * 1000) && (dP >= -(int64_t)MPPT_IC_DP_DEADBAND_MW * 1000) )
+		{
+			atMpp = true;
+			return duty;
+		}
+
+		// dP/dV > 0: left of the MPP
+		direction = ( (dP > 0) == (dV > 0) ) ? -MPPT_IC_STEP : MPPT_IC_STEP;
+		command = ic_Move(duty, direction);
+		atMpp = false;
+	}
+
+	// The voltage held still, so a current change is the irradiance changing and the MPP moving with it
+	else if (abs(dI) > MPPT_IC_DI_DEADBAND_MA)
+	{
+		direction = (dI > 0) ? -MPPT_IC_STEP : MPPT_IC_STEP;
+		command = ic_Move(duty, direction);
+		atMpp = false;
+	}
+
+	/* Nothing changed. The last values stay as the reference, so a slow drift still adds up past the deadbands, and
+	 * a perturbation is measured against the point before it. At a duty limit the perturbation turns around.
+	 */
+	else
+	{
+		if (atMpp)
+			return duty;
+
+		command = ic_Move(duty, direction);
+
+		if (command == duty)
+		{
+			direction = -direction;
+			command = ic_Move(duty, direction);
+		}
+
+		return command;
+	}
+
+	lastVsolar = m->vSolar;
+	lastIsolar = m->iSolar;
+
+	return command;
+}
+
+static void ic_Reset(void)
+{
+	lastVsolar = 0;
+	lastIsolar = 0;
+	direction = -MPPT_IC_STEP;
+	atMpp = false;
+}
+
+const MPPT_Strategy mpptIC =
+{
+	ic_Init,
+	ic_Step,
+	ic_Reset
+};
@@ -0,0 +1,75 @@
+/** mppt_po.c
+ * Perturb and observe MPPT strategy
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Moves the duty one count every step, in the direction that raised the array power on the previous step.
+ * Raising the duty lowers the array voltage.
+ */
+
+#include "mppt_strategy.h"
+#include "converter.h"
+#include "measure.h"
+
+static int32_t lastPower;
+static int32_t lastVsolar;
+
+
+static void po_Init(const MPPT_Measurement *m, uint16_t duty)
+{
+	lastPower = calcPower(m->vSolar, m->iSolar);
+	lastVsolar = m->vSolar;
+}
+
+static int32_t po_Step(const MPPT_Measurement *m, uint16_t duty)
+{
+	int32_t currentPower;
+	int32_t command;
+
+	currentPower = calcPower(m->vSolar, m->iSolar);
+
+	if (currentPower > lastPower)
+	{
+		// Keep going the same way: if the voltage went up, keep lowering the duty
+		if (m->vSolar > lastVsolar)
+			command = duty - DUTY_FINE(1);
+		else
+			command = duty + DUTY_FINE(1);
+	}
+
+	else
+	{
+		if (m->vSolar > lastVsolar)
+			command = duty + DUTY_FINE(1);
+		else
+			command = duty - DUTY_FINE(1);
+	}
+
+	lastPower = currentPower;
+	lastVsolar = m->vSolar;
+
+	return command;
+}
+
+static void po_Reset(void)
+{
+	lastPower = 0;
+	lastVsolar = 0;
+}
+
+const MPPT_Strategy mpptPO =
+{
+	po_Init,
+	po_Step,
+	po_Reset
+};
@@ -0,0 +1,145 @@
+/** mppt_scan.c
+ * Source file for the periodic global peak scan that keeps the MPPT off local maxima
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * With partial shading or mixed panels the P-V curve has more than one peak, and the hill climbing
+ * strategies stay on whichever one they start next to. Every MPPT_SCAN_INTERVAL_MS the scan takes over the duty cycle,
+ * sweeps MIN_DUTY_CYCLE..MAX_DUTY_CYCLE in at most MPPT_SCAN_POINTS steps, goes back to the duty with the most power and
+ * hands the converter back to the active strategy there.
+ */
+
+#include "mppt_scan.h"
+#include "measure.h"
+#include "converter.h"
+
+#define SCAN_IDLE		0
+#define SCAN_SWEEP		1
+#define SCAN_RETURN		2	// Waiting at the peak so the strategy starts from a measurement taken there
+
+// Smallest step that covers the range within the budget
+#define SCAN_STEP		((MAX_DUTY_CYCLE - MIN_DUTY_CYCLE + MPPT_SCAN_POINTS - 2) / (MPPT_SCAN_POINTS - 1))
+
+static uint8_t state = SCAN_IDLE;
+static uint8_t settle;
+static uint16_t point;
+static uint16_t peakDuty = PCT80_DUTY_CYCLE;
+static int32_t peakPower;
+static uint32_t nextScan;
+
+
+// The next scan starts at time now (mS, HAL_GetTick() on the target). Called when charging starts.
+void mpptScan_Schedule(uint32_t now)
+{
+	nextScan = now;
+	state = SCAN_IDLE;
+}
+
+bool mpptScan_Due(uint32_t now)
+{
+	if (MPPT_SCAN_INTERVAL_MS == 0)
+		return false;
+
+	return (state == SCAN_IDLE) && ((int32_t)(now - nextScan) >= 0);
+}
+
+// Starts a scan at time now (mS). The next one is due MPPT_SCAN_INTERVAL_MS later.
+void mpptScan_Start(uint32_t now)
+{
+	nextScan = now + MPPT_SCAN_INTERVAL_MS;
+	state = SCAN_SWEEP;
+	point = MIN_DUTY_CYCLE;
+	settle = MPPT_SCAN_SETTLE_STEPS;
+	peakPower = -1;
+}
+
+// Drops a running scan, leaving the duty cycle where it is. The next one is still due when it would have been.
+void mpptScan_Cancel(void)
+{
+	state = SCAN_IDLE;
+}
+
+bool mpptScan_Active(void)
+{
+	return state != SCAN_IDLE;
+}
+
+/** One control step of the scan, with m measured at the present duty cycle.
+ * Returns true with the duty cycle to apply in *duty while the scan is running, false once it is finished.
+ * The converter is then at the peak and the active strategy should be started from m.
+ */
+bool mpptScan_Step(const MPPT_Measurement *m, uint16_t *duty)
+{
+	int32_t power;
+
+	if (state == SCAN_RETURN)
+	{
+		if (settle != 0)
+		{
+			settle--;
+			*duty = peakDuty;
+
+			return true;
+		}
+
+		state = SCAN_IDLE;
+
+		return false;
+	}
+
+	// The first step only moves the converter to the first point
+	if (*duty != point)
+	{
+		*duty = point;
+		return true;
+	}
+
+	if (settle != 0)
+	{
+		settle--;
+		return true;
+	}
+
+	power = calcPower(m->vSolar, m->iSolar);
+
+	if (power > peakPower)
+	{
+		peakPower = power;
+		peakDuty = point;
+	}
+
+	if (point >= MAX_DUTY_CYCLE)
+	{
+		state = SCAN_RETURN;
+		settle = MPPT_SCAN_SETTLE_STEPS;
+		*duty = peakDuty;
+
+		return true;
+	}
+
+	point += SCAN_STEP;
+
+	if (point > MAX_DUTY_CYCLE)
+		point = MAX_DUTY_CYCLE;
+
+	settle = MPPT_SCAN_SETTLE_STEPS;
+	*duty = point;
+
+	return true;
+}
+
+// Array power at the peak the last scan found, in mW
+int32_t mpptScan_GetPeakPower(void)
+{
+	return peakPower;
+}
@@ -0,0 +1,82 @@
+/** mppt_strategy.c
+ * Source file for the runtime selectable MPPT strategies
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The strategies only compute duty commands. Limiting the duty, counting the time spent at
+ * MAX_DUTY_CYCLE and writing TIM1 stay with the caller (calcMPPT() in mppt.c), so every strategy is
+ * treated the same way.
+ */
+
+#include "mppt_strategy.h"
+#include "converter.h"
+
+static const MPPT_Strategy *const strategies[MPPT_STRATEGY_COUNT] =
+{
+	&mpptPO,
+	&mpptTI,
+	&mpptIC,
+	&mpptCV,
+	&mpptVPO
+};
+
+static uint8_t active = MPPT_STRATEGY_PO;
+
+
+// Makes strategy index the active one. Returns false, and leaves the active strategy alone, for an unknown index.
+bool mpptStrategy_Select(uint8_t index)
+{
+	if (index >= MPPT_STRATEGY_COUNT)
+		return false;
+
+	active = index;
+	strategies[active]->reset();
+
+	return true;
+}
+
+uint8_t mpptStrategy_GetActive(void)
+{
+	return active;
+}
+
+void mpptStrategy_Init(const MPPT_Measurement *m, uint16_t duty)
+{
+	strategies[active]->init(m, duty);
+}
+
+int32_t mpptStrategy_Step(const MPPT_Measurement *m, uint16_t duty)
+{
+	return strategies[active]->step(m, duty);
+}
+
+// Duty cycle that puts the array near its MPP, from the open circuit array voltage and the battery voltage (mV)
+uint16_t mpptStrategy_SeedDuty(int32_t vOpenCircuit, int32_t vBattery)
+{
+	int32_t vMPP, duty;
+
+	vMPP = vOpenCircuit * MPPT_SEED_VOC_FRACTION_Q8 / 256;
+
+	if (vMPP <= 0)
+		return MAX_DUTY_CYCLE;
+
+	duty = vBattery * TIM1_PERIOD / vMPP;
+
+	if (duty > MAX_DUTY_CYCLE)
+		return MAX_DUTY_CYCLE;
+
+	if (duty < MIN_DUTY_CYCLE)
+		return MIN_DUTY_CYCLE;
+
+	return (uint16_t)duty;
+}
@@ -0,0 +1,58 @@
+/** mppt_ti.c
+ * Power only perturb and observe MPPT strategy
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Keeps moving the duty one count per step in the same direction for as long as the array power rises,
+ * and reverses whenever it falls.
+ */
+
+#include "mppt_strategy.h"
+#include "converter.h"
+#include "measure.h"
+
+static int32_t lastPower;
+static int8_t direction = 1;		// 1: lower the duty, -1: raise it
+
+
+static void ti_Init(const MPPT_Measurement *m, uint16_t duty)
+{
+	lastPower = calcPower(m->vSolar, m->iSolar);
+}
+
+static int32_t ti_Step(const MPPT_Measurement *m, uint16_t duty)
+{
+	int32_t currentPower;
+
+	currentPower = calcPower(m->vSolar, m->iSolar);
+
+	if (currentPower < lastPower)
+		direction = -direction;
+
+	lastPower = currentPower;
+
+	return duty - direction * DUTY_FINE(1);
+}
+
+static void ti_Reset(void)
+{
+	lastPower = 0;
+	direction = 1;
+}
+
+const MPPT_Strategy mpptTI =
+{
+	ti_Init,
+	ti_Step,
+	ti_Reset
+};
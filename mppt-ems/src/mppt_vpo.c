@@ -0,0 +1,126 @@
+/** mppt_vpo.c
+ * Variable step perturb and observe MPPT strategy
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Works like mppt_po.c, but takes big steps while the power curve is steep (after a cloud edge)
+ * and half count steps near the MPP. Once the power is flat within noise it stops perturbing altogether
+ * instead of dithering across three duty values.
+ */
+
+#include "mppt_strategy.h"
+#include "converter.h"
+#include "measure.h"
+
+#include <stdlib.h>
+
+static int32_t lastPower;
+static int32_t lastVsolar;
+static int32_t frozenPower;
+static uint8_t flatSteps;
+static bool frozen;
+
+
+static void vpo_Init(const MPPT_Measurement *m, uint16_t duty)
+{
+	lastPower = calcPower(m->vSolar, m->iSolar);
+	lastVsolar = m->vSolar;
+	flatSteps = 0;
+	frozen = false;
+}
+
+// Step size in 1/16 duty counts for a power change dP (mW) over a voltage change dV (mV)
+static int32_t vpo_StepSize(int32_t dP, int32_t dV)
+{
+	int32_t step;
+
+	// A voltage change inside the measurement noise makes dP/dV meaningless, and huge
+	if (abs(dV) <= MPPT_VPO_DV_DEADBAND_MV)
+		return MPPT_VPO_MIN_STEP;
+
+	step = (abs(dP) * MPPT_VPO_GAIN_Q8 / abs(dV)) >> (8 - DUTY_FRACTION_BITS);
+
+	if (step < MPPT_VPO_MIN_STEP)
+		return MPPT_VPO_MIN_STEP;
+
+	if (step > MPPT_VPO_MAX_STEP)
+		return MPPT_VPO_MAX_STEP;
+
+	return step;
+}
+
+static int32_t vpo_Step(const MPPT_Measurement *m, uint16_t duty)
+{
+	int32_t currentPower, dP, dV, step;
+	int32_t command;
+
+	currentPower = calcPower(m->vSolar, m->iSolar);
+
+	// Holding still: resume tracking only when the operating point has clearly moved
+	if (frozen)
+	{
+		if (abs(currentPower - frozenPower) <= MPPT_VPO_FLAT_MW)
+			return duty;
+
+		frozen = false;
+		flatSteps = 0;
+	}
+
+	dP = currentPower - lastPower;
+	dV = m->vSolar - lastVsolar;
+
+	if (abs(dP) <= MPPT_VPO_FLAT_MW)
+	{
+		if (++flatSteps >= MPPT_VPO_FLAT_STEPS)
+		{
+			frozen = true;
+			frozenPower = currentPower;
+			lastPower = currentPower;
+			lastVsolar = m->vSolar;
+
+			return duty;
+		}
+	}
+	else
+	{
+		flatSteps = 0;
+	}
+
+	step = vpo_StepSize(dP, dV);
+
+	// Same direction rules as the fixed step P&O: raising the duty lowers the array voltage
+	if ( (dP > 0) == (dV > 0) )
+		command = duty - step;
+	else
+		command = duty + step;
+
+	lastPower = currentPower;
+	lastVsolar = m->vSolar;
+
+	return command;
+}
+
+static void vpo_Reset(void)
+{
+	lastPower = 0;
+	lastVsolar = 0;
+	flatSteps = 0;
+	frozen = false;
+}
+
+const MPPT_Strategy mpptVPO =
+{
+	vpo_Init,
+	vpo_Step,
+	vpo_Reset
+};
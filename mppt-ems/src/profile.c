@@ -0,0 +1,124 @@
+/** profile.c
+ * Source file for the cycle count profiler
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A probe is timed as
+ *		start = prof_Now();
+ *		...
+ *		prof_Stop(PROF_x, start);
+ * and keeps the count, minimum, maximum and total of its times. On the target the time is the DWT cycle counter
+ * (one count per core clock, wrapping after 42 S at 100 MHz); a host build uses the monotonic clock in ns instead,
+ * so the same records come out of a simulation. Probes may be stopped from interrupts: a stop updates its record, and
+ * clears them all after prof_Reset(), with interrupts masked, so a stop in an interrupt can't land inside another.
+ */
+
+#include "profile.h"
+#include "stm32f4xx_hal.h"
+
+#if !defined(__arm__)
+#include <time.h>
+#endif
+
+#include <string.h>
+
+static PROF_Record records[PROF_PROBES];
+
+static volatile uint32_t sequence;		// Bumped by every stop, so a copy can tell it was interrupted
+static volatile uint8_t resetRequest;
+
+
+// Starts the DWT cycle counter
+void prof_Init(void)
+{
+#if defined(__arm__)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	memset((void *)records, 0, sizeof(records));
+}
+
+uint32_t prof_Now(void)
+{
+#if defined(__arm__)
+	return DWT->CYCCNT;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint32_t)((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec);
+#endif
+}
+
+// Ends a probe that started at start (prof_Now())
+void prof_Stop(uint8_t probe, uint32_t start)
+{
+	PROF_Record *record;
+	uint32_t time = prof_Now() - start;
+	uint32_t primask;
+
+	if (probe >= PROF_PROBES)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (resetRequest)
+	{
+		memset((void *)records, 0, sizeof(records));
+		resetRequest = 0;
+	}
+
+	record = &records[probe];
+
+	if ( (record->count == 0) || (time < record->min) )
+		record->min = time;
+
+	if (time > record->max)
+		record->max = time;
+
+	record->count++;
+	record->total += time;
+
+	sequence++;
+
+	__set_PRIMASK(primask);
+}
+
+// Copies the record of probe into record
+void prof_Get(uint8_t probe, PROF_Record *record)
+{
+	uint32_t start;
+
+	if (probe >= PROF_PROBES)
+	{
+		memset((void *)record, 0, sizeof(PROF_Record));
+		return;
+	}
+
+	// A stop between reading the sequence and finishing the copy may have torn it, so take it again
+	do
+	{
+		start = sequence;
+		memcpy((void *)record, (void *)&records[probe], sizeof(PROF_Record));
+	} while (start != sequence);
+}
+
+// Clears all records, at the next stop
+void prof_Reset(void)
+{
+	resetRequest = 1;
+}
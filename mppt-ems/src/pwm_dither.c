@@ -0,0 +1,98 @@
+/** pwm_dither.c
+ * Source file for the high resolution TIM1 duty cycle (dithering between adjacent counts)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * MIN_DUTY_CYCLE..MAX_DUTY_CYCLE is only 43 TIM1 counts. A duty cycle in 1/16 counts (DUTY_FRACTION_BITS) is made
+ * by running the whole count for some of 16 consecutive PWM periods and the next count up for the rest, which
+ * averages to the fraction. That's 4096 steps over the TIM1 period, 12 bits.
+ *
+ * Every TIM1 update event (once per PWM period, RepetitionCounter = 1) requests a DMA burst that writes CCR1 and CCR2
+ * for the next period through TIM1->DMAR, from a circular table of 16 periods. No interrupt and no CPU time is involved.
+ * The table is rewritten by pwmDither_Set() from the ADC interrupt while the DMA runs through it. Each period is one
+ * 32 bit word, CCR1 in the low half and CCR2 in the high half: pwmDither_Set() stores it in one write, and the DMA
+ * (word reads, unpacked to half-word writes through its FIFO) reads it in one. A burst never gets the new CCR1 with
+ * the old CCR2, so CCR2 = TIM1_PERIOD - CCR1 holds for every single period as in changePWM_TIM1().
+ */
+
+#include "stm32f4xx_hal.h"
+#include "pwm_dither.h"
+#include "mppt.h"
+
+#define PERIODS		(1 << DUTY_FRACTION_BITS)
+
+extern TIM_HandleTypeDef htim1;
+extern DMA_HandleTypeDef hdma_tim1_up;
+
+/** Dither patterns, one per fraction. Bit k set: period k runs one count more.
+ * A fraction of f / 16 has f bits set, spread the way a first order sigma-delta modulator spreads them,
+ * so the duty never sits on the same count for longer than it has to and the added ripple stays small.
+ */
+static const uint16_t pattern[PERIODS] =
+{
+	0x0000,		//  0/16
+	0x8000,		//  1/16
+	0x8080,		//  2/16
+	0x8420,		//  3/16
+	0x8888,		//  4/16
+	0x9248,		//  5/16
+	0xa4a4,		//  6/16
+	0xaa54,		//  7/16
+	0xaaaa,		//  8/16
+	0xd5aa,		//  9/16
+	0xdada,		// 10/16
+	0xedb6,		// 11/16
+	0xeeee,		// 12/16
+	0xfbde,		// 13/16
+	0xfefe,		// 14/16
+	0xfffe		// 15/16
+};
+
+// CCR1 | CCR2 << 16 of every period: the DMA burst writes the low half first
+static uint32_t burst[PERIODS];
+
+
+/** Sets the duty cycle, in 1/16 TIM1 counts. Takes effect within one pattern (16 PWM periods), and the word or two
+ * the DMA FIFO has already read, once started.
+ */
+void pwmDither_Set(uint16_t pulseFine)
+{
+	uint16_t pulse = pulseFine >> DUTY_FRACTION_BITS;
+	uint16_t bits = pattern[pulseFine & (PERIODS - 1)];
+	uint16_t ccr;
+	uint8_t k;
+
+	for (k = 0; k < PERIODS; k++)
+	{
+		ccr = pulse + ((bits >> k) & 1);
+
+		burst[k] = ccr | ((uint32_t)(TIM1_PERIOD - ccr) << 16);
+	}
+}
+
+// Starts the update DMA. Call with the PWM outputs running, after pwmDither_Set().
+void pwmDither_Start(void)
+{
+	TIM1->DCR = TIM_DMABASE_CCR1 | TIM_DMABURSTLENGTH_2TRANSFERS;
+
+	// NDTR counts the half-word writes to the timer, two per period
+	if (HAL_DMA_Start(&hdma_tim1_up, (uint32_t)burst, (uint32_t)&TIM1->DMAR, 2 * PERIODS) == HAL_OK)
+		__HAL_TIM_ENABLE_DMA(&htim1, TIM_DMA_UPDATE);
+}
+
+// Stops the update DMA. CCR1 / CCR2 keep the value of the last period written.
+void pwmDither_Stop(void)
+{
+	__HAL_TIM_DISABLE_DMA(&htim1, TIM_DMA_UPDATE);
+	HAL_DMA_Abort(&hdma_tim1_up);
+}
@@ -0,0 +1,118 @@
+/** sched.c
+ * Source file for the cooperative task scheduler
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The main loop calls sched_Run() over and over, and it runs whatever the task table has due at the clock it was given
+ * (HAL_GetTick() on the target). Nothing here touches the hardware or runs from an interrupt, so a task that starts late
+ * was held up by the tasks that ran before it. Releases stay on their period grid: a task held up for longer than its period runs once
+ * and counts the releases it missed, instead of running again back to back to catch up.
+ */
+
+#include "sched.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static const SCHED_Task *table;
+static SCHED_State *state;
+static uint8_t count;
+static uint32_t (*tick)(void);
+
+
+void sched_Init(const SCHED_Task *tasks, SCHED_State *taskState, uint8_t taskCount, uint32_t (*now)(void))
+{
+	uint32_t start = now();
+	uint8_t i;
+
+	table = tasks;
+	state = taskState;
+	count = taskCount;
+	tick = now;
+
+	memset((void *)state, 0, count * sizeof(SCHED_State));
+
+	for (i = 0; i < count; i++)
+		state[i].release = start + table[i].offset;
+}
+
+// Runs every task that is due, in table order
+void sched_Run(void)
+{
+	uint32_t start, finish, late;
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		start = tick();
+
+		if ((int32_t)(start - state[i].release) < 0)
+			continue;
+
+		table[i].run();
+
+		finish = tick();
+		late = start - state[i].release;
+
+		state[i].runs++;
+		state[i].lateness = (late > UINT16_MAX) ? UINT16_MAX : (uint16_t)late;
+		state[i].totalLateness += late;
+
+		if (state[i].lateness > state[i].maxLateness)
+			state[i].maxLateness = state[i].lateness;
+
+		if ((finish - start) > state[i].maxRun)
+			state[i].maxRun = ((finish - start) > UINT16_MAX) ? UINT16_MAX : (uint16_t)(finish - start);
+
+		if ((finish - state[i].release) > table[i].deadline)
+			state[i].misses++;
+
+		state[i].release += table[i].period;
+
+		while ((int32_t)(finish - state[i].release) >= 0)
+		{
+			state[i].release += table[i].period;
+			state[i].skipped++;
+		}
+	}
+}
+
+uint8_t sched_Count(void)
+{
+	return count;
+}
+
+const SCHED_State *sched_GetState(uint8_t index)
+{
+	if (index >= count)
+		return NULL;
+
+	return &state[index];
+}
+
+// Clears the counters. The releases carry on where they are.
+void sched_ResetStats(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		state[i].runs = 0;
+		state[i].misses = 0;
+		state[i].skipped = 0;
+		state[i].lateness = 0;
+		state[i].maxLateness = 0;
+		state[i].totalLateness = 0;
+		state[i].maxRun = 0;
+	}
+}
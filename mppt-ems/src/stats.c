@@ -0,0 +1,200 @@
+/** stats.c
+ * Source file for the fixed-size running window statistics (mean, min, max, variance)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Adding a slot is O(1): the running sum and sum of squares drop the slot that falls out of the window,
+ * and the minimum and maximum come from monotonic queues, where every slot index is pushed and popped at most once.
+ * Nothing is allocated and there is no floating point.
+ */
+
+#include "stats.h"
+
+
+static void stats_Push(STATS_Window *w, int32_t value)
+{
+	uint8_t back;
+
+	if (w->count == w->size)
+	{
+		// The window is full, so the slot about to be overwritten is the oldest one.
+		// If it's still queued at all it is at the front.
+		w->sum -= w->sample[w->head];
+		w->sumSquares -= (int64_t)w->sample[w->head] * w->sample[w->head];
+
+		if ( (w->minCount != 0) && (w->minQ[w->minFront] == w->head) )
+		{
+			w->minFront = (w->minFront + 1) % w->size;
+			w->minCount--;
+		}
+
+		if ( (w->maxCount != 0) && (w->maxQ[w->maxFront] == w->head) )
+		{
+			w->maxFront = (w->maxFront + 1) % w->size;
+			w->maxCount--;
+		}
+	}
+	else
+	{
+		w->count++;
+	}
+
+	// Older slots that can never be the minimum (maximum) again while the new one is in the window
+	while (w->minCount != 0)
+	{
+		back = (w->minFront + w->minCount - 1) % w->size;
+
+		if (w->sample[w->minQ[back]] < value)
+			break;
+
+		w->minCount--;
+	}
+
+	while (w->maxCount != 0)
+	{
+		back = (w->maxFront + w->maxCount - 1) % w->size;
+
+		if (w->sample[w->maxQ[back]] > value)
+			break;
+
+		w->maxCount--;
+	}
+
+	w->sample[w->head] = value;
+	w->sum += value;
+	w->sumSquares += (int64_t)value * value;
+
+	w->minQ[(w->minFront + w->minCount) % w->size] = w->head;
+	w->minCount++;
+
+	w->maxQ[(w->maxFront + w->maxCount) % w->size] = w->head;
+	w->maxCount++;
+
+	w->head = (w->head + 1) % w->size;
+}
+
+void stats_Init(STATS_Window *w, int32_t *sample, uint8_t *minQ, uint8_t *maxQ, uint8_t size, uint8_t decimation)
+{
+	w->sample = sample;
+	w->minQ = minQ;
+	w->maxQ = maxQ;
+	w->size = size;
+	w->decimation = decimation;
+
+	stats_Reset(w);
+}
+
+// Empties the window
+void stats_Reset(STATS_Window *w)
+{
+	w->head = 0;
+	w->count = 0;
+	w->minFront = 0;
+	w->minCount = 0;
+	w->maxFront = 0;
+	w->maxCount = 0;
+	w->pending = 0;
+	w->pendingSum = 0;
+	w->sum = 0;
+	w->sumSquares = 0;
+}
+
+// Adds a sample. Every decimation samples are averaged into one slot.
+void stats_Add(STATS_Window *w, int32_t value)
+{
+	w->pendingSum += value;
+
+	if (++w->pending < w->decimation)
+		return;
+
+	stats_Push(w, w->pendingSum / w->decimation);
+
+	w->pending = 0;
+	w->pendingSum = 0;
+}
+
+// Number of slots in the window (less than size until it has filled once)
+uint8_t stats_Count(const STATS_Window *w)
+{
+	return w->count;
+}
+
+// The statistics below are 0 for an empty window
+
+int32_t stats_Mean(const STATS_Window *w)
+{
+	if (w->count == 0)
+		return 0;
+
+	return w->sum / w->count;
+}
+
+int32_t stats_Min(const STATS_Window *w)
+{
+	if (w->minCount == 0)
+		return 0;
+
+	return w->sample[w->minQ[w->minFront]];
+}
+
+int32_t stats_Max(const STATS_Window *w)
+{
+	if (w->maxCount == 0)
+		return 0;
+
+	return w->sample[w->maxQ[w->maxFront]];
+}
+
+// Population variance, in units squared
+uint32_t stats_Variance(const STATS_Window *w)
+{
+	int64_t variance;
+
+	if (w->count == 0)
+		return 0;
+
+	variance = (w->sumSquares - (int64_t)w->sum * w->sum / w->count) / w->count;
+
+	if (variance < 0)
+		return 0;
+
+	return (uint32_t)variance;
+}
+
+// Standard deviation (integer square root of the variance), in units
+uint32_t stats_StdDev(const STATS_Window *w)
+{
+	uint32_t value = stats_Variance(w);
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > value)
+		bit >>= 2;
+
+	while (bit != 0)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+
+		bit >>= 2;
+	}
+
+	return root;
+}
@@ -27,6 +27,8 @@
 #include "stm32f4xx_hal.h"
 
 extern DMA_HandleTypeDef hdma_adc1;
+extern DMA_HandleTypeDef hdma_tim1_up;
+extern DMA_HandleTypeDef hdma_usart1_tx;
 
 /**
   * Initializes the Global MSP.
@@ -145,6 +147,28 @@ void HAL_TIM_Base_MspInit(TIM_HandleTypeDef* htim_base)
   {
     /* Peripheral clock enable */
     __HAL_RCC_TIM1_CLK_ENABLE();
+
+    /* Peripheral DMA init*/
+    /* TIM1_UP: bursts of CCR1 / CCR2 through TIM1->DMAR, see pwm_dither.c. A period's pair is read as one word, and
+       the FIFO unpacks it into the two half-word writes. */
+
+      hdma_tim1_up.Instance = DMA2_Stream5;
+      hdma_tim1_up.Init.Channel = DMA_CHANNEL_6;
+      hdma_tim1_up.Init.Direction = DMA_MEMORY_TO_PERIPH;
+      hdma_tim1_up.Init.PeriphInc = DMA_PINC_DISABLE;
+      hdma_tim1_up.Init.MemInc = DMA_MINC_ENABLE;
+      hdma_tim1_up.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+      hdma_tim1_up.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+      hdma_tim1_up.Init.Mode = DMA_CIRCULAR;
+      hdma_tim1_up.Init.Priority = DMA_PRIORITY_LOW;
+      hdma_tim1_up.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
+      hdma_tim1_up.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_1QUARTERFULL;
+      hdma_tim1_up.Init.MemBurst = DMA_MBURST_SINGLE;
+      hdma_tim1_up.Init.PeriphBurst = DMA_PBURST_SINGLE;
+
+      HAL_DMA_Init(&hdma_tim1_up);
+
+      __HAL_LINKDMA(htim_base,hdma[TIM_DMA_ID_UPDATE],hdma_tim1_up);
   }
 
   else if(htim_base->Instance==TIM5)
@@ -162,6 +186,10 @@ void HAL_TIM_Base_MspInit(TIM_HandleTypeDef* htim_base)
 
   else if(htim_base->Instance==TIM11) {
 	  __HAL_RCC_TIM11_CLK_ENABLE();
+
+	  // CC1 runs the one-shot microsecond timers (us_timer.c). They can always wait for the ADC and the UART.
+	  HAL_NVIC_SetPriority(TIM1_TRG_COM_TIM11_IRQn, 1, 0);
+	  HAL_NVIC_EnableIRQ(TIM1_TRG_COM_TIM11_IRQn);
  	 }
 }
 
@@ -214,6 +242,9 @@ void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef* htim_base)
   {
     /* Peripheral clock disable */
     __HAL_RCC_TIM1_CLK_DISABLE();
+
+    /* Peripheral DMA DeInit*/
+     HAL_DMA_DeInit(htim_base->hdma[TIM_DMA_ID_UPDATE]);
   }
 
   else if(htim_base->Instance==TIM5)
@@ -249,6 +280,23 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
     GPIO_InitStruct.Alternate = GPIO_AF7_USART1;
     HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    /* USART1 DMA Init */
+    /* USART1_TX Init */
+    hdma_usart1_tx.Instance = DMA2_Stream7;
+    hdma_usart1_tx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart1_tx.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_usart1_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+    HAL_DMA_Init(&hdma_usart1_tx);
+
+    __HAL_LINKDMA(huart,hdmatx,hdma_usart1_tx);
   }
 }
 
@@ -266,6 +314,8 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
     */
     HAL_GPIO_DeInit(GPIOB, GPIO_PIN_6|GPIO_PIN_7);
 
+    /* USART1 DMA DeInit */
+    HAL_DMA_DeInit(huart->hdmatx);
   }
 }
 
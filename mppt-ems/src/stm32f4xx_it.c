@@ -27,10 +27,12 @@
 #include "stm32f4xx.h"
 #include "stm32f4xx_it.h"
 #include "mppt.h"
+#include "profile.h"
 #include <string.h>
 
 extern UART_HandleTypeDef huart1;
 extern DMA_HandleTypeDef hdma_adc1;
+extern DMA_HandleTypeDef hdma_usart1_tx;
 extern ADC_HandleTypeDef hadc1;
 extern TIM_HandleTypeDef htim9;
 extern TIM_HandleTypeDef htim11;
@@ -133,7 +135,10 @@ void SysTick_Handler(void)
 
 
 void TIM1_BRK_TIM9_IRQHandler(void) {
+	uint32_t start = prof_Now();
+
 	HAL_TIM_IRQHandler(&htim9);
+	prof_Stop(PROF_TICK_ISR, start);
 }
 
 void TIM1_TRG_COM_TIM11_IRQHandler(void) {
@@ -141,11 +146,24 @@ void TIM1_TRG_COM_TIM11_IRQHandler(void) {
 }
 
 
+/** The receiver reads DR itself instead of calling HAL_UART_Receive(), which would find the handle locked
+ * whenever the byte arrives while a DMA transmit is being started. The end of a transmit (TC, enabled by
+ * the HAL once the TX DMA is done) is finished here too, since HAL_UART_IRQHandler() isn't used.
+ */
 void USART1_IRQHandler(void) {
 
 	uint8_t packetOK;
 
-	HAL_UART_Receive(&huart1, &rxBuff[rxByteCount], 1, 0);
+	if ( __HAL_UART_GET_IT_SOURCE(&huart1, UART_IT_TC) && __HAL_UART_GET_FLAG(&huart1, UART_FLAG_TC) ) {
+		__HAL_UART_DISABLE_IT(&huart1, UART_IT_TC);
+		huart1.gState = HAL_UART_STATE_READY;
+		HAL_UART_TxCpltCallback(&huart1);
+	}
+
+	if (!__HAL_UART_GET_FLAG(&huart1, UART_FLAG_RXNE))
+		return;
+
+	rxBuff[rxByteCount] = (uint8_t)(huart1.Instance->DR & 0xff);
 	advancePointer();
 
 	if (rxByteCount > 6) {
@@ -156,9 +174,6 @@ void USART1_IRQHandler(void) {
 		if (packetOK)
 			handleData();
 	}
-
-	__HAL_UART_FLUSH_DRREGISTER(&huart1);
-	HAL_NVIC_ClearPendingIRQ(USART1_IRQn);
 }
 
 void ADC_IRQHandler(void)
@@ -171,6 +186,11 @@ void DMA2_Stream0_IRQHandler(void)
   HAL_DMA_IRQHandler(&hdma_adc1);
 }
 
+void DMA2_Stream7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
 
 void advancePointer(void)
 {
@@ -187,8 +207,8 @@ void advancePointer(void)
 		{
 			rxByteCount = 0;
 			inByteCount = 0;
-			memset((void *)rxBuff, 0, 20);
-			memset((void *)inBuff, 0, 20);
+			memset((void *)rxBuff, 0, sizeof(rxBuff));
+			memset((void *)inBuff, 0, sizeof(inBuff));
 		}
 	}
 	else
@@ -0,0 +1,87 @@
+/** uart_tx.c
+ * Source file for the DMA driven UART transmit queue
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * uartTx_Send() queues a frame and returns; DMA2 Stream7 feeds the frames to USART1 one after the other, and the
+ * frame's done callback hands its buffer back once the transmission complete flag says the last byte is out.
+ * Only the frame's own length goes out, and nothing waits for the UART.
+ *
+ * The main context adds frames at head, the USART1 interrupt takes them off at tail, so neither masks interrupts.
+ * active is only ever set while a frame is on its way out, and only the interrupt ending that frame clears it, so
+ * the main context starts the DMA itself only when nothing is going out and no interrupt is coming to do it.
+ */
+
+#include "uart_tx.h"
+
+#include <stddef.h>
+
+static UART_HandleTypeDef *uart;
+
+static UART_TxFrame queue[UART_TX_QUEUE];
+static volatile uint8_t head;			// Next frame to add, main context only
+static volatile uint8_t tail;			// Frame going out (while active), interrupt only once started
+static volatile bool active;
+
+
+// Sends the frame at tail
+static void uartTx_Start(void)
+{
+	active = true;
+	HAL_UART_Transmit_DMA(uart, (uint8_t *)queue[tail].data, queue[tail].length);
+}
+
+void uartTx_Init(UART_HandleTypeDef *huart)
+{
+	uart = huart;
+	head = 0;
+	tail = 0;
+	active = false;
+}
+
+/** Queues length bytes of data for the UART. data must stay untouched until done is called (done may be NULL).
+ * Returns false, and queues nothing, if the queue is full: back-pressure for the caller to retry later.
+ */
+bool uartTx_Send(const uint8_t *data, uint16_t length, UART_TxDone done)
+{
+	uint8_t next = (head + 1) % UART_TX_QUEUE;
+
+	if (next == tail)
+		return false;
+
+	queue[head].data = data;
+	queue[head].length = length;
+	queue[head].done = done;
+	head = next;
+
+	if (!active)
+		uartTx_Start();
+
+	return true;
+}
+
+// The frame at tail has gone out. From the USART1 transmission complete interrupt (see HAL_UART_TxCpltCallback()).
+void uartTx_Complete(void)
+{
+	UART_TxFrame *frame = &queue[tail];
+
+	active = false;
+
+	if (frame->done != NULL)
+		frame->done(frame->data);
+
+	tail = (tail + 1) % UART_TX_QUEUE;
+
+	if (tail != head)
+		uartTx_Start();
+}
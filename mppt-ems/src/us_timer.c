@@ -0,0 +1,153 @@
+/** us_timer.c
+ * Source file for the one-shot microsecond timers
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * TIM11 counts uS over its full 16 bits and never stops: the 100 MHz APB2 timer clock over a prescaler of 100 (see
+ * MX_TIM11_Init()). Work that has to happen a few uS or mS from now is scheduled as a callback in its slot instead of
+ * spinning on the counter; the CC1 compare is set to the earliest pending deadline, and its interrupt runs every
+ * callback that is due, then sets the compare for the next one. A callback runs in that interrupt (priority 1, behind
+ * the ADC DMA and the UART), so it must be short; it may schedule itself again.
+ *
+ * The time from a deadline to its callback starting is kept as the worst case interrupt latency at that priority.
+ */
+
+#include "us_timer.h"
+#include "stm32f4xx_hal.h"
+
+#include <stddef.h>
+
+extern TIM_HandleTypeDef htim11;
+
+static US_TimerCallback callback[US_TIMER_SLOTS];		// NULL: nothing pending
+static uint16_t due[US_TIMER_SLOTS];
+static volatile uint16_t maxLatency;
+
+
+// Sets CC1 for the earliest pending deadline, and turns its interrupt off with nothing pending
+static void usTimer_Arm(void)
+{
+	uint16_t now = usTimer_Now();
+	uint16_t next = 0;
+	int32_t nearest = INT32_MAX;
+	uint8_t i;
+
+	for (i = 0; i < US_TIMER_SLOTS; i++)
+	{
+		if ( (callback[i] != NULL) && ((int16_t)(due[i] - now) < nearest) )
+		{
+			nearest = (int16_t)(due[i] - now);
+			next = due[i];
+		}
+	}
+
+	if (nearest == INT32_MAX)
+	{
+		__HAL_TIM_DISABLE_IT(&htim11, TIM_IT_CC1);
+		return;
+	}
+
+	__HAL_TIM_SET_COMPARE(&htim11, TIM_CHANNEL_1, next);
+	__HAL_TIM_ENABLE_IT(&htim11, TIM_IT_CC1);
+
+	// A deadline the counter has already passed would only match after it wraps, 65 mS late. Raise the compare event now.
+	if ((int16_t)(next - usTimer_Now()) <= 0)
+		htim11.Instance->EGR = TIM_EGR_CC1G;
+}
+
+void usTimer_Init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < US_TIMER_SLOTS; i++)
+		callback[i] = NULL;
+
+	maxLatency = 0;
+
+	__HAL_TIM_DISABLE_IT(&htim11, TIM_IT_CC1);
+	__HAL_TIM_CLEAR_FLAG(&htim11, TIM_FLAG_CC1);
+}
+
+uint16_t usTimer_Now(void)
+{
+	return (uint16_t)__HAL_TIM_GET_COUNTER(&htim11);
+}
+
+/** Runs run delay uS (up to US_TIMER_MAX_DELAY) from now, from the TIM11 interrupt. Replaces whatever slot had pending.
+ * The CC1 interrupt is held off while the slots change, so this can be called from the main context and from callbacks.
+ */
+void usTimer_Schedule(uint8_t slot, uint16_t delay, US_TimerCallback run)
+{
+	if (slot >= US_TIMER_SLOTS)
+		return;
+
+	if (delay > US_TIMER_MAX_DELAY)
+		delay = US_TIMER_MAX_DELAY;
+
+	__HAL_TIM_DISABLE_IT(&htim11, TIM_IT_CC1);
+
+	due[slot] = usTimer_Now() + delay;
+	callback[slot] = run;
+
+	usTimer_Arm();
+}
+
+void usTimer_Cancel(uint8_t slot)
+{
+	if (slot >= US_TIMER_SLOTS)
+		return;
+
+	__HAL_TIM_DISABLE_IT(&htim11, TIM_IT_CC1);
+
+	callback[slot] = NULL;
+
+	usTimer_Arm();
+}
+
+// Runs the callbacks that are due. From the TIM11 CC1 interrupt (see HAL_TIM_OC_DelayElapsedCallback() in mppt.c).
+void usTimer_Service(void)
+{
+	uint16_t now = usTimer_Now();
+	uint16_t late;
+	US_TimerCallback run;
+	uint8_t i;
+
+	for (i = 0; i < US_TIMER_SLOTS; i++)
+	{
+		if ( (callback[i] == NULL) || ((int16_t)(due[i] - now) > 0) )
+			continue;
+
+		late = now - due[i];
+
+		if (late > maxLatency)
+			maxLatency = late;
+
+		// Cleared first, so the callback can schedule the slot again
+		run = callback[i];
+		callback[i] = NULL;
+		run();
+	}
+
+	usTimer_Arm();
+}
+
+// Longest time, in uS, from a deadline to its callback starting
+uint16_t usTimer_GetMaxLatency(void)
+{
+	return maxLatency;
+}
+
+void usTimer_ResetLatency(void)
+{
+	maxLatency = 0;
+}
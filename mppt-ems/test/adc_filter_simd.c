@@ -0,0 +1,69 @@
+/** adc_filter_simd.c
+ * The Cortex-M4 SIMD path of adc_filter.c, built for the host
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * adc_filter.c is compiled a second time here with __ARM_FEATURE_SIMD32 set, and UADD16, USUB16 and SEL replaced
+ * by models of what the instructions do to the registers and the APSR.GE flags (ARMv7-M Architecture Reference
+ * Manual, A7.7.179, A7.7.196 and A7.7.127). Its adcFilter_Run() is renamed adcFilter_RunSimd(), so a test links
+ * both paths and gives them the same bursts.
+ */
+
+#include "stm32f4xx_hal.h"
+
+#include <stdint.h>
+
+static uint8_t simdGE;					// APSR.GE[3:0]
+
+
+// Lane sums modulo 2^16; GE is set per lane on carry, SEL never follows a UADD16 in the filter
+static uint32_t simd_Uadd16(uint32_t a, uint32_t b)
+{
+	uint32_t lo = (a & 0xffff) + (b & 0xffff);
+	uint32_t hi = (a >> 16) + (b >> 16);
+
+	simdGE = ((lo >= 0x10000) ? 0x3 : 0) | ((hi >= 0x10000) ? 0xc : 0);
+
+	return (lo & 0xffff) | (hi << 16);
+}
+
+// Lane differences modulo 2^16; GE is set per lane where the difference is >= 0
+static uint32_t simd_Usub16(uint32_t a, uint32_t b)
+{
+	uint32_t lo = (a & 0xffff) - (b & 0xffff);
+	uint32_t hi = (a >> 16) - (b >> 16);
+
+	simdGE = (((a & 0xffff) >= (b & 0xffff)) ? 0x3 : 0) | (((a >> 16) >= (b >> 16)) ? 0xc : 0);
+
+	return (lo & 0xffff) | (hi << 16);
+}
+
+// Byte n from a where GE[n] is set, from b where it isn't
+static uint32_t simd_Sel(uint32_t a, uint32_t b)
+{
+	uint32_t result = 0;
+	uint8_t n;
+
+	for (n = 0; n < 4; n++)
+		result |= (((simdGE >> n) & 1) ? a : b) & (0xffU << (8 * n));
+
+	return result;
+}
+
+#define __ARM_FEATURE_SIMD32	1
+#define __UADD16				simd_Uadd16
+#define __USUB16				simd_Usub16
+#define __SEL					simd_Sel
+#define adcFilter_Run			adcFilter_RunSimd
+
+#include "../src/adc_filter.c"
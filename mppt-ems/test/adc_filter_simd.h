@@ -0,0 +1,26 @@
+/** adc_filter_simd.h
+ * Header file for the host build of the adc_filter.c SIMD path
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef ADC_FILTER_SIMD_H_
+#define ADC_FILTER_SIMD_H_
+
+#include <stdint.h>
+
+// adcFilter_Run() as the target builds it, with the SIMD instructions modelled (see adc_filter_simd.c)
+void adcFilter_RunSimd(const uint16_t *, uint8_t, uint8_t, uint8_t, uint16_t *);
+
+#endif /* ADC_FILTER_SIMD_H_ */
@@ -0,0 +1,82 @@
+/** bench_adc_filter.c
+ * Host benchmark of the decimation filter (adc_filter.c), plain C lanes against the modelled SIMD path
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Times one half buffer (32 passes of the 4 regular channels, as adc_acq.c filters it) in every mode and prints
+ * ns per burst. The SIMD rows run the instruction models of adc_filter_simd.c, so they show what the mode costs
+ * relative to the others and to the C lanes, not the target's speed (there a SIMD lane operation is one cycle).
+ */
+
+#include "adc_filter.h"
+#include "adc_filter_simd.h"
+#include "adc_acq.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ROUNDS		200000
+#define PASSES		ADC_ACQ_FRAMES_PER_HALF
+#define CHANNELS	ADC_ACQ_REGULAR_CHANNELS
+
+static uint32_t burstWords[PASSES * CHANNELS / 2];
+static volatile uint16_t sink;
+
+static const char *modeName[] = { "mean", "trimmed", "median3", "median5" };
+
+
+static double seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static double timeBursts(void (*run)(const uint16_t *, uint8_t, uint8_t, uint8_t, uint16_t *), uint8_t mode)
+{
+	uint16_t out[CHANNELS];
+	double start = seconds();
+	uint32_t i;
+
+	for (i = 0; i < ROUNDS; i++)
+	{
+		burstWords[i % (PASSES * CHANNELS / 2)] ^= 1;
+		run((const uint16_t *)burstWords, PASSES, CHANNELS, mode, out);
+		sink = out[0];
+	}
+
+	return (seconds() - start) * 1e9 / ROUNDS;
+}
+
+int main(void)
+{
+	uint16_t *burst = (uint16_t *)burstWords;
+	uint8_t mode;
+	uint16_t i;
+
+	for (i = 0; i < PASSES * CHANNELS; i++)
+		burst[i] = rand() % 4096;
+
+	printf("benchmark,ns_per_burst\n");
+
+	for (mode = ADC_FILTER_MEAN; mode <= ADC_FILTER_MEDIAN5; mode++)
+	{
+		printf("filter_%s_c,%.2f\n", modeName[mode], timeBursts(adcFilter_Run, mode));
+		printf("filter_%s_simd_model,%.2f\n", modeName[mode], timeBursts(adcFilter_RunSimd, mode));
+	}
+
+	return 0;
+}
@@ -0,0 +1,276 @@
+/** bench_latency.c
+ * Host benchmark of the interrupt latency around a desulfation pulse train, masked delay_us() against us_timer.c
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A virtual clock in nS runs the main context and three interrupts: the ADC frame (every 655.36 uS, FRAME_ISR_NS),
+ * the 1 mS tick (TICK_ISR_NS), both at priority 0, and TIM11 CC1 (priority 1) for the microsecond timers. An
+ * interrupt that comes due while another runs, or while the main context has them masked, waits; the time from its
+ * due time to its start is its latency. The ISR times are a load in the order of the target's, not measurements.
+ *   masked   pulse() and delay_us() as they were (pulse_ref.h): every spin iteration reads the count and takes
+ *            SPIN_NS, with interrupts masked for the 100 uS of each edge
+ *   timers   pulse() as it is in mppt.c: the first edge from the main context, the other nine from us_timer.c
+ *            (the real one, on the virtual TIM11)
+ * Both run TRAINS pulse trains, each started at another phase of the frame grid. Per path the table gives the worst
+ * and mean frame and tick latency, the time pulse() keeps the main context, the spread of the edge periods (100 uS
+ * nominal), and for the timers the worst deadline to callback time us_timer.c measured itself.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "us_timer.h"
+#include "pulse_ref.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FRAME_NS			655360ULL
+#define TICK_NS				1000000ULL
+#define FRAME_ISR_NS		15000ULL
+#define TICK_ISR_NS			2000ULL
+#define TIM11_ISR_NS		1000ULL
+#define SPIN_NS				50ULL
+#define LOOP_NS				2000ULL
+#define TRAINS				500
+#define TRAIN_GAP_NS		7300000ULL		// Plus TRAIN_STEP_NS more every train, to move along the frame grid
+#define TRAIN_STEP_NS		13000ULL
+#define EDGES				10
+#define NEVER				UINT64_MAX
+
+TIM_HandleTypeDef htim11;
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+} Latency;
+
+static uint64_t nowNs, nextFrame, nextTick;
+static uint64_t tim11Match = NEVER;		// When CC1 matched, while the flag waits for the interrupt
+static Latency frameLatency, tickLatency;
+
+static uint64_t lastEdge;
+static uint64_t minPeriod, maxPeriod;
+static uint8_t edges;
+static bool pinHigh;
+
+static uint8_t pulseEdges;
+
+
+static void clock_Set(uint64_t ns)
+{
+	uint64_t fromUs = nowNs / 1000, toUs = ns / 1000;
+	uint16_t delta = (uint16_t)(TIM11->CCR1 - fromUs);
+
+	// CC1 matches when the count gets to CCR1
+	if ( (tim11Match == NEVER) && (delta != 0) && (delta <= toUs - fromUs) )
+		tim11Match = (fromUs + delta) * 1000;
+
+	nowNs = ns;
+	TIM11->CNT = (uint16_t)toUs;
+}
+
+static void latency_Add(Latency *latency, uint64_t due)
+{
+	uint64_t late = nowNs - due;
+
+	latency->count++;
+	latency->total += late;
+
+	if (late > latency->max)
+		latency->max = late;
+}
+
+// The interrupt that goes next, priority 0 first among those already due, and its due time
+static uint8_t irq_Next(uint64_t *due)
+{
+	uint64_t tim11 = NEVER;
+
+	if (TIM11->DIER & TIM_IT_CC1)
+	{
+		if (TIM11->EGR & TIM_EGR_CC1G)
+			tim11 = nowNs;
+		else
+			tim11 = tim11Match;
+	}
+
+	if ( (nextFrame <= nowNs) || (nextTick <= nowNs) || ((nextFrame <= tim11) && (nextTick <= tim11)) )
+	{
+		*due = (nextFrame <= nextTick) ? nextFrame : nextTick;
+		return (nextFrame <= nextTick) ? 0 : 1;
+	}
+
+	*due = tim11;
+	return 2;
+}
+
+static void irq_Run(uint8_t irq, uint64_t due)
+{
+	if (irq == 0)
+	{
+		latency_Add(&frameLatency, due);
+		nextFrame += FRAME_NS;
+		clock_Set(nowNs + FRAME_ISR_NS);
+	}
+	else if (irq == 1)
+	{
+		latency_Add(&tickLatency, due);
+		nextTick += TICK_NS;
+		clock_Set(nowNs + TICK_ISR_NS);
+	}
+	else
+	{
+		TIM11->EGR &= ~TIM_EGR_CC1G;
+		tim11Match = NEVER;
+		usTimer_Service();
+		clock_Set(nowNs + TIM11_ISR_NS);
+	}
+}
+
+/** The main context works for ns. Interrupts come in on the way, unless they are masked: then the clock just moves,
+ * and they wait for the next time the main context works with them unmasked.
+ */
+static void cpu(uint64_t ns)
+{
+	uint64_t end = nowNs + ns, due, start;
+	uint8_t irq;
+
+	while (!__get_PRIMASK())
+	{
+		irq = irq_Next(&due);
+
+		if (due > end)
+			break;
+
+		if (due > nowNs)
+			clock_Set(due);
+
+		start = nowNs;
+		irq_Run(irq, due);
+		end += nowNs - start;
+	}
+
+	clock_Set(end);
+}
+
+uint32_t ref_Counter(void)
+{
+	cpu(SPIN_NS);
+
+	return TIM11->CNT;
+}
+
+// An edge of the train on PB11
+static void pin_Watch(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+	uint64_t period;
+
+	if ( (port != GPIOB) || (pin != GPIO_PIN_11) || ((state == GPIO_PIN_SET) == pinHigh) )
+		return;
+
+	pinHigh = (state == GPIO_PIN_SET);
+
+	if (edges > 0)
+	{
+		period = nowNs - lastEdge;
+
+		if (period < minPeriod)
+			minPeriod = period;
+
+		if (period > maxPeriod)
+			maxPeriod = period;
+	}
+
+	lastEdge = nowNs;
+	edges++;
+}
+
+// pulse() and its edges, as in mppt.c
+static void pulseEdge(void)
+{
+	if (pulseEdges < 10)
+	{
+		HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_11);
+		pulseEdges++;
+
+		usTimer_Schedule(US_TIMER_PULSE, 100, pulseEdge);
+	}
+	else
+	{
+		HAL_GPIO_WritePin(GPIOB, GPIO_PIN_11, GPIO_PIN_RESET);
+		HAL_GPIO_WritePin(GPIOB, GPIO_PIN_10, GPIO_PIN_SET);
+	}
+}
+
+static void pulse(void)
+{
+	HAL_GPIO_WritePin(GPIOB, GPIO_PIN_10, GPIO_PIN_RESET);
+
+	pulseEdges = 0;
+	pulseEdge();
+}
+
+static void run(const char *path, void (*train)(void))
+{
+	uint64_t blocked = 0, start, gap;
+	uint32_t k, short_trains = 0;
+
+	nowNs = 0;
+	nextFrame = FRAME_NS;
+	nextTick = TICK_NS;
+	tim11Match = NEVER;
+	memset(&frameLatency, 0, sizeof(frameLatency));
+	memset(&tickLatency, 0, sizeof(tickLatency));
+	minPeriod = NEVER;
+	maxPeriod = 0;
+
+	usTimer_Init();
+
+	for (k = 0; k < TRAINS; k++)
+	{
+		// The main loop goes round until the train is due
+		for (gap = 0; gap < TRAIN_GAP_NS + k * TRAIN_STEP_NS; gap += LOOP_NS)
+			cpu(LOOP_NS);
+
+		edges = 0;
+		start = nowNs;
+		train();
+		blocked += nowNs - start;
+
+		// And carries on while the timers finish the train
+		for (gap = 0; gap < 2 * EDGES * 100000ULL; gap += LOOP_NS)
+			cpu(LOOP_NS);
+
+		if (edges != EDGES)
+			short_trains++;
+	}
+
+	printf("%s,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%u\n", path, TRAINS, frameLatency.max / 1e3,
+		(double)frameLatency.total / frameLatency.count / 1e3, tickLatency.max / 1e3,
+		(double)tickLatency.total / tickLatency.count / 1e3, (double)blocked / TRAINS / 1e3, minPeriod / 1e3,
+		maxPeriod / 1e3, (train == pulse) ? usTimer_GetMaxLatency() : 0, short_trains);
+}
+
+int main(void)
+{
+	htim11.Instance = TIM11;
+	host_SetPinWatcher(pin_Watch);
+
+	printf("path,trains,frame_max_us,frame_mean_us,tick_max_us,tick_mean_us,pulse_call_us,edge_min_us,edge_max_us,"
+		"timer_latency_us,short_trains\n");
+
+	run("masked", refPulse);
+	run("timers", pulse);
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+/** bench_measure.c
+ * Host benchmark of the fixed point measurement conversions (measure.c) against the original double formulas
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Times the eight conversions getADCreadings() makes per frame, both ways, and prints ns per frame set.
+ * The host has a double precision FPU, so the ratio here understates the target's, where every double operation
+ * is a library call (the cycle counts on the target come from the PROF_GET_ADC_READINGS probe).
+ */
+
+#include "measure.h"
+#include "measure_ref.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define ROUNDS		2000000
+
+static volatile int32_t sinkInt;
+static volatile double sinkDouble;
+
+
+static double seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// One frame's worth of conversions, as getADCreadings() does them
+static __attribute__((noinline)) void fixedFrame(uint16_t counts)
+{
+	sinkInt = calcVoltage(counts, 2);
+	sinkInt = calcVoltage(counts + 1, 2);
+	sinkInt = calcCurrent(counts + 2);
+	sinkInt = calcCurrent(counts + 3);
+	sinkInt = calcVoltage(counts + 4, 1);
+	sinkInt = calcTemperature(counts + 5);
+	sinkInt = calcTemperature(counts + 6);
+	sinkInt = calcCurrent(counts + 7);
+}
+
+static __attribute__((noinline)) void doubleFrame(uint16_t counts)
+{
+	sinkDouble = refVoltage(counts, 2);
+	sinkDouble = refVoltage(counts + 1, 2);
+	sinkDouble = refCurrent(counts + 2);
+	sinkDouble = refCurrent(counts + 3);
+	sinkDouble = refVoltage(counts + 4, 1);
+	sinkDouble = refTemperature(counts + 5);
+	sinkDouble = refTemperature(counts + 6);
+	sinkDouble = refCurrent(counts + 7);
+}
+
+static double timeFrames(void (*frame)(uint16_t))
+{
+	double start = seconds();
+	uint32_t i;
+
+	for (i = 0; i < ROUNDS; i++)
+		frame(i & 4087);
+
+	return (seconds() - start) * 1e9 / ROUNDS;
+}
+
+int main(void)
+{
+	double fixed, reference;
+
+	fixed = timeFrames(fixedFrame);
+	reference = timeFrames(doubleFrame);
+
+	printf("benchmark,ns_per_frame\n");
+	printf("measure_fixed,%.2f\n", fixed);
+	printf("measure_double,%.2f\n", reference);
+
+	return 0;
+}
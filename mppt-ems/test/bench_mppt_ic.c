@@ -0,0 +1,82 @@
+/** bench_mppt_ic.c
+ * Host benchmark of the integer incremental conductance step (mppt_ic.c) against the floating point one it replaced
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Both steps run over the same measurements, taken from the array model (pv_model.c) with a count of ADC noise around
+ * its MPP, and the benchmark prints ns per step. The target's FPU does the float division in 14 cycles, so the two
+ * divisions of the old step cost about as much there as the rest of it; the host's divider is faster, and the
+ * ratio here understates the difference (the cycle counts on the target come from the PROF_MPPT_STEP probe).
+ */
+
+#include "mppt_strategy.h"
+#include "mppt_ic_ref.h"
+#include "converter.h"
+#include "pv_model.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define ROUNDS		4000000
+#define POINTS		1024
+#define VBAT		12800
+
+static MPPT_Measurement point[POINTS];
+static volatile int32_t sink;
+
+
+static double seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static double timeSteps(void (*init)(const MPPT_Measurement *, uint16_t),
+	int32_t (*step)(const MPPT_Measurement *, uint16_t))
+{
+	uint16_t duty = DUTY_FINE(220);
+	double start;
+	uint32_t i;
+
+	init(&point[0], duty);
+	start = seconds();
+
+	for (i = 0; i < ROUNDS; i++)
+	{
+		sink = step(&point[i % POINTS], duty);
+		duty = DUTY_FINE(220) + (i & 15);
+	}
+
+	return (seconds() - start) * 1e9 / ROUNDS;
+}
+
+int main(void)
+{
+	uint16_t best, i;
+
+	pv_SetIrradiance(1000);
+	pv_BestDuty(VBAT, &best);
+	pv_SetNoise(6, 8);
+
+	for (i = 0; i < POINTS; i++)
+		pv_Operate(best + (i % 9) - 4, VBAT, &point[i]);
+
+	printf("benchmark,ns_per_step\n");
+	printf("ic_integer,%.2f\n", timeSteps(mpptIC.init, mpptIC.step));
+	printf("ic_float,%.2f\n", timeSteps(refIc_Init, refIc_Step));
+
+	return 0;
+}
@@ -0,0 +1,194 @@
+/** bench_mppt_profiles.c
+ * Host benchmark of every MPPT strategy over a library of irradiance profiles, scored by the on-target counters
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every strategy is stepped the way calcMPPT() does it, a step per frame, against the array model (pv_model.c) with
+ * the converter in steady state after every step. A profile is a list of segments, each holding or ramping the
+ * irradiance (in whole W/m2), or putting a shadow on some of the array's bypass groups:
+ *   static_low, static_high    a fixed level
+ *   en50530_low_N              100 -> 500 -> 100 W/m2 at N W/m2/S, with dwells, after the EN 50530 dynamic test
+ *   en50530_high_N             300 -> 1000 -> 300 W/m2 at N W/m2/S
+ *   cloud_edges                1000 <-> 200 W/m2 in 0.1 S, twice
+ *   partial_shading            a shadow over 3, then 6, of the 9 groups, which leaves the array a local maximum
+ * The figures are the ones the target reports for CMD_BENCHMARK, from the same counters (mppt_bench.c), with the best
+ * power any duty cycle gets as the available power and a convergence timed from every segment start: tracking
+ * efficiency, mean convergence time (and how many of the segments converged) and the mean step to step power change.
+ * The last column is the ripple over the second half of the dwells only, where the irradiance is not moving.
+ * The table is CSV, one row per profile and strategy.
+ */
+
+#include "mppt_strategy.h"
+#include "mppt_bench.h"
+#include "converter.h"
+#include "measure.h"
+#include "pv_model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define STEP_US			655			// MPPT_CONTROL_STEP_US in mppt.c
+#define VBAT			12800
+#define MAX_IRRADIANCE	1000
+#define MAX_SEGMENTS	8
+
+typedef struct
+{
+	double from;					// W/m2 at the start and the end of the segment
+	double to;
+	double seconds;
+	const double *shading;			// PV_GROUPS irradiances instead, or NULL
+} Segment;
+
+typedef struct
+{
+	const char *name;
+	Segment segment[MAX_SEGMENTS];
+} Profile;
+
+static const double shade3[PV_GROUPS] = { 1000, 1000, 1000, 1000, 1000, 1000, 300, 300, 300 };
+static const double shade6[PV_GROUPS] = { 1000, 1000, 1000, 300, 300, 300, 300, 300, 300 };
+
+#define HOLD(level, s)		{ level, level, s, NULL }
+#define RAMP(a, b, slope)	{ a, b, (((b) > (a)) ? (b) - (a) : (a) - (b)) / (double)(slope), NULL }
+#define EN50530(low, high, slope) \
+	{ HOLD(low, 2), RAMP(low, high, slope), HOLD(high, 2), RAMP(high, low, slope), HOLD(low, 2) }
+
+static const Profile profiles[] =
+{
+	{ "static_low", { HOLD(100, 3) } },
+	{ "static_high", { HOLD(1000, 3) } },
+	{ "en50530_low_10", EN50530(100, 500, 10) },
+	{ "en50530_low_50", EN50530(100, 500, 50) },
+	{ "en50530_high_10", EN50530(300, 1000, 10) },
+	{ "en50530_high_50", EN50530(300, 1000, 50) },
+	{ "en50530_high_100", EN50530(300, 1000, 100) },
+	{ "cloud_edges", { HOLD(1000, 2), RAMP(1000, 200, 8000), HOLD(200, 3), RAMP(200, 1000, 8000), HOLD(1000, 3),
+		RAMP(1000, 200, 8000), HOLD(200, 3), RAMP(200, 1000, 8000) } },
+	{ "partial_shading", { HOLD(1000, 2), { 0, 0, 5, shade3 }, { 0, 0, 5, shade6 }, HOLD(1000, 3) } },
+};
+
+static const char *strategyName[MPPT_STRATEGY_COUNT] = { "po", "ti", "ic", "cv", "vpo" };
+
+static int32_t availableAt[MAX_IRRADIANCE + 1];		// Best power (mW) at a uniform irradiance, 0: not worked out yet
+
+
+// calcMPPT()'s limits on a duty command
+static uint16_t limit(int32_t command)
+{
+	if (command >= DUTY_FINE(MAX_DUTY_CYCLE))
+		return DUTY_FINE(MAX_DUTY_CYCLE);
+
+	if (command <= DUTY_FINE(MIN_DUTY_CYCLE))
+		return DUTY_FINE(MIN_DUTY_CYCLE);
+
+	return command;
+}
+
+// Sets the uniform irradiance and returns the best power any duty cycle gets there, worked out once per level
+static int32_t uniform(uint16_t irradiance)
+{
+	uint16_t best;
+
+	pv_SetIrradiance(irradiance);
+
+	if (availableAt[irradiance] == 0)
+		availableAt[irradiance] = pv_BestDuty(VBAT, &best);
+
+	return availableAt[irradiance];
+}
+
+static void run(const Profile *profile, uint8_t strategy)
+{
+	const Segment *segment;
+	MPPT_Measurement m;
+	MPPT_BenchRecord record;
+	uint16_t duty = DUTY_FINE(MIN_DUTY_CYCLE + 2), best;
+	uint32_t step, steps, events = 0, steadySteps = 0;
+	int32_t available = uniform(profile->segment[0].from), power, lastPower = -1;
+	uint64_t steadyChange = 0;
+	uint8_t k;
+
+	mpptStrategy_Select(strategy);
+	pv_Operate(duty, VBAT, &m);
+	mpptStrategy_Init(&m, duty);
+
+	mpptBench_Reset();
+
+	for (k = 0; k < MAX_SEGMENTS; k++)
+	{
+		segment = &profile->segment[k];
+		steps = (uint32_t)lround(segment->seconds * 1e6 / STEP_US);
+
+		if (steps == 0)
+			break;
+
+		if (segment->shading != NULL)
+		{
+			pv_SetShading(segment->shading);
+			available = pv_BestDuty(VBAT, &best);
+		}
+
+		mpptBench_Start();
+		events++;
+
+		for (step = 0; step < steps; step++)
+		{
+			if (segment->shading == NULL)
+				available = uniform((uint16_t)lround(segment->from + (segment->to - segment->from) * step / steps));
+
+			duty = limit(mpptStrategy_Step(&m, duty));
+			pv_Operate(duty, VBAT, &m);
+
+			power = calcPower(m.vSolar, m.iSolar);
+
+			mpptBench_SetPeak(available);
+			mpptBench_Step(strategy, power);
+
+			if ( (segment->from == segment->to) && (step >= steps / 2) )
+			{
+				if (step > steps / 2)
+				{
+					steadyChange += abs(power - lastPower);
+					steadySteps++;
+				}
+
+				lastPower = power;
+			}
+		}
+	}
+
+	mpptBench_Get(strategy, &record);
+
+	printf("%s,%s,%u,%.2f,%.1f,%u,%u,%.0f,%.0f\n", profile->name, strategyName[strategy], record.steps,
+		(record.available != 0) ? 100.0 * record.energy / record.available : 0,
+		(record.converged != 0) ? (double)record.convergeSteps * STEP_US / 1000 / record.converged : -1.0,
+		record.converged, events, (record.steps > 1) ? (double)record.ripple / (record.steps - 1) : 0,
+		(steadySteps != 0) ? (double)steadyChange / steadySteps : 0);
+}
+
+int main(void)
+{
+	uint8_t p, s;
+
+	printf("profile,strategy,steps,efficiency_pct,convergence_ms,converged,segments,ripple_mw,steady_ripple_mw\n");
+
+	for (p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++)
+	{
+		for (s = 0; s < MPPT_STRATEGY_COUNT; s++)
+			run(&profiles[p], s);
+	}
+
+	return 0;
+}
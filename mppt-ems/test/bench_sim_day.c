@@ -0,0 +1,136 @@
+/** bench_sim_day.c
+ * Host benchmark of a whole day of charging: the firmware (mppt.c) on the virtual clock (sim_host.c), sunrise to sunset
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A clear day from SUNRISE_H to SUNSET_H: the irradiance follows sin^1.5 of the sun's way across the sky, up to
+ * 1000 W/m2 at noon, and the ambient temperature goes from AMBIENT_LOW_C up to AMBIENT_HIGH_C and back. Both change a
+ * minute at a time, and the array's MPP power is worked out for every minute. The battery starts at rest at
+ * START_SOC. Printed are
+ *   the trajectory   every TRAJECTORY_S: stage, duty cycle, battery and array voltage, charge current
+ *   the stages       the time the firmware spent in every CHARGE_x stage, and when it first got there
+ *   the summary      the energy the array could have given, and what it gave; the tracking efficiency, over the
+ *                    seconds the MPPT ran without the regulator holding it back; when the battery got to the
+ *                    absorption voltage and when it had held it for ADSORPTION_TIME_FLOODED; and the host CPU time
+ * The firmware runs every frame of the day, so the run takes a couple of minutes.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "sim_host.h"
+#include "pv_model.h"
+#include "mppt.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#define SUNRISE_H			6
+#define SUNSET_H			20
+#define AMBIENT_LOW_C		15.0
+#define AMBIENT_HIGH_C		25.0
+#define START_SOC			0.5
+#define TRAJECTORY_S		600
+#define TARGET_BAND_MV		30
+#define STAGES				(CHARGE_BYPASS + 1)
+
+extern uint8_t chargeState;
+extern uint16_t dutyApplied;
+extern volatile bool regulating;
+extern bool adsorptionComplete;
+int32_t AdsorptionVoltage(int32_t);
+
+static const char *stageName[STAGES] = { "off", "dark", "desulfate", "idle", "wait", "start", "mppt", "bypass" };
+
+static double irradiance, ambient, mppWatts;
+static double availableWh, trackedWh, trackedAvailableWh, lastArrayWh;
+static uint32_t stageSeconds[STAGES], stageFirst[STAGES];
+static uint32_t absorptionAt, completeAt;
+
+
+// The sky for the minute starting s seconds after sunrise
+static void sky(uint32_t s)
+{
+	double x = s / (3600.0 * (SUNSET_H - SUNRISE_H)), volts;
+
+	irradiance = ((x > 0) && (x < 1)) ? 1000 * pow(sin(M_PI * x), 1.5) : 0;
+	ambient = AMBIENT_LOW_C + (AMBIENT_HIGH_C - AMBIENT_LOW_C) * sin(M_PI * x);
+
+	plant_SetSky(irradiance, ambient);
+	mppWatts = (irradiance > 0) ? pv_MaxPower(&volts) : 0;
+}
+
+static void second(uint32_t s)
+{
+	const PLANT_Readings *r = sim_Readings();
+	double arrayWh = plant_ArrayWh();
+
+	// The second that just ended
+	availableWh += mppWatts / 3600;
+
+	if ( (chargeState == CHARGE_MPPT) && !regulating )
+	{
+		trackedWh += arrayWh - lastArrayWh;
+		trackedAvailableWh += mppWatts / 3600;
+	}
+
+	lastArrayWh = arrayWh;
+
+	if (stageSeconds[chargeState] == 0)
+		stageFirst[chargeState] = s;
+
+	stageSeconds[chargeState]++;
+
+	if ( (absorptionAt == 0) && (r->vBat >= AdsorptionVoltage(r->ambient) - TARGET_BAND_MV) )
+		absorptionAt = s;
+
+	if ( (completeAt == 0) && adsorptionComplete )
+		completeAt = s;
+
+	if (s % TRAJECTORY_S == 0)
+		printf("%.2f,%s,%u,%d,%d,%d,%.0f,%.3f\n", SUNRISE_H + s / 3600.0, stageName[chargeState], dutyApplied,
+			r->vBat, r->vSolar, r->iBat, irradiance, plant_StateOfCharge());
+
+	if (s % 60 == 0)
+		sky(s);
+}
+
+// Hours of the day, for a time in seconds after sunrise (0 for never)
+static double hours(uint32_t s)
+{
+	return (s == 0) ? 0 : SUNRISE_H + s / 3600.0;
+}
+
+int main(void)
+{
+	clock_t start = clock();
+	uint8_t k;
+
+	plant_Init(START_SOC, AMBIENT_LOW_C);
+	sky(0);
+
+	printf("time_h,stage,duty,vbat_mv,vsolar_mv,ibat_ma,irradiance,soc\n");
+
+	sim_Run((SUNSET_H - SUNRISE_H) * 3600 * 1000, second);
+
+	printf("stage,seconds,first_h\n");
+
+	for (k = 0; k < STAGES; k++)
+		printf("%s,%u,%.2f\n", stageName[k], stageSeconds[k], hours(stageFirst[k]));
+
+	printf("available_wh,array_wh,charge_wh,tracking_pct,absorption_h,absorption_done_h,soc_end,frames,cpu_s\n");
+	printf("%.1f,%.1f,%.1f,%.2f,%.2f,%.2f,%.3f,%u,%.1f\n", availableWh, plant_ArrayWh(), plant_ChargeWh(),
+		100 * trackedWh / trackedAvailableWh, hours(absorptionAt), hours(completeAt), plant_StateOfCharge(),
+		sim_Frames(), (double)(clock() - start) / CLOCKS_PER_SEC);
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+/** buck_model.c
+ * Host model of the buck converter dynamics between the solar array and the battery
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * pv_Operate() puts the array where the converter settles. This model gets there the way the power stage does:
+ * the state space average of the synchronous buck over a PWM period, integrated every BUCK_STEP_S,
+ *   C dVin/dt = Ipv(Vin) - d * iL
+ *   L diL/dt  = d * Vin - Vbat - R * iL
+ * with the array current from pv_model.c and the battery as its open circuit voltage behind R0 and an R1 || C1 pair,
+ * Vbat = Voc + R0 * iL + V1, C1 dV1/dt = iL - V1 / R1. d is the duty cycle in 1/16 counts over 16 * TIM1_PERIOD,
+ * the average the dithering (pwm_dither.c) gives. The PWM ripple itself is averaged out, as the ADC frames average it.
+ * Duty 0 is the converter off: no inductor current, and the array charges the input capacitor towards open circuit.
+ */
+
+#include "buck_model.h"
+#include "pv_model.h"
+#include "converter.h"
+
+#include <math.h>
+
+static double vIn;
+static double iL;
+static double v1;
+static double batteryVoc = 12.8;
+static double r0 = BUCK_BATTERY_R0;
+static double r1 = BUCK_BATTERY_R1;
+static double c1 = BUCK_BATTERY_C1;
+
+
+// Starts the converter off, with the input capacitor at vArray and the battery at rest at vBattery (V)
+void buck_Init(double vArray, double vBattery)
+{
+	vIn = vArray;
+	iL = 0;
+	v1 = 0;
+	batteryVoc = vBattery;
+}
+
+// The battery: open circuit voltage (V), series resistance and RC pair (Ohm, Ohm, F). c = 0 leaves out the pair.
+void buck_SetBattery(double voc, double rSeries, double rPolarization, double cPolarization)
+{
+	batteryVoc = voc;
+	r0 = rSeries;
+	r1 = rPolarization;
+	c1 = cPolarization;
+
+	if (c1 == 0)
+		v1 = 0;
+}
+
+// Moves the battery's open circuit voltage, as its state of charge changes
+void buck_SetOpenCircuit(double voc)
+{
+	batteryVoc = voc;
+}
+
+/** Runs the converter at duty (1/16 counts) for seconds, and returns the averages over that time in m,
+ * as an ADC frame gives them: array voltage and current, battery voltage and charge current.
+ */
+void buck_Run(uint16_t duty, double seconds, MPPT_Measurement *m)
+{
+	double d = duty / (double)DUTY_FINE(TIM1_PERIOD);
+	double sumVin = 0, sumIpv = 0, sumVbat = 0, sumIl = 0;
+	double iPv, vBat;
+	uint32_t steps = (uint32_t)lround(seconds / BUCK_STEP_S), k;
+
+	for (k = 0; k < steps; k++)
+	{
+		iPv = (vIn > 0) ? pv_Current(vIn) : pv_Current(0);
+		vBat = batteryVoc + r0 * iL + v1;
+
+		// Semi-implicit Euler: the inductor first, the capacitors from its new current
+		if (duty == 0)
+			iL = 0;
+		else
+			iL += (d * vIn - vBat - BUCK_RESISTANCE * iL) * BUCK_STEP_S / BUCK_INDUCTANCE;
+
+		vIn += (iPv - d * iL) * BUCK_STEP_S / BUCK_INPUT_CAPACITANCE;
+
+		if (c1 > 0)
+			v1 += (iL - v1 / r1) * BUCK_STEP_S / c1;
+
+		sumVin += vIn;
+		sumIpv += iPv;
+		sumVbat += vBat;
+		sumIl += iL;
+	}
+
+	if (steps == 0)
+		steps = 1;
+
+	m->vSolar = (int32_t)lround(sumVin * 1000 / steps);
+	m->iSolar = (int32_t)lround(sumIpv * 1000 / steps);
+	m->vBat = (int32_t)lround(sumVbat * 1000 / steps);
+	m->iBat = (int32_t)lround(sumIl * 1000 / steps);
+}
+
+double buck_ArrayVoltage(void)
+{
+	return vIn;
+}
+
+double buck_BatteryVoltage(void)
+{
+	return batteryVoc + r0 * iL + v1;
+}
+
+double buck_InductorCurrent(void)
+{
+	return iL;
+}
@@ -0,0 +1,46 @@
+/** buck_model.h
+ * Header file for the host model of the buck converter dynamics between the solar array and the battery
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef BUCK_MODEL_H_
+#define BUCK_MODEL_H_
+
+#include <stdint.h>
+
+#include "mppt_strategy.h"
+
+// The power stage: input capacitance across the array, the inductor and the resistance in its path
+#define BUCK_INPUT_CAPACITANCE	470e-6		// F
+#define BUCK_INDUCTANCE			22e-6		// H
+#define BUCK_RESISTANCE			0.02		// Ohm, inductor and switches
+#define BUCK_STEP_S				2e-6		// Integration step
+
+/** The battery: open circuit voltage, series resistance and one RC pair for the polarization.
+ * A 100 Ah flooded 12 V battery is about 5 mOhm in series with 10 mOhm || 2000 F.
+ */
+#define BUCK_BATTERY_R0			0.005		// Ohm
+#define BUCK_BATTERY_R1			0.010		// Ohm
+#define BUCK_BATTERY_C1			2000.0		// F
+
+void buck_Init(double, double);
+void buck_SetBattery(double, double, double, double);
+void buck_SetOpenCircuit(double);
+void buck_Run(uint16_t, double, MPPT_Measurement *);
+double buck_ArrayVoltage(void);
+double buck_BatteryVoltage(void);
+double buck_InductorCurrent(void);
+
+#endif /* BUCK_MODEL_H_ */
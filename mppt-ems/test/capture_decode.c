@@ -0,0 +1,81 @@
+/** capture_decode.c
+ * Source file for the host decoder of the ADC frame capture (MSG_CAPTURE)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * sendCapture() in mppt.c sends up to CAPTURE_PER_FRAME records a frame: the records dropped so far and the record
+ * count, then 21 bytes per record, LSB first: frame number (2), tick (4), the 8 channels packed two 12 bit counts to
+ * 3 bytes (12), duty cycle in 1/16 counts (2) and the CAPTURE_x flags (1).
+ */
+
+#include "capture_decode.h"
+#include "frame_decode.h"
+
+#define MSG_CAPTURE			0x97	// As in mppt.h
+#define RECORD_BYTES		21
+
+
+static void captureFrame(const uint8_t *frame, uint8_t length, void *context)
+{
+	CAPTURE_Decoded *out = context;
+	const uint8_t *p = &frame[FRAME_PAYLOAD];
+	CAPTURE_Record *record;
+	uint32_t pair;
+	uint8_t count, i, ch;
+
+	if ( (frame[FRAME_TYPE] != MSG_CAPTURE) || (length < FRAME_PAYLOAD + 3) )
+		return;
+
+	count = p[2];
+
+	if (length != FRAME_PAYLOAD + 3 + RECORD_BYTES * count)
+	{
+		out->broken++;
+		return;
+	}
+
+	out->dropped = p[0] | (p[1] << 8);
+	p += 3;
+
+	for (i = 0; (i < count) && (out->count < out->max); i++, p += RECORD_BYTES)
+	{
+		record = &out->record[out->count++];
+
+		record->frame = p[0] | (p[1] << 8);
+		record->tick = p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t)p[5] << 24);
+
+		for (ch = 0; ch < ADC_ACQ_CHANNELS; ch += 2)
+		{
+			pair = p[6 + 3 * ch / 2] | (p[7 + 3 * ch / 2] << 8) | ((uint32_t)p[8 + 3 * ch / 2] << 16);
+			record->channel[ch] = pair & 0x0fff;
+			record->channel[ch + 1] = pair >> 12;
+		}
+
+		record->duty = p[18] | (p[19] << 8);
+		record->flags = p[20];
+	}
+}
+
+// Decodes every capture record in length bytes received from the controller into out, up to out->max of them
+void captureDecode_Stream(const uint8_t *stream, uint32_t length, CAPTURE_Decoded *out)
+{
+	FRAME_Counts counts;
+
+	out->count = 0;
+	out->dropped = 0;
+	out->broken = 0;
+
+	frame_Split(stream, length, captureFrame, out, &counts);
+
+	out->broken += counts.badFrames;
+}
@@ -0,0 +1,36 @@
+/** capture_decode.h
+ * Header file for the host decoder of the ADC frame capture (MSG_CAPTURE)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef CAPTURE_DECODE_H_
+#define CAPTURE_DECODE_H_
+
+#include <stdint.h>
+
+#include "capture.h"
+
+typedef struct
+{
+	CAPTURE_Record *record;			// Room for max records, filled in the order they arrived
+	uint32_t max;
+	uint32_t count;
+	uint16_t dropped;				// Records the controller dropped, as of its last frame
+	uint32_t broken;				// Frames with a bad CRC or a bad length
+} CAPTURE_Decoded;
+
+void captureDecode_Stream(const uint8_t *, uint32_t, CAPTURE_Decoded *);
+
+#endif /* CAPTURE_DECODE_H_ */
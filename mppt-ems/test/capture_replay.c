@@ -0,0 +1,55 @@
+/** capture_replay.c
+ * Host tool that replays a USART1 capture of ADC frames through the firmware and diffs its decisions
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ *   build/capture_replay < capture.bin > diff.csv
+ *
+ * Reads the raw bytes received after CMD_CAPTURE (e.g. saved by a serial terminal), replays the records in them
+ * through the firmware on the virtual clock (replay.c), and writes the records whose duty cycle or flags came out
+ * differently, then the summary row. Capture a burst, or stream with a decimation of 1 and no records dropped, to
+ * replay frame for frame. Exits with 1 if there were no records, 2 if the replay differed.
+ */
+
+#include "capture_decode.h"
+#include "replay.h"
+
+#include <stdlib.h>
+
+#define MAX_CAPTURE		(1024 * 1024)
+
+int main(void)
+{
+	static uint8_t capture[MAX_CAPTURE];
+	static CAPTURE_Record records[MAX_CAPTURE / 21];
+	CAPTURE_Decoded decoded = { records, MAX_CAPTURE / 21 };
+	REPLAY_Diff diff;
+	size_t length;
+
+	length = fread(capture, 1, sizeof(capture), stdin);
+	captureDecode_Stream(capture, length, &decoded);
+
+	if (decoded.count == 0)
+	{
+		fprintf(stderr, "no capture records in %lu bytes (%u broken)\n", (unsigned long)length, decoded.broken);
+		return 1;
+	}
+
+	if ( (decoded.dropped != 0) || (decoded.broken != 0) )
+		fprintf(stderr, "%u records dropped, %u frames broken: the replay has gaps\n", decoded.dropped, decoded.broken);
+
+	replay_Run(records, decoded.count, stdout, &diff);
+	replay_WriteSummary(&diff, stdout);
+
+	return (diff.first == diff.records) ? 0 : 2;
+}
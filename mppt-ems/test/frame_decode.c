@@ -0,0 +1,136 @@
+/** frame_decode.c
+ * Source file for the host decoder of the frames the controller sends over USART1
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Undoes sendFrame() in mppt.c. A frame starts with 0x9a, which appears nowhere else: inside a frame 0x9a is sent as
+ * 0x9b 0x01 and 0x9b as 0x9b 0x02. The last two bytes are the crc16() of everything before them, seeded with 0xffff,
+ * LSB first. There is no end marker, so a frame ends where the next one starts, or at the end of the capture. Text
+ * the controller sends between frames (the DEBUG2 lines in mppt.c) ends up behind the frame before it, so a frame that
+ * doesn't check out is cut at the shortest length whose CRC does, if there is one.
+ */
+
+#include "frame_decode.h"
+
+#include <stdbool.h>
+
+extern void crc16_init(void);
+extern uint16_t crc16(uint8_t[], uint8_t, uint16_t);
+
+static bool crcReady;
+
+
+static bool crcMatches(const uint8_t *frame, uint16_t length)
+{
+	uint16_t crc = crc16((uint8_t *)frame, length - 2, 0xffff);
+
+	return (frame[length - 2] == (crc & 0xff)) && (frame[length - 1] == (crc >> 8));
+}
+
+static void finish(uint8_t *frame, uint16_t length, bool bad, FRAME_Handler handler, void *context, FRAME_Counts *counts)
+{
+	uint16_t cut;
+
+	if ( bad || (length > FRAME_MAX_LENGTH) || (length < FRAME_PAYLOAD + 2) || !crcMatches(frame, length) )
+	{
+		for (cut = FRAME_PAYLOAD + 2; cut < length; cut++)
+		{
+			if (crcMatches(frame, cut))
+				break;
+		}
+
+		if (cut >= length)
+		{
+			counts->badFrames++;
+			return;
+		}
+
+		counts->skipped += length - cut;
+		length = cut;
+	}
+
+	counts->frames++;
+	handler(frame, length - 2, context);
+}
+
+/** Splits length bytes received from the controller into frames, and calls handler with every frame that checks out,
+ * unescaped and without its CRC. counts gets the totals.
+ */
+void frame_Split(const uint8_t *stream, uint32_t length, FRAME_Handler handler, void *context, FRAME_Counts *counts)
+{
+	uint8_t frame[FRAME_MAX_LENGTH + 1];
+	uint16_t used = 0;
+	uint32_t i;
+	bool inFrame = false, escape = false, bad = false;
+
+	if (!crcReady)
+	{
+		crc16_init();
+		crcReady = true;
+	}
+
+	counts->frames = 0;
+	counts->badFrames = 0;
+	counts->skipped = 0;
+
+	for (i = 0; i < length; i++)
+	{
+		if (stream[i] == 0x9a)
+		{
+			if (inFrame)
+				finish(frame, used, bad || escape, handler, context, counts);
+
+			inFrame = true;
+			escape = false;
+			bad = false;
+			frame[0] = 0x9a;
+			used = 1;
+			continue;
+		}
+
+		if (!inFrame)
+		{
+			counts->skipped++;
+			continue;
+		}
+
+		if (escape)
+		{
+			escape = false;
+
+			if (stream[i] == 0x01)
+				frame[used] = 0x9a;
+			else if (stream[i] == 0x02)
+				frame[used] = 0x9b;
+			else
+				bad = true;
+		}
+		else if (stream[i] == 0x9b)
+		{
+			escape = true;
+			continue;
+		}
+		else
+		{
+			frame[used] = stream[i];
+		}
+
+		if (used < FRAME_MAX_LENGTH)
+			used++;
+		else
+			bad = true;
+	}
+
+	if (inFrame)
+		finish(frame, used, bad || escape, handler, context, counts);
+}
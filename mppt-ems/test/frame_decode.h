@@ -0,0 +1,43 @@
+/** frame_decode.h
+ * Header file for the host decoder of the frames the controller sends over USART1
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef FRAME_DECODE_H_
+#define FRAME_DECODE_H_
+
+#include <stdint.h>
+
+// Longest frame sendFrame() sends, before escaping and with the CRC
+#define FRAME_MAX_LENGTH	130
+
+// Offsets in a decoded frame
+#define FRAME_START			0		// 0x9a
+#define FRAME_VERSION		1		// 4 characters
+#define FRAME_TYPE			5		// MSG_x
+#define FRAME_PAYLOAD		6
+
+typedef struct
+{
+	uint32_t frames;				// Frames with a good CRC
+	uint32_t badFrames;				// Frames with a bad CRC or a bad escape, or too long
+	uint32_t skipped;				// Bytes before the first start byte, or cut off behind a frame
+} FRAME_Counts;
+
+typedef void (*FRAME_Handler)(const uint8_t *frame, uint8_t length, void *context);
+
+void frame_Split(const uint8_t *, uint32_t, FRAME_Handler, void *, FRAME_Counts *);
+
+#endif /* FRAME_DECODE_H_ */
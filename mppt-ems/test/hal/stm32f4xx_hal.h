@@ -0,0 +1,28 @@
+/** stm32f4xx_hal.h
+ * Host build stand-in for the HAL header
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The host tests build the firmware sources unchanged. test/hal comes first on the include path, so their
+ * #include "stm32f4xx_hal.h" lands here: the real HAL header supplies the types, register bits and macros,
+ * and hal_host.h moves the peripherals into host memory and replaces the Cortex-M intrinsics.
+ */
+
+// Prevent recursive inclusion
+#ifndef HOST_STM32F4XX_HAL_H_
+#define HOST_STM32F4XX_HAL_H_
+
+#include_next "stm32f4xx_hal.h"
+#include "hal_host.h"
+
+#endif /* HOST_STM32F4XX_HAL_H_ */
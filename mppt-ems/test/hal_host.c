@@ -0,0 +1,624 @@
+/** hal_host.c
+ * Source file for the host build HAL stand-in (peripherals in host memory, virtual clock, interrupts as signals)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Only the HAL calls the firmware makes are here, and they do the least that keeps the firmware's view of the
+ * hardware consistent: configuration calls succeed and change nothing, starting a timer channel sets its CCER bit,
+ * a GPIO write updates ODR. Everything with timing (ADC conversions, DMA transfers, UART bytes) is left to the test,
+ * which plays the hardware through the host_ calls in hal_host.h. The firmware's DMA addresses are 32 bits wide,
+ * so the tests link without PIE and every static buffer stays below 4 GB.
+ */
+
+#include "stm32f4xx_hal.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+uint32_t SystemCoreClock = 100000000;
+
+TIM_TypeDef hostTIM1, hostTIM5, hostTIM6, hostTIM9, hostTIM11;
+ADC_TypeDef hostADC1;
+ADC_Common_TypeDef hostADC1_COMMON;
+DMA_TypeDef hostDMA2;
+DMA_Stream_TypeDef hostDMA2_Stream0, hostDMA2_Stream5, hostDMA2_Stream7;
+GPIO_TypeDef hostGPIOA, hostGPIOB, hostGPIOC, hostGPIOH;
+USART_TypeDef hostUSART1;
+RCC_TypeDef hostRCC;
+PWR_TypeDef hostPWR;
+FLASH_TypeDef hostFLASH;
+DBGMCU_TypeDef hostDBGMCU;
+DWT_Type hostDWT;
+CoreDebug_Type hostCoreDebug;
+
+uint8_t hostCalSector[HOST_CAL_SECTOR] = { [0 ... HOST_CAL_SECTOR - 1] = 0xff };
+
+volatile uint32_t hostTick;
+
+static void (*idle)(void);
+static void (*interrupt)(void);
+static void (*pinWatcher)(GPIO_TypeDef *, uint16_t, GPIO_PinState);
+static volatile uint32_t primask;
+static volatile uint8_t inInterrupt;
+
+static uint16_t *adcBuffer;
+static uint32_t adcLength;
+
+static UART_HandleTypeDef *uartHandle;
+static uint8_t uartLog[HOST_UART_LOG];
+static uint32_t uartLogLength;
+static uint32_t uartStarts;
+static uint8_t uartInput[256];
+static uint16_t inputHead, inputTail;
+
+
+// Interrupts ---------------------------------------------------------------------------------------------------------
+
+static void host_Signal(int signal)
+{
+	(void)signal;
+
+	inInterrupt++;
+
+	if (interrupt != NULL)
+		interrupt();
+
+	inInterrupt--;
+}
+
+static void host_Mask(int how)
+{
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+	sigprocmask(how, &set, NULL);
+}
+
+void host_Interrupts(void (*handler)(void), uint32_t periodUs)
+{
+	struct itimerval timer;
+	struct sigaction action;
+
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_REAL, &timer, NULL);
+
+	interrupt = handler;
+
+	if ( (handler == NULL) || (periodUs == 0) )
+		return;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = host_Signal;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGALRM, &action, NULL);
+
+	timer.it_interval.tv_usec = periodUs;
+	timer.it_value.tv_usec = periodUs;
+	setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+void host_DisableIrq(void)
+{
+	host_Mask(SIG_BLOCK);
+	primask = 1;
+}
+
+// Inside the handler the signal stays blocked until it returns, as an interrupt can't preempt itself on the target
+void host_EnableIrq(void)
+{
+	primask = 0;
+
+	if (inInterrupt == 0)
+		host_Mask(SIG_UNBLOCK);
+}
+
+uint32_t host_GetPrimask(void)
+{
+	return primask;
+}
+
+void host_SetPrimask(uint32_t mask)
+{
+	if (mask & 1)
+		host_DisableIrq();
+	else
+		host_EnableIrq();
+}
+
+// Clock --------------------------------------------------------------------------------------------------------------
+
+void host_SetIdle(void (*hook)(void))
+{
+	idle = hook;
+}
+
+// The MSP initialization the HAL calls back into: stm32f4xx_hal_msp.c replaces these in the programs that link it
+__weak void HAL_MspInit(void)
+{
+}
+
+__weak void HAL_ADC_MspInit(ADC_HandleTypeDef *hadc)
+{
+	UNUSED(hadc);
+}
+
+__weak void HAL_TIM_Base_MspInit(TIM_HandleTypeDef *htim)
+{
+	UNUSED(htim);
+}
+
+__weak void HAL_UART_MspInit(UART_HandleTypeDef *huart)
+{
+	UNUSED(huart);
+}
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+	HAL_MspInit();
+
+	return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	if (idle != NULL)
+		idle();
+
+	return hostTick;
+}
+
+void HAL_IncTick(void)
+{
+	hostTick++;
+}
+
+void HAL_SYSTICK_IRQHandler(void)
+{
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+}
+
+void HAL_NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+}
+
+void HAL_NVIC_SetPriorityGrouping(uint32_t PriorityGroup)
+{
+}
+
+uint32_t HAL_SYSTICK_Config(uint32_t TicksNumb)
+{
+	return 0;
+}
+
+void HAL_SYSTICK_CLKSourceConfig(uint32_t CLKSource)
+{
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+	return SystemCoreClock;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+	return HAL_OK;
+}
+
+// GPIO ---------------------------------------------------------------------------------------------------------------
+
+void host_SetPinWatcher(void (*watcher)(GPIO_TypeDef *, uint16_t, GPIO_PinState))
+{
+	pinWatcher = watcher;
+}
+
+bool host_GetPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return (GPIOx->ODR & GPIO_Pin) != 0;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if (PinState == GPIO_PIN_SET)
+		GPIOx->ODR |= GPIO_Pin;
+	else
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+
+	if (pinWatcher != NULL)
+		pinWatcher(GPIOx, GPIO_Pin, PinState);
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	HAL_GPIO_WritePin(GPIOx, GPIO_Pin, host_GetPin(GPIOx, GPIO_Pin) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+// Timers -------------------------------------------------------------------------------------------------------------
+
+static void host_TimInit(TIM_HandleTypeDef *htim)
+{
+	htim->Instance->ARR = htim->Init.Period;
+	htim->Instance->PSC = htim->Init.Prescaler;
+}
+
+uint32_t host_TimCountNs(TIM_TypeDef *TIMx)
+{
+	return (uint32_t)(((uint64_t)TIMx->PSC + 1) * 1000000000ULL / HOST_TIM_CLOCK_HZ);
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+	HAL_TIM_Base_MspInit(htim);
+	host_TimInit(htim);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim)
+{
+	host_TimInit(htim);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_Init(TIM_HandleTypeDef *htim)
+{
+	host_TimInit(htim);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *sClockSourceConfig)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_SlaveConfigSynchronization(TIM_HandleTypeDef *htim, TIM_SlaveConfigTypeDef *sSlaveConfig)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_ConfigBreakDeadTime(TIM_HandleTypeDef *htim, TIM_BreakDeadTimeConfigTypeDef *sBreakDeadTimeConfig)
+{
+	return HAL_OK;
+}
+
+static void host_SetCompare(TIM_HandleTypeDef *htim, uint32_t Channel, uint32_t pulse)
+{
+	__HAL_TIM_SET_COMPARE(htim, Channel, pulse);
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel)
+{
+	host_SetCompare(htim, Channel, sConfig->Pulse);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel)
+{
+	host_SetCompare(htim, Channel, sConfig->Pulse);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	htim->Instance->CCER |= TIM_CCER_CC1E << Channel;
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	htim->Instance->CCER &= ~(TIM_CCER_CC1E << Channel);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	htim->Instance->CCER |= TIM_CCER_CC1NE << Channel;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	htim->Instance->CCER &= ~(TIM_CCER_CC1NE << Channel);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+{
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+	htim->Instance->DIER |= TIM_IT_UPDATE;
+
+	return HAL_TIM_Base_Start(htim);
+}
+
+// The firmware's MSP (stm32f4xx_hal_msp.c) and callbacks (mppt.c) replace these in the programs that link them
+__weak void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim)
+{
+	UNUSED(htim);
+}
+
+__weak void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	UNUSED(htim);
+}
+
+__weak void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	UNUSED(htim);
+}
+
+// The update and CC1 interrupts, the only ones the firmware enables, for a test that sets their flags in SR
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim)
+{
+	if ( (htim->Instance->SR & TIM_FLAG_CC1) && (htim->Instance->DIER & TIM_IT_CC1) )
+	{
+		htim->Instance->SR &= ~TIM_FLAG_CC1;
+		HAL_TIM_OC_DelayElapsedCallback(htim);
+	}
+
+	if ( (htim->Instance->SR & TIM_FLAG_UPDATE) && (htim->Instance->DIER & TIM_IT_UPDATE) )
+	{
+		htim->Instance->SR &= ~TIM_FLAG_UPDATE;
+		HAL_TIM_PeriodElapsedCallback(htim);
+	}
+}
+
+// ADC and DMA --------------------------------------------------------------------------------------------------------
+
+uint16_t *host_AdcBuffer(void)
+{
+	return adcBuffer;
+}
+
+uint32_t host_AdcLength(void)
+{
+	return adcLength;
+}
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *hadc)
+{
+	HAL_ADC_MspInit(hadc);
+
+	return HAL_OK;
+}
+
+// A channel's sample time goes into SMPR1 (channels 10 - 18) or SMPR2 (0 - 9), 3 bits per channel, as the HAL puts it
+static void host_AdcSampleTime(ADC_HandleTypeDef *hadc, uint32_t channel, uint32_t sampleTime)
+{
+	if (channel > ADC_CHANNEL_9)
+	{
+		hadc->Instance->SMPR1 &= ~(7UL << (3 * (channel - 10)));
+		hadc->Instance->SMPR1 |= sampleTime << (3 * (channel - 10));
+	}
+	else
+	{
+		hadc->Instance->SMPR2 &= ~(7UL << (3 * channel));
+		hadc->Instance->SMPR2 |= sampleTime << (3 * channel);
+	}
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc, ADC_ChannelConfTypeDef *sConfig)
+{
+	host_AdcSampleTime(hadc, sConfig->Channel, sConfig->SamplingTime);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_InjectedConfigChannel(ADC_HandleTypeDef *hadc, ADC_InjectionConfTypeDef *sConfigInjected)
+{
+	host_AdcSampleTime(hadc, sConfigInjected->InjectedChannel, sConfigInjected->InjectedSamplingTime);
+
+	return HAL_OK;
+}
+
+// The DMA restarts at the top of the buffer, as the real one does
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length)
+{
+	adcBuffer = (uint16_t *)pData;
+	adcLength = Length;
+
+	if (hadc->DMA_Handle != NULL)
+		hadc->DMA_Handle->Instance->NDTR = Length;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc)
+{
+	adcBuffer = NULL;
+	adcLength = 0;
+
+	return HAL_OK;
+}
+
+// The tests call the ADC and DMA callbacks themselves, so the interrupt handlers in stm32f4xx_it.c have nothing to do
+void HAL_ADC_IRQHandler(ADC_HandleTypeDef *hadc)
+{
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+}
+
+// Sets up the stream registers as the HAL does, the stream disabled
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+	hdma->Instance->CR = hdma->Init.Channel | hdma->Init.Direction | hdma->Init.PeriphInc | hdma->Init.MemInc |
+		hdma->Init.PeriphDataAlignment | hdma->Init.MemDataAlignment | hdma->Init.Mode | hdma->Init.Priority;
+	hdma->Instance->FCR = hdma->Init.FIFOMode;
+
+	if (hdma->Init.FIFOMode == DMA_FIFOMODE_ENABLE)
+	{
+		hdma->Instance->CR |= hdma->Init.MemBurst | hdma->Init.PeriphBurst;
+		hdma->Instance->FCR |= hdma->Init.FIFOThreshold;
+	}
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	hdma->Instance->M0AR = SrcAddress;
+	hdma->Instance->PAR = DstAddress;
+	hdma->Instance->NDTR = DataLength;
+	hdma->Instance->CR |= DMA_SxCR_EN;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+	hdma->Instance->CR &= ~DMA_SxCR_EN;
+
+	return HAL_OK;
+}
+
+// UART ---------------------------------------------------------------------------------------------------------------
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+	HAL_UART_MspInit(huart);
+	huart->gState = HAL_UART_STATE_READY;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if (huart->gState == HAL_UART_STATE_BUSY_TX)
+		return HAL_BUSY;
+
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	uartHandle = huart;
+	uartStarts++;
+
+	if (uartLogLength + Size > HOST_UART_LOG)
+		Size = HOST_UART_LOG - uartLogLength;
+
+	memcpy(&uartLog[uartLogLength], pData, Size);
+	uartLogLength += Size;
+
+	return HAL_OK;
+}
+
+bool host_UartBusy(void)
+{
+	return (uartHandle != NULL) && (uartHandle->gState == HAL_UART_STATE_BUSY_TX);
+}
+
+// The firmware's callback (mppt.c) replaces this one in the tests that link it
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	UNUSED(huart);
+}
+
+void host_UartComplete(void)
+{
+	if (!host_UartBusy())
+		return;
+
+	uartHandle->gState = HAL_UART_STATE_READY;
+	HAL_UART_TxCpltCallback(uartHandle);
+}
+
+uint32_t host_UartLogLength(void)
+{
+	return uartLogLength;
+}
+
+const uint8_t *host_UartLog(void)
+{
+	return uartLog;
+}
+
+void host_UartLogClear(void)
+{
+	uartLogLength = 0;
+}
+
+uint32_t host_UartStarts(void)
+{
+	return uartStarts;
+}
+
+void host_UartInput(const uint8_t *data, uint16_t length)
+{
+	while (length--)
+	{
+		uartInput[inputHead] = *data++;
+		inputHead = (inputHead + 1) % sizeof(uartInput);
+	}
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	while (Size--)
+	{
+		if (inputTail == inputHead)
+			return HAL_TIMEOUT;
+
+		*pData++ = uartInput[inputTail];
+		inputTail = (inputTail + 1) % sizeof(uartInput);
+	}
+
+	return HAL_OK;
+}
@@ -0,0 +1,155 @@
+/** hal_host.h
+ * Header file for the host build HAL stand-in (peripherals in host memory, virtual clock, interrupts as signals)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every peripheral the firmware touches is a plain struct here, so register writes land in memory the tests can read
+ * and register reads return what the tests put there. HAL_GetTick() is a virtual mS clock that only moves when a test
+ * moves it. An interrupt is whatever the test calls from the signal handler it installs with host_Interrupts():
+ * __disable_irq() and friends block that signal, so code that masks interrupts is checked for real.
+ */
+
+// Prevent recursive inclusion
+#ifndef HAL_HOST_H_
+#define HAL_HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+extern TIM_TypeDef hostTIM1, hostTIM5, hostTIM6, hostTIM9, hostTIM11;
+extern ADC_TypeDef hostADC1;
+extern ADC_Common_TypeDef hostADC1_COMMON;
+extern DMA_TypeDef hostDMA2;
+extern DMA_Stream_TypeDef hostDMA2_Stream0, hostDMA2_Stream5, hostDMA2_Stream7;
+extern GPIO_TypeDef hostGPIOA, hostGPIOB, hostGPIOC, hostGPIOH;
+extern USART_TypeDef hostUSART1;
+extern RCC_TypeDef hostRCC;
+extern PWR_TypeDef hostPWR;
+extern FLASH_TypeDef hostFLASH;
+extern DBGMCU_TypeDef hostDBGMCU;
+extern DWT_Type hostDWT;
+extern CoreDebug_Type hostCoreDebug;
+
+#undef TIM1
+#undef TIM5
+#undef TIM6
+#undef TIM9
+#undef TIM11
+#undef ADC1
+#undef ADC1_COMMON
+#undef DMA2
+#undef DMA2_Stream0
+#undef DMA2_Stream5
+#undef DMA2_Stream7
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOH
+#undef USART1
+#undef RCC
+#undef PWR
+#undef FLASH
+#undef DBGMCU
+#undef DWT
+#undef CoreDebug
+
+#define TIM1				(&hostTIM1)
+#define TIM5				(&hostTIM5)
+#define TIM6				(&hostTIM6)
+#define TIM9				(&hostTIM9)
+#define TIM11				(&hostTIM11)
+#define ADC1				(&hostADC1)
+#define ADC1_COMMON			(&hostADC1_COMMON)
+#define DMA2				(&hostDMA2)
+#define DMA2_Stream0		(&hostDMA2_Stream0)
+#define DMA2_Stream5		(&hostDMA2_Stream5)
+#define DMA2_Stream7		(&hostDMA2_Stream7)
+#define GPIOA				(&hostGPIOA)
+#define GPIOB				(&hostGPIOB)
+#define GPIOC				(&hostGPIOC)
+#define GPIOH				(&hostGPIOH)
+#define USART1				(&hostUSART1)
+#define RCC					(&hostRCC)
+#define PWR					(&hostPWR)
+#define FLASH				(&hostFLASH)
+#define DBGMCU				(&hostDBGMCU)
+#define DWT					(&hostDWT)
+#define CoreDebug			(&hostCoreDebug)
+
+// The calibration flash sector (CAL_RECORD_ADDRESS in calibration.h): erased, until a test writes a record into it
+#define HOST_CAL_SECTOR		256
+
+extern uint8_t hostCalSector[HOST_CAL_SECTOR];
+
+#define CAL_RECORD_ADDRESS	((uint32_t)hostCalSector)
+
+// Cortex-M intrinsics. Interrupt masking blocks the interrupt signal; barriers are host barriers.
+void host_DisableIrq(void);
+void host_EnableIrq(void);
+uint32_t host_GetPrimask(void);
+void host_SetPrimask(uint32_t);
+
+#define __disable_irq()		host_DisableIrq()
+#define __enable_irq()		host_EnableIrq()
+#define __get_PRIMASK()		host_GetPrimask()
+#define __set_PRIMASK(mask)	host_SetPrimask(mask)
+#define __DMB()				__sync_synchronize()
+#define __DSB()				__sync_synchronize()
+#define __ISB()				__sync_synchronize()
+#define __NOP()				do { } while (0)
+
+/** Interrupts
+ * handler runs on SIGALRM every periodUs uS of host time (0 stops it). The handler is the test's interrupt:
+ * it calls the firmware's interrupt side (DMA callbacks and so on) and must not call back into the test's main context.
+ */
+void host_Interrupts(void (*handler)(void), uint32_t periodUs);
+
+/** Virtual clock
+ * HAL_GetTick() returns hostTick. If an idle hook is set, HAL_GetTick() calls it first, so a loop that waits on the
+ * tick (or on something an interrupt does) can let the test move time and raise the interrupts meanwhile.
+ */
+extern volatile uint32_t hostTick;
+void host_SetIdle(void (*)(void));
+
+/** Timer clock
+ * Every timer counts the 100 MHz APB2 / APB1 timer clock of SystemClock_Config() over its prescaler (PSC + 1), so a
+ * test can turn a count into real time the way the target runs it.
+ */
+#define HOST_TIM_CLOCK_HZ	100000000
+
+uint32_t host_TimCountNs(TIM_TypeDef *);
+
+// GPIO: every HAL_GPIO_WritePin() / HAL_GPIO_TogglePin() updates ODR and then calls the watcher, if one is set
+void host_SetPinWatcher(void (*)(GPIO_TypeDef *, uint16_t, GPIO_PinState));
+bool host_GetPin(GPIO_TypeDef *, uint16_t);
+
+// ADC DMA: the buffer HAL_ADC_Start_DMA() was given (NULL while stopped) and its length in samples
+uint16_t *host_AdcBuffer(void);
+uint32_t host_AdcLength(void);
+
+/** UART DMA
+ * HAL_UART_Transmit_DMA() appends the frame to the host transmit log and leaves the UART busy until
+ * host_UartComplete() finishes it, which calls HAL_UART_TxCpltCallback() as the interrupt would.
+ * HAL_UART_Receive() reads what host_UartInput() queued and times out when there is nothing.
+ */
+#define HOST_UART_LOG		65536
+
+bool host_UartBusy(void);
+void host_UartComplete(void);
+uint32_t host_UartLogLength(void);
+const uint8_t *host_UartLog(void);
+void host_UartLogClear(void);
+uint32_t host_UartStarts(void);
+void host_UartInput(const uint8_t *, uint16_t);
+
+#endif /* HAL_HOST_H_ */
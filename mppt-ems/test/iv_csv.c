@@ -0,0 +1,46 @@
+/** iv_csv.c
+ * Host tool that turns a USART1 capture of an I-V trace into CSV
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ *   build/iv_csv < capture.bin > trace.csv
+ *
+ * Reads the raw bytes received after CMD_IV_TRACE (e.g. saved by a serial terminal), and writes the last complete
+ * trace in them. Exits with 1 if there was none.
+ */
+
+#include "iv_decode.h"
+
+#include <stdlib.h>
+
+#define MAX_CAPTURE		(1024 * 1024)
+
+int main(void)
+{
+	static uint8_t capture[MAX_CAPTURE];
+	IV_Decoded trace;
+	size_t length;
+
+	length = fread(capture, 1, sizeof(capture), stdin);
+	ivDecode_Stream(capture, length, &trace);
+
+	if (trace.traces == 0)
+	{
+		fprintf(stderr, "no complete I-V trace in %lu bytes (%u broken)\n", (unsigned long)length, trace.broken);
+		return 1;
+	}
+
+	ivDecode_WriteCsv(&trace, stdout);
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/** iv_decode.c
+ * Source file for the host decoder of the I-V trace frames (MSG_IV_TRACE)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A trace is sent by sendIVTrace() in mppt.c as frames 0 .. count - 1, each with the frame index, frame count and
+ * point count, then 5 bytes per point: duty (counts), array voltage (mV) and current (mA), LSB first. Only a trace
+ * whose frames all arrived, in order, is kept; the last one in the stream wins.
+ */
+
+#include "iv_decode.h"
+#include "frame_decode.h"
+
+#define MSG_IV_TRACE		0x9c	// As in mppt.h
+
+typedef struct
+{
+	IV_Decoded *out;
+	IV_Point point[IV_TRACE_MAX_POINTS];
+	uint8_t count;
+	uint8_t nextFrame;				// Frame index expected next, 0xff: waiting for frame 0
+} Assembly;
+
+
+static void ivFrame(const uint8_t *frame, uint8_t length, void *context)
+{
+	Assembly *a = context;
+	const uint8_t *p = &frame[FRAME_PAYLOAD];
+	uint8_t index, frames, points, i;
+
+	if ( (frame[FRAME_TYPE] != MSG_IV_TRACE) || (length < FRAME_PAYLOAD + 3) )
+		return;
+
+	index = p[0];
+	frames = p[1];
+	points = p[2];
+
+	if ( (length != FRAME_PAYLOAD + 3 + 5 * points) || (index >= frames) )
+	{
+		a->out->broken++;
+		a->nextFrame = 0xff;
+		return;
+	}
+
+	if (index == 0)
+	{
+		a->count = 0;
+	}
+	else if (index != a->nextFrame)
+	{
+		a->out->broken++;
+		a->nextFrame = 0xff;
+		return;
+	}
+
+	for (i = 0; (i < points) && (a->count < IV_TRACE_MAX_POINTS); i++)
+	{
+		a->point[a->count].duty = p[3 + 5 * i];
+		a->point[a->count].vSolar = p[4 + 5 * i] | (p[5 + 5 * i] << 8);
+		a->point[a->count].iSolar = p[6 + 5 * i] | (p[7 + 5 * i] << 8);
+		a->count++;
+	}
+
+	a->nextFrame = index + 1;
+
+	if (a->nextFrame == frames)
+	{
+		for (i = 0; i < a->count; i++)
+			a->out->point[i] = a->point[i];
+
+		a->out->count = a->count;
+		a->out->traces++;
+		a->nextFrame = 0xff;
+	}
+}
+
+// Decodes every I-V trace in length bytes received from the controller into out
+void ivDecode_Stream(const uint8_t *stream, uint32_t length, IV_Decoded *out)
+{
+	Assembly a;
+	FRAME_Counts counts;
+
+	out->count = 0;
+	out->traces = 0;
+	out->broken = 0;
+
+	a.out = out;
+	a.count = 0;
+	a.nextFrame = 0xff;
+
+	frame_Split(stream, length, ivFrame, &a, &counts);
+
+	out->broken += counts.badFrames;
+}
+
+// One line per point: duty_counts,v_mv,i_ma,p_mw
+void ivDecode_WriteCsv(const IV_Decoded *trace, FILE *out)
+{
+	uint8_t i;
+
+	fprintf(out, "duty_counts,v_mv,i_ma,p_mw\n");
+
+	for (i = 0; i < trace->count; i++)
+	{
+		fprintf(out, "%u,%u,%u,%lu\n", trace->point[i].duty, trace->point[i].vSolar, trace->point[i].iSolar,
+			((unsigned long)trace->point[i].vSolar * trace->point[i].iSolar + 500) / 1000);
+	}
+}
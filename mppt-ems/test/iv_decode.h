@@ -0,0 +1,37 @@
+/** iv_decode.h
+ * Header file for the host decoder of the I-V trace frames (MSG_IV_TRACE)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef IV_DECODE_H_
+#define IV_DECODE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "iv_trace.h"
+
+typedef struct
+{
+	IV_Point point[IV_TRACE_MAX_POINTS];
+	uint8_t count;					// Points of the last complete trace
+	uint8_t traces;					// Complete traces seen
+	uint8_t broken;					// Traces with a frame missing or out of order
+} IV_Decoded;
+
+void ivDecode_Stream(const uint8_t *, uint32_t, IV_Decoded *);
+void ivDecode_WriteCsv(const IV_Decoded *, FILE *);
+
+#endif /* IV_DECODE_H_ */
@@ -0,0 +1,47 @@
+/** measure_ref.h
+ * Header file for the original double precision measurement formulas, the reference for measure.c
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * These are calcVoltage(), calcCurrent() and calcTemperature() as they were in mppt.c before measure.c,
+ * returning V, A and degC as doubles.
+ */
+
+// Prevent recursive inclusion
+#ifndef MEASURE_REF_H_
+#define MEASURE_REF_H_
+
+#include <stdint.h>
+
+static const double adcUnit = 0.000806;
+static const double voltageDividerOutput = 0.0623;		// Voltage Divider ratio gives 0.0623 volts out / volt in
+
+static inline double refVoltage(uint16_t ADvalue, uint8_t gain)
+{
+	return (ADvalue * adcUnit) / gain / voltageDividerOutput;
+}
+
+static inline double refCurrent(uint16_t ADvalue)
+{
+	const uint8_t gain = 50;						// Gain of the INA213AIDCK current sense amplifier
+	const double Rsense	=	0.002;					// Value of current sense resistors used in design.
+
+	return (ADvalue * adcUnit) / gain / Rsense;
+}
+
+static inline double refTemperature(uint16_t ADvalue)
+{
+	return ( (ADvalue * adcUnit) / 0.010)  - 50;
+}
+
+#endif /* MEASURE_REF_H_ */
@@ -0,0 +1,76 @@
+/** mppt_ic_ref.h
+ * Header file for the original floating point incremental conductance step, the reference for mppt_ic.c
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * This is ic_Init() and ic_Step() as they were before mppt_ic.c went integer: two float divisions a step, an exact
+ * comparison of the conductances, and the duty moved a whole count the wrong way. Duty cycles are in 1/16 counts here
+ * as well, so it runs in the same loops as the strategies.
+ */
+
+// Prevent recursive inclusion
+#ifndef MPPT_IC_REF_H_
+#define MPPT_IC_REF_H_
+
+#include "mppt_strategy.h"
+#include "converter.h"
+
+static int32_t refLastVsolar;
+static int32_t refLastIsolar;
+
+static inline void refIc_Init(const MPPT_Measurement *m, uint16_t duty)
+{
+	refLastVsolar = m->vSolar;
+	refLastIsolar = m->iSolar;
+}
+
+static inline int32_t refIc_Step(const MPPT_Measurement *m, uint16_t duty)
+{
+	float conductance;
+	int32_t dV, dI;
+	int32_t command = duty;
+
+	dV = m->vSolar - refLastVsolar;
+	dI = m->iSolar - refLastIsolar;
+
+	if ( (dV != 0) && (m->vSolar != 0) )
+	{
+		conductance = (float)dI / (float)dV;
+
+		if (conductance == -((float)m->iSolar / (float)m->vSolar))
+		{
+			// At the MPP
+		}
+
+		else if (conductance > -((float)m->iSolar / (float)m->vSolar))
+			command = duty + DUTY_FINE(1);
+
+		else
+			command = duty - DUTY_FINE(1);
+	}
+
+	else if (dI != 0)
+	{
+		if (dI > 0)
+			command = duty - DUTY_FINE(1);
+		else
+			command = duty + DUTY_FINE(1);
+	}
+
+	refLastVsolar = m->vSolar;
+	refLastIsolar = m->iSolar;
+
+	return command;
+}
+
+#endif /* MPPT_IC_REF_H_ */
@@ -0,0 +1,193 @@
+/** plant_model.c
+ * Host model of what the controller is wired to: array, converter, lead-acid battery and load
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Meant to be stepped once per ADC frame for hours of simulated time, so the converter is taken in steady state
+ * (buck_model.c integrates its transients, for the tests that need them): with the array switch on, the array sits at
+ * Vbattery / duty, or at open circuit if that is above it, and the battery gets the array power times
+ * PLANT_CONVERTER_EFF. With the bypass on the array is straight across the battery. The array is pv_model.c.
+ *
+ * The battery is its rest voltage, linear in the state of charge, behind PLANT_R_INTERNAL and a polarization voltage
+ * that settles, with PLANT_POLARIZATION_S, at the charge current times the acceptance resistance
+ *   Ra = PLANT_R_ACCEPT * soc^4 / (1 - soc^4 + PLANT_R_ACCEPT_KNEE) * (1 + PLANT_R_TEMP_COEFF * (25 - T)).
+ * That is what makes a lead-acid battery take less and less current at the absorption voltage: about 8 A at 85 %,
+ * 3 A at 95 % and 1.4 A at 99 % at 14.4 V and 25 degC, and less the colder the battery is. The battery temperature
+ * follows the ambient temperature with PLANT_THERMAL_S. The load draws PLANT_LOAD_A while it is switched on, and the
+ * MOSFETs sit above the ambient temperature by the converter loss through the heatsink.
+ */
+
+#include "plant_model.h"
+#include "pv_model.h"
+#include "converter.h"
+
+#include <math.h>
+
+#define PLANT_ITERATIONS		4
+#define PLANT_SETTLED_A			1e-4
+
+static double soc;
+static double batteryTemp;
+static double ambient;
+static double polarization;			// V
+static double mosfetTemp;
+static double charge;				// A, last charge current
+static double arrayWh, chargeWh;
+
+
+static double restVoltage(void)
+{
+	return PLANT_OCV_EMPTY + (PLANT_OCV_FULL - PLANT_OCV_EMPTY) * soc;
+}
+
+// Acceptance resistance (Ohm) at the present state of charge and battery temperature
+static double acceptance(void)
+{
+	double x = soc * soc * soc * soc;
+	double scale = 1 + PLANT_R_TEMP_COEFF * (25 - batteryTemp);
+
+	if (scale < 0.5)
+		scale = 0.5;
+
+	return PLANT_R_ACCEPT * x / (1 - x + PLANT_R_ACCEPT_KNEE) * scale;
+}
+
+static double terminalVoltage(double amps)
+{
+	return restVoltage() + polarization + amps * PLANT_R_INTERNAL;
+}
+
+// Starts the battery at rest at soc (0 - 1), with everything at ambientC
+void plant_Init(double stateOfCharge, double ambientC)
+{
+	soc = stateOfCharge;
+	batteryTemp = ambientC;
+	ambient = ambientC;
+	mosfetTemp = ambientC;
+	polarization = 0;
+	charge = 0;
+	arrayWh = 0;
+	chargeWh = 0;
+
+	pv_SetIrradiance(0);
+}
+
+// Irradiance on the whole array in W/m2, and the ambient temperature in degC
+void plant_SetSky(double irradiance, double ambientC)
+{
+	pv_SetIrradiance(irradiance);
+	ambient = ambientC;
+}
+
+/** Runs the plant for seconds with the controller's outputs in drive, and returns what its sensors read at the end.
+ * The battery voltage and the charge current depend on each other; a few rounds from the last charge current settle
+ * them, the battery's internal resistance being small next to what the array current does with the voltage.
+ */
+void plant_Run(const PLANT_Drive *drive, double seconds, PLANT_Readings *r)
+{
+	double load = drive->loadOn ? PLANT_LOAD_A : 0;
+	double vOpen = pv_OpenCircuit();
+	double vArray = vOpen, iArray = 0, vBat = 0, loss = 0, last, rth, target;
+	uint8_t k;
+
+	if ( !drive->arrayOn || ((drive->duty == 0) && !drive->bypass) )
+		charge = 0;
+
+	for (k = 0; k < PLANT_ITERATIONS; k++)
+	{
+		last = charge;
+		vBat = terminalVoltage(charge - load);
+
+		if (!drive->arrayOn)
+			break;
+
+		if (drive->bypass)
+		{
+			vArray = vBat + PLANT_BYPASS_DROP;
+			iArray = (vArray < vOpen) ? pv_Current(vArray) : 0;
+			charge = iArray;
+			loss = iArray * PLANT_BYPASS_DROP;
+		}
+		else if (drive->duty != 0)
+		{
+			vArray = vBat * DUTY_FINE(TIM1_PERIOD) / drive->duty;
+
+			if (vArray >= vOpen)
+			{
+				vArray = vOpen;
+				iArray = 0;
+			}
+			else
+				iArray = pv_Current(vArray);
+
+			charge = vArray * iArray * PLANT_CONVERTER_EFF / vBat;
+			loss = vArray * iArray * (1 - PLANT_CONVERTER_EFF);
+		}
+		else
+			break;
+
+		if (fabs(charge - last) < PLANT_SETTLED_A)
+			break;
+	}
+
+	vBat = terminalVoltage(charge - load);
+
+	// The battery
+	polarization += ((charge - load) * ((charge > load) ? acceptance() : 0) - polarization) * seconds / PLANT_POLARIZATION_S;
+	soc += (charge - load) * seconds / (3600 * PLANT_BATTERY_AH);
+
+	if (soc > 1)
+		soc = 1;
+	if (soc < 0)
+		soc = 0;
+
+	batteryTemp += (ambient - batteryTemp) * seconds / PLANT_THERMAL_S;
+
+	// The heatsink
+	rth = drive->fanOn ? PLANT_HEATSINK_C_PER_W / 2 : PLANT_HEATSINK_C_PER_W;
+	target = ambient + loss * rth;
+	mosfetTemp += (target - mosfetTemp) * seconds / PLANT_HEATSINK_S;
+
+	arrayWh += vArray * iArray * seconds / 3600;
+	chargeWh += vBat * charge * seconds / 3600;
+
+	r->vBat = (int32_t)lround(vBat * 1000);
+	r->vSolar = (int32_t)lround(vArray * 1000);
+	r->iBat = (int32_t)lround(charge * 1000);
+	r->iSolar = (int32_t)lround(iArray * 1000);
+	r->vLoad = drive->loadOn ? r->vBat : 0;
+	r->iLoad = (int32_t)lround(load * 1000);
+	r->ambient = (int32_t)lround(ambient * 100);
+	r->mosfet = (int32_t)lround(mosfetTemp * 100);
+}
+
+double plant_StateOfCharge(void)
+{
+	return soc;
+}
+
+double plant_BatteryTemperature(void)
+{
+	return batteryTemp;
+}
+
+// Energy the array has delivered, and the battery has taken from the controller, since plant_Init()
+double plant_ArrayWh(void)
+{
+	return arrayWh;
+}
+
+double plant_ChargeWh(void)
+{
+	return chargeWh;
+}
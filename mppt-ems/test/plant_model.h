@@ -0,0 +1,75 @@
+/** plant_model.h
+ * Header file for the host model of what the controller is wired to: array, converter, lead-acid battery and load
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef PLANT_MODEL_H_
+#define PLANT_MODEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The battery: a 12 V flooded bank
+#define PLANT_BATTERY_AH		100.0
+#define PLANT_OCV_EMPTY			11.9		// V at rest, 25 degC, 0 % and 100 % charged
+#define PLANT_OCV_FULL			12.75
+#define PLANT_R_INTERNAL		0.01		// Ohm
+#define PLANT_R_ACCEPT			0.243		// Ohm, scale of the charge acceptance resistance (see plant_model.c)
+#define PLANT_R_ACCEPT_KNEE		0.162
+#define PLANT_R_TEMP_COEFF		0.02		// Acceptance resistance change per degC below 25 degC
+#define PLANT_POLARIZATION_S	20.0		// Time constant of the charge overvoltage
+#define PLANT_THERMAL_S			7200.0		// Time constant of the battery following the ambient temperature
+
+// The converter and the bypass switch
+#define PLANT_CONVERTER_EFF		0.97
+#define PLANT_BYPASS_DROP		0.1			// V across the bypass MOSFETs
+
+// The load output and the heatsink
+#define PLANT_LOAD_A			1.0
+#define PLANT_HEATSINK_C_PER_W	3.0			// Halved with the fan on
+#define PLANT_HEATSINK_S		120.0
+
+// What the controller drives, read back from its outputs
+typedef struct
+{
+	uint16_t duty;				// 1/16 counts, 0 with the converter off
+	bool arrayOn;				// Array switch
+	bool bypass;				// Array straight across the battery
+	bool loadOn;
+	bool fanOn;
+} PLANT_Drive;
+
+// What its sensors see: mV, mA and hundredths of a degC
+typedef struct
+{
+	int32_t vBat;
+	int32_t vSolar;
+	int32_t iBat;				// Charge current, out of the converter or the bypass
+	int32_t iSolar;
+	int32_t vLoad;
+	int32_t iLoad;
+	int32_t ambient;
+	int32_t mosfet;
+} PLANT_Readings;
+
+void plant_Init(double, double);
+void plant_SetSky(double, double);
+void plant_Run(const PLANT_Drive *, double, PLANT_Readings *);
+double plant_StateOfCharge(void);
+double plant_BatteryTemperature(void);
+double plant_ArrayWh(void);
+double plant_ChargeWh(void);
+
+#endif /* PLANT_MODEL_H_ */
@@ -0,0 +1,56 @@
+/** pulse_ref.h
+ * Header file for the original interrupt-masking delay_us() and pulse(), the reference for the microsecond timers
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * This is delay_us() and pulse() from mppt.c as they were before us_timer.c: the desulfation train toggles the pin
+ * and spins 100 uS on the TIM11 count with interrupts masked, ten times. The count is read through ref_Counter(),
+ * which the program including this defines; on the host it moves the virtual clock on, the way the spin does.
+ */
+
+// Prevent recursive inclusion
+#ifndef PULSE_REF_H_
+#define PULSE_REF_H_
+
+#include "stm32f4xx_hal.h"
+
+uint32_t ref_Counter(void);
+
+static inline void refDelay_us(uint32_t usDelay)
+{
+	uint32_t initTime;
+
+	initTime = ref_Counter();
+
+	__disable_irq();
+	while ( (ref_Counter() - initTime < usDelay));
+	__enable_irq();
+}
+
+static inline void refPulse(void)
+{
+	uint8_t i;
+
+	HAL_GPIO_WritePin(GPIOB, GPIO_PIN_10, GPIO_PIN_RESET);		// switchCapacitors(OFF)
+
+	for (i=0; i<=9; i++)
+	{
+		HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_11);
+		refDelay_us(100);
+	}
+
+	HAL_GPIO_WritePin(GPIOB, GPIO_PIN_11, GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(GPIOB, GPIO_PIN_10, GPIO_PIN_SET);		// switchCapacitors(ON)
+}
+
+#endif /* PULSE_REF_H_ */
@@ -0,0 +1,280 @@
+/** pv_model.c
+ * Source file for the host model of the solar array and the converter operating point
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every group of cells is a single diode model at 25 degC without shunt leakage,
+ *   V(I) = n * cells * Vt * ln((Iph - I) / I0 + 1) - I * Rs,  Iph proportional to the group's irradiance,
+ * and its bypass diode clamps it at -PV_BYPASS_DROP once the string current is more than the group makes.
+ * The string voltage is the sum over the groups, so a shaded group puts a second peak on the P-V curve.
+ * The control tests drive the array through an ideal buck in steady state, where the array sits at
+ * Vbattery / duty, or at open circuit if that is above it (the converter can't pull more out of it).
+ */
+
+#include "pv_model.h"
+#include "converter.h"
+
+#include <math.h>
+
+#define THERMAL_VOLTAGE		0.025693	// kT / q at 25 degC
+
+static double irradiance[PV_GROUPS] = { [0 ... PV_GROUPS - 1] = 1000 };
+static double lastCurrent;
+static double i0;
+static double curveEnds[2];			// Open circuit voltage, and the voltage at the highest photo current
+static double curveCurrent;			// The highest photo current
+static bool curveValid;
+static int32_t noiseMv, noiseMa;
+static uint32_t noiseState = 12345;
+
+
+// Diode voltage scale of a group and its saturation current, from the STC open circuit voltage
+static double groupScale(void)
+{
+	return PV_IDEALITY * PV_CELLS_PER_GROUP * THERMAL_VOLTAGE;
+}
+
+static double saturationCurrent(void)
+{
+	if (i0 == 0)
+		i0 = PV_ISC_STC / (exp(PV_VOC_STC / PV_GROUPS / groupScale()) - 1);
+
+	return i0;
+}
+
+static double photoCurrent(uint8_t group)
+{
+	return PV_ISC_STC * irradiance[group] / 1000;
+}
+
+// Every group at the same irradiance, in W/m2
+void pv_SetIrradiance(double wattsPerM2)
+{
+	uint8_t g;
+
+	for (g = 0; g < PV_GROUPS; g++)
+		irradiance[g] = wattsPerM2;
+
+	curveValid = false;
+}
+
+// The irradiance of every group, PV_GROUPS values in W/m2
+void pv_SetShading(const double *wattsPerM2)
+{
+	uint8_t g;
+
+	for (g = 0; g < PV_GROUPS; g++)
+		irradiance[g] = wattsPerM2[g];
+
+	curveValid = false;
+}
+
+// Uniform noise of up to +/- mV and mA on the measurements pv_Operate() makes, 0 for none
+void pv_SetNoise(int32_t milliVolts, int32_t milliAmps)
+{
+	noiseMv = milliVolts;
+	noiseMa = milliAmps;
+}
+
+static int32_t noise(int32_t amplitude)
+{
+	if (amplitude == 0)
+		return 0;
+
+	noiseState = noiseState * 1664525 + 1013904223;
+
+	return (int32_t)((noiseState >> 8) % (2 * amplitude + 1)) - amplitude;
+}
+
+// String voltage at current amps, and its slope dV/dI in *slope
+static double stringVoltage(double amps, double *slope)
+{
+	double scale = groupScale(), i0 = saturationCurrent();
+	double volts = 0, iph, v;
+	uint8_t g;
+
+	*slope = 0;
+
+	for (g = 0; g < PV_GROUPS; g++)
+	{
+		iph = photoCurrent(g);
+
+		if (amps < iph)
+		{
+			v = scale * log((iph - amps) / i0 + 1) - amps * PV_RS_PER_GROUP;
+
+			if (v > -PV_BYPASS_DROP)
+			{
+				volts += v;
+				*slope -= scale / (iph - amps + i0) + PV_RS_PER_GROUP;
+				continue;
+			}
+		}
+
+		volts -= PV_BYPASS_DROP;
+	}
+
+	return volts;
+}
+
+// Array voltage at a string current of amps
+double pv_Voltage(double amps)
+{
+	double slope;
+
+	return stringVoltage(amps, &slope);
+}
+
+// The ends of the curve only change with the irradiance; the plant model asks for them every frame
+static void curve_Update(void)
+{
+	uint8_t g;
+
+	if (curveValid)
+		return;
+
+	curveCurrent = 0;
+
+	for (g = 0; g < PV_GROUPS; g++)
+	{
+		if (photoCurrent(g) > curveCurrent)
+			curveCurrent = photoCurrent(g);
+	}
+
+	curveEnds[0] = pv_Voltage(0);
+	curveEnds[1] = pv_Voltage(curveCurrent);
+	curveValid = true;
+}
+
+double pv_OpenCircuit(void)
+{
+	curve_Update();
+
+	return curveEnds[0];
+}
+
+// Array current at volts (0 at or above open circuit). Newton from the last result, kept inside a bisection bracket.
+double pv_Current(double volts)
+{
+	double low = 0, high, amps, error, slope, next;
+	uint8_t k;
+
+	curve_Update();
+	high = curveCurrent;
+
+	if (volts >= curveEnds[0])
+		return 0;
+
+	if (volts <= curveEnds[1])
+		return high;
+
+	amps = (lastCurrent > low && lastCurrent < high) ? lastCurrent : high / 2;
+
+	for (k = 0; k < 100; k++)
+	{
+		error = stringVoltage(amps, &slope) - volts;
+
+		if (fabs(error) < 1e-7)
+			break;
+
+		// The voltage falls as the current rises
+		if (error > 0)
+			low = amps;
+		else
+			high = amps;
+
+		next = (slope < 0) ? amps - error / slope : (low + high) / 2;
+
+		if ( (next <= low) || (next >= high) )
+			next = (low + high) / 2;
+
+		if (high - low < 1e-9)
+			break;
+
+		amps = next;
+	}
+
+	lastCurrent = amps;
+
+	return amps;
+}
+
+// Power at the global maximum power point in W, with its voltage in *volts
+double pv_MaxPower(double *volts)
+{
+	double v, p, best = 0, voc = pv_OpenCircuit();
+
+	*volts = voc;
+
+	for (v = 0; v < voc; v += 0.002)
+	{
+		p = v * pv_Current(v);
+
+		if (p > best)
+		{
+			best = p;
+			*volts = v;
+		}
+	}
+
+	return best;
+}
+
+// Array voltage the converter asks for at duty (1/16 counts) with the battery at vBat mV
+double pv_ArrayVoltage(uint16_t duty, int32_t vBat)
+{
+	return vBat / 1000.0 * DUTY_FINE(TIM1_PERIOD) / duty;
+}
+
+// What the ADC would measure in steady state at duty (1/16 counts) with the battery at vBat mV
+void pv_Operate(uint16_t duty, int32_t vBat, MPPT_Measurement *m)
+{
+	double volts = pv_ArrayVoltage(duty, vBat);
+	double amps = 0;
+
+	if (volts >= pv_OpenCircuit())
+		volts = pv_OpenCircuit();
+	else
+		amps = pv_Current(volts);
+
+	m->vSolar = (int32_t)lround(volts * 1000) + noise(noiseMv);
+	m->iSolar = (int32_t)lround(amps * 1000) + noise(noiseMa);
+	m->vBat = vBat;
+	m->iBat = (int32_t)lround(volts * amps * PV_CONVERTER_EFF * 1e6 / vBat);
+
+	if (m->iSolar < 0)
+		m->iSolar = 0;
+}
+
+// Most array power (mW) any duty in MIN_DUTY_CYCLE..MAX_DUTY_CYCLE gets with the battery at vBat mV, and that duty
+int32_t pv_BestDuty(int32_t vBat, uint16_t *duty)
+{
+	double volts, watts, best = 0;
+	uint16_t d;
+
+	*duty = DUTY_FINE(MAX_DUTY_CYCLE);
+
+	for (d = DUTY_FINE(MIN_DUTY_CYCLE); d <= DUTY_FINE(MAX_DUTY_CYCLE); d++)
+	{
+		volts = pv_ArrayVoltage(d, vBat);
+		watts = volts * pv_Current(volts);
+
+		if (watts > best)
+		{
+			best = watts;
+			*duty = d;
+		}
+	}
+
+	return (int32_t)lround(best * 1000);
+}
@@ -0,0 +1,50 @@
+/** pv_model.h
+ * Header file for the host model of the solar array and the converter operating point
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef PV_MODEL_H_
+#define PV_MODEL_H_
+
+#include <stdint.h>
+
+#include "mppt_strategy.h"
+
+// The array: a 36 cell string with a bypass diode across every PV_CELLS_PER_GROUP cells
+#define PV_GROUPS			9
+#define PV_CELLS_PER_GROUP	4
+
+#define PV_ISC_STC			9.0		// A at 1000 W/m2
+#define PV_VOC_STC			19.8	// V at 1000 W/m2
+#define PV_IDEALITY			1.3
+#define PV_RS_PER_GROUP		0.03	// Ohm
+#define PV_BYPASS_DROP		0.5		// V across a conducting bypass diode
+
+#define PV_CONVERTER_EFF	0.97	// Converter efficiency for the battery current
+
+void pv_SetIrradiance(double);
+void pv_SetShading(const double *);
+void pv_SetNoise(int32_t, int32_t);
+
+double pv_Voltage(double);
+double pv_Current(double);
+double pv_OpenCircuit(void);
+double pv_MaxPower(double *);
+
+double pv_ArrayVoltage(uint16_t, int32_t);
+void pv_Operate(uint16_t, int32_t, MPPT_Measurement *);
+int32_t pv_BestDuty(int32_t, uint16_t *);
+
+#endif /* PV_MODEL_H_ */
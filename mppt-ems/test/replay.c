@@ -0,0 +1,159 @@
+/** replay.c
+ * Source file for the host replay of captured ADC frames through the firmware
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The firmware (mppt.c) boots on the virtual clock (sim_host.c) with the plant model switched out: the ADC converts
+ * the captured channels instead, the first record in the first published frame and every record as many frames after
+ * it as it was captured after the first one. Between records (a capture decimated by more than 1) the ADC holds the
+ * last one. The frames go through the same acquisition, getADCreadings(), control step and charge stages as on the
+ * target, and the capture tap compares the duty cycle and the CAPTURE_x flags that came out of every recorded frame
+ * with the record. A difference is written as a CSV row:
+ *   record, frame, tick          the record, its frame number and HAL_GetTick() as recorded
+ *   duty, replay_duty            the duty cycle in 1/16 counts, recorded and replayed
+ *   flags, replay_flags          the CAPTURE_x flags, recorded and replayed
+ * The firmware's state is not seeded from the capture, it boots: a capture that starts from boot replays frame for
+ * frame, one started in the middle of a session differs until the stages and the strategy have caught up with it (the
+ * last difference tells where). The firmware boots once per process, so replay_Run() can only be called once.
+ */
+
+#include "replay.h"
+#include "sim_host.h"
+
+#include <string.h>
+
+// Virtual time run at a time until the firmware has published the last record, and allowed for the boot
+#define REPLAY_STEP_MS		1000
+#define REPLAY_BOOT_MS		5000
+
+static const CAPTURE_Record *records;
+static uint32_t recordCount;
+static uint32_t cursor;				// Record the ADC converts now
+static uint32_t cursorOffset;		// Frames between the first record and the cursor
+static uint32_t lastOffset;
+static FILE *diffOut;
+static REPLAY_Diff *diff;
+
+
+// Frames between record index and the next one
+static uint32_t replay_Gap(uint32_t index)
+{
+	return (uint16_t)(records[index + 1].frame - records[index].frame);
+}
+
+// The record for the frame the ADC converts next. The first published frame (sequence 1) gets the first record.
+static void replay_Source(uint16_t *counts)
+{
+	uint32_t offset = adcAcq_GetSequence();
+
+	while ( (cursor + 1 < recordCount) && (cursorOffset + replay_Gap(cursor) <= offset) )
+	{
+		cursorOffset += replay_Gap(cursor);
+		cursor++;
+	}
+
+	memcpy(counts, records[cursor].channel, sizeof(records[cursor].channel));
+}
+
+static void replay_Tap(const ADC_Frame *frame, uint32_t tick, uint16_t duty, uint8_t flags)
+{
+	const CAPTURE_Record *record = &records[cursor];
+	bool differs = false;
+
+	UNUSED(tick);
+
+	if (frame->sequence - 1 != cursorOffset)
+		return;
+
+	diff->compared++;
+
+	if (memcmp(frame->channel, record->channel, sizeof(record->channel)) != 0)
+		diff->inputMismatches++;
+
+	if (duty != record->duty)
+	{
+		diff->dutyMismatches++;
+		differs = true;
+	}
+
+	if (flags != record->flags)
+	{
+		diff->flagMismatches++;
+		differs = true;
+	}
+
+	if (!differs)
+		return;
+
+	if (diff->first == recordCount)
+		diff->first = cursor;
+
+	diff->last = cursor;
+
+	if ( (diffOut != NULL) && (diff->dutyMismatches + diff->flagMismatches - 1 < REPLAY_DIFF_ROWS) )
+	{
+		fprintf(diffOut, "%u,%u,%u,%u,%u,%u,%u\n", cursor, record->frame, record->tick, record->duty, duty,
+			record->flags, flags);
+	}
+}
+
+/** Replays count records captured in a row through the firmware, and fills in result. The first REPLAY_DIFF_ROWS
+ * records that differ are written to out as CSV, if it isn't NULL.
+ */
+void replay_Run(const CAPTURE_Record *capture, uint32_t count, FILE *out, REPLAY_Diff *result)
+{
+	uint32_t i, ms = 0;
+
+	records = capture;
+	recordCount = count;
+	cursor = 0;
+	cursorOffset = 0;
+	lastOffset = 0;
+	diffOut = out;
+	diff = result;
+
+	for (i = 0; i + 1 < count; i++)
+		lastOffset += replay_Gap(i);
+
+	memset(result, 0, sizeof(REPLAY_Diff));
+	result->records = count;
+	result->first = count;
+	result->last = count;
+
+	if (out != NULL)
+		fprintf(out, "record,frame,tick,duty,replay_duty,flags,replay_flags\n");
+
+	if (count == 0)
+		return;
+
+	sim_SetFrameSource(replay_Source);
+	sim_SetCaptureTap(replay_Tap);
+
+	while ( (result->compared < count) && (ms < REPLAY_BOOT_MS + (lastOffset + 1) * SIM_FRAME_NS / SIM_MS_NS) )
+	{
+		sim_Run(REPLAY_STEP_MS, NULL);
+		ms += REPLAY_STEP_MS;
+	}
+
+	sim_SetCaptureTap(NULL);
+	sim_SetFrameSource(NULL);
+}
+
+// One row, -1 for no difference: records,compared,duty_mismatches,flag_mismatches,input_mismatches,first_record,last_record
+void replay_WriteSummary(const REPLAY_Diff *result, FILE *out)
+{
+	fprintf(out, "records,compared,duty_mismatches,flag_mismatches,input_mismatches,first_record,last_record\n");
+	fprintf(out, "%u,%u,%u,%u,%u,%d,%d\n", result->records, result->compared, result->dutyMismatches,
+		result->flagMismatches, result->inputMismatches, (result->first == result->records) ? -1 : (int)result->first,
+		(result->last == result->records) ? -1 : (int)result->last);
+}
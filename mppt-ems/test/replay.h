@@ -0,0 +1,43 @@
+/** replay.h
+ * Header file for the host replay of captured ADC frames through the firmware
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "capture.h"
+
+// Rows replay_Run() writes at most, the differences after them are only counted
+#define REPLAY_DIFF_ROWS	20
+
+typedef struct
+{
+	uint32_t records;
+	uint32_t compared;				// Records the firmware got to
+	uint32_t dutyMismatches;		// Records the replay gave another duty cycle, or other CAPTURE_x flags
+	uint32_t flagMismatches;
+	uint32_t inputMismatches;		// Records whose frame didn't come out of the ADC path as it went in
+	uint32_t first;					// Index of the first and of the last record that differed, compared if none
+	uint32_t last;
+} REPLAY_Diff;
+
+void replay_Run(const CAPTURE_Record *, uint32_t, FILE *, REPLAY_Diff *);
+void replay_WriteSummary(const REPLAY_Diff *, FILE *);
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,443 @@
+/** sim_host.c
+ * Host target that runs the whole firmware (mppt.c) on a virtual clock against the plant model
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * mppt.c is built with its main() renamed firmware_main() and runs unchanged on a context of its own, on top of the
+ * HAL stand-in (hal_host.c). This file is the rest of the board. It keeps a virtual clock in nS and plays the hardware
+ * events in time order, through the firmware's own interrupt handlers where it has them:
+ *   every mS      SysTick_Handler() and the TIM9 update (TIM1_BRK_TIM9_IRQHandler())
+ *   every frame   the plant model (plant_model.c) runs for the frame with what the firmware drives (the TIM1 outputs,
+ *                 the average of the duty cycle dither table, the array, bypass, load and fan pins), one injected
+ *                 conversion if adc_sched.c armed one, then the DMA fills the next half buffer with the readings in
+ *                 ADC counts and raises the half or full transfer callback. With a frame source set, the counts come
+ *                 from it instead of the plant, e.g. recorded frames played back (replay.c).
+ *   TIM11 CC1     when the counter reaches CCR1, or right away for a CC1G event (TIM1_TRG_COM_TIM11_IRQHandler())
+ *   USART1        a transmit completes 10 bit times per byte after it started, at the firmware's baud rate, and
+ *                 queued input arrives a byte at a time through USART1_IRQHandler()
+ * The clock only moves between main loop passes (sched_Run() is wrapped, and every pass moves it to the next event),
+ * inside delay_us() and inside adcAcq_WaitFrames(), all three wrapped by the linker. capture_Frame() is wrapped too,
+ * so a capture tap sees every frame the control step ran on, with the duty cycle and flags that resulted from it. The firmware's code takes no
+ * virtual time, so the profiler and the latency counters read the clock as it was when an interrupt was raised.
+ * sim_Run() switches to the firmware's context and back once the clock has run the time asked for; the next call
+ * carries on where the firmware left off.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "stm32f4xx_it.h"
+#include "sim_host.h"
+#include "adc_acq.h"
+#include "capture.h"
+#include "converter.h"
+#include "measure.h"
+
+#include <ucontext.h>
+
+#define SIM_NEVER			UINT64_MAX
+#define SIM_STACK			(256 * 1024)
+
+extern ADC_HandleTypeDef hadc1;
+extern DMA_HandleTypeDef hdma_adc1;
+extern UART_HandleTypeDef huart1;
+
+void __real_sched_Run(void);
+void __real_capture_Frame(const ADC_Frame *, uint32_t, uint16_t, uint8_t);
+
+static ucontext_t hostContext, firmwareContext;
+static uint8_t firmwareStack[SIM_STACK];
+static bool started;
+
+static uint64_t nowNs, endNs;
+static uint64_t nextTick, nextFrame, uartDone = SIM_NEVER, nextRx = SIM_NEVER;
+static void (*secondHook)(uint32_t);
+static void (*uartOutput)(const uint8_t *, uint32_t);
+static void (*frameSource)(uint16_t *);
+static SIM_CaptureTap captureTap;
+
+static uint32_t frames;
+static PLANT_Drive drive;
+static PLANT_Readings readings;
+
+static uint8_t rxQueue[256];
+static uint16_t rxHead, rxTail;
+
+
+static uint64_t earliest(uint64_t a, uint64_t b)
+{
+	return (a < b) ? a : b;
+}
+
+static uint64_t byteNs(void)
+{
+	return 10 * 1000000000ULL / huart1.Init.BaudRate;
+}
+
+static uint16_t clampCounts(int64_t counts)
+{
+	if (counts < 0)
+		return 0;
+
+	if (counts > 4095)
+		return 4095;
+
+	return (uint16_t)counts;
+}
+
+// The inverses of the measure.c scales
+static uint16_t voltsToCounts(int32_t milliVolts, uint8_t gain)
+{
+	return clampCounts(((int64_t)milliVolts * gain * 65536 + MEAS_MV_PER_COUNT_Q16 / 2) / MEAS_MV_PER_COUNT_Q16);
+}
+
+static uint16_t ampsToCounts(int32_t milliAmps)
+{
+	return clampCounts(((int64_t)milliAmps * 65536 + MEAS_MA_PER_COUNT_Q16 / 2) / MEAS_MA_PER_COUNT_Q16);
+}
+
+static uint16_t degreesToCounts(int32_t centiDegrees)
+{
+	return clampCounts(((int64_t)(centiDegrees + MEAS_CC_OFFSET) * 65536 + MEAS_CC_PER_COUNT_Q16 / 2) / MEAS_CC_PER_COUNT_Q16);
+}
+
+// Duty cycle in 1/16 counts TIM1 puts out: the average over the dither table while the update DMA runs, 0 while off
+static uint16_t sim_Duty(void)
+{
+	const uint16_t *table;
+	uint32_t sum = 0;
+	uint8_t k;
+
+	if (!(TIM1->CCER & TIM_CCER_CC1E))
+		return 0;
+
+	if ( (TIM1->DIER & TIM_DMA_UPDATE) && (DMA2_Stream5->CR & DMA_SxCR_EN) )
+	{
+		table = (const uint16_t *)DMA2_Stream5->M0AR;
+
+		for (k = 0; k < DUTY_FINE(1); k++)
+			sum += table[2 * k];
+
+		return sum;
+	}
+
+	return DUTY_FINE(TIM1->CCR1);
+}
+
+static void sim_ReadDrive(void)
+{
+	drive.duty = sim_Duty();
+	drive.arrayOn = host_GetPin(GPIOC, GPIO_PIN_9);
+	drive.bypass = host_GetPin(GPIOB, GPIO_PIN_11);
+	drive.loadOn = host_GetPin(GPIOB, GPIO_PIN_1);
+	drive.fanOn = host_GetPin(GPIOB, GPIO_PIN_2);
+}
+
+// The plant's readings in ADC counts, indexed as in ADC_Frame.channel
+static void sim_Counts(uint16_t *counts)
+{
+	counts[0] = voltsToCounts(readings.vBat, 2);
+	counts[1] = voltsToCounts(readings.vSolar, 2);
+	counts[2] = ampsToCounts(readings.iBat);
+	counts[3] = ampsToCounts(readings.iSolar);
+	counts[4] = voltsToCounts(readings.vLoad, 1);
+	counts[5] = degreesToCounts(readings.ambient);
+	counts[6] = degreesToCounts(readings.mosfet);
+	counts[7] = ampsToCounts(readings.iLoad);
+}
+
+// The conversion adc_sched.c armed the injected group for, if any
+static void sim_Injected(const uint16_t *counts)
+{
+	uint32_t jsqr = ADC1->JSQR;
+
+	if ( !(ADC1->CR2 & ADC_CR2_JEXTEN) || !(ADC1->CR1 & ADC_CR1_JEOCIE) )
+		return;
+
+	if (jsqr == ADC_JSQR(ADC_CHANNEL_4, 1, 1))
+		ADC1->JDR1 = counts[4];
+	else if (jsqr == ADC_JSQR(ADC_CHANNEL_6, 1, 1))
+		ADC1->JDR1 = counts[5];
+	else if (jsqr == ADC_JSQR(ADC_CHANNEL_7, 1, 1))
+		ADC1->JDR1 = counts[6];
+	else
+		ADC1->JDR1 = counts[7];
+
+	HAL_ADCEx_InjectedConvCpltCallback(&hadc1);
+}
+
+// The plant runs for a frame, and the DMA fills the next half buffer with what the ADC converted meanwhile
+static void sim_Frame(void)
+{
+	uint16_t *buffer = host_AdcBuffer();
+	uint16_t half = ADC_ACQ_BUFFER_SIZE / 2, first, i;
+	uint16_t counts[ADC_ACQ_CHANNELS];
+
+	sim_ReadDrive();
+
+	if (frameSource != NULL)
+	{
+		frameSource(counts);
+	}
+	else
+	{
+		plant_Run(&drive, SIM_FRAME_NS * 1e-9, &readings);
+		sim_Counts(counts);
+	}
+
+	sim_Injected(counts);
+
+	if (buffer == NULL)
+		return;
+
+	first = (frames & 1) ? half : 0;
+
+	for (i = 0; i < half; i++)
+		buffer[first + i] = counts[i % ADC_ACQ_REGULAR_CHANNELS];
+
+	hdma_adc1.Instance->NDTR = (first == 0) ? half : ADC_ACQ_BUFFER_SIZE;
+	frames++;
+
+	if (first == 0)
+		HAL_ADC_ConvHalfCpltCallback(&hadc1);
+	else
+		HAL_ADC_ConvCpltCallback(&hadc1);
+}
+
+static void sim_Tick(void)
+{
+	SysTick_Handler();
+
+	TIM9->SR |= TIM_FLAG_UPDATE;
+	TIM1_BRK_TIM9_IRQHandler();
+
+	if ( (secondHook != NULL) && (HAL_GetTick() % 1000 == 0) )
+		secondHook(HAL_GetTick() / 1000);
+}
+
+// When TIM11 next raises CC1, if its interrupt is on
+static uint64_t sim_Tim11Due(void)
+{
+	uint64_t us = nowNs / 1000;
+
+	if (!(TIM11->DIER & TIM_IT_CC1))
+		return SIM_NEVER;
+
+	if (TIM11->EGR & TIM_EGR_CC1G)
+		return nowNs;
+
+	return (us + (uint16_t)(TIM11->CCR1 - (uint16_t)us - 1) + 1) * 1000;
+}
+
+static void sim_Tim11(void)
+{
+	TIM11->EGR &= ~TIM_EGR_CC1G;
+	TIM11->SR |= TIM_FLAG_CC1;
+	TIM1_TRG_COM_TIM11_IRQHandler();
+}
+
+static void sim_UartDone(void)
+{
+	uartDone = SIM_NEVER;
+
+	if (uartOutput != NULL)
+		uartOutput(host_UartLog(), host_UartLogLength());
+
+	host_UartLogClear();
+	host_UartComplete();
+}
+
+static void sim_Rx(void)
+{
+	USART1->DR = rxQueue[rxTail];
+	USART1->SR |= USART_SR_RXNE;
+	rxTail = (rxTail + 1) % sizeof(rxQueue);
+
+	USART1_IRQHandler();
+
+	USART1->SR &= ~USART_SR_RXNE;
+	nextRx = (rxTail != rxHead) ? nowNs + byteNs() : SIM_NEVER;
+}
+
+static void sim_SetClock(uint64_t ns)
+{
+	nowNs = ns;
+	TIM11->CNT = (nowNs / 1000) & 0xffff;
+	DWT->CYCCNT = (uint32_t)(nowNs / 10);
+}
+
+// Plays the next hardware event, if it comes no later than until, and returns false if there is none
+static bool sim_Event(uint64_t until)
+{
+	uint64_t tim11 = sim_Tim11Due();
+	uint64_t next;
+
+	// A transmit the firmware started since the last event ends after its bytes have gone out
+	if ( host_UartBusy() && (uartDone == SIM_NEVER) )
+		uartDone = nowNs + host_UartLogLength() * byteNs();
+
+	next = earliest(earliest(nextTick, nextFrame), earliest(tim11, earliest(uartDone, nextRx)));
+
+	if (next > until)
+		return false;
+
+	sim_SetClock(next);
+
+	if (next == nextTick)
+	{
+		nextTick += SIM_MS_NS;
+		sim_Tick();
+	}
+	else if (next == nextFrame)
+	{
+		nextFrame += SIM_FRAME_NS;
+		sim_Frame();
+	}
+	else if (next == tim11)
+		sim_Tim11();
+	else if (next == uartDone)
+		sim_UartDone();
+	else
+		sim_Rx();
+
+	return true;
+}
+
+static void sim_Advance(uint64_t until)
+{
+	while (sim_Event(until))
+		;
+
+	sim_SetClock(until);
+}
+
+// A pass of the main loop, then the clock moves on to the next event. Back to sim_Run() once its time is up.
+void __wrap_sched_Run(void)
+{
+	__real_sched_Run();
+
+	if (nowNs >= endNs)
+		swapcontext(&firmwareContext, &hostContext);
+
+	sim_Event(SIM_NEVER);
+}
+
+void __wrap_delay_us(uint32_t usDelay)
+{
+	sim_Advance(nowNs + usDelay * 1000ULL);
+}
+
+// The frames come from the clock moving on
+bool __wrap_adcAcq_WaitFrames(uint8_t count, uint32_t timeoutMs)
+{
+	uint32_t sequence = adcAcq_GetSequence();
+	uint64_t timeout = nowNs + timeoutMs * SIM_MS_NS;
+
+	while ( ((adcAcq_GetSequence() - sequence) < count) && (nowNs < timeout) )
+		sim_Event(SIM_NEVER);
+
+	return (adcAcq_GetSequence() - sequence) >= count;
+}
+
+void __wrap_capture_Frame(const ADC_Frame *frame, uint32_t tick, uint16_t duty, uint8_t flags)
+{
+	if (captureTap != NULL)
+		captureTap(frame, tick, duty, flags);
+
+	__real_capture_Frame(frame, tick, duty, flags);
+}
+
+static void sim_Firmware(void)
+{
+	firmware_main();
+}
+
+/** Runs the firmware for ms of virtual time. second, if not NULL, is called at every whole second of the clock,
+ * between two hardware events, with the seconds since the start; it can change the sky and read the firmware's state.
+ * The first call boots the firmware at time 0.
+ */
+void sim_Run(uint32_t ms, void (*second)(uint32_t))
+{
+	endNs = nowNs + ms * SIM_MS_NS;
+	secondHook = second;
+
+	if (!started)
+	{
+		started = true;
+		sim_SetClock(0);
+		nextTick = SIM_MS_NS;
+		nextFrame = SIM_FRAME_NS;
+
+		getcontext(&firmwareContext);
+		firmwareContext.uc_stack.ss_sp = firmwareStack;
+		firmwareContext.uc_stack.ss_size = sizeof(firmwareStack);
+		firmwareContext.uc_link = &hostContext;
+		makecontext(&firmwareContext, sim_Firmware, 0);
+	}
+
+	swapcontext(&hostContext, &firmwareContext);
+}
+
+// The virtual clock in nS
+uint64_t sim_Now(void)
+{
+	return nowNs;
+}
+
+uint32_t sim_Frames(void)
+{
+	return frames;
+}
+
+// What the firmware drove, and what the plant gave the ADC, in the last frame
+const PLANT_Drive *sim_Drive(void)
+{
+	return &drive;
+}
+
+const PLANT_Readings *sim_Readings(void)
+{
+	return &readings;
+}
+
+// Bytes for USART1 to receive, one every 10 bit times
+void sim_UartReceive(const uint8_t *data, uint16_t length)
+{
+	while (length--)
+	{
+		rxQueue[rxHead] = *data++;
+		rxHead = (rxHead + 1) % sizeof(rxQueue);
+	}
+
+	if (nextRx == SIM_NEVER)
+		nextRx = nowNs + byteNs();
+}
+
+// Everything the firmware transmits goes to output, a transmit at a time as it completes
+void sim_SetUartOutput(void (*output)(const uint8_t *, uint32_t))
+{
+	uartOutput = output;
+}
+
+/** The ADC converts what source gives it instead of the plant's readings, from the next frame on: source fills
+ * ADC_ACQ_CHANNELS counts, indexed as in ADC_Frame.channel, for every regular and injected conversion of the frame.
+ * The plant doesn't run meanwhile. NULL goes back to the plant.
+ */
+void sim_SetFrameSource(void (*source)(uint16_t *))
+{
+	frameSource = source;
+}
+
+// tap sees every capture_Frame() call, i.e. every published frame once the control step is done with it
+void sim_SetCaptureTap(SIM_CaptureTap tap)
+{
+	captureTap = tap;
+}
@@ -0,0 +1,48 @@
+/** sim_host.h
+ * Header file for the host target that runs the whole firmware (mppt.c) on a virtual clock against the plant model
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ */
+
+// Prevent recursive inclusion
+#ifndef SIM_HOST_H_
+#define SIM_HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "plant_model.h"
+#include "adc_acq.h"
+
+// One published ADC frame: a half DMA buffer of one conversion per 5.12 uS PWM period
+#define SIM_FRAME_NS		655360ULL
+#define SIM_MS_NS			1000000ULL
+
+// A published frame, HAL_GetTick(), and the duty cycle and CAPTURE_x flags that resulted from it (see capture_Frame())
+typedef void (*SIM_CaptureTap)(const ADC_Frame *, uint32_t, uint16_t, uint8_t);
+
+// The firmware's main(), renamed for the host build of mppt.c
+int firmware_main(void);
+
+void sim_Run(uint32_t, void (*)(uint32_t));
+uint64_t sim_Now(void);
+uint32_t sim_Frames(void);
+const PLANT_Drive *sim_Drive(void);
+const PLANT_Readings *sim_Readings(void);
+
+void sim_UartReceive(const uint8_t *, uint16_t);
+void sim_SetUartOutput(void (*)(const uint8_t *, uint32_t));
+void sim_SetFrameSource(void (*)(uint16_t *));
+void sim_SetCaptureTap(SIM_CaptureTap);
+
+#endif /* SIM_HOST_H_ */
@@ -0,0 +1,68 @@
+/** test.h
+ * Header file for the host test checks
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every test is a program of its own. A failed check prints where it failed and the run carries on;
+ * test_Report() prints the totals and gives main() its exit status, so make stops at the first test that failed.
+ */
+
+// Prevent recursive inclusion
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+static unsigned testChecks;
+static unsigned testFailures;
+
+static inline int test_Check(int passed, const char *text, const char *file, int line)
+{
+	testChecks++;
+
+	if (!passed)
+	{
+		testFailures++;
+		printf("%s:%d: check failed: %s\n", file, line, text);
+	}
+
+	return passed;
+}
+
+static inline int test_CheckEqual(long long actual, long long expected, const char *text, const char *file, int line)
+{
+	testChecks++;
+
+	if (actual != expected)
+	{
+		testFailures++;
+		printf("%s:%d: check failed: %s is %lld, expected %lld\n", file, line, text, actual, expected);
+		return 0;
+	}
+
+	return 1;
+}
+
+#define CHECK(condition)				test_Check((condition) != 0, #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected)	test_CheckEqual((long long)(actual), (long long)(expected), #actual, __FILE__, __LINE__)
+
+// Prints the totals for the test called name and returns the exit status for main()
+static inline int test_Report(const char *name)
+{
+	printf("%s: %u checks, %u failed\n", name, testChecks, testFailures);
+
+	return (testFailures == 0) ? 0 : 1;
+}
+
+#endif /* TEST_H_ */
@@ -0,0 +1,281 @@
+/** test_adc_acq.c
+ * Host test for the ADC frame acquisition (adc_acq.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The test plays the ADC and DMA2 Stream 0: it fills a half of the circular buffer, moves NDTR on and calls the
+ * half transfer or transfer complete callback. Every sample of half n reads n % 512 + 512 * channel, so a published
+ * frame shows which half it came from and a frame put together from two halves doesn't add up.
+ * The last two runs raise the callbacks from a signal while the main context reads frames as fast as it can,
+ * which is how the target's DMA interrupt lands in the middle of adcAcq_GetFrame(). The test is built with
+ * -fno-builtin-memcpy and copies byte by byte (see memcpy() below), so a copy lasts long enough to be landed in.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "adc_acq.h"
+#include "adc_sched.h"
+#include "calibration.h"
+#include "test.h"
+
+#include <string.h>
+#include <time.h>
+#include <stddef.h>
+
+#define HALF			(ADC_ACQ_BUFFER_SIZE / 2)
+
+ADC_HandleTypeDef hadc1;
+DMA_HandleTypeDef hdma_adc1;
+
+extern void crc16_init(void);
+
+static uint32_t halves;					// Halves the DMA has filled
+static uint32_t callbackFrames;			// Frames adcAcq_FrameCallback() was given
+static uint32_t lastCallback;			// Sequence number of the last of them
+static uint32_t callbackGaps;
+static uint8_t burst;					// Halves per interrupt
+
+
+// Every copy adc_acq.c makes, slowed down to about 50 nS a byte
+void *memcpy(void *destination, const void *source, size_t length)
+{
+	volatile uint8_t *to = destination;
+	const uint8_t *from = source;
+	volatile uint8_t pause;
+
+	while (length--)
+	{
+		*to++ = *from++;
+
+		for (pause = 0; pause < 20; pause++)
+			;
+	}
+
+	return destination;
+}
+
+// Fills the next half of the DMA buffer and leaves the DMA position where the hardware has it at the callback
+static void dma_Fill(void)
+{
+	uint16_t *buffer = host_AdcBuffer();
+	uint16_t first = (halves & 1) ? HALF : 0;
+	uint16_t i;
+
+	for (i = 0; i < HALF; i++)
+		buffer[first + i] = (halves % 512) + 512 * (i % ADC_ACQ_REGULAR_CHANNELS);
+
+	halves++;
+	hdma_adc1.Instance->NDTR = (first == 0) ? HALF : ADC_ACQ_BUFFER_SIZE;
+}
+
+// The callback for the half dma_Fill() filled last
+static void dma_Interrupt(void)
+{
+	if (halves & 1)
+		HAL_ADC_ConvHalfCpltCallback(&hadc1);
+	else
+		HAL_ADC_ConvCpltCallback(&hadc1);
+}
+
+static void dma_Publish(void)
+{
+	dma_Fill();
+	dma_Interrupt();
+}
+
+static void dma_Burst(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < burst; i++)
+		dma_Publish();
+}
+
+void adcAcq_FrameCallback(const ADC_Frame *frame)
+{
+	if ( (callbackFrames != 0) && (frame->sequence != lastCallback + 1) )
+		callbackGaps++;
+
+	lastCallback = frame->sequence;
+	callbackFrames++;
+}
+
+// True if every regular channel of frame came from the same half
+static bool frame_Whole(const ADC_Frame *frame)
+{
+	uint8_t ch;
+
+	for (ch = 1; ch < ADC_ACQ_REGULAR_CHANNELS; ch++)
+	{
+		if (frame->channel[ch] != frame->channel[0] + 512 * ch)
+			return false;
+	}
+
+	return true;
+}
+
+static double seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void test_InOrder(void)
+{
+	ADC_Frame frame;
+	uint32_t i;
+	bool whole = true, latest = true;
+
+	CHECK_EQUAL(adcAcq_GetFrame(&frame), 0);
+
+	for (i = 1; i <= 1000; i++)
+	{
+		dma_Publish();
+
+		if (adcAcq_GetFrame(&frame) != i)
+			latest = false;
+
+		if ( !frame_Whole(&frame) || (frame.channel[0] != (halves - 1) % 512) )
+			whole = false;
+	}
+
+	CHECK(latest);
+	CHECK(whole);
+	CHECK_EQUAL(adcAcq_GetSequence(), 1000);
+	CHECK_EQUAL(callbackFrames, 1000);
+	CHECK_EQUAL(callbackGaps, 0);
+	CHECK_EQUAL(adcAcq_GetLostHalves(), 0);
+}
+
+// The callback for a half runs after the DMA has come back into it: the half is dropped and counted
+static void test_Lapped(void)
+{
+	ADC_Frame frame;
+	uint32_t sequence = adcAcq_GetSequence();
+	uint32_t frames = callbackFrames;
+
+	dma_Fill();
+	hdma_adc1.Instance->NDTR = (halves & 1) ? ADC_ACQ_BUFFER_SIZE - 5 : HALF - 5;
+	dma_Interrupt();
+
+	CHECK_EQUAL(adcAcq_GetLostHalves(), 1);
+	CHECK_EQUAL(adcAcq_GetSequence(), sequence);
+	CHECK_EQUAL(callbackFrames, frames);
+	CHECK_EQUAL(adcAcq_GetFrame(&frame), sequence);
+
+	// The next half on time publishes again
+	dma_Publish();
+
+	CHECK_EQUAL(adcAcq_GetSequence(), sequence + 1);
+	CHECK_EQUAL(adcAcq_GetLostHalves(), 1);
+}
+
+// An ADC overrun restarts the DMA from the top of the buffer, and the half transfer comes next
+static void test_Overrun(void)
+{
+	uint32_t sequence = adcAcq_GetSequence();
+
+	HAL_ADC_ErrorCallback(&hadc1);
+
+	CHECK_EQUAL(adcAcq_GetLostHalves(), 2);
+	CHECK(host_AdcBuffer() != NULL);
+	CHECK_EQUAL(hdma_adc1.Instance->NDTR, ADC_ACQ_BUFFER_SIZE);
+
+	halves = 0;
+	dma_Publish();
+	dma_Publish();
+
+	CHECK_EQUAL(adcAcq_GetSequence(), sequence + 2);
+	CHECK_EQUAL(adcAcq_GetLostHalves(), 2);
+}
+
+/** Reads frames in the main context for runTime S while a signal publishes halvesPerInterrupt halves every 20 uS.
+ * No frame the main context gets may be torn or older than the one before. Returns the halves lost while it ran.
+ */
+static uint32_t test_Preempted(uint8_t halvesPerInterrupt, double runTime)
+{
+	ADC_Frame frame;
+	uint32_t lost = adcAcq_GetLostHalves();
+	uint32_t sequence, last = 0, reads = 0, torn = 0, backwards = 0;
+	int32_t offset = -1;
+	double end;
+
+	burst = halvesPerInterrupt;
+	callbackGaps = 0;
+
+	// channel[0] - sequence stays the same from here on, as no half is lapped
+	adcAcq_GetFrame(&frame);
+	offset = ((int32_t)frame.channel[0] - (int32_t)frame.sequence) & 511;
+
+	host_Interrupts(dma_Burst, 20);
+	end = seconds() + runTime;
+
+	while (seconds() < end)
+	{
+		sequence = adcAcq_GetFrame(&frame);
+		reads++;
+
+		if ( !frame_Whole(&frame) || ((((int32_t)frame.channel[0] - (int32_t)sequence) & 511) != offset) )
+			torn++;
+
+		if (sequence < last)
+			backwards++;
+
+		last = sequence;
+	}
+
+	host_Interrupts(NULL, 0);
+
+	printf("  %u half / interrupt: %u reads, %u frames published, %u lost\n", halvesPerInterrupt, reads,
+		adcAcq_GetSequence(), adcAcq_GetLostHalves() - lost);
+
+	CHECK(reads > 1000);
+	CHECK_EQUAL(torn, 0);
+	CHECK_EQUAL(backwards, 0);
+	CHECK_EQUAL(callbackGaps, 0);
+
+	// A publish that found its slot held leaves the newest frame to the callback only
+	CHECK(adcAcq_GetSequence() - adcAcq_GetFrame(&frame) <= 1);
+
+	return adcAcq_GetLostHalves() - lost;
+}
+
+int main(void)
+{
+	uint8_t blank[sizeof(CAL_Record)];
+
+	crc16_init();
+	memset(blank, 0xff, sizeof(blank));
+	calib_Load(blank);
+
+	hdma_adc1.Instance = DMA2_Stream0;
+	hadc1.Instance = ADC1;
+	hadc1.DMA_Handle = &hdma_adc1;
+
+	adcSched_Init(&hadc1);
+	adcAcq_Start(&hadc1);
+
+	test_InOrder();
+	test_Lapped();
+	test_Overrun();
+
+	// One publish per interrupt only needs the held slot when the host delivers two signals inside one copy
+	test_Preempted(1, 0.3);
+
+	// Two in a row while a copy is held: the second one has to skip the slot, and is counted
+	CHECK(test_Preempted(2, 0.3) > 0);
+
+	return test_Report("adc_acq");
+}
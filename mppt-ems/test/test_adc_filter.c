@@ -0,0 +1,182 @@
+/** test_adc_filter.c
+ * Host test for the outlier rejecting decimation filter (adc_filter.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Both builds of the filter (the plain C lanes and the SIMD path, see adc_filter_simd.c) get the same random bursts
+ * for every mode, channel count and pass count, and have to agree with each other and with a per-channel reference
+ * that sorts every window instead of using the min / max networks.
+ */
+
+#include "adc_filter.h"
+#include "adc_filter_simd.h"
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PASSES		64
+#define ROUNDS			2000
+
+static uint32_t burstWords[MAX_PASSES * ADC_FILTER_MAX_CHANNELS / 2];	// 32 bit aligned, as the DMA buffer is
+static uint16_t *burst = (uint16_t *)burstWords;
+
+
+static int compare(const void *a, const void *b)
+{
+	return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
+// The filter written out per channel
+static uint16_t reference(uint8_t passes, uint8_t channels, uint8_t mode, uint8_t ch)
+{
+	uint16_t window[5];
+	uint32_t sum = 0;
+	uint16_t value, low = 0xffff, high = 0;
+	uint8_t size, used = 0, i, k;
+
+	size = (mode == ADC_FILTER_MEDIAN5) ? 5 : (mode == ADC_FILTER_MEDIAN3) ? 3 : 1;
+
+	if (passes < size)
+		size = 1;
+
+	for (i = 0; i + size <= passes; i++)
+	{
+		for (k = 0; k < size; k++)
+			window[k] = burst[(i + k) * channels + ch];
+
+		qsort(window, size, sizeof(window[0]), compare);
+		value = window[size / 2];
+
+		sum += value;
+		used++;
+
+		if (value < low)
+			low = value;
+
+		if (value > high)
+			high = value;
+	}
+
+	if ( (mode == ADC_FILTER_TRIMMED) && (used > 2) )
+	{
+		sum -= low + high;
+		used -= 2;
+	}
+
+	return sum / used;
+}
+
+// 12 bit noise around a level per channel, with the odd spike to the rails
+static void randomBurst(uint8_t passes, uint8_t channels)
+{
+	uint16_t i;
+
+	for (i = 0; i < passes * channels; i++)
+	{
+		if (rand() % 16 == 0)
+			burst[i] = (rand() & 1) ? 4095 : 0;
+		else
+			burst[i] = 300 * (i % channels) + rand() % 200;
+	}
+}
+
+static void test_Equivalence(void)
+{
+	uint16_t plain[ADC_FILTER_MAX_CHANNELS], simd[ADC_FILTER_MAX_CHANNELS];
+	uint32_t runs = 0, differ = 0, wrong = 0;
+	uint8_t mode, channels, passes, ch;
+	uint16_t round;
+
+	srand(1);
+
+	for (mode = ADC_FILTER_MEAN; mode <= ADC_FILTER_MEDIAN5; mode++)
+	{
+		for (channels = 2; channels <= ADC_FILTER_MAX_CHANNELS; channels += 2)
+		{
+			for (round = 0; round < ROUNDS; round++)
+			{
+				passes = 1 + round % MAX_PASSES;
+				randomBurst(passes, channels);
+
+				adcFilter_Run(burst, passes, channels, mode, plain);
+				adcFilter_RunSimd(burst, passes, channels, mode, simd);
+				runs++;
+
+				if (memcmp(plain, simd, channels * sizeof(plain[0])) != 0)
+					differ++;
+
+				for (ch = 0; ch < channels; ch++)
+				{
+					if (plain[ch] != reference(passes, channels, mode, ch))
+						wrong++;
+				}
+			}
+		}
+	}
+
+	printf("  %u bursts: %u where the paths differ, %u channel results off the reference\n", runs, differ, wrong);
+
+	CHECK_EQUAL(differ, 0);
+	CHECK_EQUAL(wrong, 0);
+}
+
+// Full scale on every sample: the packed lanes spill before they overflow
+static void test_FullScale(void)
+{
+	uint16_t plain[ADC_FILTER_MAX_CHANNELS], simd[ADC_FILTER_MAX_CHANNELS];
+	uint16_t i;
+
+	for (i = 0; i < MAX_PASSES * ADC_FILTER_MAX_CHANNELS; i++)
+		burst[i] = 4095;
+
+	adcFilter_Run(burst, MAX_PASSES, ADC_FILTER_MAX_CHANNELS, ADC_FILTER_MEAN, plain);
+	adcFilter_RunSimd(burst, MAX_PASSES, ADC_FILTER_MAX_CHANNELS, ADC_FILTER_MEAN, simd);
+
+	CHECK_EQUAL(plain[0], 4095);
+	CHECK_EQUAL(plain[ADC_FILTER_MAX_CHANNELS - 1], 4095);
+	CHECK_EQUAL(simd[0], 4095);
+	CHECK_EQUAL(simd[ADC_FILTER_MAX_CHANNELS - 1], 4095);
+}
+
+// One switching spike in a flat burst moves the mean, and none of the rejecting modes
+static void test_Spike(void)
+{
+	uint16_t out[4];
+	uint8_t mode;
+	uint16_t i;
+
+	for (i = 0; i < 32 * 4; i++)
+		burst[i] = 1000;
+
+	burst[9 * 4 + 2] = 4095;
+
+	adcFilter_RunSimd(burst, 32, 4, ADC_FILTER_MEAN, out);
+	CHECK_EQUAL(out[2], 1000 + 3095 / 32);
+
+	for (mode = ADC_FILTER_TRIMMED; mode <= ADC_FILTER_MEDIAN5; mode++)
+	{
+		adcFilter_RunSimd(burst, 32, 4, mode, out);
+		CHECK_EQUAL(out[2], 1000);
+		CHECK_EQUAL(out[3], 1000);
+	}
+}
+
+int main(void)
+{
+	test_Equivalence();
+	test_FullScale();
+	test_Spike();
+
+	return test_Report("adc_filter");
+}
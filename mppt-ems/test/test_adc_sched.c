@@ -0,0 +1,206 @@
+/** test_adc_sched.c
+ * Host test for the slow channel schedule on the injected group (adc_sched.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The test publishes frames at the rate the regular sequence makes them (one every 32 * 4 PWM periods) on the
+ * virtual clock, and calls adcSched_Collect() and adcSched_Poll() for each as adc_acq.c does. Whenever the injected
+ * trigger is armed, the next CC4 event converts the channel in JSQR: JDR1 gets a value that tells the channels apart
+ * and the JEOC callback runs. The conversion counts over a simulated minute have to come out at the rates
+ * adcSched_GetRate() reports.
+ * Before that, every slow channel has to get its own sample time from the table, and pass adcSched_Verify() with the
+ * triggers where MX_TIM1_Init() puts them. Last, with the injected trigger moved into the regular conversion, every
+ * channel is left out of the schedule: none is converted and their rates read 0.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "adc_sched.h"
+#include "adc_acq.h"
+#include "adc_trigger.h"
+#include "converter.h"
+#include "test.h"
+
+#define PWM_NS			(2 * TIM1_PERIOD * 10)
+#define FRAME_NS		(PWM_NS * ADC_ACQ_FRAMES_PER_HALF * ADC_ACQ_REGULAR_CHANNELS)
+
+ADC_HandleTypeDef hadc1;
+
+static uint64_t now;					// nS
+static uint32_t injected;				// Conversions the ADC made
+static uint16_t regularTrigger, injectedTrigger;
+
+
+// ADC channel the injected group is set up to convert
+static uint8_t jsqrChannel(void)
+{
+	return (hadc1.Instance->JSQR >> 15) & 0x1f;
+}
+
+// One frame: the scheduler's share of adcAcq_Publish(), then the injected conversion if one was armed
+static void frame(uint16_t *channel)
+{
+	now += FRAME_NS;
+	hostTick = now / 1000000;
+
+	adcSched_Collect(channel);
+	adcSched_Poll();
+
+	if ( ((hadc1.Instance->CR2 & ADC_CR2_JEXTEN) != 0) && ((hadc1.Instance->CR1 & ADC_IT_JEOC) != 0) )
+	{
+		hadc1.Instance->JDR1 = 100 * jsqrChannel() + (injected & 3);
+		injected++;
+		HAL_ADCEx_InjectedConvCpltCallback(&hadc1);
+	}
+}
+
+static uint32_t conversions(uint8_t index)
+{
+	return adcSched_GetConversions(index);
+}
+
+// Sample time the ADC has for channel, ADC_SAMPLETIME_x
+static uint32_t sampleTime(uint32_t channel)
+{
+	return (hadc1.Instance->SMPR2 >> (3 * channel)) & 7;
+}
+
+// The triggers as MX_TIM1_Init() places them, for the longest sample time in the table
+static void test_Verify(void)
+{
+	CHECK_EQUAL(sampleTime(4), ADC_SCHED_LOAD_SAMPLETIME);
+	CHECK_EQUAL(sampleTime(6), ADC_SCHED_TEMP_SAMPLETIME);
+	CHECK_EQUAL(sampleTime(7), ADC_SCHED_TEMP_SAMPLETIME);
+	CHECK_EQUAL(sampleTime(8), ADC_SCHED_LOAD_SAMPLETIME);
+	CHECK_EQUAL(adcSched_SampleCycles(), 28);
+
+	regularTrigger = adcTrig_Select();
+	injectedTrigger = adcTrig_SelectInjected(regularTrigger, adcSched_SampleCycles());
+
+	CHECK(adcSched_Verify(injectedTrigger, regularTrigger));
+}
+
+static void test_Rates(void)
+{
+	uint16_t channel[ADC_ACQ_CHANNELS];
+	uint32_t before[ADC_ACQ_CHANNELS];
+	uint8_t i;
+
+	for (i = 4; i < ADC_ACQ_CHANNELS; i++)
+		before[i] = conversions(i);
+
+	// A minute of frames
+	while (now < 60ULL * 1000000000ULL)
+		frame(channel);
+
+	printf("  per second over 60 S:");
+
+	for (i = 4; i < ADC_ACQ_CHANNELS; i++)
+		printf(" ch%u %.2f (%lu configured)", i, (conversions(i) - before[i]) / 60.0, (unsigned long)adcSched_GetRate(i));
+
+	printf("\n");
+
+	for (i = 4; i < ADC_ACQ_CHANNELS; i++)
+	{
+		CHECK(conversions(i) - before[i] >= 60 * adcSched_GetRate(i) - 1);
+		CHECK(conversions(i) - before[i] <= 60 * adcSched_GetRate(i) + 1);
+	}
+
+	CHECK_EQUAL(adcSched_GetRate(4), 1000 / ADC_SCHED_LOAD_PERIOD_MS);
+	CHECK_EQUAL(adcSched_GetRate(5), 1000 / ADC_SCHED_TEMP_PERIOD_MS);
+	CHECK_EQUAL(adcSched_GetRate(0), 100000000 / (2 * TIM1_PERIOD) / ADC_ACQ_REGULAR_CHANNELS);
+	CHECK_EQUAL(injected, conversions(4) + conversions(5) + conversions(6) + conversions(7));
+
+	// Every slow channel lands at its frame index, averaged: JDR1 was 100 * ADC channel + 0..3
+	CHECK(channel[4] >= 400 && channel[4] <= 403);
+	CHECK(channel[5] >= 600 && channel[5] <= 603);
+	CHECK(channel[6] >= 700 && channel[6] <= 703);
+	CHECK(channel[7] >= 800 && channel[7] <= 803);
+}
+
+// After a stall longer than a period, a channel converts once and then picks its period up again
+static void test_Stall(void)
+{
+	uint16_t channel[ADC_ACQ_CHANNELS];
+	uint32_t before = conversions(4);
+	uint64_t end;
+
+	now += 50ULL * 1000000ULL;
+	end = now + 9ULL * 1000000ULL;
+
+	while (now < end)
+		frame(channel);
+
+	CHECK(conversions(4) - before <= 2);
+
+	before = conversions(4);
+	end = now + 1000ULL * 1000000ULL;
+
+	while (now < end)
+		frame(channel);
+
+	CHECK(conversions(4) - before >= 99);
+	CHECK(conversions(4) - before <= 101);
+}
+
+// A stray JEOC (from a conversion started before adcSched_Start()) is dropped
+static void test_Stray(void)
+{
+	uint32_t before = conversions(4) + conversions(5) + conversions(6) + conversions(7);
+
+	adcSched_Start();
+
+	hadc1.Instance->JDR1 = 4095;
+	HAL_ADCEx_InjectedConvCpltCallback(&hadc1);
+
+	CHECK_EQUAL(conversions(4) + conversions(5) + conversions(6) + conversions(7), before);
+	CHECK_EQUAL(hadc1.Instance->CR2 & ADC_CR2_JEXTEN, 0);
+}
+
+// An injected conversion that would run into the regular one is never armed
+static void test_Unfit(void)
+{
+	uint16_t channel[ADC_ACQ_CHANNELS];
+	uint32_t before = injected;
+	uint64_t end = now + 1000ULL * 1000000ULL;
+	uint8_t i;
+
+	CHECK(!adcSched_Verify(2 * TIM1_PERIOD - regularTrigger - 10, regularTrigger));
+
+	while (now < end)
+		frame(channel);
+
+	CHECK_EQUAL(injected, before);
+
+	for (i = 4; i < ADC_ACQ_CHANNELS; i++)
+		CHECK_EQUAL(adcSched_GetRate(i), 0);
+
+	// Placed right again, they are back
+	CHECK(adcSched_Verify(injectedTrigger, regularTrigger));
+	CHECK_EQUAL(adcSched_GetRate(4), 1000 / ADC_SCHED_LOAD_PERIOD_MS);
+}
+
+int main(void)
+{
+	hadc1.Instance = ADC1;
+
+	adcSched_Init(&hadc1);
+	adcSched_Start();
+
+	test_Verify();
+	test_Rates();
+	test_Stall();
+	test_Stray();
+	test_Unfit();
+
+	return test_Report("adc_sched");
+}
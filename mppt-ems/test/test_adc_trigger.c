@@ -0,0 +1,251 @@
+/** test_adc_trigger.c
+ * Host test for the ADC trigger placement (adc_trigger.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * adc_trigger.c works from the gate edge formulas in its header. This test doesn't: it runs TIM1 tick by tick the way
+ * the reference manual describes it (center aligned counter, PWM1 on channel 1, PWM2 on channel 2 at
+ * TIM1_PERIOD - CCR1, complementary outputs with the rising edges delayed by the dead time), finds where the four
+ * gate outputs actually switch, and checks the ADC sampling windows against those edges for every duty cycle:
+ * the regular one and the injected one of the slow channels (adc_sched.c), which must also leave the regular
+ * conversion alone.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "adc_trigger.h"
+#include "adc_sched.h"
+#include "converter.h"
+#include "test.h"
+
+#include <stdlib.h>
+
+#define PWM_TICKS		(2 * TIM1_PERIOD)
+#define MAX_EDGES		16
+
+// Counter value at tick t of a period, t = 0 at the valley
+static uint16_t counter(uint16_t t)
+{
+	t %= PWM_TICKS;
+
+	return (t <= TIM1_PERIOD) ? t : PWM_TICKS - t;
+}
+
+// The four gate outputs at tick t: bit 0 CH1, 1 CH1N, 2 CH2, 3 CH2N
+static uint8_t gates(uint16_t duty, uint16_t t)
+{
+	uint8_t out = 0;
+	uint8_t delayed1 = 1, delayed2 = 1, low1 = 1, low2 = 1;
+	bool ref1, ref2;
+	uint16_t k;
+
+	// A rising output needs its reference to have been in that state for the whole dead time
+	for (k = 0; k <= TIM1_DEADTIME; k++)
+	{
+		ref1 = counter(t + PWM_TICKS - k) < duty;								// PWM1, CCR1 = duty
+		ref2 = counter(t + PWM_TICKS - k) >= TIM1_PERIOD - duty;				// PWM2, CCR2 = P - duty
+
+		delayed1 &= ref1;
+		low1 &= !ref1;
+		delayed2 &= ref2;
+		low2 &= !ref2;
+	}
+
+	out |= delayed1 << 0;
+	out |= low1 << 1;
+	out |= delayed2 << 2;
+	out |= low2 << 3;
+
+	return out;
+}
+
+// Ticks in one period where any gate output switches
+static uint8_t edges(uint16_t duty, int16_t *edge)
+{
+	uint8_t count = 0;
+	uint16_t t;
+
+	for (t = 0; t < PWM_TICKS; t++)
+	{
+		if ( (gates(duty, t) != gates(duty, t + PWM_TICKS - 1)) && (count < MAX_EDGES) )
+			edge[count++] = t;
+	}
+
+	return count;
+}
+
+// Circular distance from edge to the window [start, start + length]
+static int16_t distance(int16_t edge, int16_t start, int16_t length)
+{
+	int16_t offset = ((edge - start) % PWM_TICKS + PWM_TICKS) % PWM_TICKS;
+
+	if (offset <= length)
+		return 0;
+
+	return ((offset - length) < (PWM_TICKS - offset)) ? (offset - length) : (PWM_TICKS - offset);
+}
+
+// Smallest distance between the simulated edges at duty and the window [start, start + length]
+static int16_t clearance(uint16_t duty, int16_t start, int16_t length)
+{
+	int16_t edge[MAX_EDGES];
+	int16_t nearest = PWM_TICKS;
+	int16_t d;
+	uint8_t count, i;
+
+	count = edges(duty, edge);
+
+	for (i = 0; i < count; i++)
+	{
+		d = distance(edge[i], start, length);
+
+		if (d < nearest)
+			nearest = d;
+	}
+
+	return nearest;
+}
+
+// The simulated outputs switch 8 times a period, where the formulas in adc_trigger.c put them
+static void test_Edges(void)
+{
+	int16_t edge[MAX_EDGES];
+	uint16_t duty;
+	bool eight = true, formula = true;
+
+	for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+	{
+		if (edges(duty, edge) != 8)
+			eight = false;
+
+		// Spot check: the trigger at the formula's clearance of a window right on the first phase 2 edge is 0
+		if (adcTrig_Clearance(duty, TIM1_PERIOD - duty - ADC_TRIG_LATENCY_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE) != 0)
+			formula = false;
+	}
+
+	CHECK(eight);
+	CHECK(formula);
+}
+
+// adcTrig_Clearance() agrees with the simulated edges to within the one tick the compare boundaries leave open
+static void test_Clearance(void)
+{
+	int16_t start, length = ADC_TRIG_SAMPLE_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+	uint16_t duty, trigger;
+	int32_t worst = 0;
+
+	for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+	{
+		for (trigger = 1; trigger < TIM1_PERIOD; trigger++)
+		{
+			start = trigger + ADC_TRIG_LATENCY_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+
+			if (abs(clearance(duty, start, length) - (int16_t)adcTrig_Clearance(duty, trigger)) > worst)
+				worst = abs(clearance(duty, start, length) - (int16_t)adcTrig_Clearance(duty, trigger));
+		}
+	}
+
+	CHECK(worst <= 1);
+}
+
+// The trigger MX_TIM1_Init() is given keeps every sample out of the keep-out at every duty cycle
+static void test_Selected(void)
+{
+	uint16_t trigger = adcTrig_Select();
+	int16_t start = trigger + ADC_TRIG_LATENCY_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+	int16_t length = ADC_TRIG_SAMPLE_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+	int16_t worst = PWM_TICKS, best = 0, c;
+	uint16_t duty, other;
+
+	for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+	{
+		c = clearance(duty, start, length);
+
+		if (c < worst)
+			worst = c;
+	}
+
+	// No other trigger does better in the simulation either
+	for (other = 1; other < TIM1_PERIOD; other++)
+	{
+		int16_t otherWorst = PWM_TICKS;
+
+		for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+		{
+			c = clearance(duty, other + ADC_TRIG_LATENCY_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE, length);
+
+			if (c < otherWorst)
+				otherWorst = c;
+		}
+
+		if (otherWorst > best)
+			best = otherWorst;
+	}
+
+	printf("  CCR3 = %u: sampling %d..%d ticks, %d ticks (%d nS) from the nearest gate edge, best possible %d\n",
+		trigger, start, start + length, worst, worst * 10, best);
+
+	CHECK(adcTrig_Verify(trigger));
+	CHECK(worst >= ADC_TRIG_KEEPOUT_TICKS);
+	CHECK(worst + 1 >= best);
+
+	// A trigger right on a switching edge fails the check
+	CHECK(!adcTrig_Verify(TIM1_PERIOD - MIN_DUTY_CYCLE));
+}
+
+// The injected trigger samples the slow channels clear of the edges too, and the two conversions never meet
+static void test_Injected(void)
+{
+	uint16_t regular = adcTrig_Select();
+	uint16_t injected = adcTrig_SelectInjected(regular, adcSched_SampleCycles());
+	int16_t start = PWM_TICKS - injected;
+	int16_t sample = start + ADC_TRIG_LATENCY_CYCLES * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+	int16_t length = adcSched_SampleCycles() * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+	int16_t end = start + (ADC_TRIG_LATENCY_CYCLES + adcSched_SampleCycles() + ADC_TRIG_CONVERSION_CYCLES) * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+	int16_t regularEnd = regular + (ADC_TRIG_LATENCY_CYCLES + ADC_TRIG_SAMPLE_CYCLES + ADC_TRIG_CONVERSION_CYCLES) * ADC_TRIG_TICKS_PER_ADC_CYCLE;
+	int16_t worst = PWM_TICKS, c;
+	uint16_t duty;
+
+	for (duty = MIN_DUTY_CYCLE; duty <= MAX_DUTY_CYCLE; duty++)
+	{
+		c = clearance(duty, sample, length);
+
+		if (c < worst)
+			worst = c;
+	}
+
+	printf("  CCR4 = %u: converting %d..%d ticks, sampling %d..%d, %d ticks from the nearest gate edge; regular %u..%d\n",
+		injected, start, end, sample, sample + length, worst, regular, regularEnd);
+
+	CHECK(adcTrig_VerifyInjected(injected, regular, adcSched_SampleCycles()));
+	CHECK(worst >= ADC_TRIG_KEEPOUT_TICKS);
+
+	// The injected conversion is over before the regular one starts, and starts after it has ended
+	CHECK(start >= regularEnd);
+	CHECK(end <= PWM_TICKS + regular);
+
+	// The 480 cycle sample the temperatures used to get spans almost two PWM periods, and fails both checks
+	CHECK(!adcTrig_VerifyInjected(injected, regular, 480));
+
+	// A trigger whose conversion runs into the regular one is never picked, nor passed
+	CHECK(!adcTrig_VerifyInjected(PWM_TICKS - regular - 10, regular, adcSched_SampleCycles()));
+}
+
+int main(void)
+{
+	test_Edges();
+	test_Clearance();
+	test_Selected();
+	test_Injected();
+
+	return test_Report("adc_trigger");
+}
@@ -0,0 +1,168 @@
+/** test_calibration.c
+ * Host test for loading and applying the calibration record (calibration.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * calib_Load() is given flash images built here the way the mppt-test calibration program writes them:
+ * a version 1 record, the same with a bad CRC or an unknown version, the five legacy offsets, and erased flash.
+ */
+
+#include "calibration.h"
+#include "test.h"
+
+#include <string.h>
+
+extern void crc16_init(void);
+extern uint16_t crc16(uint8_t[], uint8_t, uint16_t);
+
+// Flash sector contents: erased, apart from what the test writes
+static uint16_t image[64];
+
+
+static void image_Erase(void)
+{
+	memset(image, 0xff, sizeof(image));
+}
+
+static void image_Record(CAL_Record *record)
+{
+	uint8_t ch;
+
+	record->magic = CAL_MAGIC;
+	record->version = CAL_VERSION;
+
+	for (ch = 0; ch < ADC_ACQ_CHANNELS; ch++)
+	{
+		record->offset[ch] = 10 * ch - 20;					// -20 .. 50 counts
+		record->gain[ch] = CAL_GAIN_ONE + 200 * ch;			// 1.0 .. 1.085
+	}
+
+	record->crc = crc16((uint8_t *)record, sizeof(CAL_Record) - sizeof(record->crc), 0xffff);
+
+	image_Erase();
+	memcpy(image, record, sizeof(CAL_Record));
+}
+
+// What calib_Apply() must return for counts with the given offset and Q14 gain
+static uint16_t expected(uint16_t counts, int16_t offset, uint16_t gain)
+{
+	double value = ((double)counts - offset) * gain / CAL_GAIN_ONE;
+
+	if (value < 0)
+		return 0;
+
+	if (value > CAL_MAX_COUNTS)
+		return CAL_MAX_COUNTS;
+
+	return (uint16_t)(value + 0.5);
+}
+
+static bool appliesIdentity(void)
+{
+	uint16_t counts;
+	uint8_t ch;
+
+	for (ch = 0; ch < ADC_ACQ_CHANNELS; ch++)
+	{
+		for (counts = 0; counts <= CAL_MAX_COUNTS; counts++)
+		{
+			if (calib_Apply(ch, counts) != counts)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static void test_Record(void)
+{
+	CAL_Record record;
+	uint16_t counts;
+	uint8_t ch;
+	uint32_t wrong = 0;
+
+	image_Record(&record);
+
+	CHECK_EQUAL(calib_Load(image), CAL_SOURCE_RECORD);
+	CHECK_EQUAL(calib_GetSource(), CAL_SOURCE_RECORD);
+
+	for (ch = 0; ch < ADC_ACQ_CHANNELS; ch++)
+	{
+		for (counts = 0; counts <= CAL_MAX_COUNTS; counts++)
+		{
+			if (calib_Apply(ch, counts) != expected(counts, record.offset[ch], record.gain[ch]))
+				wrong++;
+		}
+	}
+
+	CHECK_EQUAL(wrong, 0);
+
+	// Clamped to the 12 bit range at both ends
+	CHECK_EQUAL(calib_Apply(7, 5), 0);
+	CHECK_EQUAL(calib_Apply(7, 4095), CAL_MAX_COUNTS);
+}
+
+static void test_Rejected(void)
+{
+	CAL_Record record;
+
+	// One flipped bit fails the CRC, and nothing of the record is used
+	image_Record(&record);
+	((uint8_t *)image)[6] ^= 0x01;
+
+	CHECK_EQUAL(calib_Load(image), CAL_SOURCE_DEFAULT);
+	CHECK(appliesIdentity());
+
+	// A later record version is not read as anything else, legacy offsets included
+	image_Record(&record);
+	record.version = CAL_VERSION + 1;
+	record.crc = crc16((uint8_t *)&record, sizeof(CAL_Record) - sizeof(record.crc), 0xffff);
+	memcpy(image, &record, sizeof(CAL_Record));
+
+	CHECK_EQUAL(calib_Load(image), CAL_SOURCE_DEFAULT);
+	CHECK(appliesIdentity());
+}
+
+static void test_Legacy(void)
+{
+	image_Erase();
+	CHECK_EQUAL(calib_Load(image), CAL_SOURCE_DEFAULT);
+	CHECK(appliesIdentity());
+
+	// Battery V, solar V, solar I, battery I, load I; the battery voltage offset was never measured
+	image[0] = 0xffff;
+	image[1] = 12;
+	image[2] = 31;
+	image[3] = 47;
+	image[4] = 5;
+
+	CHECK_EQUAL(calib_Load(image), CAL_SOURCE_LEGACY);
+	CHECK_EQUAL(calib_Apply(0, 1000), 1000);
+	CHECK_EQUAL(calib_Apply(1, 1000), 988);
+	CHECK_EQUAL(calib_Apply(3, 1000), 969);			// Solar I is frame channel 3
+	CHECK_EQUAL(calib_Apply(2, 1000), 953);			// Battery I is frame channel 2
+	CHECK_EQUAL(calib_Apply(7, 1000), 995);
+	CHECK_EQUAL(calib_Apply(4, 1000), 1000);
+	CHECK_EQUAL(calib_Apply(1, 10), 0);
+}
+
+int main(void)
+{
+	crc16_init();
+
+	test_Record();
+	test_Rejected();
+	test_Legacy();
+
+	return test_Report("calibration");
+}
@@ -0,0 +1,292 @@
+/** test_charge_reg.c
+ * Host test of the battery voltage regulator (charge_reg.c) against the converter and a battery RC model
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The battery (buck_model.c) is its open circuit voltage behind R0 and an R1 || C1 pair, sped up so a run of seconds
+ * shows what hours would: the open circuit voltage moves BATTERY_V_PER_AS with every As the battery takes beyond
+ * LOAD_A, up to BATTERY_FULL_V. The array model is at 1000 W/m2, and P&O steps every frame the way calcMPPT() does.
+ * Two ways of holding the battery at the absorption voltage are run from the same start:
+ *   bang_bang  what the main loop did: the converter off at the target, and back on through the 1 S restart delay
+ *              at PCT80_DUTY_CYCLE once the battery has sagged 0.5 V (checked every MEASURE_PERIOD)
+ *   pi         the regulator, with the MPPT duty as its ceiling
+ * The table gives, from the first frame at the target on, the battery voltage ripple (standard deviation and peak to
+ * peak, frame averages), the time within TARGET_BAND_MV of the target, the highest voltage and the times the converter
+ * was switched off. A last test runs a global peak scan into the target, which the regulator has to stop.
+ */
+
+#include "mppt_strategy.h"
+#include "mppt_scan.h"
+#include "charge_reg.h"
+#include "buck_model.h"
+#include "pv_model.h"
+#include "converter.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define FRAME_US			655
+#define TASK_FRAMES			153			// MEASURE_PERIOD (100 mS)
+#define RESTART_FRAMES		1527		// The HAL_Delay(1000) the converter used to restart through
+#define RUN_FRAMES			4580		// 3 S
+#define TARGET_MV			14400
+#define TARGET_BAND_MV		50
+#define SAG_MV				500			// Absorption restart threshold of the bang-bang charger
+
+#define BATTERY_START_V		14.0
+#define BATTERY_FULL_V		14.3
+#define BATTERY_V_PER_AS	0.05		// A battery of 20 As
+#define BATTERY_C1			20.0		// F, 0.2 S with R1
+#define LOAD_A				4.0
+
+#define BANG_BANG			0
+#define PI					1
+
+typedef struct
+{
+	double rippleMv;				// Standard deviation
+	int32_t peakToPeakMv;
+	double inBandPct;
+	int32_t maxMv;
+	uint16_t switchOffs;
+} Result;
+
+static const char *policyName[] = { "bang_bang", "pi" };
+
+
+// calcMPPT()'s step: the strategy, or the scan, with the regulator below it. Returns the duty cycle to apply.
+static uint16_t control_Step(const MPPT_Measurement *m, uint16_t *duty, bool *regulating)
+{
+	uint16_t scanDuty, output;
+	int32_t command;
+
+	if (!*regulating)
+	{
+		if (mpptScan_Active())
+		{
+			scanDuty = *duty >> DUTY_FRACTION_BITS;
+
+			if (mpptScan_Step(m, &scanDuty))
+			{
+				*duty = DUTY_FINE(scanDuty);
+				output = chargeReg_Step(m->vBat, *duty);
+
+				if (output < *duty)
+				{
+					mpptScan_Cancel();
+					*regulating = true;
+				}
+
+				return output;
+			}
+
+			mpptStrategy_Init(m, *duty);
+			return *duty;
+		}
+
+		command = mpptStrategy_Step(m, *duty);
+
+		if (command > DUTY_FINE(MAX_DUTY_CYCLE))
+			command = DUTY_FINE(MAX_DUTY_CYCLE);
+		if (command < DUTY_FINE(MIN_DUTY_CYCLE))
+			command = DUTY_FINE(MIN_DUTY_CYCLE);
+
+		*duty = command;
+	}
+
+	output = chargeReg_Step(m->vBat, *duty);
+
+	if (output < *duty)
+		*regulating = true;
+	else if (*regulating)
+	{
+		*regulating = false;
+		mpptStrategy_Init(m, *duty);
+	}
+
+	return output;
+}
+
+static void charge(uint8_t policy, Result *result)
+{
+	MPPT_Measurement m;
+	double ocv = BATTERY_START_V, sum = 0, sumSquares = 0;
+	uint16_t duty = DUTY_FINE(MIN_DUTY_CYCLE + 2), applied;
+	uint32_t frame, samples = 0, inBand = 0, restart = 0;
+	int32_t low = INT32_MAX;
+	bool running = true, regulating = false, atTarget = false;
+
+	buck_Init(pv_OpenCircuit(), ocv);
+	buck_SetBattery(ocv, BUCK_BATTERY_R0, BUCK_BATTERY_R1, BATTERY_C1);
+	buck_Run(duty, FRAME_US * 1e-6, &m);
+
+	mpptStrategy_Select(MPPT_STRATEGY_PO);
+	mpptStrategy_Init(&m, duty);
+	chargeReg_SetTarget((policy == BANG_BANG) ? 0 : TARGET_MV);
+	chargeReg_Reset(duty);
+	mpptScan_Schedule(0);
+	mpptScan_Cancel();
+
+	result->maxMv = 0;
+	result->switchOffs = 0;
+	applied = duty;
+
+	for (frame = 1; frame <= RUN_FRAMES; frame++)
+	{
+		if (running)
+			applied = control_Step(&m, &duty, &regulating);
+
+		// The bang-bang charger, every MEASURE_PERIOD
+		if ( (policy == BANG_BANG) && (frame % TASK_FRAMES == 0) )
+		{
+			if (running && (m.vBat >= TARGET_MV))
+			{
+				running = false;
+				applied = 0;
+				result->switchOffs++;
+			}
+			else if (!running && (restart == 0) && (m.vBat <= TARGET_MV - SAG_MV))
+				restart = frame + RESTART_FRAMES;
+		}
+
+		if ( !running && (restart != 0) && (frame >= restart) )
+		{
+			running = true;
+			restart = 0;
+			duty = DUTY_FINE(PCT80_DUTY_CYCLE);
+			applied = duty;
+			mpptStrategy_Init(&m, duty);
+		}
+
+		buck_Run(applied, FRAME_US * 1e-6, &m);
+
+		ocv += (buck_InductorCurrent() - LOAD_A) * BATTERY_V_PER_AS * FRAME_US * 1e-6;
+
+		if (ocv > BATTERY_FULL_V)
+			ocv = BATTERY_FULL_V;
+
+		buck_SetOpenCircuit(ocv);
+
+		if (m.vBat >= TARGET_MV)
+			atTarget = true;
+
+		if (!atTarget)
+			continue;
+
+		samples++;
+		sum += m.vBat;
+		sumSquares += (double)m.vBat * m.vBat;
+
+		if (abs(m.vBat - TARGET_MV) <= TARGET_BAND_MV)
+			inBand++;
+
+		if (m.vBat > result->maxMv)
+			result->maxMv = m.vBat;
+
+		if (m.vBat < low)
+			low = m.vBat;
+	}
+
+	result->rippleMv = sqrt(sumSquares / samples - (sum / samples) * (sum / samples));
+	result->peakToPeakMv = result->maxMv - low;
+	result->inBandPct = 100.0 * inBand / samples;
+}
+
+static void test_Regulation(void)
+{
+	Result result[2];
+	uint8_t p;
+
+	pv_SetIrradiance(1000);
+
+	printf("policy,ripple_mv,peak_to_peak_mv,in_band_pct,max_mv,switch_offs\n");
+
+	for (p = BANG_BANG; p <= PI; p++)
+	{
+		charge(p, &result[p]);
+		printf("%s,%.1f,%d,%.1f,%d,%u\n", policyName[p], result[p].rippleMv, result[p].peakToPeakMv,
+			result[p].inBandPct, result[p].maxMv, result[p].switchOffs);
+	}
+
+	// The regulator holds the battery at the target without switching the converter off
+	CHECK(result[PI].inBandPct > 95.0);
+	CHECK(result[PI].rippleMv < 20.0);
+	CHECK(result[PI].maxMv <= TARGET_MV + TARGET_BAND_MV);
+	CHECK_EQUAL(result[PI].switchOffs, 0);
+
+	// The converter switching off and on leaves the battery mostly out of the band
+	CHECK(result[BANG_BANG].switchOffs > 0);
+	CHECK(result[BANG_BANG].inBandPct < result[PI].inBandPct);
+	CHECK(result[BANG_BANG].rippleMv > 5 * result[PI].rippleMv);
+}
+
+/** A scan that brings the battery up to the target: the sweep runs while the battery is below it, and stops at the
+ * first step that would take it over, where the regulator backs the duty cycle off instead
+ */
+static void test_ScanStops(void)
+{
+	MPPT_Measurement m = { 15000, 8000, TARGET_MV - 300, 8000 };
+	uint16_t duty = DUTY_FINE(220), output = 0, sweep;
+	bool regulating = false;
+	uint8_t k;
+
+	mpptStrategy_Select(MPPT_STRATEGY_PO);
+	mpptStrategy_Init(&m, duty);
+	chargeReg_SetTarget(TARGET_MV);
+	chargeReg_Reset(duty);
+	mpptScan_Start(0);
+
+	// Below the target the scan moves the converter to its first point, and the regulator passes it through
+	output = control_Step(&m, &duty, &regulating);
+
+	CHECK(mpptScan_Active());
+	CHECK_EQUAL(output, DUTY_FINE(MIN_DUTY_CYCLE));
+
+	for (k = 0; k < 2 * MPPT_SCAN_SETTLE_STEPS; k++)
+		output = control_Step(&m, &duty, &regulating);
+
+	sweep = duty;
+
+	CHECK(sweep > DUTY_FINE(MIN_DUTY_CYCLE));
+	CHECK_EQUAL(output, sweep);
+	CHECK(!regulating);
+
+	// The battery goes over the target
+	m.vBat = TARGET_MV + 200;
+
+	for (k = 0; k < MPPT_SCAN_SETTLE_STEPS + 1; k++)
+		output = control_Step(&m, &duty, &regulating);
+
+	CHECK(!mpptScan_Active());
+	CHECK(regulating);
+	CHECK(output < duty);
+	CHECK(duty <= sweep + DUTY_FINE(MAX_DUTY_CYCLE - MIN_DUTY_CYCLE) / (MPPT_SCAN_POINTS - 1) + DUTY_FINE(1));
+
+	// Back under the target the strategy takes over again from there, not the scan
+	m.vBat = TARGET_MV - 300;
+
+	for (k = 0; k < 100; k++)
+		output = control_Step(&m, &duty, &regulating);
+
+	CHECK(!mpptScan_Active());
+	CHECK(!regulating);
+}
+
+int main(void)
+{
+	test_Regulation();
+	test_ScanStops();
+
+	return test_Report("charge_reg");
+}
@@ -0,0 +1,188 @@
+/** test_event.c
+ * Host test of the event queue (event.c) under bursts posted from a signal
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A signal every INTERRUPT_US stands in for the interrupts and posts BURST events at a time, numbered 1 .. 255 over
+ * and over (0 is EVENT_NONE), while the main context takes them out the way eventTask() does:
+ * - burst: the main context keeps up. The host can hold the process back long enough for signals to come back to
+ *   back, so a signal holds its burst back when it wouldn't fit in the queue, working out what can be pending from
+ *   what it posted and what the main context took out, the way an interrupt source has only so many events
+ *   outstanding. With the load within the queue no event may be dropped, and every one has to come out once, in
+ *   order.
+ * - full: nothing is taken out. The queue takes EVENT_QUEUE_SIZE - 1 events, the next is dropped and counted.
+ * - stalled: the signals post every burst, and the main context stops taking events for STALL_INTERRUPTS of them.
+ *   The queue fills and the rest is dropped and counted, but never while the queue had room; what did get in still
+ *   comes out in order.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "event.h"
+#include "test.h"
+
+#define INTERRUPT_US		20
+#define BURST				5
+#define INTERRUPTS			5000
+#define STALL_INTERRUPTS	10
+
+static volatile uint32_t interrupts;
+static volatile uint32_t attempts, accepted, falseDrops;
+static volatile uint32_t received;
+static volatile uint32_t held;
+static bool pacing;
+static uint8_t nextEvent = 1;
+static uint8_t expected = 1;
+static uint32_t outOfOrder;
+
+
+static uint8_t event_Next(uint8_t event)
+{
+	return (event % 255) + 1;
+}
+
+// Posts the next event. received lags event_Get() by one at most, so accepted - received is never below the depth.
+static void post(void)
+{
+	attempts++;
+
+	if (event_Post(nextEvent))
+	{
+		accepted++;
+		nextEvent = event_Next(nextEvent);
+	}
+	else if (accepted - received < EVENT_QUEUE_SIZE - 1)
+	{
+		falseDrops++;
+	}
+}
+
+static void burst_Interrupt(void)
+{
+	uint8_t k;
+
+	interrupts++;
+
+	if ( pacing && (accepted - received + BURST > EVENT_QUEUE_SIZE - 1) )
+	{
+		held++;
+		return;
+	}
+
+	for (k = 0; k < BURST; k++)
+		post();
+}
+
+// eventTask(): everything pending, in order
+static void drain(void)
+{
+	uint8_t event;
+
+	while ((event = event_Get()) != EVENT_NONE)
+	{
+		if (event != expected)
+			outOfOrder++;
+
+		expected = event_Next(event);
+		received++;
+	}
+}
+
+static void flow(uint32_t count)
+{
+	uint32_t until = interrupts + count;
+
+	host_Interrupts(burst_Interrupt, INTERRUPT_US);
+
+	while (interrupts < until)
+		drain();
+
+	host_Interrupts(NULL, 0);
+	drain();
+}
+
+static void test_Burst(void)
+{
+	pacing = true;
+	flow(INTERRUPTS);
+	pacing = false;
+
+	printf("  burst: %u interrupts (%u held back), %u events posted, %u received, high water %u\n", interrupts, held,
+		attempts, received, event_GetHighWater());
+
+	CHECK_EQUAL(event_GetDropped(), 0);
+	CHECK_EQUAL(accepted, attempts);
+	CHECK_EQUAL(received, accepted);
+	CHECK_EQUAL(outOfOrder, 0);
+	CHECK(event_GetHighWater() >= BURST);
+	CHECK(event_GetHighWater() < EVENT_QUEUE_SIZE);
+}
+
+static void test_Full(void)
+{
+	uint32_t dropped = event_GetDropped(), from = accepted;
+	uint8_t k;
+
+	for (k = 0; k < EVENT_QUEUE_SIZE; k++)
+		post();
+
+	CHECK_EQUAL(accepted - from, EVENT_QUEUE_SIZE - 1);
+	CHECK_EQUAL(event_GetDropped(), dropped + 1);
+	CHECK_EQUAL(falseDrops, 0);
+	CHECK_EQUAL(event_GetHighWater(), EVENT_QUEUE_SIZE - 1);
+
+	drain();
+
+	CHECK_EQUAL(received, accepted);
+	CHECK_EQUAL(outOfOrder, 0);
+	CHECK_EQUAL(event_Get(), EVENT_NONE);
+}
+
+static void test_Stalled(void)
+{
+	uint32_t from;
+
+	host_Interrupts(burst_Interrupt, INTERRUPT_US);
+
+	// The main context takes nothing out for a while
+	from = interrupts;
+
+	while (interrupts < from + STALL_INTERRUPTS)
+		;
+
+	host_Interrupts(NULL, 0);
+	drain();
+
+	printf("  stalled: %u events posted, %u dropped\n", attempts, event_GetDropped());
+
+	CHECK_EQUAL(falseDrops, 0);
+	CHECK_EQUAL(event_GetDropped(), attempts - accepted);
+	CHECK_EQUAL(received, accepted);
+	CHECK_EQUAL(outOfOrder, 0);
+
+	// And then the events flow again
+	flow(INTERRUPTS / 10);
+
+	CHECK_EQUAL(falseDrops, 0);
+	CHECK_EQUAL(event_GetDropped(), attempts - accepted);
+	CHECK_EQUAL(received, accepted);
+	CHECK_EQUAL(outOfOrder, 0);
+}
+
+int main(void)
+{
+	test_Burst();
+	test_Full();
+	test_Stalled();
+
+	return test_Report("event");
+}
@@ -0,0 +1,291 @@
+/** test_hd44780.c
+ * Host test of the LCD framebuffer driver (HD44780.c) against a model of the display
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The model watches the pins (hal_host.c) the way the controller does: it latches D7 - D4 on every falling edge of E,
+ * with RS telling a command from data. It starts in 8 bit mode, where a strobe is a whole byte with D3 - D0 low, until
+ * a function set for 4 bits; from then on two strobes make a byte. It keeps the 2 line DDRAM (0x00 - 0x27 and
+ * 0x40 - 0x67) with the address counter, and carries out CLEAR_DISPLAY, SET_DDRAM_ADDRESS and the data writes.
+ * delay_us() and the microsecond timer run on a virtual clock in nS, a TIM11 count at a time: TIM11 is set up with the
+ * prescaler MX_TIM11_Init() uses, and a count lasts what it lasts on the target (host_TimCountNs()). The test plays
+ * the timer's callbacks.
+ * - init: HD44780_Init() puts the display in 4 bit mode, cleared and on, in 4 single and 4 double strobes
+ * - print: two lines with gaps in them go out as their changed cells, with an address command for every gap
+ * - update: a single changed digit costs an address command and a data byte, the same text again nothing
+ * Every time the final contents are checked against the framebuffer, and the bytes the driver put on the bus
+ * against the count worked out for the text. After HD44780_Start(), no byte may start within 37 uS (real time) of
+ * the end of the last.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "HD44780.h"
+#include "us_timer.h"
+#include "test.h"
+
+#include <string.h>
+
+#define DDRAM_SIZE			0x80
+#define EXECUTE_NS			37000
+#define IDLE_US				HD44780_POLL_US
+
+// In mppt.h, which defines the UART buffers
+void HD44780_Init(void);
+
+typedef struct
+{
+	uint8_t ddram[DDRAM_SIZE];
+	uint8_t address;
+	bool fourBit;
+	bool high;					// In 4 bit mode, the next strobe is a high nibble
+	uint8_t nibble;
+	bool displayOn;
+	uint32_t strobes;
+	uint32_t commands;			// Whole bytes, as the controller saw them
+	uint32_t data;
+	uint64_t lastByteNs;
+	uint32_t tooSoon;			// Bytes started within EXECUTE_NS of the end of the one before, once checked
+	bool checkTiming;
+	bool readMode;				// RW was high at a strobe
+} Display;
+
+static Display lcd;
+static TIM_HandleTypeDef htim11;
+static uint32_t countNs;		// One TIM11 count
+static uint64_t nowNs;
+static US_TimerCallback pending;
+static uint16_t pendingDelay;
+
+
+void delay_us(uint32_t us)
+{
+	nowNs += (uint64_t)us * countNs;
+}
+
+void usTimer_Schedule(uint8_t slot, uint16_t delay, US_TimerCallback run)
+{
+	UNUSED(slot);
+
+	pending = run;
+	pendingDelay = delay;
+}
+
+// Next DDRAM address after address, in 2 line mode
+static uint8_t display_Next(uint8_t address)
+{
+	if (address == 0x27)
+		return 0x40;
+
+	if (address == 0x67)
+		return 0x00;
+
+	return address + 1;
+}
+
+static void display_Byte(uint8_t byte, bool data)
+{
+	lcd.lastByteNs = nowNs;
+
+	if (data)
+	{
+		lcd.data++;
+		lcd.ddram[lcd.address] = byte;
+		lcd.address = display_Next(lcd.address);
+		return;
+	}
+
+	lcd.commands++;
+
+	if (byte & SET_DDRAM_ADDRESS)
+	{
+		lcd.address = byte & 0x7f;
+	}
+	else if (byte & FUNCTION_SET)
+	{
+		lcd.fourBit = !(byte & SET_DATA_LENGTH_8);
+		lcd.high = true;
+	}
+	else if (byte & DISPLAY_ON_OFF_CONTROL)
+	{
+		lcd.displayOn = (byte & SET_DISPLAY_ON) != 0;
+	}
+	else if (byte == CLEAR_DISPLAY)
+	{
+		memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+		lcd.address = 0;
+	}
+}
+
+// E falling: the controller takes D7 - D4
+static void display_Pin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+	uint8_t nibble;
+	bool data;
+
+	if ( (port != GPIOC) || (pin != GPIO_PIN_2) || (state != GPIO_PIN_RESET) )
+		return;
+
+	nibble = (host_GetPin(GPIOC, GPIO_PIN_6) << 3) | (host_GetPin(GPIOC, GPIO_PIN_5) << 2) |
+		(host_GetPin(GPIOC, GPIO_PIN_4) << 1) | host_GetPin(GPIOC, GPIO_PIN_3);
+	data = host_GetPin(GPIOC, GPIO_PIN_0);
+
+	lcd.strobes++;
+
+	// The byte before has to have executed before the first strobe of the next
+	if ( lcd.checkTiming && (!lcd.fourBit || lcd.high) && (lcd.commands + lcd.data > 0) &&
+		(nowNs - lcd.lastByteNs < EXECUTE_NS) )
+		lcd.tooSoon++;
+
+	if (host_GetPin(GPIOC, GPIO_PIN_1))
+		lcd.readMode = true;
+
+	if (!lcd.fourBit)
+	{
+		display_Byte(nibble << 4, data);
+		return;
+	}
+
+	if (lcd.high)
+	{
+		lcd.nibble = nibble;
+		lcd.high = false;
+		return;
+	}
+
+	lcd.high = true;
+	display_Byte((lcd.nibble << 4) | nibble, data);
+}
+
+// Plays the timer until the driver has nothing left to write, i.e. it waits for the next framebuffer check
+static void run(void)
+{
+	US_TimerCallback callback;
+	uint64_t start = nowNs;
+
+	while ( (pending != NULL) && (nowNs - start < 1000000000ULL) )
+	{
+		nowNs += (uint64_t)pendingDelay * countNs;
+		callback = pending;
+		pending = NULL;
+		callback();
+
+		if (pendingDelay == IDLE_US)
+			break;
+	}
+}
+
+// The row as the display shows it
+static bool display_Shows(uint8_t row, const char *text)
+{
+	char expected[HD44780_COLS];
+	uint8_t col;
+
+	for (col = 0; col < HD44780_COLS; col++)
+		expected[col] = (*text != '\0') ? *text++ : ' ';
+
+	return memcmp(&lcd.ddram[row ? 0x40 : 0x00], expected, HD44780_COLS) == 0;
+}
+
+static void test_Init(void)
+{
+	// As MX_TIM11_Init()
+	htim11.Instance = TIM11;
+	htim11.Init.Prescaler = US_TIMER_PRESCALER;
+	htim11.Init.Period = 0xffff;
+	HAL_TIM_Base_Init(&htim11);
+	countNs = host_TimCountNs(TIM11);
+
+	memset(&lcd, 0, sizeof(lcd));
+	memset(lcd.ddram, 0xff, sizeof(lcd.ddram));
+	host_SetPinWatcher(display_Pin);
+
+	HD44780_Init();
+
+	CHECK(lcd.fourBit);
+	CHECK(lcd.displayOn);
+	CHECK_EQUAL(lcd.strobes, 4 + 2 * 4);
+	CHECK_EQUAL(lcd.commands, 8);
+	CHECK_EQUAL(lcd.data, 0);
+	CHECK(display_Shows(0, ""));
+	CHECK(display_Shows(1, ""));
+	CHECK_EQUAL(lcd.address, 0);
+}
+
+static void test_Print(void)
+{
+	uint32_t commands, data;
+
+	HD44780_Start();
+	lcd.checkTiming = true;
+	commands = lcd.commands;
+	data = lcd.data;
+
+	HD44780_Print(0, "MPPT 12.50 V");
+	HD44780_Print(1, "14.66 V 3.33 A");
+	run();
+
+	printf("  print: %u data bytes, %u address commands, %u uS, TIM11 count %u nS\n", lcd.data - data,
+		lcd.commands - commands, (uint32_t)(nowNs / 1000), countNs);
+
+	CHECK(display_Shows(0, "MPPT 12.50 V"));
+	CHECK(display_Shows(1, "14.66 V 3.33 A"));
+
+	// Row 0: MPPT, 12.50 and V, the first run from the cursor at 0. Row 1: 14.66, V, 3.33 and A.
+	CHECK_EQUAL(lcd.data - data, 10 + 11);
+	CHECK_EQUAL(lcd.commands - commands, 2 + 4);
+	CHECK_EQUAL(lcd.strobes, 12 + 2 * (21 + 6));
+}
+
+static void test_Update(void)
+{
+	uint32_t commands = lcd.commands, data = lcd.data;
+
+	HD44780_Print(0, "MPPT 12.51 V");
+	HD44780_Print(1, "14.66 V 3.33 A");
+	run();
+
+	CHECK(display_Shows(0, "MPPT 12.51 V"));
+	CHECK(display_Shows(1, "14.66 V 3.33 A"));
+	CHECK_EQUAL(lcd.data - data, 1);
+	CHECK_EQUAL(lcd.commands - commands, 1);
+
+	// Nothing changed, nothing goes out
+	commands = lcd.commands;
+	data = lcd.data;
+
+	HD44780_Print(0, "MPPT 12.51 V");
+	run();
+	run();
+
+	CHECK_EQUAL(lcd.data - data, 0);
+	CHECK_EQUAL(lcd.commands - commands, 0);
+
+	// A shorter line blanks the rest of the row
+	HD44780_Print(1, "14.66 V");
+	run();
+
+	CHECK(display_Shows(0, "MPPT 12.51 V"));
+	CHECK(display_Shows(1, "14.66 V"));
+
+	CHECK_EQUAL(lcd.tooSoon, 0);
+	CHECK(!lcd.readMode);
+}
+
+int main(void)
+{
+	test_Init();
+	test_Print();
+	test_Update();
+
+	return test_Report("hd44780");
+}
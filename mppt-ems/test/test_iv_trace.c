@@ -0,0 +1,277 @@
+/** test_iv_trace.c
+ * Host test of the I-V curve tracer (iv_trace.c) and of the CSV decoder for its frames (iv_decode.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The sweep runs against the array model (pv_model.c): the test stands in for adc_acq.c and publishes frames with the
+ * ADC counts the model gives at the duty cycle the sweep set last. The points are then framed the way sendIVTrace()
+ * and sendFrame() in mppt.c frame them, mixed with other traffic and line noise, and decoded back.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "iv_trace.h"
+#include "iv_decode.h"
+#include "adc_acq.h"
+#include "converter.h"
+#include "measure.h"
+#include "mppt.h"
+#include "pv_model.h"
+#include "test.h"
+
+#include <string.h>
+
+#define VBAT			12800
+
+extern void crc16_init(void);
+extern uint16_t crc16(uint8_t[], uint8_t, uint16_t);
+
+static uint16_t sweepDuty;
+static uint32_t framesPublished;
+
+static uint8_t stream[4096];
+static uint32_t streamLength;
+
+
+// The sweep's duty cycle, in counts
+static void setDuty(uint16_t duty)
+{
+	sweepDuty = duty;
+}
+
+// adc_acq.c stand-ins: every wait sees the converter settled at the last duty
+bool adcAcq_WaitFrames(uint8_t count, uint32_t timeoutMs)
+{
+	framesPublished += count;
+
+	return true;
+}
+
+uint32_t adcAcq_GetFrame(ADC_Frame *frame)
+{
+	MPPT_Measurement m;
+
+	memset(frame, 0, sizeof(ADC_Frame));
+	pv_Operate(DUTY_FINE(sweepDuty), VBAT, &m);
+
+	// The counts calcVoltage(, 2) and calcCurrent() turn back into the nearest mV and mA
+	frame->channel[1] = ((uint64_t)m.vSolar * 2 * 65536 + MEAS_MV_PER_COUNT_Q16 / 2) / MEAS_MV_PER_COUNT_Q16;
+	frame->channel[3] = ((uint64_t)m.iSolar * 65536 + MEAS_MA_PER_COUNT_Q16 / 2) / MEAS_MA_PER_COUNT_Q16;
+	frame->sequence = framesPublished;
+
+	return framesPublished;
+}
+
+// sendFrame(): CRC, then 0x9a and 0x9b escaped everywhere but the start byte
+static void send(uint8_t *message, uint8_t length)
+{
+	uint16_t crc = crc16(message, length, 0xffff);
+	uint8_t i;
+
+	message[length++] = crc & 0xff;
+	message[length++] = crc >> 8;
+
+	for (i = 0; i < length; i++)
+	{
+		if ( (i != 0) && (message[i] == 0x9a) )
+		{
+			stream[streamLength++] = 0x9b;
+			stream[streamLength++] = 0x01;
+		}
+		else if (message[i] == 0x9b)
+		{
+			stream[streamLength++] = 0x9b;
+			stream[streamLength++] = 0x02;
+		}
+		else
+		{
+			stream[streamLength++] = message[i];
+		}
+	}
+}
+
+static uint8_t header(uint8_t *message, uint8_t type)
+{
+	message[0] = 0x9a;
+	memcpy(&message[1], "1.00", 4);
+	message[5] = type;
+
+	return 6;
+}
+
+// sendIVTrace(): count points in frames of up to IV_POINTS_PER_FRAME
+static void sendTrace(const IV_Point *points, uint8_t count)
+{
+	uint8_t message[128];
+	uint8_t frameCount, frameIndex, first, n, length, i;
+
+	frameCount = (count + IV_POINTS_PER_FRAME - 1) / IV_POINTS_PER_FRAME;
+
+	if (frameCount == 0)
+		frameCount = 1;
+
+	for (frameIndex = 0; frameIndex < frameCount; frameIndex++)
+	{
+		first = frameIndex * IV_POINTS_PER_FRAME;
+		n = (count - first > IV_POINTS_PER_FRAME) ? IV_POINTS_PER_FRAME : count - first;
+
+		length = header(message, MSG_IV_TRACE);
+		message[length++] = frameIndex;
+		message[length++] = frameCount;
+		message[length++] = n;
+
+		for (i = 0; i < n; i++)
+		{
+			message[length++] = (uint8_t)points[first + i].duty;
+			message[length++] = points[first + i].vSolar & 0xff;
+			message[length++] = points[first + i].vSolar >> 8;
+			message[length++] = points[first + i].iSolar & 0xff;
+			message[length++] = points[first + i].iSolar >> 8;
+		}
+
+		send(message, length);
+	}
+}
+
+// Some other frame in between, as the controller sends MSG_DATA every second
+static void sendOther(void)
+{
+	uint8_t message[128];
+	uint8_t length = header(message, MSG_DATA);
+
+	memset(&message[length], 0x9a, 14);
+	send(message, length + 14);
+}
+
+static void test_Sweep(void)
+{
+	IV_Point points[IV_TRACE_MAX_POINTS];
+	IV_Decoded decoded;
+	uint8_t count, i;
+	bool falling = true, rising = true, same = true;
+
+	pv_SetIrradiance(800);
+	count = ivTrace_Sweep(MIN_DUTY_CYCLE, MAX_DUTY_CYCLE, setDuty);
+
+	CHECK_EQUAL(count, MAX_DUTY_CYCLE - MIN_DUTY_CYCLE + 1);
+	CHECK_EQUAL(framesPublished, count * IV_TRACE_SETTLE_FRAMES);
+
+	for (i = 0; i < count; i++)
+	{
+		points[i] = *ivTrace_GetPoint(i);
+
+		// A higher duty pulls the array voltage down and the current up
+		if ( (i != 0) && (points[i].vSolar >= points[i - 1].vSolar) )
+			falling = false;
+		if ( (i != 0) && (points[i].iSolar <= points[i - 1].iSolar) )
+			rising = false;
+	}
+
+	CHECK_EQUAL(points[0].duty, MIN_DUTY_CYCLE);
+	CHECK(falling);
+	CHECK(rising);
+
+	// Line noise, then the trace among other frames
+	streamLength = 0;
+	stream[streamLength++] = 0x00;
+	stream[streamLength++] = 0x55;
+	sendOther();
+	sendTrace(points, count);
+	sendOther();
+
+	ivDecode_Stream(stream, streamLength, &decoded);
+
+	CHECK_EQUAL(decoded.traces, 1);
+	CHECK_EQUAL(decoded.broken, 0);
+	CHECK_EQUAL(decoded.count, count);
+
+	for (i = 0; i < count; i++)
+	{
+		if (memcmp(&decoded.point[i], &points[i], sizeof(IV_Point)) != 0)
+			same = false;
+	}
+
+	CHECK(same);
+}
+
+// Points whose bytes are the start and escape bytes come through, and so does the CSV
+static void test_Escapes(void)
+{
+	IV_Point points[3] = { { 200, 0x9a9b, 0x019a }, { 201, 0x9b9a, 0x9b02 }, { 202, 16000, 5000 } };
+	IV_Decoded decoded;
+	char csv[256];
+	FILE *out;
+
+	streamLength = 0;
+	sendTrace(points, 3);
+	ivDecode_Stream(stream, streamLength, &decoded);
+
+	CHECK_EQUAL(decoded.traces, 1);
+	CHECK_EQUAL(decoded.count, 3);
+	CHECK_EQUAL(decoded.point[0].vSolar, 0x9a9b);
+	CHECK_EQUAL(decoded.point[1].iSolar, 0x9b02);
+
+	out = fmemopen(csv, sizeof(csv), "w");
+	ivDecode_WriteCsv(&decoded, out);
+	fclose(out);
+
+	CHECK(strcmp(csv, "duty_counts,v_mv,i_ma,p_mw\n200,39579,410,16227\n201,39834,39682,1580693\n202,16000,5000,80000\n") == 0);
+}
+
+// A trace with a corrupted or missing frame is not passed off as complete
+static void test_Broken(void)
+{
+	IV_Point points[IV_TRACE_MAX_POINTS];
+	IV_Decoded decoded;
+	uint32_t firstFrameEnd;
+	uint8_t i;
+
+	for (i = 0; i < 44; i++)
+	{
+		points[i].duty = MIN_DUTY_CYCLE + i;
+		points[i].vSolar = 17000 - 50 * i;
+		points[i].iSolar = 2000 + 100 * i;
+	}
+
+	streamLength = 0;
+	sendTrace(points, 44);
+	stream[streamLength / 2] ^= 0x10;
+
+	ivDecode_Stream(stream, streamLength, &decoded);
+
+	CHECK_EQUAL(decoded.traces, 0);
+	CHECK(decoded.broken > 0);
+
+	// Frame 0 alone: nothing complete
+	streamLength = 0;
+	sendTrace(points, IV_POINTS_PER_FRAME);
+	firstFrameEnd = streamLength;
+	sendTrace(points, 44);
+
+	ivDecode_Stream(stream + firstFrameEnd, streamLength - firstFrameEnd - 3, &decoded);
+	CHECK_EQUAL(decoded.traces, 0);
+
+	ivDecode_Stream(stream, streamLength, &decoded);
+	CHECK_EQUAL(decoded.traces, 2);
+	CHECK_EQUAL(decoded.count, 44);
+}
+
+int main(void)
+{
+	crc16_init();
+
+	test_Sweep();
+	test_Escapes();
+	test_Broken();
+
+	return test_Report("iv_trace");
+}
@@ -0,0 +1,113 @@
+/** test_measure.c
+ * Host test for the fixed point measurement conversions (measure.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every ADC count from 0 to 4095 goes through the integer conversions and through the original double formulas
+ * (measure_ref.h), and the two may differ by no more than measure.c promises: 1 mV, 1 mA, 0.01 degC.
+ */
+
+#include "measure.h"
+#include "measure_ref.h"
+#include "test.h"
+
+#include <math.h>
+
+// Largest difference between the integer result and the reference in its units, over every count
+static double worstVoltage(uint8_t gain)
+{
+	double worst = 0, error;
+	uint16_t counts;
+
+	for (counts = 0; counts <= 4095; counts++)
+	{
+		error = fabs(calcVoltage(counts, gain) - refVoltage(counts, gain) * 1000);
+
+		if (error > worst)
+			worst = error;
+	}
+
+	return worst;
+}
+
+static void test_Conversions(void)
+{
+	double worstI = 0, worstT = 0, error;
+	uint16_t counts;
+
+	for (counts = 0; counts <= 4095; counts++)
+	{
+		error = fabs(calcCurrent(counts) - refCurrent(counts) * 1000);
+
+		if (error > worstI)
+			worstI = error;
+
+		error = fabs(calcTemperature(counts) - refTemperature(counts) * 100);
+
+		if (error > worstT)
+			worstT = error;
+	}
+
+	printf("  worst error: %.3f mV (gain 1), %.3f mV (gain 2), %.3f mA, %.3f centi-degC\n",
+		worstVoltage(1), worstVoltage(2), worstI, worstT);
+
+	CHECK(worstVoltage(1) <= 1.0);
+	CHECK(worstVoltage(2) <= 1.0);
+	CHECK(worstI <= 1.0);
+	CHECK(worstT <= 1.0);
+}
+
+// Golden values worked out by hand from the formulas
+static void test_Golden(void)
+{
+	CHECK_EQUAL(calcVoltage(0, 2), 0);
+	CHECK_EQUAL(calcVoltage(2010, 1), 26004);			// 2010 * 0.000806 / 0.0623 = 26.0043 V
+	CHECK_EQUAL(calcVoltage(2010, 2), 13002);			// MAX_START_VOLT: 13.0 V
+	CHECK_EQUAL(calcVoltage(4095, 2), 26489);			// Full scale: 26.4893 V
+	CHECK_EQUAL(calcCurrent(49), 395);					// THRESHOLD_CURRENT: 394.9 mA
+	CHECK_EQUAL(calcCurrent(3722), 29999);				// MAX_CHARGE_CURRENT: 29.9993 A
+	CHECK_EQUAL(calcTemperature(620), -3);				// 620 * 0.0806 - 50 = -0.028 degC
+	CHECK_EQUAL(calcTemperature(931), 2504);			// 25.04 degC
+}
+
+// Power in mW, within 1 mW of the product, over the whole range of both inputs
+static void test_Power(void)
+{
+	int32_t mV, mA;
+	double worst = 0, error;
+
+	for (mV = 0; mV <= calcVoltage(4095, 1); mV += 97)
+	{
+		for (mA = 0; mA <= calcCurrent(4095); mA += 89)
+		{
+			error = fabs(calcPower(mV, mA) - (double)mV * mA / 1000);
+
+			if (error > worst)
+				worst = error;
+		}
+	}
+
+	CHECK(worst <= 0.5);
+	CHECK_EQUAL(calcPower(13500, 20000), 270000);
+	CHECK_EQUAL(calcPower(1, 499), 0);
+	CHECK_EQUAL(calcPower(1, 500), 1);
+}
+
+int main(void)
+{
+	test_Conversions();
+	test_Golden();
+	test_Power();
+
+	return test_Report("measure");
+}
@@ -0,0 +1,250 @@
+/** test_mppt_ic.c
+ * Host test of the incremental conductance strategy (mppt_ic.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The first part hands ic_Step() measurements made up to land on each side of its tests: left and right of the MPP,
+ * inside each deadband, a current change alone, and the duty limits. The second part tracks the array model
+ * (pv_model.c) at MPPT_CONTROL_STEP_US through four regions: a flat one at 1000 W/m2, irradiance rising from 300 to
+ * 1000 W/m2 in 2 S, falling back in 2 S, and the flat one with a count of ADC noise. The floating point step it
+ * replaced (mppt_ic_ref.h) runs alongside for comparison. The table gives the tracking efficiency against the best
+ * duty cycle of every step and the duty span over the last half of each region.
+ */
+
+#include "mppt_strategy.h"
+#include "mppt_ic_ref.h"
+#include "converter.h"
+#include "measure.h"
+#include "pv_model.h"
+#include "test.h"
+
+#define STEP_US			655			// MPPT_CONTROL_STEP_US in mppt.c
+#define VBAT			12800
+#define REGION_STEPS	3054		// 2 S
+#define MPP_MV			15000
+#define MPP_MA			8000
+
+typedef struct
+{
+	const char *name;
+	double from;					// W/m2
+	double to;
+	int32_t noiseMv;
+	int32_t noiseMa;
+} Region;
+
+typedef struct
+{
+	void (*init)(const MPPT_Measurement *, uint16_t);
+	int32_t (*step)(const MPPT_Measurement *, uint16_t);
+	const char *name;
+} Tracker;
+
+typedef struct
+{
+	double efficiency;				// Percent of the best power
+	uint16_t dutySpan;				// 1/16 counts, last half of the region
+} Result;
+
+static const Region region[] =
+{
+	{ "flat", 1000, 1000, 0, 0 },
+	{ "rising", 300, 1000, 0, 0 },
+	{ "falling", 1000, 300, 0, 0 },
+	{ "noisy", 1000, 1000, 6, 8 },
+};
+
+#define REGIONS		(sizeof(region) / sizeof(region[0]))
+
+static const Tracker tracker[] =
+{
+	{ NULL, NULL, "ic" },
+	{ refIc_Init, refIc_Step, "ic_float" },
+};
+
+
+static MPPT_Measurement point(int32_t vSolar, int32_t iSolar)
+{
+	MPPT_Measurement m = { vSolar, iSolar, VBAT, 0 };
+
+	return m;
+}
+
+// Starts at MPP_MV, MPP_MA and returns the command for the next point
+static int32_t decide(uint16_t duty, int32_t vSolar, int32_t iSolar)
+{
+	MPPT_Measurement m = point(MPP_MV, MPP_MA);
+
+	mpptIC.init(&m, duty);
+	m = point(vSolar, iSolar);
+
+	return mpptIC.step(&m, duty);
+}
+
+// The decisions, one point after ic_Init() each
+static void test_Decisions(void)
+{
+	uint16_t duty = DUTY_FINE(210);
+
+	/* dP = dI * V + I * dV: 100 mV up and 10 mA down gains 0.65 W, left of the MPP, so the voltage has to go up
+	 * (duty down), whichever way the step went
+	 */
+	CHECK_EQUAL(decide(duty, MPP_MV + 100, MPP_MA - 10), duty - MPPT_IC_STEP);
+	CHECK_EQUAL(decide(duty, MPP_MV - 100, MPP_MA + 10), duty - MPPT_IC_STEP);
+
+	// 100 mV up and 200 mA down loses 2.2 W, right of it
+	CHECK_EQUAL(decide(duty, MPP_MV + 100, MPP_MA - 200), duty + MPPT_IC_STEP);
+	CHECK_EQUAL(decide(duty, MPP_MV - 100, MPP_MA + 200), duty + MPPT_IC_STEP);
+
+	// 100 mV up and 53 mA down: -5.6 mW, inside MPPT_IC_DP_DEADBAND_MW
+	CHECK_EQUAL(decide(duty, MPP_MV + 100, MPP_MA - 53), duty);
+
+	// The voltage inside its deadband: the current alone says which way the MPP went
+	CHECK_EQUAL(decide(duty, MPP_MV + MPPT_IC_DV_DEADBAND_MV, MPP_MA + 100), duty - MPPT_IC_STEP);
+	CHECK_EQUAL(decide(duty, MPP_MV - MPPT_IC_DV_DEADBAND_MV, MPP_MA - 100), duty + MPPT_IC_STEP);
+
+	// The duty limits hold
+	CHECK_EQUAL(decide(DUTY_FINE(MAX_DUTY_CYCLE), MPP_MV + 100, MPP_MA - 200), DUTY_FINE(MAX_DUTY_CYCLE));
+	CHECK_EQUAL(decide(DUTY_FINE(MIN_DUTY_CYCLE), MPP_MV + 100, MPP_MA - 10), DUTY_FINE(MIN_DUTY_CYCLE));
+}
+
+// Nothing changing: a perturbation until a step finds the MPP, and a hold after that
+static void test_Perturb(void)
+{
+	MPPT_Measurement m = point(MPP_MV, MPP_MA);
+	uint16_t duty = DUTY_FINE(210);
+
+	mpptIC.init(&m, duty);
+
+	// The first one raises the array voltage, and keeps on while the point doesn't move
+	CHECK_EQUAL(mpptIC.step(&m, duty), duty - MPPT_IC_STEP);
+	CHECK_EQUAL(mpptIC.step(&m, duty - MPPT_IC_STEP), duty - 2 * MPPT_IC_STEP);
+
+	// At MIN_DUTY_CYCLE it turns around
+	mpptIC.init(&m, DUTY_FINE(MIN_DUTY_CYCLE));
+	CHECK_EQUAL(mpptIC.step(&m, DUTY_FINE(MIN_DUTY_CYCLE)), DUTY_FINE(MIN_DUTY_CYCLE) + MPPT_IC_STEP);
+
+	// At the MPP it holds, also on the steps after
+	mpptIC.init(&m, duty);
+	m = point(MPP_MV + 100, MPP_MA - 53);
+	CHECK_EQUAL(mpptIC.step(&m, duty), duty);
+	CHECK_EQUAL(mpptIC.step(&m, duty), duty);
+
+	// Until the point moves: a current rise alone moves the duty down again
+	m = point(MPP_MV, MPP_MA + 200);
+	CHECK_EQUAL(mpptIC.step(&m, duty), duty - MPPT_IC_STEP);
+}
+
+// calcMPPT()'s limits on a duty command
+static uint16_t limit(int32_t command)
+{
+	if (command >= DUTY_FINE(MAX_DUTY_CYCLE))
+		return DUTY_FINE(MAX_DUTY_CYCLE);
+
+	if (command <= DUTY_FINE(MIN_DUTY_CYCLE))
+		return DUTY_FINE(MIN_DUTY_CYCLE);
+
+	return command;
+}
+
+// Tracks one region, starting from where the best duty cycle of its first step is
+static void track(const Tracker *t, const Region *r, Result *result)
+{
+	MPPT_Measurement m;
+	double irradiance, energy = 0, available = 0;
+	uint16_t duty, best, low = 0xffff, high = 0;
+	int32_t bestPower;
+	uint32_t step;
+
+	pv_SetNoise(r->noiseMv, r->noiseMa);
+	pv_SetIrradiance(r->from);
+	pv_BestDuty(VBAT, &duty);
+	pv_Operate(duty, VBAT, &m);
+
+	if (t->init == NULL)
+	{
+		mpptStrategy_Select(MPPT_STRATEGY_IC);
+		mpptStrategy_Init(&m, duty);
+	}
+	else
+		t->init(&m, duty);
+
+	for (step = 1; step <= REGION_STEPS; step++)
+	{
+		irradiance = r->from + (r->to - r->from) * step / REGION_STEPS;
+		pv_SetIrradiance(irradiance);
+		bestPower = pv_BestDuty(VBAT, &best);
+
+		duty = limit((t->init == NULL) ? mpptStrategy_Step(&m, duty) : t->step(&m, duty));
+		pv_Operate(duty, VBAT, &m);
+
+		energy += calcPower(m.vSolar, m.iSolar);
+		available += bestPower;
+
+		if (step > REGION_STEPS / 2)
+		{
+			if (duty < low)
+				low = duty;
+
+			if (duty > high)
+				high = duty;
+		}
+	}
+
+	pv_SetNoise(0, 0);
+
+	result->efficiency = 100 * energy / available;
+	result->dutySpan = high - low;
+}
+
+static void test_Regions(void)
+{
+	Result result[REGIONS][2];
+	uint8_t r, t;
+
+	printf("region,tracker,efficiency_pct,duty_span_16ths\n");
+
+	for (r = 0; r < REGIONS; r++)
+	{
+		for (t = 0; t < 2; t++)
+		{
+			track(&tracker[t], &region[r], &result[r][t]);
+			printf("%s,%s,%.2f,%u\n", region[r].name, tracker[t].name, result[r][t].efficiency, result[r][t].dutySpan);
+		}
+	}
+
+	// Flat: it settles on one duty cycle at the MPP
+	CHECK(result[0][0].efficiency > 99.5);
+	CHECK_EQUAL(result[0][0].dutySpan, 0);
+
+	// Rising and falling: it follows the MPP
+	CHECK(result[1][0].efficiency > 99.0);
+	CHECK(result[2][0].efficiency > 99.0);
+
+	// Noisy: a count of noise moves it no further than the fixed step P&O dithers
+	CHECK(result[3][0].efficiency > 99.0);
+	CHECK(result[3][0].dutySpan <= DUTY_FINE(6));
+
+	// It never does worse than the step it replaced
+	for (r = 0; r < REGIONS; r++)
+		CHECK(result[r][0].efficiency >= result[r][1].efficiency);
+}
+
+int main(void)
+{
+	test_Decisions();
+	test_Perturb();
+	test_Regions();
+
+	return test_Report("mppt_ic");
+}
@@ -0,0 +1,176 @@
+/** test_mppt_rate.c
+ * Host test of the MPPT control step at the ADC frame rate, against the converter dynamics (buck_model.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The strategy steps the way the ADC DMA interrupt does it: on every MPPT_CONTROL_FRAMES frames, from the averages
+ * of the newest frame (655 uS), with the new duty cycle reaching the power stage LATENCY_US after the frame ended.
+ * Unlike pv_Operate(), the power stage doesn't settle between steps: the input capacitor and the inductor take
+ * about a frame to follow a duty change, so at the new rate every step sees some of the one before it.
+ * P&O starts at MIN_DUTY_CYCLE + 2 with the array at 1000 W/m2 and a 12.8 V battery, at 1, 2, 4 and 16 frames per
+ * step and at the 100 mS the main loop used to step at, for CLIMB_STEPS steps and a second more. The table gives the
+ * time until the array first delivers MPPT_BENCH_CONVERGED_PCT of its maximum power, then over the last second the
+ * tracking efficiency, the duty span and the standard deviation of the array voltage from step to step.
+ */
+
+#include "mppt_strategy.h"
+#include "mppt_bench.h"
+#include "buck_model.h"
+#include "pv_model.h"
+#include "converter.h"
+#include "measure.h"
+#include "test.h"
+
+#include <math.h>
+
+#define FRAME_US		655
+#define LATENCY_US		45			// The step, and half a dither pattern (pwm_dither.c) for the new duty cycle
+#define CLIMB_STEPS		60			// Steps given to get to the MPP, P&O takes about 35 from where it starts
+#define VBAT			12.8
+#define OLD_STEP_FRAMES	153			// 100 mS
+
+typedef struct
+{
+	double convergeMs;				// -1: never
+	double efficiency;				// Percent of the maximum power
+	uint16_t dutySpan;				// 1/16 counts
+	double vRipple;					// mV
+} Result;
+
+
+// Weighted average of the measurements over two consecutive stretches of a frame
+static void frame_Average(const MPPT_Measurement *a, double aUs, const MPPT_Measurement *b, double bUs,
+	MPPT_Measurement *m)
+{
+	m->vSolar = lround((a->vSolar * aUs + b->vSolar * bUs) / (aUs + bUs));
+	m->iSolar = lround((a->iSolar * aUs + b->iSolar * bUs) / (aUs + bUs));
+	m->vBat = lround((a->vBat * aUs + b->vBat * bUs) / (aUs + bUs));
+	m->iBat = lround((a->iBat * aUs + b->iBat * bUs) / (aUs + bUs));
+}
+
+/** Runs the power stage from the end of the frame a step used to the end of the frame the next step uses, with the
+ * old duty cycle until the new one arrives. Returns the newest frame's averages in m.
+ */
+static void control_Period(uint16_t oldDuty, uint16_t newDuty, uint16_t frames, MPPT_Measurement *m)
+{
+	MPPT_Measurement early, late;
+
+	if (frames == 1)
+	{
+		buck_Run(oldDuty, LATENCY_US * 1e-6, &early);
+		buck_Run(newDuty, (FRAME_US - LATENCY_US) * 1e-6, &late);
+		frame_Average(&early, LATENCY_US, &late, FRAME_US - LATENCY_US, m);
+		return;
+	}
+
+	buck_Run(oldDuty, LATENCY_US * 1e-6, &early);
+	buck_Run(newDuty, ((frames - 1) * FRAME_US - LATENCY_US) * 1e-6, &late);
+	buck_Run(newDuty, FRAME_US * 1e-6, m);
+}
+
+static void track(uint16_t frames, Result *result)
+{
+	MPPT_Measurement m;
+	double vMpp, maxPower = pv_MaxPower(&vMpp) * 1000;
+	double energy = 0, sum = 0, sumSquares = 0, t = 0;
+	uint16_t duty = DUTY_FINE(MIN_DUTY_CYCLE + 2), next, low = 0xffff, high = 0;
+	uint32_t samples = 0, run = CLIMB_STEPS * frames * FRAME_US + 1000000, lastSecond = run - 1000000;
+	int32_t command, power;
+
+	buck_Init(pv_OpenCircuit(), VBAT);
+	buck_SetBattery(VBAT, BUCK_BATTERY_R0, 0, 0);
+
+	// Started, and given a few frames to get there
+	buck_Run(duty, 4 * FRAME_US * 1e-6, &m);
+
+	mpptStrategy_Select(MPPT_STRATEGY_PO);
+	mpptStrategy_Init(&m, duty);
+
+	result->convergeMs = -1;
+
+	while (t < run)
+	{
+		command = mpptStrategy_Step(&m, duty);
+
+		if (command > DUTY_FINE(MAX_DUTY_CYCLE))
+			command = DUTY_FINE(MAX_DUTY_CYCLE);
+		if (command < DUTY_FINE(MIN_DUTY_CYCLE))
+			command = DUTY_FINE(MIN_DUTY_CYCLE);
+
+		next = command;
+		control_Period(duty, next, frames, &m);
+		duty = next;
+		t += frames * FRAME_US;
+
+		power = calcPower(m.vSolar, m.iSolar);
+
+		if ( (result->convergeMs < 0) && (power * 100.0 >= maxPower * MPPT_BENCH_CONVERGED_PCT) )
+			result->convergeMs = t / 1000;
+
+		if (t > lastSecond)
+		{
+			energy += power;
+			sum += m.vSolar;
+			sumSquares += (double)m.vSolar * m.vSolar;
+			samples++;
+
+			if (duty < low)
+				low = duty;
+
+			if (duty > high)
+				high = duty;
+		}
+	}
+
+	result->efficiency = 100 * energy / (maxPower * samples);
+	result->dutySpan = high - low;
+	result->vRipple = sqrt(sumSquares / samples - (sum / samples) * (sum / samples));
+}
+
+static void test_Rates(void)
+{
+	static const uint16_t rate[] = { 1, 2, 4, 16, OLD_STEP_FRAMES };
+	Result result[5];
+	uint8_t r;
+
+	pv_SetIrradiance(1000);
+
+	printf("frames_per_step,step_us,ms_to_mpp,efficiency_pct,duty_span_16ths,v_ripple_mv\n");
+
+	for (r = 0; r < 5; r++)
+	{
+		track(rate[r], &result[r]);
+		printf("%u,%u,%.1f,%.2f,%u,%.0f\n", rate[r], rate[r] * FRAME_US, result[r].convergeMs, result[r].efficiency,
+			result[r].dutySpan, result[r].vRipple);
+	}
+
+	// At the frame rate it gets to the MPP in tens of mS, where 100 mS steps take seconds
+	CHECK( (result[0].convergeMs > 0) && (result[0].convergeMs < 100) );
+	CHECK(result[0].convergeMs * 20 < result[4].convergeMs);
+
+	// and the power stage lagging a step behind costs no tracking efficiency
+	CHECK(result[0].efficiency > 99.0);
+	CHECK(result[0].efficiency >= result[4].efficiency - 0.2);
+
+	/* With the power stage a step behind, P&O dithers over four duty cycles instead of the three it does in steady
+	 * state (test_mppt_strategy.c), and no further
+	 */
+	CHECK(result[0].dutySpan <= DUTY_FINE(3));
+}
+
+int main(void)
+{
+	test_Rates();
+
+	return test_Report("mppt_rate");
+}
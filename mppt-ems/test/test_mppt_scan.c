@@ -0,0 +1,218 @@
+/** test_mppt_scan.c
+ * Host test of the periodic global peak scan (mppt_scan.c) on a partly shaded array
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * With one bypass group of the array model (pv_model.c) at 600 W/m2 and the battery at 12.8 V, the array gives 89.3 W
+ * at a peak at duty 196.2 and 95.2 W at MAX_DUTY_CYCLE, with 80.1 W in the valley between. P&O started next to the
+ * lower peak stays on it. The test then runs the scan the way calcMPPT() does, on a virtual clock of MPPT_CONTROL_STEP_US per step,
+ * and checks that P&O carries on from the higher peak, what the scan cost, and when the next one is due. On a single
+ * peak mid sweep the scan has to go back to it, and the strategy may only start once the converter settled there.
+ */
+
+#include "mppt_scan.h"
+#include "mppt_strategy.h"
+#include "converter.h"
+#include "measure.h"
+#include "pv_model.h"
+#include "test.h"
+
+#define STEP_US			655			// MPPT_CONTROL_STEP_US in mppt.c
+#define VBAT			12800
+
+typedef struct
+{
+	uint16_t duty;					// 1/16 counts
+	uint32_t steps;
+	uint32_t scanSteps;
+	uint32_t points;				// Duty cycles the scan measured
+	uint16_t lowest, highest;		// Range it covered, in counts
+	uint32_t held;					// Measurements taken at the present duty cycle
+	uint32_t handoverHeld;			// held when the scan last handed back to the strategy
+	uint16_t handoverDuty;
+	double energy;					// Array energy in J
+} Run;
+
+static MPPT_Measurement m;
+
+
+static uint32_t now(const Run *run)
+{
+	return (uint64_t)run->steps * STEP_US / 1000;
+}
+
+// One control step as calcMPPT() takes it, with the scan enabled or not
+static void step(Run *run, bool scan)
+{
+	int32_t command;
+	uint16_t scanDuty, duty = run->duty;
+
+	if (scan && mpptScan_Due(now(run)))
+		mpptScan_Start(now(run));
+
+	if (scan && mpptScan_Active())
+	{
+		scanDuty = run->duty >> DUTY_FRACTION_BITS;
+
+		if (mpptScan_Step(&m, &scanDuty))
+		{
+			if (DUTY_FINE(scanDuty) != run->duty)
+			{
+				if (scanDuty < run->lowest)
+					run->lowest = scanDuty;
+				if (scanDuty > run->highest)
+					run->highest = scanDuty;
+			}
+
+			run->duty = DUTY_FINE(scanDuty);
+		}
+		else
+		{
+			run->handoverHeld = run->held;
+			run->handoverDuty = run->duty;
+			mpptStrategy_Init(&m, run->duty);
+		}
+
+		run->scanSteps++;
+	}
+	else
+	{
+		command = mpptStrategy_Step(&m, run->duty);
+
+		if (command > DUTY_FINE(MAX_DUTY_CYCLE))
+			command = DUTY_FINE(MAX_DUTY_CYCLE);
+		if (command < DUTY_FINE(MIN_DUTY_CYCLE))
+			command = DUTY_FINE(MIN_DUTY_CYCLE);
+
+		run->duty = command;
+	}
+
+	if (run->duty != duty)
+		run->held = 0;
+
+	pv_Operate(run->duty, VBAT, &m);
+	run->held++;
+	run->energy += calcPower(m.vSolar, m.iSolar) * 1e-3 * STEP_US * 1e-6;
+	run->steps++;
+}
+
+static void start(Run *run, uint16_t duty)
+{
+	run->duty = duty;
+	run->steps = 0;
+	run->scanSteps = 0;
+	run->lowest = MAX_DUTY_CYCLE;
+	run->highest = MIN_DUTY_CYCLE;
+	run->energy = 0;
+	run->held = 1;
+	run->handoverHeld = 0;
+
+	mpptStrategy_Select(MPPT_STRATEGY_PO);
+	pv_Operate(duty, VBAT, &m);
+	mpptStrategy_Init(&m, duty);
+}
+
+// Mean array power over the next steps, in mW
+static int32_t meanPower(Run *run, bool scan, uint32_t steps)
+{
+	double energy = run->energy;
+	uint32_t i;
+
+	for (i = 0; i < steps; i++)
+		step(run, scan);
+
+	return (int32_t)((run->energy - energy) / (steps * STEP_US * 1e-6) * 1000);
+}
+
+static void test_Shaded(void)
+{
+	double shading[PV_GROUPS] = { 600, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000 };
+	Run local, scanned;
+	int32_t localPower, before, after, best;
+	uint32_t scanSteps;
+	uint16_t bestDuty;
+
+	pv_SetShading(shading);
+	best = pv_BestDuty(VBAT, &bestDuty);
+
+	// Without the scan, P&O never leaves the lower peak
+	start(&local, DUTY_FINE(200));
+	localPower = meanPower(&local, false, 5000);
+
+	// With it, the first scan is due at once
+	start(&scanned, DUTY_FINE(200));
+	mpptScan_Schedule(0);
+	before = calcPower(m.vSolar, m.iSolar);
+	after = meanPower(&scanned, true, 5000);
+	scanSteps = scanned.scanSteps;
+
+	printf("case,best_mw,best_duty,local_mw,after_scan_mw,scan_steps,scan_ms,range\n");
+	printf("shaded,%d,%.2f,%d,%d,%u,%.1f,%u..%u\n", best, bestDuty / 16.0, localPower, after, scanSteps,
+		scanSteps * STEP_US / 1000.0, scanned.lowest, scanned.highest);
+
+	CHECK(localPower < best * 95 / 100);
+	CHECK(before < best * 95 / 100);
+	CHECK(after > best * 99 / 100);
+	CHECK(scanned.duty >= bestDuty - DUTY_FINE(3) && scanned.duty <= bestDuty + DUTY_FINE(3));
+
+	// The sweep covers the whole range within its budget of points and settling steps
+	CHECK_EQUAL(scanned.lowest, MIN_DUTY_CYCLE);
+	CHECK_EQUAL(scanned.highest, MAX_DUTY_CYCLE);
+	CHECK(scanSteps <= (MPPT_SCAN_POINTS + 1) * (MPPT_SCAN_SETTLE_STEPS + 1) + 2);
+	CHECK(mpptScan_GetPeakPower() > best * 98 / 100);
+
+	// The strategy starts from a measurement taken at the peak
+	CHECK(scanned.handoverDuty >= bestDuty - DUTY_FINE(3) && scanned.handoverDuty <= bestDuty + DUTY_FINE(3));
+
+	// Once over, the next scan waits MPPT_SCAN_INTERVAL_MS from the start of this one
+	CHECK(!mpptScan_Active());
+	CHECK(!mpptScan_Due(MPPT_SCAN_INTERVAL_MS - 1));
+	CHECK(mpptScan_Due(MPPT_SCAN_INTERVAL_MS));
+}
+
+// On a single peak the scan comes back to where the strategy was
+static void test_Unshaded(void)
+{
+	Run run;
+	int32_t before, after, best;
+	uint16_t bestDuty;
+
+	pv_SetIrradiance(1000);
+	best = pv_BestDuty(VBAT, &bestDuty);
+
+	start(&run, bestDuty);
+	before = meanPower(&run, false, 2000);
+
+	mpptScan_Schedule(now(&run));
+	meanPower(&run, true, 1000);
+	after = meanPower(&run, true, 2000);
+
+	printf("unshaded,%d,%.2f,%d,%d,%u,%.1f,%u..%u\n", best, bestDuty / 16.0, before, after, run.scanSteps,
+		run.scanSteps * STEP_US / 1000.0, run.lowest, run.highest);
+
+	CHECK(after >= before * 999 / 1000);
+
+	// Here the peak is mid sweep, so the scan has to go back to it, and wait there as long as at any sweep point
+	// before the strategy starts from a measurement taken there
+	CHECK(run.handoverDuty != DUTY_FINE(MAX_DUTY_CYCLE));
+	CHECK(run.handoverDuty >= bestDuty - DUTY_FINE(3) && run.handoverDuty <= bestDuty + DUTY_FINE(3));
+	CHECK(run.handoverHeld > MPPT_SCAN_SETTLE_STEPS);
+}
+
+int main(void)
+{
+	test_Shaded();
+	test_Unshaded();
+
+	return test_Report("mppt_scan");
+}
@@ -0,0 +1,180 @@
+/** test_mppt_seed.c
+ * Host test of the seeded converter start (mpptStrategy_SeedDuty()) over a dawn ramp
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The irradiance on the array model (pv_model.c) rises from 0 to 1000 W/m2 over 10 minutes. Every MEASURE_PERIOD the
+ * test does what chargeTask() does with the converter off: once Voc is TWO_VOLT above the battery it starts the
+ * converter, and one task period later it keeps it running if the array gives THRESHOLD_CURRENT, or stops it and waits
+ * LOW_CHARGE_CURRENT_TIMEOUT seconds. While it runs, P&O steps every MPPT_CONTROL_STEP_US. The run is made with the
+ * seeded start and with the fixed PCT80_DUTY_CYCLE start it replaced, and reports the time of the first start that
+ * held, the time from when the array could first charge until it delivered MPPT_BENCH_CONVERGED_PCT of the available
+ * power, and the energy over the first RUN_S seconds.
+ */
+
+#include "mppt_strategy.h"
+#include "mppt_bench.h"
+#include "converter.h"
+#include "measure.h"
+#include "pv_model.h"
+#include "test.h"
+
+#define STEP_US				655			// MPPT_CONTROL_STEP_US in mppt.c
+#define TASK_STEPS			153			// MEASURE_PERIOD (100 mS) in control steps
+#define RETRY_STEPS			15267		// LOW_CHARGE_CURRENT_TIMEOUT (10 S) in control steps
+#define RAMP_S				600
+#define RUN_S				120			// Both starts are at rated power well inside this
+#define VBAT				12800
+#define START_MARGIN_MV		2000		// TWO_VOLT
+#define START_CURRENT_MA	394			// THRESHOLD_CURRENT
+
+typedef struct
+{
+	double chargeable;				// S: Voc first TWO_VOLT above the battery
+	double started;					// S: first start that held
+	double rated;					// S: first step at MPPT_BENCH_CONVERGED_PCT of the available power
+	uint16_t failedStarts;
+	double energy;					// J
+	double available;				// J from the first possible start on
+} Dawn;
+
+
+static double irradiance(uint32_t step)
+{
+	double t = step * STEP_US * 1e-6;
+
+	return (t < RAMP_S) ? 1000 * t / RAMP_S : 1000;
+}
+
+static void dawn(bool seeded, Dawn *result)
+{
+	MPPT_Measurement m;
+	uint32_t step, end = (uint32_t)(RUN_S * 1e6 / STEP_US), retry = 0;
+	uint16_t duty = 0, best;
+	int32_t available = 0, command, power;
+	double voc;
+	bool running = false, starting = false;
+
+	result->chargeable = -1;
+	result->started = -1;
+	result->rated = -1;
+	result->failedStarts = 0;
+	result->energy = 0;
+	result->available = 0;
+
+	mpptStrategy_Select(MPPT_STRATEGY_PO);
+
+	for (step = 0; step < end; step++)
+	{
+		pv_SetIrradiance(irradiance(step));
+
+		if (step % TASK_STEPS == 0)
+		{
+			voc = pv_OpenCircuit() * 1000;
+			available = pv_BestDuty(VBAT, &best);
+
+			if ( (result->chargeable < 0) && (voc >= VBAT + START_MARGIN_MV) )
+				result->chargeable = step * STEP_US * 1e-6;
+
+			// CHARGE_START: the converter ran for one task period at the start duty
+			if (starting)
+			{
+				starting = false;
+
+				if (m.iSolar >= START_CURRENT_MA)
+				{
+					running = true;
+					mpptStrategy_Init(&m, duty);
+
+					if (result->started < 0)
+						result->started = step * STEP_US * 1e-6;
+				}
+				else
+				{
+					duty = 0;
+					retry = step + RETRY_STEPS;
+					result->failedStarts++;
+				}
+			}
+
+			// CHARGE_WAIT
+			else if ( !running && (voc >= VBAT + START_MARGIN_MV) && (step >= retry) )
+			{
+				duty = seeded ? DUTY_FINE(mpptStrategy_SeedDuty((int32_t)voc, VBAT)) : DUTY_FINE(PCT80_DUTY_CYCLE);
+				starting = true;
+			}
+		}
+
+		if (running)
+		{
+			command = mpptStrategy_Step(&m, duty);
+
+			if (command > DUTY_FINE(MAX_DUTY_CYCLE))
+				command = DUTY_FINE(MAX_DUTY_CYCLE);
+			if (command < DUTY_FINE(MIN_DUTY_CYCLE))
+				command = DUTY_FINE(MIN_DUTY_CYCLE);
+
+			duty = command;
+		}
+
+		if (duty == 0)
+			continue;
+
+		pv_Operate(duty, VBAT, &m);
+		power = calcPower(m.vSolar, m.iSolar);
+
+		result->energy += power * 1e-3 * STEP_US * 1e-6;
+
+		if (result->chargeable >= 0)
+			result->available += available * 1e-3 * STEP_US * 1e-6;
+
+		if ( running && (result->rated < 0) && ((int64_t)power * 100 >= (int64_t)available * MPPT_BENCH_CONVERGED_PCT) )
+			result->rated = step * STEP_US * 1e-6;
+	}
+}
+
+static void test_Dawn(void)
+{
+	Dawn seeded, fixed;
+
+	dawn(true, &seeded);
+	dawn(false, &fixed);
+
+	printf("start,chargeable_s,started_s,failed_starts,time_to_rated_s,energy_j,efficiency_pct\n");
+	printf("seeded,%.1f,%.1f,%u,%.2f,%.0f,%.2f\n", seeded.chargeable, seeded.started, seeded.failedStarts,
+		seeded.rated - seeded.chargeable, seeded.energy, 100 * seeded.energy / seeded.available);
+	printf("pct80,%.1f,%.1f,%u,%.2f,%.0f,%.2f\n", fixed.chargeable, fixed.started, fixed.failedStarts,
+		fixed.rated - fixed.chargeable, fixed.energy, 100 * fixed.energy / fixed.available);
+
+	CHECK(seeded.started > 0);
+	CHECK(seeded.rated > 0);
+	CHECK(seeded.rated <= fixed.rated);
+	CHECK(seeded.energy >= fixed.energy);
+}
+
+// The seed itself: 0.76 Voc, and the limits of the duty range
+static void test_Seed(void)
+{
+	CHECK_EQUAL(mpptStrategy_SeedDuty(20000, 12800), 12800 * TIM1_PERIOD / (20000 * MPPT_SEED_VOC_FRACTION_Q8 / 256));
+	CHECK_EQUAL(mpptStrategy_SeedDuty(30000, 12800), MIN_DUTY_CYCLE);
+	CHECK_EQUAL(mpptStrategy_SeedDuty(14000, 12800), MAX_DUTY_CYCLE);
+	CHECK_EQUAL(mpptStrategy_SeedDuty(0, 12800), MAX_DUTY_CYCLE);
+}
+
+int main(void)
+{
+	test_Dawn();
+	test_Seed();
+
+	return test_Report("mppt_seed");
+}
@@ -0,0 +1,173 @@
+/** test_mppt_strategy.c
+ * Host test of the MPPT strategies (mppt_strategy.c and the strategy sources) against a model of the array
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every strategy starts at MIN_DUTY_CYCLE, on the steep side of the unshaded array's P-V curve (pv_model.c), and is
+ * stepped the way calcMPPT() does it, with the converter in steady state after every step. Each one runs once on exact
+ * measurements and once with up to a count of ADC noise on them. The table gives the steps (and mS at MPPT_CONTROL_STEP_US) until the array first delivers
+ * MPPT_BENCH_CONVERGED_PCT of the best power any duty cycle gets, then the tracking efficiency, the duty span
+ * and the mean step to step power change over the second half of the run.
+ */
+
+#include "mppt_strategy.h"
+#include "mppt_bench.h"
+#include "converter.h"
+#include "measure.h"
+#include "pv_model.h"
+#include "test.h"
+
+#include <stdlib.h>
+
+#define STEPS			2000
+#define STEP_US			655			// MPPT_CONTROL_STEP_US in mppt.c
+#define VBAT			12800
+
+static const char *strategyName[MPPT_STRATEGY_COUNT] = { "po", "ti", "ic", "cv", "vpo" };
+
+typedef struct
+{
+	int32_t convergeSteps;			// -1: never
+	double efficiency;				// Percent of the best power
+	uint16_t dutySpan;				// 1/16 counts
+	double ripple;					// mW
+} Result;
+
+
+// calcMPPT()'s limits on a duty command
+static uint16_t limit(int32_t command)
+{
+	if (command >= DUTY_FINE(MAX_DUTY_CYCLE))
+		return DUTY_FINE(MAX_DUTY_CYCLE);
+
+	if (command <= DUTY_FINE(MIN_DUTY_CYCLE))
+		return DUTY_FINE(MIN_DUTY_CYCLE);
+
+	return command;
+}
+
+static void track(uint8_t strategy, uint16_t duty, Result *result)
+{
+	MPPT_Measurement m;
+	uint16_t best, low = 0xffff, high = 0;
+	int32_t available = pv_BestDuty(VBAT, &best);
+	int32_t power, lastPower = -1;
+	uint64_t energy = 0, change = 0;
+	uint32_t step;
+
+	mpptStrategy_Select(strategy);
+	pv_Operate(duty, VBAT, &m);
+	mpptStrategy_Init(&m, duty);
+
+	result->convergeSteps = -1;
+
+	for (step = 1; step <= STEPS; step++)
+	{
+		duty = limit(mpptStrategy_Step(&m, duty));
+		pv_Operate(duty, VBAT, &m);
+
+		power = calcPower(m.vSolar, m.iSolar);
+
+		if ( (result->convergeSteps < 0) && ((int64_t)power * 100 >= (int64_t)available * MPPT_BENCH_CONVERGED_PCT) )
+			result->convergeSteps = step;
+
+		if (step > STEPS / 2)
+		{
+			energy += power;
+
+			if (lastPower >= 0)
+				change += abs(power - lastPower);
+
+			if (duty < low)
+				low = duty;
+
+			if (duty > high)
+				high = duty;
+
+			lastPower = power;
+		}
+	}
+
+	result->efficiency = 100.0 * energy / ((double)available * (STEPS / 2));
+	result->dutySpan = high - low;
+	result->ripple = (double)change / (STEPS / 2 - 1);
+}
+
+static void table(const char *noise, Result *result)
+{
+	uint8_t s;
+
+	for (s = 0; s < MPPT_STRATEGY_COUNT; s++)
+	{
+		track(s, DUTY_FINE(MIN_DUTY_CYCLE + 2), &result[s]);
+
+		printf("%s,%s,%d,%.1f,%.2f,%u,%.0f\n", strategyName[s], noise, result[s].convergeSteps,
+			(result[s].convergeSteps < 0) ? -1.0 : result[s].convergeSteps * STEP_US / 1000.0,
+			result[s].efficiency, result[s].dutySpan, result[s].ripple);
+	}
+}
+
+static void test_Strategies(void)
+{
+	Result clean[MPPT_STRATEGY_COUNT], noisy[MPPT_STRATEGY_COUNT];
+	uint8_t s;
+
+	pv_SetIrradiance(1000);
+
+	printf("strategy,noise,steps_to_mpp,ms_to_mpp,efficiency_pct,duty_span_16ths,ripple_mw\n");
+
+	pv_SetNoise(0, 0);
+	table("none", clean);
+
+	pv_SetNoise(6, 8);
+	table("1_count", noisy);
+
+	pv_SetNoise(0, 0);
+
+	// The perturbing hill climbers find the MPP from the far end of the range within a count or two per step, and stay there
+	for (s = 0; s < MPPT_STRATEGY_COUNT; s++)
+	{
+		if (s == MPPT_STRATEGY_CV)
+			continue;
+
+		CHECK( (clean[s].convergeSteps > 0) && (clean[s].convergeSteps < 40) );
+		CHECK(clean[s].efficiency > 99.5);
+		CHECK(noisy[s].efficiency > 99.0);
+	}
+
+	// Fixed steps dither over three duty cycles, the variable step and incremental conductance settle
+	CHECK(clean[MPPT_STRATEGY_PO].dutySpan <= DUTY_FINE(2));
+	CHECK(clean[MPPT_STRATEGY_TI].dutySpan <= DUTY_FINE(2));
+	CHECK(clean[MPPT_STRATEGY_VPO].dutySpan < clean[MPPT_STRATEGY_PO].dutySpan);
+	CHECK_EQUAL(clean[MPPT_STRATEGY_IC].dutySpan, 0);
+
+	// The constant voltage ratio holds its set point, which is near the MPP of this array but not at it
+	CHECK(clean[MPPT_STRATEGY_CV].efficiency > 90.0);
+	CHECK_EQUAL(clean[MPPT_STRATEGY_CV].dutySpan, 0);
+}
+
+// An unknown strategy index is refused and leaves the active one alone
+static void test_Select(void)
+{
+	CHECK(mpptStrategy_Select(MPPT_STRATEGY_IC));
+	CHECK(!mpptStrategy_Select(MPPT_STRATEGY_COUNT));
+	CHECK_EQUAL(mpptStrategy_GetActive(), MPPT_STRATEGY_IC);
+}
+
+int main(void)
+{
+	test_Strategies();
+	test_Select();
+
+	return test_Report("mppt_strategy");
+}
@@ -0,0 +1,150 @@
+/** test_mppt_vpo.c
+ * Host test of the variable step perturb and observe strategy (mppt_vpo.c) against the fixed step one over a cloud
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * A cloud passes over the array model (pv_model.c): 1000 W/m2, down to 300 W/m2 in 200 mS, 2 S in its shadow,
+ * and back up in 200 mS. Both strategies track it at MPPT_CONTROL_STEP_US with a count of ADC noise, and the test
+ * compares the energy each one takes from the array with the energy available at the best duty cycle of every step,
+ * over the whole run and over the second after each edge.
+ */
+
+#include "mppt_strategy.h"
+#include "converter.h"
+#include "measure.h"
+#include "pv_model.h"
+#include "test.h"
+
+#define STEP_US			655			// MPPT_CONTROL_STEP_US in mppt.c
+#define VBAT			12800
+#define RUN_MS			6400
+
+typedef struct
+{
+	double energy;					// J
+	double available;				// J
+	double edgeEnergy;				// J in the second after each edge
+	double edgeAvailable;
+} Result;
+
+static int32_t bestPower;
+static double bestIrradiance = -1;
+
+
+// The cloud, in W/m2 at t mS
+static double cloud(double t)
+{
+	if (t < 1000)
+		return 1000;
+
+	if (t < 1200)
+		return 1000 - 700 * (t - 1000) / 200;
+
+	if (t < 3200)
+		return 300;
+
+	if (t < 3400)
+		return 300 + 700 * (t - 3200) / 200;
+
+	return 1000;
+}
+
+static bool afterEdge(double t)
+{
+	return ((t >= 1000) && (t < 2200)) || ((t >= 3200) && (t < 4400));
+}
+
+static void run(uint8_t strategy, Result *result)
+{
+	MPPT_Measurement m;
+	uint16_t duty = DUTY_FINE(205), best;
+	double t, watts, g;
+	int32_t command;
+
+	pv_SetIrradiance(cloud(0));
+	pv_SetNoise(6, 8);
+
+	mpptStrategy_Select(strategy);
+	pv_Operate(duty, VBAT, &m);
+	mpptStrategy_Init(&m, duty);
+
+	result->energy = 0;
+	result->available = 0;
+	result->edgeEnergy = 0;
+	result->edgeAvailable = 0;
+
+	for (t = 0; t < RUN_MS; t += STEP_US / 1000.0)
+	{
+		command = mpptStrategy_Step(&m, duty);
+
+		if (command > DUTY_FINE(MAX_DUTY_CYCLE))
+			command = DUTY_FINE(MAX_DUTY_CYCLE);
+		if (command < DUTY_FINE(MIN_DUTY_CYCLE))
+			command = DUTY_FINE(MIN_DUTY_CYCLE);
+
+		duty = command;
+		g = cloud(t);
+
+		pv_SetIrradiance(g);
+		pv_Operate(duty, VBAT, &m);
+
+		if (g != bestIrradiance)
+		{
+			bestPower = pv_BestDuty(VBAT, &best);
+			bestIrradiance = g;
+		}
+
+		// What the array delivers, rather than what the strategy measured
+		watts = pv_ArrayVoltage(duty, VBAT);
+		watts = (watts < pv_OpenCircuit()) ? watts * pv_Current(watts) : 0;
+
+		result->energy += watts * STEP_US * 1e-6;
+		result->available += bestPower * 1e-3 * STEP_US * 1e-6;
+
+		if (afterEdge(t))
+		{
+			result->edgeEnergy += watts * STEP_US * 1e-6;
+			result->edgeAvailable += bestPower * 1e-3 * STEP_US * 1e-6;
+		}
+	}
+
+	pv_SetNoise(0, 0);
+}
+
+static void test_Cloud(void)
+{
+	Result po, vpo;
+
+	run(MPPT_STRATEGY_PO, &po);
+	run(MPPT_STRATEGY_VPO, &vpo);
+
+	printf("strategy,energy_j,available_j,efficiency_pct,edge_efficiency_pct\n");
+	printf("po,%.2f,%.2f,%.3f,%.3f\n", po.energy, po.available, 100 * po.energy / po.available,
+		100 * po.edgeEnergy / po.edgeAvailable);
+	printf("vpo,%.2f,%.2f,%.3f,%.3f\n", vpo.energy, vpo.available, 100 * vpo.energy / vpo.available,
+		100 * vpo.edgeEnergy / vpo.edgeAvailable);
+
+	// At this step rate the fixed step keeps up with 3500 W/m2/S, so the variable step can't gain on the edges here.
+	// What it must not do is lose more than noise: a step sized from a dP/dV inside the noise used to cost 0.1 %.
+	CHECK(po.energy / po.available > 0.995);
+	CHECK(vpo.energy / vpo.available > 0.995);
+	CHECK(vpo.energy / vpo.available > po.energy / po.available - 0.0005);
+	CHECK(vpo.edgeEnergy / vpo.edgeAvailable > po.edgeEnergy / po.edgeAvailable - 0.0005);
+}
+
+int main(void)
+{
+	test_Cloud();
+
+	return test_Report("mppt_vpo");
+}
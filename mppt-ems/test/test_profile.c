@@ -0,0 +1,166 @@
+/** test_profile.c
+ * Host test of the profiler (profile.c) on its host clock, with probes stopped from a signal as well
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * On a host build the probes time with the monotonic clock in ns, and the records are what CMD_PROFILE would send
+ * from a simulation: the first test times sleeps of a known length. The second checks that prof_Reset() clears the
+ * records at the next stop and not before. The last stops one probe in the main context as fast as it can while a
+ * signal every 20 uS stops another, the way the tick interrupt stops PROF_TICK_ISR in the middle of the main loop's
+ * probes: no stop may be lost, and no copy prof_Get() makes may be torn.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "profile.h"
+#include "test.h"
+
+#include <time.h>
+
+#define SLEEP_NS		1000000
+#define SLEEPS			5
+#define MAIN_STOPS		500000
+
+static volatile uint32_t interruptStops;
+
+
+static void sleepNs(long ns)
+{
+	struct timespec pause = { 0, ns };
+
+	nanosleep(&pause, NULL);
+}
+
+static void test_HostClock(void)
+{
+	PROF_Record record;
+	uint32_t start, before;
+	uint8_t k;
+
+	prof_Init();
+
+	before = prof_Now();
+	sleepNs(SLEEP_NS);
+	CHECK(prof_Now() - before >= SLEEP_NS);
+
+	for (k = 0; k < SLEEPS; k++)
+	{
+		start = prof_Now();
+		sleepNs(SLEEP_NS);
+		prof_Stop(PROF_UPDATE_LCD, start);
+	}
+
+	prof_Get(PROF_UPDATE_LCD, &record);
+
+	printf("  %u sleeps of %d ns: min %u ns, max %u ns, mean %llu ns\n", record.count, SLEEP_NS, record.min, record.max,
+		(unsigned long long)(record.total / record.count));
+
+	CHECK_EQUAL(record.count, SLEEPS);
+	CHECK(record.min >= SLEEP_NS);
+	CHECK(record.max >= record.min);
+	CHECK(record.max < 100 * SLEEP_NS);
+	CHECK(record.total >= (uint64_t)record.min * SLEEPS);
+	CHECK(record.total <= (uint64_t)record.max * SLEEPS);
+
+	// The other probes, and probes that don't exist, have nothing
+	prof_Get(PROF_MPPT_STEP, &record);
+	CHECK_EQUAL(record.count, 0);
+
+	prof_Stop(PROF_PROBES, prof_Now());
+	prof_Get(PROF_PROBES, &record);
+	CHECK_EQUAL(record.count, 0);
+	CHECK_EQUAL(record.total, 0);
+}
+
+static void test_Reset(void)
+{
+	PROF_Record record;
+
+	prof_Stop(PROF_SEND_MESSAGE, prof_Now());
+	prof_Reset();
+
+	// Nothing is cleared until a probe stops
+	prof_Get(PROF_UPDATE_LCD, &record);
+	CHECK_EQUAL(record.count, SLEEPS);
+
+	prof_Stop(PROF_DEBUG_PRINT, prof_Now());
+
+	prof_Get(PROF_UPDATE_LCD, &record);
+	CHECK_EQUAL(record.count, 0);
+	prof_Get(PROF_SEND_MESSAGE, &record);
+	CHECK_EQUAL(record.count, 0);
+	prof_Get(PROF_DEBUG_PRINT, &record);
+	CHECK_EQUAL(record.count, 1);
+}
+
+static void tick_Interrupt(void)
+{
+	prof_Stop(PROF_TICK_ISR, prof_Now());
+	interruptStops++;
+}
+
+static bool record_Whole(const PROF_Record *record)
+{
+	if (record->count == 0)
+		return record->total == 0;
+
+	return (record->min <= record->max) && (record->total >= (uint64_t)record->min * record->count) &&
+		(record->total <= (uint64_t)record->max * record->count);
+}
+
+static void test_Preempted(void)
+{
+	PROF_Record record;
+	uint32_t k, torn = 0;
+
+	prof_Init();
+	interruptStops = 0;
+
+	host_Interrupts(tick_Interrupt, 20);
+
+	for (k = 0; k < MAIN_STOPS; k++)
+	{
+		prof_Stop(PROF_GET_ADC_READINGS, prof_Now());
+
+		if (k % 64 == 0)
+		{
+			prof_Get(PROF_TICK_ISR, &record);
+
+			if (!record_Whole(&record))
+				torn++;
+		}
+	}
+
+	host_Interrupts(NULL, 0);
+
+	prof_Get(PROF_GET_ADC_READINGS, &record);
+	CHECK_EQUAL(record.count, MAIN_STOPS);
+	CHECK(record_Whole(&record));
+
+	prof_Get(PROF_TICK_ISR, &record);
+
+	printf("  %u main stops, %u interrupt stops\n", MAIN_STOPS, interruptStops);
+
+	CHECK(interruptStops > 100);
+	CHECK_EQUAL(record.count, interruptStops);
+	CHECK(record_Whole(&record));
+	CHECK_EQUAL(torn, 0);
+}
+
+int main(void)
+{
+	test_HostClock();
+	test_Reset();
+	test_Preempted();
+
+	return test_Report("profile");
+}
@@ -0,0 +1,251 @@
+/** test_pwm_dither.c
+ * Host test of the TIM1 duty cycle dithering (pwm_dither.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The test plays TIM1 and DMA2 Stream 5: every update event moves the next CCR1, CCR2 pair of the circular table
+ * pwmDither_Start() handed the DMA into the timer, the way the DMA burst through TIM1->DMAR does. For every duty cycle
+ * in 1/16 counts over MIN_DUTY_CYCLE..MAX_DUTY_CYCLE it checks what the timer gets over 16 periods: the average is the
+ * duty cycle, CCR2 = TIM1_PERIOD - CCR1 in every period, and only the two counts either side are used. The table gives,
+ * per fraction, how far the running sum of the counts gets from the ideal one, in count periods, next to what the same
+ * number of high periods in one block would give. A first order sigma-delta keeps it below one.
+ * The stream is set up as stm32f4xx_hal_msp.c sets it up, and the model reads the table the way the stream does: a
+ * period in one word read with word memory accesses, in two half-word reads otherwise. The last test rewrites the
+ * table from a signal every INTERRUPT_US, the way calcMPPT() does from the ADC interrupt, while the main context runs
+ * update events as fast as it can: no period may get the CCR1 of one duty cycle with the CCR2 of the other.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "pwm_dither.h"
+#include "converter.h"
+#include "test.h"
+
+#include <math.h>
+
+#define PERIODS			(1 << DUTY_FRACTION_BITS)
+#define INTERRUPT_US	20
+#define UPDATES			20000000
+#define DUTY_A			(DUTY_FINE(MIN_DUTY_CYCLE + 5) + 3)
+#define DUTY_B			(DUTY_FINE(MAX_DUTY_CYCLE - 5) + 11)
+
+TIM_HandleTypeDef htim1;
+DMA_HandleTypeDef hdma_tim1_up;
+
+static volatile uint32_t interrupts;
+
+
+// One TIM1 update event: the DMA writes the next pair of the circular table
+static void tim1_Update(void)
+{
+	const volatile uint16_t *table = (const volatile uint16_t *)hdma_tim1_up.Instance->M0AR;
+	uint16_t next = 2 * PERIODS - hdma_tim1_up.Instance->NDTR;
+	uint32_t pair;
+
+	if ( !(TIM1->DIER & TIM_DMA_UPDATE) || !(hdma_tim1_up.Instance->CR & DMA_SxCR_EN) )
+		return;
+
+	if ((hdma_tim1_up.Instance->CR & DMA_SxCR_MSIZE) == DMA_MDATAALIGN_WORD)
+	{
+		pair = ((const volatile uint32_t *)table)[next / 2];
+		TIM1->CCR1 = pair & 0xffff;
+		TIM1->CCR2 = pair >> 16;
+	}
+	else
+	{
+		TIM1->CCR1 = table[next];
+		TIM1->CCR2 = table[next + 1];
+	}
+
+	hdma_tim1_up.Instance->NDTR -= 2;
+
+	if (hdma_tim1_up.Instance->NDTR == 0)
+		hdma_tim1_up.Instance->NDTR = 2 * PERIODS;
+}
+
+// The DMA is set up for a two register burst from CCR1 into TIM1->DMAR, over the whole table
+static void test_Start(void)
+{
+	pwmDither_Set(DUTY_FINE(MIN_DUTY_CYCLE));
+	pwmDither_Start();
+
+	CHECK_EQUAL(TIM1->DCR, TIM_DMABASE_CCR1 | TIM_DMABURSTLENGTH_2TRANSFERS);
+	CHECK_EQUAL(hdma_tim1_up.Instance->PAR, (uint32_t)&TIM1->DMAR);
+	CHECK_EQUAL(hdma_tim1_up.Instance->NDTR, 2 * PERIODS);
+	CHECK(TIM1->DIER & TIM_DMA_UPDATE);
+}
+
+// Every duty cycle, 16 periods each, with the pattern in the middle of a DMA cycle when the duty cycle changes
+static void test_Average(void)
+{
+	uint16_t duty, k;
+	uint32_t sum;
+	bool average = true, paired = true, adjacent = true;
+
+	for (duty = DUTY_FINE(MIN_DUTY_CYCLE); duty <= DUTY_FINE(MAX_DUTY_CYCLE); duty++)
+	{
+		pwmDither_Set(duty);
+		sum = 0;
+
+		for (k = 0; k < PERIODS; k++)
+		{
+			tim1_Update();
+			sum += TIM1->CCR1;
+
+			if (TIM1->CCR1 + TIM1->CCR2 != TIM1_PERIOD)
+				paired = false;
+
+			if ( (TIM1->CCR1 != (duty >> DUTY_FRACTION_BITS)) && (TIM1->CCR1 != (duty >> DUTY_FRACTION_BITS) + 1) )
+				adjacent = false;
+		}
+
+		// 16 periods from anywhere in the cycle add up to the duty cycle in 1/16 counts
+		if (sum != duty)
+			average = false;
+	}
+
+	CHECK(average);
+	CHECK(paired);
+	CHECK(adjacent);
+}
+
+// The spread of the high periods over the pattern, per fraction
+static void test_Spread(void)
+{
+	uint16_t fraction, k, pulse = MIN_DUTY_CYCLE + 10;
+	double running, worst, block;
+	bool bounded = true;
+
+	printf("fraction_16ths,worst_error_periods,block_error_periods\n");
+
+	for (fraction = 0; fraction < PERIODS; fraction++)
+	{
+		pwmDither_Set(DUTY_FINE(pulse) + fraction);
+
+		// Start the table from its first period
+		hdma_tim1_up.Instance->NDTR = 2 * PERIODS;
+
+		running = 0;
+		worst = 0;
+
+		for (k = 1; k <= PERIODS; k++)
+		{
+			tim1_Update();
+			running += TIM1->CCR1 - pulse;
+
+			if (fabs(running - (double)fraction * k / PERIODS) > worst)
+				worst = fabs(running - (double)fraction * k / PERIODS);
+		}
+
+		// All fraction high periods first: the error peaks after them
+		block = (double)fraction * (PERIODS - fraction) / PERIODS;
+
+		printf("%u,%.3f,%.3f\n", fraction, worst, block);
+
+		if (worst >= 1)
+			bounded = false;
+	}
+
+	CHECK(bounded);
+}
+
+// Stopped, the timer keeps the last period's values
+static void test_Stop(void)
+{
+	uint16_t ccr1;
+
+	pwmDither_Set(DUTY_FINE(MAX_DUTY_CYCLE - 1) + 8);
+	tim1_Update();
+	ccr1 = TIM1->CCR1;
+
+	pwmDither_Stop();
+	tim1_Update();
+
+	CHECK(!(TIM1->DIER & TIM_DMA_UPDATE));
+	CHECK(!(hdma_tim1_up.Instance->CR & DMA_SxCR_EN));
+	CHECK_EQUAL(TIM1->CCR1, ccr1);
+}
+
+// The ADC interrupt: the next step's duty cycle
+static void adc_Interrupt(void)
+{
+	pwmDither_Set((interrupts & 1) ? DUTY_B : DUTY_A);
+	interrupts++;
+}
+
+static bool duty_Count(uint16_t ccr1)
+{
+	return (ccr1 == (DUTY_A >> DUTY_FRACTION_BITS)) || (ccr1 == (DUTY_A >> DUTY_FRACTION_BITS) + 1) ||
+		(ccr1 == (DUTY_B >> DUTY_FRACTION_BITS)) || (ccr1 == (DUTY_B >> DUTY_FRACTION_BITS) + 1);
+}
+
+// The table rewritten from a signal while the update events read it
+static void test_Preempted(void)
+{
+	uint32_t k, torn = 0, stray = 0;
+
+	pwmDither_Set(DUTY_A);
+	pwmDither_Start();
+	interrupts = 0;
+
+	host_Interrupts(adc_Interrupt, INTERRUPT_US);
+
+	for (k = 0; k < UPDATES; k++)
+	{
+		tim1_Update();
+
+		if (TIM1->CCR1 + TIM1->CCR2 != TIM1_PERIOD)
+			torn++;
+
+		if (!duty_Count(TIM1->CCR1))
+			stray++;
+	}
+
+	host_Interrupts(NULL, 0);
+
+	printf("  %u update events, %u table rewrites, %u torn\n", UPDATES, interrupts, torn);
+
+	CHECK(interrupts > 100);
+	CHECK_EQUAL(torn, 0);
+	CHECK_EQUAL(stray, 0);
+
+	pwmDither_Stop();
+}
+
+int main(void)
+{
+	htim1.Instance = TIM1;
+
+	// As HAL_TIM_Base_MspInit()
+	hdma_tim1_up.Instance = DMA2_Stream5;
+	hdma_tim1_up.Init.Channel = DMA_CHANNEL_6;
+	hdma_tim1_up.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma_tim1_up.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_tim1_up.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_tim1_up.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+	hdma_tim1_up.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+	hdma_tim1_up.Init.Mode = DMA_CIRCULAR;
+	hdma_tim1_up.Init.Priority = DMA_PRIORITY_LOW;
+	hdma_tim1_up.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
+	hdma_tim1_up.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_1QUARTERFULL;
+	hdma_tim1_up.Init.MemBurst = DMA_MBURST_SINGLE;
+	hdma_tim1_up.Init.PeriphBurst = DMA_PBURST_SINGLE;
+	HAL_DMA_Init(&hdma_tim1_up);
+
+	test_Start();
+	test_Average();
+	test_Spread();
+	test_Stop();
+	test_Preempted();
+
+	return test_Report("pwm_dither");
+}
@@ -0,0 +1,255 @@
+/** test_replay.c
+ * Host test of the capture and of its replay through the firmware (replay.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The firmware (mppt.c) runs for RECORD_S on the virtual clock against the plant model, from boot, the array at
+ * 400 W/m2 and then, from SKY_CHANGE_S on, at 1000 W/m2; the capture tap records every frame, and at BURST_S a
+ * CMD_CAPTURE burst goes in over USART1. The burst that comes back, decoded (capture_decode.c) from in between the
+ * DEBUG2 lines, has to be what the tap saw. Then the recording is replayed through a fresh boot of the firmware: every duty cycle and every state has
+ * to come out as recorded. Last, the array current is zeroed in PERTURB_FRAMES records from PERTURB_S on, the way a
+ * bad reading would look, and replayed again: the replay has to differ, and not before the first changed record.
+ * The firmware boots once per process, so the recording and the replays run in child processes that leave their
+ * results in shared memory.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "sim_host.h"
+#include "capture_decode.h"
+#include "replay.h"
+#include "mppt.h"
+#include "test.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define RECORD_S			60
+#define SKY_CHANGE_S		30
+#define BURST_S				10
+#define PERTURB_S			40
+#define PERTURB_FRAMES		200
+#define AMBIENT_C			25
+#define MAX_RECORDS			(RECORD_S * 1000 * SIM_MS_NS / SIM_FRAME_NS + 1)
+#define MAX_UART			(256 * 1024)
+#define MAX_BURST			(4 * CAPTURE_RECORDS)
+
+extern uint16_t crc16(uint8_t[], uint8_t, uint16_t);
+
+typedef struct
+{
+	CAPTURE_Record record[MAX_RECORDS];
+	uint32_t count;
+	CAPTURE_Record burst[MAX_BURST];
+	CAPTURE_Decoded decoded;
+	bool commandSent;
+	REPLAY_Diff clean;
+	REPLAY_Diff perturbed;
+} Shared;
+
+static Shared *shared;
+static uint8_t uart[MAX_UART];
+static uint32_t uartLength;
+
+
+static void record_Tap(const ADC_Frame *frame, uint32_t tick, uint16_t duty, uint8_t flags)
+{
+	CAPTURE_Record *record;
+
+	if (shared->count == MAX_RECORDS)
+		return;
+
+	record = &shared->record[shared->count++];
+	record->frame = (uint16_t)frame->sequence;
+	record->tick = tick;
+	memcpy(record->channel, frame->channel, sizeof(record->channel));
+	record->duty = duty;
+	record->flags = flags;
+}
+
+static void record_Uart(const uint8_t *data, uint32_t length)
+{
+	if (uartLength + length > MAX_UART)
+		length = MAX_UART - uartLength;
+
+	memcpy(&uart[uartLength], data, length);
+	uartLength += length;
+}
+
+// CMD_CAPTURE for a burst of every frame. A command is 7 bytes on the wire, so it can't have any escaped in it.
+static void record_Second(uint32_t s)
+{
+	uint8_t command[7] = { 0x9a, CMD_CAPTURE, 0, 1, 1 };
+	uint16_t crc;
+	uint8_t i;
+
+	if (s == SKY_CHANGE_S)
+		plant_SetSky(1000, AMBIENT_C);
+
+	if (s != BURST_S)
+		return;
+
+	crc = crc16(command, 5, 0x0000);
+	command[5] = (uint8_t)crc;
+	command[6] = (uint8_t)(crc >> 8);
+
+	shared->commandSent = true;
+
+	for (i = 1; i < sizeof(command); i++)
+	{
+		if ( (command[i] == 0x9a) || (command[i] == 0x9b) )
+			shared->commandSent = false;
+	}
+
+	sim_UartReceive(command, sizeof(command));
+}
+
+static void record(void)
+{
+	plant_Init(0.5, AMBIENT_C);
+	plant_SetSky(400, AMBIENT_C);
+
+	sim_SetCaptureTap(record_Tap);
+	sim_SetUartOutput(record_Uart);
+	sim_Run(RECORD_S * 1000, record_Second);
+
+	shared->decoded.record = shared->burst;
+	shared->decoded.max = MAX_BURST;
+	captureDecode_Stream(uart, uartLength, &shared->decoded);
+}
+
+static void replay(REPLAY_Diff *diff)
+{
+	replay_Run(shared->record, shared->count, stdout, diff);
+	replay_WriteSummary(diff, stdout);
+}
+
+// Runs what in a child process of its own, with the firmware not booted yet
+static void child(void (*what)(REPLAY_Diff *), REPLAY_Diff *diff)
+{
+	pid_t pid;
+
+	fflush(stdout);
+	pid = fork();
+
+	if (pid == 0)
+	{
+		what(diff);
+		fflush(stdout);
+		_exit(0);
+	}
+
+	waitpid(pid, NULL, 0);
+}
+
+static void record_Child(REPLAY_Diff *diff)
+{
+	UNUSED(diff);
+	record();
+}
+
+static bool record_Equal(const CAPTURE_Record *a, const CAPTURE_Record *b)
+{
+	return (a->frame == b->frame) && (a->tick == b->tick) && (a->duty == b->duty) && (a->flags == b->flags) &&
+		(memcmp(a->channel, b->channel, sizeof(a->channel)) == 0);
+}
+
+static void test_Record(void)
+{
+	uint32_t i, index, equal = 0, consecutive = 0, mppt = 0;
+
+	child(record_Child, NULL);
+
+	printf("  %u frames recorded, %u burst records over USART1 (%u broken, %u dropped)\n", shared->count,
+		shared->decoded.count, shared->decoded.broken, shared->decoded.dropped);
+
+	for (i = 0; i < shared->count; i++)
+	{
+		if (shared->record[i].flags & CAPTURE_MPPT_RUNNING)
+			mppt++;
+	}
+
+	// Every frame from the first, and most of them with the MPPT running
+	CHECK(shared->count > RECORD_S * 1000 * SIM_MS_NS / SIM_FRAME_NS - 100);
+	CHECK_EQUAL(shared->record[0].frame, 1);
+	CHECK(mppt > shared->count / 2);
+
+	// The burst goes on at least until the ring is full, frame after frame, and is what the tap saw (the frame
+	// numbers haven't wrapped yet at BURST_S). The DEBUG2 lines in between don't cost a frame.
+	CHECK(shared->commandSent);
+	CHECK(shared->decoded.count >= CAPTURE_RECORDS - 1);
+	CHECK_EQUAL(shared->decoded.broken, 0);
+	CHECK_EQUAL(shared->decoded.dropped, 0);
+
+	for (i = 0; i < shared->decoded.count; i++)
+	{
+		index = shared->burst[i].frame - 1;
+
+		if ( (index < shared->count) && record_Equal(&shared->burst[i], &shared->record[index]) )
+			equal++;
+
+		if ( (i > 0) && (shared->burst[i].frame == shared->burst[i - 1].frame + 1) )
+			consecutive++;
+	}
+
+	CHECK_EQUAL(equal, shared->decoded.count);
+	CHECK_EQUAL(consecutive, shared->decoded.count - 1);
+	CHECK(shared->burst[0].tick >= BURST_S * 1000);
+}
+
+static void test_Clean(void)
+{
+	child(replay, &shared->clean);
+
+	CHECK_EQUAL(shared->clean.compared, shared->count);
+	CHECK_EQUAL(shared->clean.inputMismatches, 0);
+	CHECK_EQUAL(shared->clean.dutyMismatches, 0);
+	CHECK_EQUAL(shared->clean.flagMismatches, 0);
+	CHECK_EQUAL(shared->clean.first, shared->count);
+}
+
+static void test_Perturbed(void)
+{
+	uint32_t first = PERTURB_S * 1000 * SIM_MS_NS / SIM_FRAME_NS, i;
+
+	for (i = first; i < first + PERTURB_FRAMES; i++)
+		shared->record[i].channel[3] = 0;
+
+	child(replay, &shared->perturbed);
+
+	CHECK_EQUAL(shared->perturbed.compared, shared->count);
+	CHECK_EQUAL(shared->perturbed.inputMismatches, 0);
+	CHECK(shared->perturbed.dutyMismatches > 0);
+	CHECK(shared->perturbed.first >= first);
+	CHECK(shared->perturbed.first < first + PERTURB_FRAMES);
+}
+
+int main(void)
+{
+	shared = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (shared == MAP_FAILED)
+	{
+		printf("FAIL: no shared memory\n");
+		return 1;
+	}
+
+	memset(shared, 0, sizeof(Shared));
+
+	test_Record();
+	test_Clean();
+	test_Perturbed();
+
+	return test_Report("replay");
+}
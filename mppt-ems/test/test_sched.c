@@ -0,0 +1,289 @@
+/** test_sched.c
+ * Host test of the main loop scheduler (sched.c) on a virtual clock, with the per task jitter
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The firmware's task table (tasks[] in mppt.c: periods, offsets, deadlines) runs on a virtual clock that ticks
+ * every TICK_NS, finer than HAL_GetTick() so a start can be seen to be late by less than a mS. Every run of a task
+ * takes the time in cost[] off the main context, and so does every main loop pass (LOOP_NS); the ADC frame interrupt
+ * (every 655.36 uS) and the 1 mS tick interrupt take theirs from whatever they land in. The costs are a load in the
+ * order of what the target's MSG_PROFILE shows, not measurements. The table gives, per task, the runs and counters
+ * sched.c keeps, the start lateness (min, mean, max) and the jitter: the spread of the time between two starts.
+ * - nominal: every task runs every period with no miss; the offsets keep the slow tasks off the measurement ticks,
+ *   so getADCreadings() is never late by more than the events task, a loop pass and the interrupts, and the charge
+ *   task always runs right after it
+ * - overrun: the LCD task takes OVERRUN_MS once, the way a blocking display write did. It misses its deadline,
+ *   the tasks it held up run once and count the releases that passed, and then they are back on their period grid.
+ * - reset: sched_ResetStats() clears the counters and leaves the releases alone
+ */
+
+#include "stm32f4xx_hal.h"
+#include "sched.h"
+#include "mppt.h"
+#include "test.h"
+
+#include <string.h>
+
+#define TICK_NS				100000ULL		// Periods of up to 6.5 S still fit SCHED_Task
+#define TICKS_PER_MS		10
+#define MS_NS				1000000ULL
+#define LOOP_NS				2000ULL
+#define FRAME_NS			655360ULL
+#define FRAME_ISR_NS		15000ULL
+#define TICK_ISR_NS			2000ULL
+#define MESSAGE_PERIOD		1000			// As in mppt.c, with DEBUG2
+#define RUN_S				60
+#define OVERRUN_MS			150
+#define OVERRUN_AT_S		10
+
+#define MS(ms)				((ms) * TICKS_PER_MS)
+
+static void task_Run(uint8_t);
+static void task0(void) { task_Run(0); }
+static void task1(void) { task_Run(1); }
+static void task2(void) { task_Run(2); }
+static void task3(void) { task_Run(3); }
+static void task4(void) { task_Run(4); }
+static void task5(void) { task_Run(5); }
+static void task6(void) { task_Run(6); }
+
+// tasks[] in mppt.c, in virtual clock ticks
+static const SCHED_Task tasks[TASKS] =
+{
+	{ task0,	MS(EVENTS_PERIOD),		MS(0),		MS(100) },
+	{ task1,	MS(MEASURE_PERIOD),		MS(0),		MS(20) },
+	{ task2,	MS(MEASURE_PERIOD),		MS(0),		MS(20) },
+	{ task3,	MS(REQUESTS_PERIOD),	MS(5),		MS(100) },
+	{ task4,	MS(MESSAGE_PERIOD),		MS(50),		MS(1000) },
+	{ task5,	MS(STATS_PERIOD),		MS(20),		MS(100) },
+	{ task6,	MS(LCD_PERIOD),			MS(70),		MS(100) }
+};
+
+static const char *taskName[TASKS] = { "events", "measure", "charge", "requests", "message", "stats", "lcd" };
+
+// Time a run takes, nS
+static const uint64_t cost[TASKS] = { 10000, 40000, 30000, 5000, 300000, 150000, 400000 };
+
+typedef struct
+{
+	uint64_t lastStart;
+	uint64_t minInterval;
+	uint64_t maxInterval;
+	uint64_t minLate;
+	uint64_t maxLate;
+	uint64_t totalLate;
+	uint32_t runs;
+} Jitter;
+
+static SCHED_State taskState[TASKS];
+static Jitter jitter[TASKS];
+
+static uint64_t nowNs, nextFrame, nextTick;
+static uint64_t overrunNs;
+static uint64_t measureStart, chargeGap;
+
+
+static uint32_t clock_Now(void)
+{
+	return (uint32_t)(nowNs / TICK_NS);
+}
+
+// The main context works for ns, and every interrupt that comes meanwhile adds its own time
+static void work(uint64_t ns)
+{
+	uint64_t end = nowNs + ns;
+
+	while ( (nextFrame <= end) || (nextTick <= end) )
+	{
+		if (nextFrame <= nextTick)
+		{
+			nextFrame += FRAME_NS;
+			end += FRAME_ISR_NS;
+		}
+		else
+		{
+			nextTick += MS_NS;
+			end += TICK_ISR_NS;
+		}
+	}
+
+	nowNs = end;
+}
+
+static void task_Run(uint8_t k)
+{
+	Jitter *j = &jitter[k];
+	uint64_t release = (uint64_t)sched_GetState(k)->release * TICK_NS;
+	uint64_t late = nowNs - release, interval = nowNs - j->lastStart;
+
+	if (j->runs > 0)
+	{
+		if ( (j->runs == 1) || (interval < j->minInterval) )
+			j->minInterval = interval;
+
+		if (interval > j->maxInterval)
+			j->maxInterval = interval;
+	}
+
+	if ( (j->runs == 0) || (late < j->minLate) )
+		j->minLate = late;
+
+	if (late > j->maxLate)
+		j->maxLate = late;
+
+	j->totalLate += late;
+	j->lastStart = nowNs;
+	j->runs++;
+
+	if (k == TASK_MEASURE)
+		measureStart = nowNs;
+
+	if ( (k == TASK_CHARGE) && (nowNs - measureStart > chargeGap) )
+		chargeGap = nowNs - measureStart;
+
+	if ( (k == TASK_LCD) && (overrunNs != 0) )
+	{
+		work(overrunNs);
+		overrunNs = 0;
+		return;
+	}
+
+	work(cost[k]);
+}
+
+// The main loop, until the clock gets to s
+static void loop(uint32_t s)
+{
+	while (nowNs < s * 1000000000ULL)
+	{
+		sched_Run();
+		work(LOOP_NS);
+	}
+}
+
+static void start(void)
+{
+	nowNs = 0;
+	nextFrame = FRAME_NS;
+	nextTick = MS_NS;
+	chargeGap = 0;
+	memset(jitter, 0, sizeof(jitter));
+
+	sched_Init(tasks, taskState, TASKS, clock_Now);
+}
+
+static void report(const char *run)
+{
+	const SCHED_State *state;
+	const Jitter *j;
+	uint8_t k;
+
+	for (k = 0; k < TASKS; k++)
+	{
+		state = sched_GetState(k);
+		j = &jitter[k];
+
+		printf("%s,%s,%u,%.0f,%u,%u,%u,%.1f,%.1f,%.1f,%.1f\n", run, taskName[k], tasks[k].period / TICKS_PER_MS,
+			cost[k] / 1e3, state->runs, state->misses, state->skipped, j->minLate / 1e3,
+			(j->runs != 0) ? j->totalLate / 1e3 / j->runs : 0, j->maxLate / 1e3, (j->maxInterval - j->minInterval) / 1e3);
+	}
+}
+
+// Releases that have come by now, and the release after them
+static uint32_t releases(uint8_t k)
+{
+	uint32_t now = clock_Now();
+
+	if (now < tasks[k].offset)
+		return 0;
+
+	return (now - tasks[k].offset) / tasks[k].period + 1;
+}
+
+static void test_Nominal(void)
+{
+	uint8_t k;
+
+	start();
+	loop(RUN_S);
+	report("nominal");
+
+	for (k = 0; k < TASKS; k++)
+	{
+		CHECK_EQUAL(taskState[k].misses, 0);
+		CHECK_EQUAL(taskState[k].skipped, 0);
+		CHECK(taskState[k].runs + 1 >= releases(k));
+		CHECK(taskState[k].runs <= releases(k));
+	}
+
+	// A measurement tick waits for the events task, the rest of a loop pass and the interrupts, never a slow task
+	CHECK(jitter[TASK_MEASURE].maxLate < TICK_NS / 2 + cost[TASK_EVENTS] + LOOP_NS + FRAME_ISR_NS + TICK_ISR_NS);
+	CHECK(jitter[TASK_MEASURE].maxInterval - jitter[TASK_MEASURE].minInterval < TICK_NS);
+	CHECK(chargeGap <= cost[TASK_MEASURE] + FRAME_ISR_NS + TICK_ISR_NS);
+}
+
+static void test_Overrun(void)
+{
+	uint8_t k;
+
+	start();
+	loop(OVERRUN_AT_S);
+	overrunNs = OVERRUN_MS * MS_NS;
+	loop(RUN_S);
+	report("overrun");
+
+	CHECK_EQUAL(taskState[TASK_LCD].misses, 1);
+	CHECK_EQUAL(taskState[TASK_EVENTS].skipped, OVERRUN_MS / EVENTS_PERIOD - 1);
+	CHECK_EQUAL(taskState[TASK_MEASURE].skipped, 1);
+	CHECK_EQUAL(taskState[TASK_MEASURE].misses, 1);
+	CHECK_EQUAL(taskState[TASK_MESSAGE].misses, 0);
+
+	// Every release either ran or was counted as skipped, and the next one is still on the grid
+	for (k = 0; k < TASKS; k++)
+	{
+		CHECK(taskState[k].runs + taskState[k].skipped + 1 >= releases(k));
+		CHECK(taskState[k].runs + taskState[k].skipped <= releases(k));
+		CHECK_EQUAL((taskState[k].release - tasks[k].offset) % tasks[k].period, 0);
+	}
+}
+
+static void test_Reset(void)
+{
+	uint32_t release[TASKS];
+	uint8_t k;
+
+	for (k = 0; k < TASKS; k++)
+		release[k] = taskState[k].release;
+
+	sched_ResetStats();
+
+	for (k = 0; k < TASKS; k++)
+	{
+		CHECK_EQUAL(taskState[k].runs, 0);
+		CHECK_EQUAL(taskState[k].misses, 0);
+		CHECK_EQUAL(taskState[k].skipped, 0);
+		CHECK_EQUAL(taskState[k].maxLateness, 0);
+		CHECK_EQUAL(taskState[k].release, release[k]);
+	}
+}
+
+int main(void)
+{
+	printf("run,task,period_ms,cost_us,runs,misses,skipped,late_min_us,late_mean_us,late_max_us,jitter_us\n");
+
+	test_Nominal();
+	test_Overrun();
+	test_Reset();
+
+	return test_Report("sched");
+}
@@ -0,0 +1,148 @@
+/** test_sim.c
+ * Host test of the whole firmware (mppt.c) on the virtual clock (sim_host.c) against the plant model
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * The firmware boots into a battery at 88 % and 25 degC, with the array at BULK_IRRADIANCE for BULK_S: it has to
+ * start the converter and track the array's MPP, the battery well below its absorption voltage. Then the sun comes
+ * out to 1000 W/m2, which is more than the battery takes at 88 %: it has to charge up to the absorption voltage and
+ * hold it there with the regulator, the charge current tapering off as the battery fills. The table gives the duty
+ * cycle trajectory every TRAJECTORY_S; the summary row the stage times and the energy harvested.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "sim_host.h"
+#include "pv_model.h"
+#include "mppt.h"
+#include "test.h"
+
+#define BULK_IRRADIANCE		400
+#define BULK_S				240
+#define RUN_S				600
+#define SETTLE_S			60			// Allowed for the start, and for the jump to the absorption voltage
+#define TRAJECTORY_S		20
+#define AMBIENT_C			25
+#define TARGET_BAND_MV		30
+
+extern uint8_t chargeState;
+extern uint16_t dutyApplied;
+extern volatile bool regulating;
+int32_t AdsorptionVoltage(int32_t);
+
+static int32_t target;
+static uint32_t mpptStart, absorptionStart;
+static double mppWatts, availableWh, bulkArrayWh;
+static int32_t maxMv, minHeldMv = INT32_MAX;
+static int32_t heldStartMa, heldEndMa;
+static uint32_t heldSeconds, heldRegulating;
+
+
+static void sky(double irradiance)
+{
+	double volts;
+
+	plant_SetSky(irradiance, AMBIENT_C);
+	mppWatts = pv_MaxPower(&volts);
+}
+
+static void second(uint32_t s)
+{
+	const PLANT_Readings *r = sim_Readings();
+
+	if ( (mpptStart == 0) && (chargeState == CHARGE_MPPT) )
+		mpptStart = s;
+
+	// What the array could have given over the second, at its MPP
+	availableWh += mppWatts / 3600;
+
+	if (s == SETTLE_S)
+	{
+		availableWh = 0;
+		bulkArrayWh = plant_ArrayWh();
+	}
+
+	if (s == BULK_S)
+	{
+		bulkArrayWh = plant_ArrayWh() - bulkArrayWh;
+		sky(1000);
+	}
+
+	if ( (absorptionStart == 0) && (r->vBat >= target - TARGET_BAND_MV) )
+		absorptionStart = s;
+
+	if (r->vBat > maxMv)
+		maxMv = r->vBat;
+
+	if ( (absorptionStart != 0) && (s >= absorptionStart + SETTLE_S) )
+	{
+		if (heldSeconds == 0)
+			heldStartMa = r->iBat;
+
+		heldSeconds++;
+		heldEndMa = r->iBat;
+
+		if (regulating)
+			heldRegulating++;
+
+		if (r->vBat < minHeldMv)
+			minHeldMv = r->vBat;
+	}
+
+	if (s % TRAJECTORY_S == 0)
+		printf("%u,%u,%u,%d,%d,%d\n", s, chargeState, dutyApplied, r->vBat, r->vSolar, r->iBat);
+}
+
+int main(void)
+{
+	double bulkAvailableWh;
+
+	target = AdsorptionVoltage(AMBIENT_C * 100);
+
+	plant_Init(0.88, AMBIENT_C);
+	sky(BULK_IRRADIANCE);
+
+	printf("t_s,state,duty,vbat_mv,vsolar_mv,ibat_ma\n");
+
+	sim_Run(BULK_S * 1000, second);
+	bulkAvailableWh = availableWh;
+
+	sim_Run((RUN_S - BULK_S) * 1000, second);
+
+	printf("mppt_start_s,bulk_tracking_pct,absorption_start_s,max_mv,min_held_mv,held_regulating_pct,taper_ma,"
+		"array_wh,charge_wh,frames\n");
+	printf("%u,%.2f,%u,%d,%d,%.1f,%d,%.2f,%.2f,%u\n", mpptStart, 100 * bulkArrayWh / bulkAvailableWh, absorptionStart,
+		maxMv, minHeldMv, 100.0 * heldRegulating / heldSeconds, heldStartMa - heldEndMa, plant_ArrayWh(),
+		plant_ChargeWh(), sim_Frames());
+
+	// The converter starts, and tracks the array's MPP while the battery is below the absorption voltage
+	CHECK(mpptStart != 0);
+	CHECK(mpptStart < SETTLE_S);
+	CHECK(100 * bulkArrayWh / bulkAvailableWh > 97.0);
+
+	// In full sun the battery goes up to the absorption voltage, not over it, and the regulator holds it there
+	CHECK(absorptionStart > BULK_S);
+	CHECK(absorptionStart < BULK_S + SETTLE_S);
+	CHECK(maxMv <= target + TARGET_BAND_MV);
+	CHECK(heldSeconds > 0);
+	CHECK(minHeldMv >= target - TARGET_BAND_MV);
+	CHECK_EQUAL(heldRegulating, heldSeconds);
+	CHECK_EQUAL(chargeState, CHARGE_MPPT);
+
+	// And the battery takes less and less as it fills
+	CHECK(heldEndMa < heldStartMa);
+
+	// Every frame of the run was played
+	CHECK_EQUAL(sim_Frames(), RUN_S * SIM_MS_NS * 1000 / SIM_FRAME_NS);
+
+	return test_Report("sim");
+}
@@ -0,0 +1,204 @@
+/** test_stats.c
+ * Host test for the running window statistics (stats.c)
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * Every window is fed far more samples than it holds, so the ring, both queues and their uint8_t indexes wrap
+ * many times, and after every sample its statistics are checked against a brute force pass over the last size slots.
+ * The sizes include the three updateStats() uses and 255, the largest an uint8_t index allows.
+ */
+
+#include "stats.h"
+#include "test.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#define MAX_SLOTS		255
+#define SAMPLES			20000
+
+static int32_t sample[MAX_SLOTS];
+static uint8_t minQ[MAX_SLOTS], maxQ[MAX_SLOTS];
+
+static int32_t history[SAMPLES];		// Every slot value pushed, oldest first
+static uint32_t slots;
+
+
+typedef int32_t (*Source)(uint32_t);
+
+static int32_t source_Random(uint32_t i)
+{
+	return rand() % 30001;
+}
+
+// Temperatures in centi-degC go negative
+static int32_t source_Signed(uint32_t i)
+{
+	return rand() % 8001 - 4000;
+}
+
+// Strictly rising then strictly falling runs longer than the window: the queues fill up and empty in one go
+static int32_t source_Sawtooth(uint32_t i)
+{
+	return ((i / 300) & 1) ? 29999 - (i % 300) * 50 : (i % 300) * 50;
+}
+
+static int32_t source_Constant(uint32_t i)
+{
+	return 13000;
+}
+
+/** Feeds SAMPLES values from source into a window of size slots, decimation samples each, and compares
+ * every statistic with the brute force values after every sample. Returns the number of mismatches.
+ */
+static uint32_t check_Window(uint8_t size, uint8_t decimation, Source source)
+{
+	STATS_Window w;
+	int64_t sum, sumSquares, variance;
+	int32_t pendingSum = 0, min, max, value;
+	uint32_t i, k, first, count, mismatches = 0;
+
+	stats_Init(&w, sample, minQ, maxQ, size, decimation);
+	slots = 0;
+
+	for (i = 0; i < SAMPLES; i++)
+	{
+		value = source(i);
+		stats_Add(&w, value);
+
+		pendingSum += value;
+
+		if ((i + 1) % decimation == 0)
+		{
+			history[slots++] = pendingSum / decimation;
+			pendingSum = 0;
+		}
+
+		count = (slots < size) ? slots : size;
+		first = slots - count;
+		sum = 0;
+		sumSquares = 0;
+		min = 0;
+		max = 0;
+
+		for (k = first; k < slots; k++)
+		{
+			sum += history[k];
+			sumSquares += (int64_t)history[k] * history[k];
+
+			if ( (k == first) || (history[k] < min) )
+				min = history[k];
+
+			if ( (k == first) || (history[k] > max) )
+				max = history[k];
+		}
+
+		variance = (count != 0) ? (sumSquares - sum * sum / count) / count : 0;
+
+		if ( (stats_Count(&w) != count)
+			|| (stats_Mean(&w) != ((count != 0) ? sum / count : 0))
+			|| (stats_Min(&w) != min)
+			|| (stats_Max(&w) != max)
+			|| (stats_Variance(&w) != (uint32_t)variance)
+			|| (stats_StdDev(&w) != (uint32_t)sqrt((double)variance)) )
+		{
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+static void test_Sizes(void)
+{
+	static const uint8_t size[] = { 1, 2, 5, 60, 254, 255 };
+	static const Source source[] = { source_Random, source_Signed, source_Sawtooth, source_Constant };
+	uint32_t mismatches = 0;
+	uint8_t s, k;
+
+	srand(7);
+
+	for (s = 0; s < sizeof(size); s++)
+	{
+		for (k = 0; k < sizeof(source) / sizeof(source[0]); k++)
+			mismatches += check_Window(size[s], 1, source[k]);
+	}
+
+	CHECK_EQUAL(mismatches, 0);
+}
+
+// The quarter hour window: 60 slots of 15 samples, fed 5 hours of seconds
+static void test_Decimation(void)
+{
+	CHECK_EQUAL(check_Window(60, 15, source_Random), 0);
+	CHECK_EQUAL(check_Window(60, 15, source_Sawtooth), 0);
+	CHECK_EQUAL(check_Window(255, 255, source_Signed), 0);
+}
+
+// A reset window starts over as if new, with the decimation it was given
+static void test_Reset(void)
+{
+	STATS_Window w;
+	uint16_t i;
+
+	stats_Init(&w, sample, minQ, maxQ, 5, 2);
+
+	for (i = 0; i < 1000; i++)
+		stats_Add(&w, i);
+
+	stats_Add(&w, 12345);
+	stats_Reset(&w);
+
+	CHECK_EQUAL(stats_Count(&w), 0);
+	CHECK_EQUAL(stats_Mean(&w), 0);
+	CHECK_EQUAL(stats_Min(&w), 0);
+	CHECK_EQUAL(stats_Max(&w), 0);
+	CHECK_EQUAL(stats_StdDev(&w), 0);
+
+	// The half slot from before the reset is gone
+	stats_Add(&w, 10);
+	CHECK_EQUAL(stats_Count(&w), 0);
+
+	stats_Add(&w, 20);
+	CHECK_EQUAL(stats_Count(&w), 1);
+	CHECK_EQUAL(stats_Mean(&w), 15);
+	CHECK_EQUAL(stats_Min(&w), 15);
+	CHECK_EQUAL(stats_Max(&w), 15);
+}
+
+// Full scale battery current on every one of 255 slots: the running sums hold it
+static void test_Range(void)
+{
+	STATS_Window w;
+	uint16_t i;
+
+	stats_Init(&w, sample, minQ, maxQ, 255, 1);
+
+	for (i = 0; i < 600; i++)
+		stats_Add(&w, (i & 1) ? 30000 : -30000);
+
+	CHECK_EQUAL(stats_Mean(&w), 30000 / 255);
+	CHECK_EQUAL(stats_Min(&w), -30000);
+	CHECK_EQUAL(stats_Max(&w), 30000);
+	CHECK_EQUAL(stats_StdDev(&w), 29999);
+}
+
+int main(void)
+{
+	test_Sizes();
+	test_Decimation();
+	test_Reset();
+	test_Range();
+
+	return test_Report("stats");
+}
@@ -0,0 +1,300 @@
+/** test_uart_tx.c
+ * Host test of the UART transmit queue (uart_tx.c) on the UART stand-in, with the transfers completed from a signal
+ *
+ * (c) 2018 Solar Technology Inc.
+ * 7620 Cetronia Road
+ * Allentown PA, 18106
+ * 610-391-8600
+ *
+ * This code is for the exclusive use of Solar Technology Inc.
+ * and cannot be used in its present or any other modified form
+ * without prior written authorization.
+ *
+ * HOST PROCESSOR: STM32F410RBT6
+ * Developed using STM32CubeF4 HAL and API version 1.18.0
+ *
+ * HAL_UART_Transmit_DMA() on the host logs the frame and leaves the UART busy until host_UartComplete(), which calls
+ * HAL_UART_TxCpltCallback() the way the transmission complete interrupt does, and that hands over to
+ * uartTx_Complete() as mppt.c does:
+ * - order: frames queued while the UART is busy go out one DMA start each, whole and in the order they were sent,
+ *   and every done callback comes once, in order, after its frame is out and not before.
+ * - full: with nothing completing, the queue takes UART_TX_QUEUE - 1 frames. The next is refused and nothing of it
+ *   goes out; once a frame completes it is taken, and goes out last.
+ * - preempted: a signal every INTERRUPT_US completes the frame going out while the main context sends FRAMES
+ *   numbered frames from a pool of buffers as fast as it can, the way sendFrame() does, retrying the ones refused.
+ *   Every frame has to go out once, whole and in order, and every buffer has to come back.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "uart_tx.h"
+#include "test.h"
+
+#include <string.h>
+
+#define INTERRUPT_US		20
+#define FRAMES				3000
+#define FRAME_MAX			12
+#define POOL				UART_TX_QUEUE
+
+static UART_HandleTypeDef huart;
+
+static uint8_t buffer[POOL][FRAME_MAX];
+static volatile bool inUse[POOL];
+static volatile uint32_t doneCount;
+static volatile uint32_t doneEarly;
+static volatile uint32_t doneOutOfOrder;
+static const uint8_t *doneExpected[FRAMES];
+static uint32_t doneEnd[FRAMES];		// Log length once frame k is out
+static volatile uint32_t logged;
+static volatile uint32_t interruptCompletes;
+
+
+// The firmware's callback, as in mppt.c
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *h)
+{
+	UNUSED(h);
+	uartTx_Complete();
+}
+
+// Frame k: its length, then k in two bytes, then filler, so a frame lost, doubled, cut or swapped shows in the log
+static uint16_t frame_Fill(uint8_t *data, uint32_t k)
+{
+	uint16_t length = 4 + k % (FRAME_MAX - 3), n;
+
+	data[0] = length;
+	data[1] = k >> 8;
+	data[2] = k;
+
+	for (n = 3; n < length; n++)
+		data[n] = k + n;
+
+	return length;
+}
+
+// Walks the log frame by frame and returns how many are frames 0, 1, 2 .. in that order, all of the log or not
+static uint32_t log_Frames(uint32_t *bytes)
+{
+	const uint8_t *log = host_UartLog();
+	uint8_t expected[FRAME_MAX];
+	uint32_t at = 0, k = 0;
+	uint16_t length;
+
+	while (at < host_UartLogLength())
+	{
+		length = frame_Fill(expected, k);
+
+		if ( (at + length > host_UartLogLength()) || (memcmp(&log[at], expected, length) != 0) )
+			break;
+
+		at += length;
+		k++;
+	}
+
+	*bytes = at;
+	return k;
+}
+
+static void frame_Done(const uint8_t *data)
+{
+	uint8_t k;
+
+	if ( (doneCount >= FRAMES) || (data != doneExpected[doneCount]) )
+		doneOutOfOrder++;
+
+	// The frame's bytes have to be out before its buffer comes back
+	if ( (doneCount < FRAMES) && (host_UartLogLength() < doneEnd[doneCount]) )
+		doneEarly++;
+
+	for (k = 0; k < POOL; k++)
+	{
+		if (data == buffer[k])
+			inUse[k] = false;
+	}
+
+	doneCount++;
+}
+
+static void reset(void)
+{
+	uint8_t k;
+
+	host_UartLogClear();
+	uartTx_Init(&huart);
+	HAL_UART_Init(&huart);
+
+	for (k = 0; k < POOL; k++)
+		inUse[k] = false;
+
+	doneCount = 0;
+	doneEarly = 0;
+	doneOutOfOrder = 0;
+	logged = 0;
+}
+
+static void test_Order(void)
+{
+	uint32_t k, starts, bytes, sent = 0;
+	uint16_t length;
+
+	reset();
+	starts = host_UartStarts();
+
+	for (k = 0; k < UART_TX_QUEUE - 1; k++)
+	{
+		length = frame_Fill(buffer[k], k);
+		sent += length;
+		doneExpected[k] = buffer[k];
+		doneEnd[k] = sent;
+		CHECK(uartTx_Send(buffer[k], length, frame_Done));
+	}
+
+	// The first frame went out as it was sent, the rest wait for it
+	CHECK(host_UartBusy());
+	CHECK_EQUAL(host_UartStarts() - starts, 1);
+	CHECK_EQUAL(host_UartLogLength(), doneEnd[0]);
+	CHECK_EQUAL(doneCount, 0);
+
+	for (k = 1; k < UART_TX_QUEUE - 1; k++)
+	{
+		host_UartComplete();
+		CHECK_EQUAL(doneCount, k);
+		CHECK_EQUAL(host_UartStarts() - starts, k + 1);
+	}
+
+	host_UartComplete();
+
+	CHECK(!host_UartBusy());
+	CHECK_EQUAL(host_UartStarts() - starts, UART_TX_QUEUE - 1);
+	CHECK_EQUAL(log_Frames(&bytes), UART_TX_QUEUE - 1);
+	CHECK_EQUAL(bytes, sent);
+	CHECK_EQUAL(host_UartLogLength(), sent);
+	CHECK_EQUAL(doneCount, UART_TX_QUEUE - 1);
+	CHECK_EQUAL(doneOutOfOrder, 0);
+	CHECK_EQUAL(doneEarly, 0);
+
+	// With nothing going out the next frame starts at once
+	length = frame_Fill(buffer[0], UART_TX_QUEUE - 1);
+	CHECK(uartTx_Send(buffer[0], length, NULL));
+	CHECK_EQUAL(host_UartStarts() - starts, UART_TX_QUEUE);
+	host_UartComplete();
+	CHECK_EQUAL(doneCount, UART_TX_QUEUE - 1);
+	CHECK_EQUAL(log_Frames(&bytes), UART_TX_QUEUE);
+}
+
+static void test_Full(void)
+{
+	uint8_t refused[FRAME_MAX];
+	uint32_t k, starts, bytes, sent = 0;
+	uint16_t length;
+
+	reset();
+	starts = host_UartStarts();
+
+	for (k = 0; k < UART_TX_QUEUE - 1; k++)
+	{
+		length = frame_Fill(buffer[k], k);
+		sent += length;
+		doneExpected[k] = buffer[k];
+		doneEnd[k] = sent;
+		CHECK(uartTx_Send(buffer[k], length, frame_Done));
+	}
+
+	// Refused, again and again, and nothing of it queued
+	memset(refused, 0xEE, sizeof(refused));
+	CHECK(!uartTx_Send(refused, sizeof(refused), frame_Done));
+	CHECK(!uartTx_Send(refused, sizeof(refused), frame_Done));
+	CHECK_EQUAL(host_UartStarts() - starts, 1);
+
+	// One frame out makes room for one
+	host_UartComplete();
+	CHECK_EQUAL(doneCount, 1);
+
+	length = frame_Fill(buffer[UART_TX_QUEUE - 1], UART_TX_QUEUE - 1);
+	sent += length;
+	doneExpected[UART_TX_QUEUE - 1] = buffer[UART_TX_QUEUE - 1];
+	doneEnd[UART_TX_QUEUE - 1] = sent;
+	CHECK(uartTx_Send(buffer[UART_TX_QUEUE - 1], length, frame_Done));
+	CHECK(!uartTx_Send(refused, sizeof(refused), frame_Done));
+
+	while (host_UartBusy())
+		host_UartComplete();
+
+	CHECK_EQUAL(doneCount, UART_TX_QUEUE);
+	CHECK_EQUAL(doneOutOfOrder, 0);
+	CHECK_EQUAL(doneEarly, 0);
+	CHECK_EQUAL(host_UartStarts() - starts, UART_TX_QUEUE);
+	CHECK_EQUAL(log_Frames(&bytes), UART_TX_QUEUE);
+	CHECK_EQUAL(bytes, sent);
+	CHECK_EQUAL(host_UartLogLength(), sent);
+}
+
+/** The transmission complete interrupt. A frame is only done once HAL_UART_Transmit_DMA() has logged all of it,
+ * which is the last thing it does: on the target the interrupt can't come before the DMA has the frame either.
+ */
+static void uart_Interrupt(void)
+{
+	if ( host_UartBusy() && (host_UartLogLength() != logged) )
+	{
+		logged = host_UartLogLength();
+		interruptCompletes++;
+		host_UartComplete();
+	}
+}
+
+static void test_Preempted(void)
+{
+	uint32_t k, bytes, refusals = 0, starts, sent = 0;
+	uint16_t length;
+	uint8_t slot = 0;
+
+	reset();
+	starts = host_UartStarts();
+	interruptCompletes = 0;
+
+	host_Interrupts(uart_Interrupt, INTERRUPT_US);
+
+	for (k = 0; k < FRAMES; k++)
+	{
+		// A buffer comes back once its frame is out
+		while (inUse[slot])
+			slot = (slot + 1) % POOL;
+
+		inUse[slot] = true;
+		length = frame_Fill(buffer[slot], k);
+		sent += length;
+		doneExpected[k] = buffer[slot];
+		doneEnd[k] = sent;
+
+		while (!uartTx_Send(buffer[slot], length, frame_Done))
+			refusals++;
+	}
+
+	while (doneCount < FRAMES)
+		;
+
+	host_Interrupts(NULL, 0);
+
+	printf("  %u frames, %u refused sends, %u interrupts completed a frame\n", FRAMES, refusals, interruptCompletes);
+
+	CHECK(refusals > 0);
+	CHECK_EQUAL(interruptCompletes, FRAMES);
+	CHECK_EQUAL(host_UartStarts() - starts, FRAMES);
+	CHECK_EQUAL(log_Frames(&bytes), FRAMES);
+	CHECK_EQUAL(bytes, sent);
+	CHECK_EQUAL(host_UartLogLength(), sent);
+	CHECK_EQUAL(doneCount, FRAMES);
+	CHECK_EQUAL(doneOutOfOrder, 0);
+	CHECK_EQUAL(doneEarly, 0);
+
+	for (k = 0; k < POOL; k++)
+		CHECK(!inUse[k]);
+}
+
+int main(void)
+{
+	test_Order();
+	test_Full();
+	test_Preempted();
+
+	return test_Report("uart_tx");
+}
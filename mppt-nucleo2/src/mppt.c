@@ -415,22 +415,23 @@ static void MX_TIM9_Init(void) {
 	  HAL_TIM_Base_Start_IT(&htim9);
 }
 
-//Used as a 5uS timer.
+//Free running 1 uS counter for delay_nus().
 static void MX_TIM11_Init(void) {
 
 	  TIM_ClockConfigTypeDef sClockSourceConfig;
 	  TIM_MasterConfigTypeDef sMasterConfig;
 
 	  htim11.Instance = TIM11;
-	  htim11.Init.Prescaler = 1;
+	  htim11.Init.Prescaler = 99; // 100 MHz (APB2 timer clock) / 100 = 1 MHz clock... 1 uS count interval
 	  htim11.Init.CounterMode = TIM_COUNTERMODE_UP;
-	  htim11.Init.Period = 250;
+	  htim11.Init.Period = 0xffff; // Full 16 bit counter
 	  htim11.Init.ClockDivision = TIM_CLOCKDIVISION_DIV2;
 	  if (HAL_TIM_Base_Init(&htim11) != HAL_OK)
 	  {
 	    Error_Handler();
 	  }
 
+	  // TIM11 has no slave mode controller: whatever the source says, it counts the internal clock
 	  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_ITR0; //TIM_CLOCKSOURCE_INTERNAL;
 	  if (HAL_TIM_ConfigClockSource(&htim11, &sClockSourceConfig) != HAL_OK)
 	  {
@@ -444,7 +445,7 @@ static void MX_TIM11_Init(void) {
 	    Error_Handler();
 	  }
 
-	  HAL_TIM_Base_Start_IT(&htim11);
+	  HAL_TIM_Base_Start(&htim11);
 }
 
 
@@ -593,12 +594,6 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
 //		HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_11);
 //		HAL_GPIO_TogglePin(GPIOA, GPIO_PIN_5);
 	}
-
-	else if (htim->Instance == TIM11)
-	{
-		if (usCounter != 0)
-		usCounter--;
-	}
 }
 
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc1) {
@@ -758,6 +753,7 @@ static uint16_t FloatVoltage(uint16_t tempAmbient)
 		return (TV_40 - ((tempAmbient - TEMP_40) * RATE2) / 100);
 }
 
+// Ten 5 uS edges, as the old 5 uS TIM11 update tick gave them
 static void pulse()
 {
 
@@ -765,16 +761,17 @@ static void pulse()
 
 	for (i=0; i<=9; i++)
 	{
-		delay_nus(1);
+		delay_nus(5);
 		HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_11);
 	}
 }
 
+// Spins for usDelay uS (up to 65535) on the free running TIM11 count. Interrupts keep running.
 void delay_nus(uint32_t usDelay)
 {
-	usCounter = usDelay;
-	while (usCounter != 0);
+	uint16_t start = __HAL_TIM_GET_COUNTER(&htim11);
 
+	while ((uint16_t)(__HAL_TIM_GET_COUNTER(&htim11) - start) < usDelay);
 }
 
 void writeFlash(uint16_t data)